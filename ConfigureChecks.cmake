@@ -27,5 +27,7 @@ check_function_exists(gmtime_r HAVE_GMTIME_R)
 check_function_exists(timegm HAVE_TIMEGM)
 check_function_exists(localtime_r HAVE_LOCALTIME_R)
 check_function_exists(strtok_r HAVE_STRTOK_R)
+check_function_exists(copy_file_range HAVE_COPY_FILE_RANGE)
+check_symbol_exists(sendfile "sys/sendfile.h" HAVE_SENDFILE)
 
 cmake_pop_check_state()
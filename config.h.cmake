@@ -50,6 +50,12 @@
 /* Defines if strtok_r is available on your system */
 #cmakedefine01 HAVE_STRTOK_R
 
+/* Defines if copy_file_range is available on your system */
+#cmakedefine01 HAVE_COPY_FILE_RANGE
+
+/* Defines if Linux sendfile is available on your system */
+#cmakedefine01 HAVE_SENDFILE
+
 /* Define to 1 if you have a big endian machine */
 #cmakedefine01 WORDS_BIGENDIAN
 
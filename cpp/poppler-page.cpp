@@ -290,6 +290,7 @@ ustring page::text(const rectf &r, text_layout_enum layout_mode) const
     const bool use_raw_order = (layout_mode == raw_order_layout);
     const bool use_physical_layout = (layout_mode == physical_layout);
     TextOutputDev td(&appendToGooString, &out, use_physical_layout, 0, use_raw_order, false);
+    td.setStreamOnly(true);
     if (r.is_empty()) {
         d->doc->doc->displayPage(&td, d->index + 1, 72, 72, 0, false, true, false);
     } else {
@@ -299,7 +300,7 @@ ustring page::text(const rectf &r, text_layout_enum layout_mode) const
         }
         d->doc->doc->displayPageSlice(&td, d->index + 1, 72, 72, 0, false, true, false, r.left(), r.top(), r.width(), r.height());
     }
-    return ustring::from_utf8(out.c_str());
+    return ustring::from_utf8(out.c_str(), static_cast<int>(out.size()));
 }
 
 /*
@@ -412,7 +413,7 @@ std::vector<text_box> page::text_list(int opt_flag) const
     output_list.reserve(words.size());
     for (const TextWord *word : words) {
         const std::unique_ptr<std::string> wordText = word->getText();
-        const ustring ustr = ustring::from_utf8(wordText->c_str());
+        const ustring ustr = ustring::from_utf8(wordText->c_str(), static_cast<int>(wordText->size()));
 
         double xMin, yMin, xMax, yMax;
         word->getBBox(&xMin, &yMin, &xMax, &yMax);
@@ -11,3 +11,13 @@
 #include "ImgWriter.h"
 
 ImgWriter::~ImgWriter() = default;
+
+bool ImgWriter::writeRows(unsigned char **rows, int rowCount)
+{
+    for (int y = 0; y < rowCount; ++y) {
+        if (!writeRow(&rows[y])) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -32,6 +32,11 @@ public:
     virtual bool writePointers(unsigned char **rowPointers, int rowCount) = 0;
     virtual bool writeRow(unsigned char **row) = 0;
 
+    // Write the next <rowCount> rows of the image.  Unlike writePointers,
+    // this can be called any number of times between init() and close(),
+    // so the image can be handed over in bands, top to bottom.
+    virtual bool writeRows(unsigned char **rows, int rowCount);
+
     virtual bool close() = 0;
     virtual bool supportCMYK() { return false; }
 };
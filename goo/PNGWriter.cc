@@ -19,14 +19,346 @@
 #if ENABLE_LIBPNG
 
 #    include <zlib.h>
+#    include <algorithm>
+#    include <condition_variable>
 #    include <cstdlib>
 #    include <cstring>
+#    include <deque>
+#    include <memory>
+#    include <mutex>
+#    include <thread>
+#    include <vector>
 
 #    include "poppler/Error.h"
 #    include "goo/gmem.h"
 
 #    include <png.h>
 
+//------------------------------------------------------------------------
+// PNGChunkEncoder
+//------------------------------------------------------------------------
+
+// Encodes the image data in independent chunks of rows, the way pigz
+// compresses: the rows are filtered on the calling thread as they come
+// in, and each chunk is deflated on a worker thread, with the 32 KB of
+// data before it as dictionary.  All chunks but the last end with a sync
+// flush, so their output concatenates into one zlib stream; each chunk
+// is written as one IDAT.
+class PNGChunkEncoder
+{
+public:
+    PNGChunkEncoder(png_structp pngA, int nThreads, size_t rowBytesA, int bppA, int heightA, bool filterA);
+    ~PNGChunkEncoder();
+
+    PNGChunkEncoder(const PNGChunkEncoder &) = delete;
+    PNGChunkEncoder &operator=(const PNGChunkEncoder &) = delete;
+
+    bool writeRows(unsigned char **rows, int rowCount);
+    bool finish();
+
+private:
+    struct Chunk
+    {
+        std::vector<unsigned char> dict; // the data preceding the chunk
+        std::vector<unsigned char> data; // the filtered rows
+        size_t dataSize = 0;
+        std::vector<unsigned char> out; // the compressed data
+        uLong adler = 0; // Adler-32 of data
+        bool first = false;
+        bool last = false;
+        bool done = false;
+        bool ok = false;
+    };
+
+    void filterRow(const unsigned char *row, unsigned char *out);
+    void submit();
+    void compress(Chunk *chunk) const;
+    bool flush(bool all);
+    bool writeChunk(const char *type, const unsigned char *data, size_t size);
+
+    // raw bytes of image data per chunk
+    static constexpr size_t chunkSize = 512 * 1024;
+    static constexpr size_t windowSize = 32 * 1024;
+
+    png_structp png;
+    size_t rowBytes;
+    size_t bpp; // bytes per pixel, at least 1
+    int height;
+    bool filter;
+    size_t chunkRows;
+
+    int rowsIn = 0;
+    size_t currentPos = 0;
+    std::unique_ptr<Chunk> current;
+    std::vector<unsigned char> prevRow; // unfiltered
+    std::vector<unsigned char> window; // the last filtered data
+    std::vector<unsigned char> candidates; // scratch space for filterRow
+    uLong adler;
+    bool failed = false;
+
+    std::deque<std::unique_ptr<Chunk>> queue; // submitted chunks, in file order
+    size_t maxQueued;
+    std::deque<Chunk *> jobs; // chunks waiting for a worker
+    bool quit = false;
+    std::mutex mutex;
+    std::condition_variable jobCond;
+    std::condition_variable doneCond;
+    std::vector<std::thread> threads;
+};
+
+PNGChunkEncoder::PNGChunkEncoder(png_structp pngA, int nThreads, size_t rowBytesA, int bppA, int heightA, bool filterA)
+    : png(pngA), rowBytes(rowBytesA), bpp(std::max(bppA, 1)), height(heightA), filter(filterA), prevRow(rowBytesA, 0), candidates(4 * rowBytesA), adler(adler32(0, nullptr, 0))
+{
+    chunkRows = std::max<size_t>(1, chunkSize / (rowBytes + 1));
+    maxQueued = 2 * nThreads + 1;
+    threads.reserve(nThreads);
+    for (int i = 0; i < nThreads; ++i) {
+        threads.emplace_back([this] {
+            while (true) {
+                Chunk *chunk;
+                {
+                    std::unique_lock<std::mutex> locker(mutex);
+                    jobCond.wait(locker, [this] { return quit || !jobs.empty(); });
+                    if (quit) {
+                        return;
+                    }
+                    chunk = jobs.front();
+                    jobs.pop_front();
+                }
+                compress(chunk);
+                {
+                    std::unique_lock<std::mutex> locker(mutex);
+                    chunk->done = true;
+                }
+                doneCond.notify_all();
+            }
+        });
+    }
+}
+
+PNGChunkEncoder::~PNGChunkEncoder()
+{
+    {
+        std::unique_lock<std::mutex> locker(mutex);
+        quit = true;
+    }
+    jobCond.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+// Applies the filter giving the smallest sum of absolute (signed)
+// differences, the heuristic libpng uses.
+void PNGChunkEncoder::filterRow(const unsigned char *row, unsigned char *out)
+{
+    if (!filter) {
+        out[0] = PNG_FILTER_VALUE_NONE;
+        memcpy(out + 1, row, rowBytes);
+        return;
+    }
+
+    const unsigned char *prev = prevRow.data();
+    unsigned char *sub = candidates.data();
+    unsigned char *up = sub + rowBytes;
+    unsigned char *avg = up + rowBytes;
+    unsigned char *paeth = avg + rowBytes;
+    const auto cost = [](unsigned char v) { return v < 128 ? v : 256 - v; };
+    size_t sums[5] = { 0, 0, 0, 0, 0 };
+    for (size_t i = 0; i < rowBytes; ++i) {
+        const int x = row[i];
+        const int a = i >= bpp ? row[i - bpp] : 0;
+        const int b = prev[i];
+        const int c = i >= bpp ? prev[i - bpp] : 0;
+        const int p = a + b - c;
+        const int pa = abs(p - a);
+        const int pb = abs(p - b);
+        const int pc = abs(p - c);
+        const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+        sub[i] = static_cast<unsigned char>(x - a);
+        up[i] = static_cast<unsigned char>(x - b);
+        avg[i] = static_cast<unsigned char>(x - ((a + b) >> 1));
+        paeth[i] = static_cast<unsigned char>(x - predictor);
+        sums[0] += cost(x);
+        sums[1] += cost(sub[i]);
+        sums[2] += cost(up[i]);
+        sums[3] += cost(avg[i]);
+        sums[4] += cost(paeth[i]);
+    }
+
+    // the filter types are numbered in the same order as sums
+    int best = PNG_FILTER_VALUE_NONE;
+    for (int i = PNG_FILTER_VALUE_SUB; i <= PNG_FILTER_VALUE_PAETH; ++i) {
+        if (sums[i] < sums[best]) {
+            best = i;
+        }
+    }
+    out[0] = static_cast<unsigned char>(best);
+    memcpy(out + 1, best == PNG_FILTER_VALUE_NONE ? row : candidates.data() + (best - 1) * rowBytes, rowBytes);
+}
+
+bool PNGChunkEncoder::writeRows(unsigned char **rows, int rowCount)
+{
+    if (failed) {
+        return false;
+    }
+    if (rowCount > height - rowsIn) {
+        error(errInternal, -1, "PNGWriter: too many rows");
+        failed = true;
+        return false;
+    }
+
+    for (int y = 0; y < rowCount; ++y) {
+        if (!current) {
+            current = std::make_unique<Chunk>();
+            current->data.resize(std::min<size_t>(chunkRows, height - rowsIn) * (rowBytes + 1));
+            currentPos = 0;
+        }
+        filterRow(rows[y], current->data.data() + currentPos);
+        memcpy(prevRow.data(), rows[y], rowBytes);
+        currentPos += rowBytes + 1;
+        ++rowsIn;
+        if (currentPos == current->data.size()) {
+            submit();
+        }
+    }
+    return flush(false);
+}
+
+void PNGChunkEncoder::submit()
+{
+    Chunk *chunk = current.get();
+    const std::vector<unsigned char> &data = chunk->data;
+    chunk->dataSize = data.size();
+    chunk->first = queue.empty() && window.empty();
+    chunk->last = rowsIn == height;
+    chunk->dict = window;
+    if (data.size() >= windowSize) {
+        window.assign(data.end() - windowSize, data.end());
+    } else {
+        window.insert(window.end(), data.begin(), data.end());
+        if (window.size() > windowSize) {
+            window.erase(window.begin(), window.end() - windowSize);
+        }
+    }
+
+    queue.push_back(std::move(current));
+    {
+        std::unique_lock<std::mutex> locker(mutex);
+        jobs.push_back(chunk);
+    }
+    jobCond.notify_one();
+}
+
+void PNGChunkEncoder::compress(Chunk *chunk) const
+{
+    chunk->adler = adler32(adler32(0, nullptr, 0), chunk->data.data(), chunk->dataSize);
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    // libpng switches to Z_FILTERED as soon as filters are in use
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, filter ? Z_FILTERED : Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    if (!chunk->dict.empty() && deflateSetDictionary(&z, chunk->dict.data(), chunk->dict.size()) != Z_OK) {
+        deflateEnd(&z);
+        return;
+    }
+
+    std::vector<unsigned char> &out = chunk->out;
+    if (chunk->first) {
+        // zlib header: deflate with a 32 KB window, maximum compression
+        out = { 0x78, 0xda };
+    }
+    const size_t start = out.size();
+    out.resize(start + deflateBound(&z, chunk->dataSize) + 64);
+    z.next_in = chunk->data.data();
+    z.avail_in = chunk->dataSize;
+    const int mode = chunk->last ? Z_FINISH : Z_SYNC_FLUSH;
+    while (true) {
+        z.next_out = out.data() + start + z.total_out;
+        z.avail_out = out.size() - start - z.total_out;
+        const int ret = deflate(&z, mode);
+        if (ret == Z_STREAM_END || (ret == Z_OK && mode == Z_SYNC_FLUSH && z.avail_in == 0 && z.avail_out > 0)) {
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            deflateEnd(&z);
+            return;
+        }
+        out.resize(2 * out.size());
+    }
+    out.resize(start + z.total_out);
+    deflateEnd(&z);
+
+    std::vector<unsigned char>().swap(chunk->data);
+    std::vector<unsigned char>().swap(chunk->dict);
+    chunk->ok = true;
+}
+
+// Writes the compressed chunks at the head of the queue.  Unless <all>
+// is set, only waits for a worker if too many chunks are held in memory.
+bool PNGChunkEncoder::flush(bool all)
+{
+    while (!queue.empty()) {
+        Chunk *chunk = queue.front().get();
+        {
+            std::unique_lock<std::mutex> locker(mutex);
+            if (!chunk->done) {
+                if (!all && queue.size() <= maxQueued) {
+                    return true;
+                }
+                doneCond.wait(locker, [chunk] { return chunk->done; });
+            }
+        }
+        if (!chunk->ok) {
+            error(errInternal, -1, "PNGWriter: compression failed");
+            failed = true;
+            return false;
+        }
+
+        adler = adler32_combine(adler, chunk->adler, chunk->dataSize);
+        if (chunk->last) {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                chunk->out.push_back(static_cast<unsigned char>(adler >> shift));
+            }
+        }
+        if (!writeChunk("IDAT", chunk->out.data(), chunk->out.size())) {
+            failed = true;
+            return false;
+        }
+        queue.pop_front();
+    }
+    return true;
+}
+
+bool PNGChunkEncoder::writeChunk(const char *type, const unsigned char *data, size_t size)
+{
+    if (setjmp(png_jmpbuf(png))) {
+        error(errInternal, -1, "Error during writing bytes");
+        return false;
+    }
+    png_write_chunk(png, reinterpret_cast<png_const_bytep>(type), data, size);
+    return true;
+}
+
+bool PNGChunkEncoder::finish()
+{
+    if (failed) {
+        return false;
+    }
+    if (rowsIn != height) {
+        error(errInternal, -1, "PNGWriter: only {0:d} of {1:d} rows written", rowsIn, height);
+        failed = true;
+        return false;
+    }
+    return flush(true) && writeChunk("IEND", nullptr, 0);
+}
+
+//------------------------------------------------------------------------
+// PNGWriter
+//------------------------------------------------------------------------
+
 struct PNGWriterPrivate
 {
     explicit PNGWriterPrivate(PNGWriter::Format f) : format(f) { }
@@ -38,6 +370,8 @@ struct PNGWriterPrivate
     int icc_data_size = 0;
     char *icc_name = nullptr;
     bool sRGB_profile = false;
+    int compressionThreads = 0;
+    std::unique_ptr<PNGChunkEncoder> encoder;
 
     PNGWriterPrivate(const PNGWriterPrivate &) = delete;
     PNGWriterPrivate &operator=(const PNGWriterPrivate &) = delete;
@@ -51,6 +385,7 @@ PNGWriter::PNGWriter(Format formatA)
 PNGWriter::~PNGWriter()
 {
     /* cleanup heap allocation */
+    priv->encoder.reset();
     png_destroy_write_struct(&priv->png_ptr, &priv->info_ptr);
     if (priv->icc_data) {
         gfree(priv->icc_data);
@@ -73,6 +408,11 @@ void PNGWriter::setSRGBProfile()
     priv->sRGB_profile = true;
 }
 
+void PNGWriter::setCompressionThreads(int nThreads)
+{
+    priv->compressionThreads = std::max(nThreads, 0);
+}
+
 bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
 {
     const auto *icc_data_ptr = const_cast<png_const_bytep>(priv->icc_data);
@@ -160,11 +500,21 @@ bool PNGWriter::init(FILE *f, int width, int height, double hDPI, double vDPI)
         return false;
     }
 
+    if (priv->compressionThreads > 0) {
+        const int depth = png_get_bit_depth(priv->png_ptr, priv->info_ptr);
+        const int bpp = png_get_channels(priv->png_ptr, priv->info_ptr) * depth / 8;
+        priv->encoder = std::make_unique<PNGChunkEncoder>(priv->png_ptr, priv->compressionThreads, png_get_rowbytes(priv->png_ptr, priv->info_ptr), bpp, height, depth >= 8);
+    }
+
     return true;
 }
 
-bool PNGWriter::writePointers(unsigned char **rowPointers, int /*rowCount*/)
+bool PNGWriter::writePointers(unsigned char **rowPointers, int rowCount)
 {
+    if (priv->encoder) {
+        return priv->encoder->writeRows(rowPointers, rowCount);
+    }
+
     png_write_image(priv->png_ptr, rowPointers);
     /* write bytes */
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
@@ -177,6 +527,10 @@ bool PNGWriter::writePointers(unsigned char **rowPointers, int /*rowCount*/)
 
 bool PNGWriter::writeRow(unsigned char **row)
 {
+    if (priv->encoder) {
+        return priv->encoder->writeRows(row, 1);
+    }
+
     // Write the row to the file
     png_write_rows(priv->png_ptr, row, 1);
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
@@ -187,8 +541,27 @@ bool PNGWriter::writeRow(unsigned char **row)
     return true;
 }
 
+bool PNGWriter::writeRows(unsigned char **rows, int rowCount)
+{
+    if (priv->encoder) {
+        return priv->encoder->writeRows(rows, rowCount);
+    }
+
+    png_write_rows(priv->png_ptr, rows, rowCount);
+    if (setjmp(png_jmpbuf(priv->png_ptr))) {
+        error(errInternal, -1, "error during png row write");
+        return false;
+    }
+
+    return true;
+}
+
 bool PNGWriter::close()
 {
+    if (priv->encoder) {
+        return priv->encoder->finish();
+    }
+
     /* end write */
     png_write_end(priv->png_ptr, priv->info_ptr);
     if (setjmp(png_jmpbuf(priv->png_ptr))) {
@@ -52,10 +52,18 @@ public:
     void setICCProfile(const char *name, unsigned char *data, int size);
     void setSRGBProfile();
 
+    // Compress the image data on <nThreads> worker threads, in
+    // independent chunks of rows, instead of on the calling thread when
+    // the image is complete.  The result is a standard PNG with the same
+    // pixels, but not byte for byte what libpng would write.  0 (the
+    // default) keeps the libpng encoder.  Must be called before init().
+    void setCompressionThreads(int nThreads);
+
     bool init(FILE *f, int width, int height, double hDPI, double vDPI) override;
 
     bool writePointers(unsigned char **rowPointers, int rowCount) override;
     bool writeRow(unsigned char **row) override;
+    bool writeRows(unsigned char **rows, int rowCount) override;
 
     bool close() override;
 
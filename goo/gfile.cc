@@ -44,9 +44,15 @@
 #    include <fcntl.h>
 #    include <cstring>
 #    include <pwd.h>
+#    if HAVE_SENDFILE
+#        include <sys/sendfile.h>
+#    endif
 #endif // _WIN32
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <limits>
+#include <vector>
 #include "gfile.h"
 
 #ifndef _WIN32
@@ -363,4 +369,53 @@ bool GooFile::modificationTimeChangedSinceOpen() const
     return modifiedTimeOnOpen.tv_sec != mtim(statbuf).tv_sec || modifiedTimeOnOpen.tv_nsec != mtim(statbuf).tv_nsec;
 }
 
+Goffset GooFile::copyTo(int outFd, Goffset offset, Goffset n) const
+{
+    Goffset done = 0;
+
+    // the kernel copies fail for some combinations of file systems and
+    // file types (e.g. to a pipe); fall back to the next method then
+#    if HAVE_COPY_FILE_RANGE
+    while (done < n) {
+        off_t inOffset = offset + done;
+        const ssize_t m = copy_file_range(fd, &inOffset, outFd, nullptr, n - done, 0);
+        if (m <= 0) {
+            break;
+        }
+        done += m;
+    }
+#    endif
+#    if HAVE_SENDFILE
+    while (done < n) {
+        off_t inOffset = offset + done;
+        const ssize_t m = sendfile(outFd, fd, &inOffset, n - done);
+        if (m <= 0) {
+            break;
+        }
+        done += m;
+    }
+#    endif
+    if (done < n) {
+        std::vector<char> buf(std::min<Goffset>(n - done, 256 * 1024));
+        while (done < n) {
+            const int m = read(buf.data(), static_cast<int>(std::min<Goffset>(n - done, buf.size())), offset + done);
+            if (m <= 0) {
+                break;
+            }
+            for (int written = 0; written < m;) {
+                const ssize_t w = write(outFd, buf.data() + written, m - written);
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w <= 0) {
+                    return done + written;
+                }
+                written += w;
+            }
+            done += m;
+        }
+    }
+    return done;
+}
+
 #endif // _WIN32
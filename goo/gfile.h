@@ -115,6 +115,11 @@ private:
 
     bool modificationTimeChangedSinceOpen() const;
 
+    // Copy <n> bytes at <offset> to the current position of the file
+    // descriptor <outFd>, inside the kernel when possible.  Returns the
+    // number of bytes copied.
+    Goffset copyTo(int outFd, Goffset offset, Goffset n) const;
+
 private:
     explicit GooFile(int fdA);
     int fd;
@@ -50,6 +50,8 @@
 #include <config.h>
 
 #include <cstring>
+#include <list>
+#include <string_view>
 #include "CairoFontEngine.h"
 #include "CairoOutputDev.h"
 #include "GlobalParams.h"
@@ -173,35 +175,100 @@ CairoFreeTypeFont::CairoFreeTypeFont(Ref refA, cairo_font_face_t *cairo_font_fac
 
 CairoFreeTypeFont::~CairoFreeTypeFont() = default;
 
+// Process-wide cache of FreeType font faces, keyed by font file name or
+// by the content of the embedded font program, so that a font embedded
+// in many documents is only loaded once.  Each entry holds a reference
+// on its cairo_font_face_t; faces are evicted (least recently used
+// first) once the cached font data exceeds fontFaceCacheMaxSize bytes.
+struct FreeTypeFontFaceCacheEntry
+{
+    size_t hash;
+    std::string filename;
+    int faceIndex;
+    FreeTypeFontResource *resource;
+    FreeTypeFontFace font_face;
+};
+
+static constexpr size_t fontFaceCacheMaxSize = 64 * 1024 * 1024;
+static constexpr size_t fontFaceCacheMaxFaces = 256;
+
+static std::mutex fontFaceCacheMutex;
+static std::list<FreeTypeFontFaceCacheEntry> fontFaceCache; // most recently used first
+static size_t fontFaceCacheSize = 0;
+
+static size_t hashFontFace(const std::string &filename, int faceIndex, const std::vector<unsigned char> &font_data)
+{
+    size_t h;
+
+    if (font_data.empty()) {
+        h = std::hash<std::string> {}(filename);
+    } else {
+        h = std::hash<std::string_view> {}(std::string_view(reinterpret_cast<const char *>(font_data.data()), font_data.size()));
+    }
+    return h ^ (static_cast<size_t>(faceIndex) * 0x9e3779b97f4a7c15ULL);
+}
+
 // Create a cairo_font_face_t for the given font filename OR font data.
 std::optional<FreeTypeFontFace> CairoFreeTypeFont::createFreeTypeFontFace(FT_Library lib, const std::string &filename, int faceIndex, std::vector<unsigned char> &&font_data)
 {
-    auto *resource = new FreeTypeFontResource;
+    std::list<FreeTypeFontFaceCacheEntry> evicted;
     FreeTypeFontFace font_face;
+    const size_t hash = hashFontFace(filename, faceIndex, font_data);
+
+    {
+        std::scoped_lock lock(fontFaceCacheMutex);
+
+        // check the cache
+        for (auto it = fontFaceCache.begin(); it != fontFaceCache.end(); ++it) {
+            if (it->hash == hash && it->faceIndex == faceIndex && it->filename == filename && it->resource->font_data == font_data) {
+                fontFaceCache.splice(fontFaceCache.begin(), fontFaceCache, it);
+                font_face = it->font_face;
+                cairo_font_face_reference(font_face.cairo_font_face);
+                return font_face;
+            }
+        }
 
-    if (font_data.empty()) {
-        FT_Error err = ft_new_face_from_file(lib, filename.c_str(), faceIndex, &resource->face);
-        if (err) {
-            delete resource;
-            return {};
+        auto *resource = new FreeTypeFontResource;
+
+        if (font_data.empty()) {
+            FT_Error err = ft_new_face_from_file(lib, filename.c_str(), faceIndex, &resource->face);
+            if (err) {
+                delete resource;
+                return {};
+            }
+        } else {
+            resource->font_data = std::move(font_data);
+            FT_Error err = FT_New_Memory_Face(lib, static_cast<FT_Byte *>(resource->font_data.data()), resource->font_data.size(), faceIndex, &resource->face);
+            if (err) {
+                delete resource;
+                return {};
+            }
         }
-    } else {
-        resource->font_data = std::move(font_data);
-        FT_Error err = FT_New_Memory_Face(lib, static_cast<FT_Byte *>(resource->font_data.data()), resource->font_data.size(), faceIndex, &resource->face);
-        if (err) {
-            delete resource;
+
+        font_face.cairo_font_face = cairo_ft_font_face_create_for_ft_face(resource->face, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP);
+        if (cairo_font_face_set_user_data(font_face.cairo_font_face, &ft_cairo_key, resource, _ft_done_face)) {
+            cairo_font_face_destroy(font_face.cairo_font_face);
+            _ft_done_face(resource);
             return {};
         }
+
+        font_face.face = resource->face;
+
+        // insert in the cache, with its own reference; evicted faces are
+        // destroyed after unlocking the mutex
+        cairo_font_face_reference(font_face.cairo_font_face);
+        fontFaceCache.push_front({ .hash = hash, .filename = filename, .faceIndex = faceIndex, .resource = resource, .font_face = font_face });
+        fontFaceCacheSize += resource->font_data.size();
+        while (fontFaceCache.size() > 1 && (fontFaceCacheSize > fontFaceCacheMaxSize || fontFaceCache.size() > fontFaceCacheMaxFaces)) {
+            fontFaceCacheSize -= fontFaceCache.back().resource->font_data.size();
+            evicted.splice(evicted.end(), fontFaceCache, std::prev(fontFaceCache.end()));
+        }
     }
 
-    font_face.cairo_font_face = cairo_ft_font_face_create_for_ft_face(resource->face, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP);
-    if (cairo_font_face_set_user_data(font_face.cairo_font_face, &ft_cairo_key, resource, _ft_done_face)) {
-        cairo_font_face_destroy(font_face.cairo_font_face);
-        _ft_done_face(resource);
-        return {};
+    for (const FreeTypeFontFaceCacheEntry &entry : evicted) {
+        cairo_font_face_destroy(entry.font_face.cairo_font_face);
     }
 
-    font_face.face = resource->face;
     return font_face;
 }
 
@@ -252,26 +319,45 @@ CairoFreeTypeFont *CairoFreeTypeFont::create(const std::shared_ptr<GfxFont> &gfx
             goto err2;
         }
 
+        // the FT_Face is shared with every font using the same font
+        // program, and cairo may be rendering with it on other threads,
+        // so it has to be locked through cairo
+        cairo_matrix_t matrix;
+        cairo_matrix_init_identity(&matrix);
+        cairo_font_options_t *options = cairo_font_options_create();
+        cairo_scaled_font_t *scaledFont = cairo_scaled_font_create(font_face->cairo_font_face, &matrix, &matrix, options);
+        cairo_font_options_destroy(options);
+        FT_Face face = cairo_ft_scaled_font_lock_face(scaledFont);
+        if (!face) {
+            cairo_scaled_font_destroy(scaledFont);
+            cairo_font_face_destroy(font_face->cairo_font_face);
+            error(errSyntaxError, -1, "could not lock type1 face");
+            goto err2;
+        }
+
         const std::array<const char *, 256> &enc = std::static_pointer_cast<Gfx8BitFont>(gfxFont)->getEncoding();
 
         codeToGID.resize(256);
         for (i = 0; i < 256; ++i) {
             codeToGID[i] = 0;
             if ((name = enc[i])) {
-                codeToGID[i] = FT_Get_Name_Index(font_face->face, name);
+                codeToGID[i] = FT_Get_Name_Index(face, name);
                 if (codeToGID[i] == 0) {
                     Unicode u;
                     u = globalParams->mapNameToUnicodeText(name);
-                    codeToGID[i] = FT_Get_Char_Index(font_face->face, u);
+                    codeToGID[i] = FT_Get_Char_Index(face, u);
                 }
                 if (codeToGID[i] == 0) {
                     name = GfxFont::getAlternateName(name);
                     if (name) {
-                        codeToGID[i] = FT_Get_Name_Index(font_face->face, name);
+                        codeToGID[i] = FT_Get_Name_Index(face, name);
                     }
                 }
             }
         }
+
+        cairo_ft_scaled_font_unlock_face(scaledFont);
+        cairo_scaled_font_destroy(scaledFont);
     } break;
     case fontCIDType2:
     case fontCIDType2OT:
@@ -1516,8 +1516,8 @@ bool CairoOutputDev::functionShadedFill(GfxState *state, GfxFunctionShading *sha
     double y_begin, y_end, y1, y2;
     double x_step;
     double y_step;
-    GfxColor color;
-    GfxRGB rgb;
+    GfxColor color[4];
+    GfxRGB rgb[4];
     cairo_matrix_t mat;
 
     const std::array<double, 6> &matrix = shading->getMatrix();
@@ -1566,21 +1566,14 @@ bool CairoOutputDev::functionShadedFill(GfxState *state, GfxFunctionShading *sha
             cairo_mesh_pattern_line_to(fill_pattern, x2, y2);
             cairo_mesh_pattern_line_to(fill_pattern, x1, y2);
 
-            shading->getColor(x1, y1, &color);
-            shading->getColorSpace()->getRGB(color, &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, 0, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
-
-            shading->getColor(x2, y1, &color);
-            shading->getColorSpace()->getRGB(color, &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, 1, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
-
-            shading->getColor(x2, y2, &color);
-            shading->getColorSpace()->getRGB(color, &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, 2, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
-
-            shading->getColor(x1, y2, &color);
-            shading->getColorSpace()->getRGB(color, &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, 3, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
+            shading->getColor(x1, y1, &color[0]);
+            shading->getColor(x2, y1, &color[1]);
+            shading->getColor(x2, y2, &color[2]);
+            shading->getColor(x1, y2, &color[3]);
+            shading->getColorSpace()->getRGBs(color, rgb, 4);
+            for (int j = 0; j < 4; j++) {
+                cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, j, colToDbl(rgb[j].r), colToDbl(rgb[j].g), colToDbl(rgb[j].b));
+            }
 
             cairo_mesh_pattern_end_patch(fill_pattern);
         }
@@ -1674,7 +1667,7 @@ bool CairoOutputDev::gouraudTriangleShadedFill(GfxState *state, GfxGouraudTriang
     double x0, y0, x1, y1, x2, y2;
     GfxColor color[3];
     int i, j;
-    GfxRGB rgb;
+    GfxRGB rgb[3];
 
     cairo_pattern_destroy(fill_pattern);
     fill_pattern = cairo_pattern_create_mesh();
@@ -1696,9 +1689,9 @@ bool CairoOutputDev::gouraudTriangleShadedFill(GfxState *state, GfxGouraudTriang
         cairo_mesh_pattern_line_to(fill_pattern, x1, y1);
         cairo_mesh_pattern_line_to(fill_pattern, x2, y2);
 
+        shading->getColorSpace()->getRGBs(color, rgb, 3);
         for (j = 0; j < 3; j++) {
-            shading->getColorSpace()->getRGB(color[j], &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, j, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
+            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, j, colToDbl(rgb[j].r), colToDbl(rgb[j].g), colToDbl(rgb[j].b));
         }
 
         cairo_mesh_pattern_end_patch(fill_pattern);
@@ -1727,8 +1720,8 @@ bool CairoOutputDev::patchMeshShadedFill(GfxState *state, GfxPatchMeshShading *s
 
     for (i = 0; i < shading->getNPatches(); i++) {
         const GfxPatch *patch = shading->getPatch(i);
-        GfxColor color;
-        GfxRGB rgb;
+        GfxColor color[4];
+        GfxRGB rgb[4];
 
         cairo_mesh_pattern_begin_patch(fill_pattern);
 
@@ -1769,16 +1762,18 @@ bool CairoOutputDev::patchMeshShadedFill(GfxState *state, GfxPatchMeshShading *s
             }
 
             if (shading->isParameterized()) {
-                shading->getParameterizedColor(patch->color[u][v].c[0], &color);
+                shading->getParameterizedColor(patch->color[u][v].c[0], &color[j]);
             } else {
                 for (k = 0; k < shading->getColorSpace()->getNComps(); k++) {
                     // simply cast to the desired type; that's all what is needed.
-                    color.c[k] = static_cast<GfxColorComp>(patch->color[u][v].c[k]);
+                    color[j].c[k] = static_cast<GfxColorComp>(patch->color[u][v].c[k]);
                 }
             }
+        }
 
-            shading->getColorSpace()->getRGB(color, &rgb);
-            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, j, colToDbl(rgb.r), colToDbl(rgb.g), colToDbl(rgb.b));
+        shading->getColorSpace()->getRGBs(color, rgb, 4);
+        for (j = 0; j < 4; j++) {
+            cairo_mesh_pattern_set_corner_color_rgb(fill_pattern, j, colToDbl(rgb[j].r), colToDbl(rgb[j].g), colToDbl(rgb[j].b));
         }
         cairo_mesh_pattern_end_patch(fill_pattern);
     }
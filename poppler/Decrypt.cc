@@ -33,13 +33,25 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <iterator>
+#include <type_traits>
 #include "goo/gmem.h"
 #include "goo/grandom.h"
 #include "Decrypt.h"
 #include "Error.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define DECRYPT_X86_INTRINSICS 1
+#    include <cpuid.h>
+#    include <immintrin.h>
+#else
+#    define DECRYPT_X86_INTRINSICS 0
+#endif
+
 static void rc4InitKey(const unsigned char *key, int keyLen, unsigned char *state);
 static unsigned char rc4DecryptByte(unsigned char *state, unsigned char *x, unsigned char *y, unsigned char c);
 
@@ -48,12 +60,14 @@ static bool aesReadBlock(Stream *str, unsigned char *in, bool addPadding);
 static void aesKeyExpansion(DecryptAESState *s, const unsigned char *objKey, int objKeyLen, bool decrypt);
 static void aesEncryptBlock(DecryptAESState *s, const unsigned char *in);
 static void aesDecryptBlock(DecryptAESState *s, const unsigned char *in, bool last);
+static void aesEncryptBlocks(DecryptAESState *s, const unsigned char *in, unsigned char *out, int nBlocks);
+template<typename State>
+static int aesDecryptData(State *s, unsigned char *data, int n, bool last);
 
 static void aes256KeyExpansion(DecryptAES256State *s, const unsigned char *objKey, bool decrypt);
 static void aes256EncryptBlock(DecryptAES256State *s, const unsigned char *in);
 static void aes256DecryptBlock(DecryptAES256State *s, const unsigned char *in, bool last);
 
-static void sha256(unsigned char *msg, int msgLen, unsigned char *hash);
 static void sha384(unsigned char *msg, int msgLen, unsigned char *hash);
 static void sha512(unsigned char *msg, int msgLen, unsigned char *hash);
 
@@ -483,8 +497,15 @@ int EncryptStream::lookChar()
 // DecryptStream
 //------------------------------------------------------------------------
 
-DecryptStream::DecryptStream(Stream &strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(strA, fileKey, algoA, keyLength, refA) { }
-DecryptStream::DecryptStream(std::unique_ptr<Stream> strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(std::move(strA), fileKey, algoA, keyLength, refA) { }
+DecryptStream::DecryptStream(Stream &strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(strA, fileKey, algoA, keyLength, refA)
+{
+    bufPtr = bufEnd = buf;
+}
+
+DecryptStream::DecryptStream(std::unique_ptr<Stream> strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref refA) : BaseCryptStream(std::move(strA), fileKey, algoA, keyLength, refA)
+{
+    bufPtr = bufEnd = buf;
+}
 
 DecryptStream::~DecryptStream() = default;
 
@@ -492,6 +513,7 @@ bool DecryptStream::rewind()
 {
     int i;
     bool baseResult = BaseCryptStream::rewind();
+    bufPtr = bufEnd = buf;
 
     switch (algo) {
     case cryptRC4:
@@ -519,50 +541,62 @@ bool DecryptStream::rewind()
     return baseResult;
 }
 
-int DecryptStream::lookChar()
+int DecryptStream::getChars(int nChars, unsigned char *buffer)
 {
-    unsigned char in[16];
-    int c;
-
-    if (nextCharBuff != EOF) {
-        return nextCharBuff;
+    int n = 0;
+    while (n < nChars) {
+        if (bufPtr >= bufEnd) {
+            // decrypt large blocks straight into the caller's buffer
+            const int size = (nChars - n) & ~15;
+            if (size >= static_cast<int>(sizeof(buf))) {
+                const int m = decrypt(buffer + n, size);
+                if (m <= 0) {
+                    break;
+                }
+                n += m;
+                charactersRead += m;
+                continue;
+            }
+            if (!fillBuf()) {
+                break;
+            }
+        }
+        const int m = std::min(static_cast<int>(bufEnd - bufPtr), nChars - n);
+        memcpy(buffer + n, bufPtr, m);
+        bufPtr += m;
+        n += m;
+        charactersRead += m;
     }
+    return n;
+}
 
-    c = EOF; // make gcc happy
+bool DecryptStream::fillBuf()
+{
+    bufPtr = buf;
+    bufEnd = buf + decrypt(buf, sizeof(buf));
+    return bufPtr < bufEnd;
+}
+
+// Read up to <size> bytes, a multiple of 16, from the underlying stream
+// and decrypt them in place.  Returns the number of decrypted bytes,
+// which is 0 at the end of the stream.
+int DecryptStream::decrypt(unsigned char *data, int size)
+{
+    const int n = str->doGetChars(size, data);
     switch (algo) {
     case cryptRC4:
-        if ((c = str->getChar()) != EOF) {
-            c = rc4DecryptByte(state.rc4.state, &state.rc4.x, &state.rc4.y, static_cast<unsigned char>(c));
+        for (int i = 0; i < n; ++i) {
+            data[i] = rc4DecryptByte(state.rc4.state, &state.rc4.x, &state.rc4.y, data[i]);
         }
-        break;
+        return n;
     case cryptAES:
-        if (state.aes.bufIdx == 16) {
-            if (aesReadBlock(str, in, false)) {
-                aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-            }
-        }
-        if (state.aes.bufIdx == 16) {
-            c = EOF;
-        } else {
-            c = state.aes.buf[state.aes.bufIdx++];
-        }
-        break;
+        return aesDecryptData(&state.aes, data, n, n % 16 == 0 && str->lookChar() == EOF);
     case cryptAES256:
-        if (state.aes256.bufIdx == 16) {
-            if (aesReadBlock(str, in, false)) {
-                aes256DecryptBlock(&state.aes256, in, str->lookChar() == EOF);
-            }
-        }
-        if (state.aes256.bufIdx == 16) {
-            c = EOF;
-        } else {
-            c = state.aes256.buf[state.aes256.bufIdx++];
-        }
-        break;
+        return aesDecryptData(&state.aes256, data, n, n % 16 == 0 && str->lookChar() == EOF);
     case cryptNone:
         break;
     }
-    return (nextCharBuff = c);
+    return 0;
 }
 
 //------------------------------------------------------------------------
@@ -606,6 +640,150 @@ static unsigned char rc4DecryptByte(unsigned char *state, unsigned char *x, unsi
     return c ^ state[(tx + ty) % 256];
 }
 
+//------------------------------------------------------------------------
+// AES and SHA-256 instructions
+//------------------------------------------------------------------------
+
+static std::atomic_bool cpuInstructionsEnabled = true;
+
+void Decrypt::setCPUInstructionsEnabled(bool enabled)
+{
+    cpuInstructionsEnabled = enabled;
+}
+
+#if DECRYPT_X86_INTRINSICS
+
+static bool cpuHasAES()
+{
+    static const bool hasAES = [] {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) && (edx & bit_SSE2);
+    }();
+    return hasAES;
+}
+
+static bool cpuHasSHA()
+{
+    static const bool hasSHA = [] {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) {
+            return false;
+        }
+        return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+    }();
+    return hasSHA;
+}
+
+// The AES instructions take the round keys as bytes, in key order.
+__attribute__((target("sse2"))) static inline __m128i aesRoundKey(const unsigned int *w)
+{
+    unsigned char k[16];
+
+    for (int c = 0; c < 4; ++c) {
+        k[4 * c] = static_cast<unsigned char>(w[c] >> 24);
+        k[4 * c + 1] = static_cast<unsigned char>(w[c] >> 16);
+        k[4 * c + 2] = static_cast<unsigned char>(w[c] >> 8);
+        k[4 * c + 3] = static_cast<unsigned char>(w[c]);
+    }
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(k));
+}
+
+// <w> is the key schedule for the equivalent inverse cipher, as
+// computed by aesKeyExpansion() with decrypt set, which is what
+// AESDEC expects.  The blocks don't depend on each other, so they are
+// decrypted four at a time to keep the AES unit busy.
+__attribute__((target("aes,sse2"))) static void aesniDecryptBlocks(const unsigned int *w, int nRounds, unsigned char *cbc, const unsigned char *in, unsigned char *out, int nBlocks)
+{
+    __m128i rk[15];
+    for (int r = 0; r <= nRounds; ++r) {
+        rk[r] = aesRoundKey(&w[r * 4]);
+    }
+
+    const auto load = [](const unsigned char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+    const auto store = [](unsigned char *p, __m128i x) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x); };
+
+    __m128i prev = load(cbc);
+    int i = 0;
+    for (; i + 4 <= nBlocks; i += 4) {
+        const __m128i c0 = load(in + 16 * i);
+        const __m128i c1 = load(in + 16 * (i + 1));
+        const __m128i c2 = load(in + 16 * (i + 2));
+        const __m128i c3 = load(in + 16 * (i + 3));
+        __m128i x0 = _mm_xor_si128(c0, rk[nRounds]);
+        __m128i x1 = _mm_xor_si128(c1, rk[nRounds]);
+        __m128i x2 = _mm_xor_si128(c2, rk[nRounds]);
+        __m128i x3 = _mm_xor_si128(c3, rk[nRounds]);
+        for (int r = nRounds - 1; r > 0; --r) {
+            x0 = _mm_aesdec_si128(x0, rk[r]);
+            x1 = _mm_aesdec_si128(x1, rk[r]);
+            x2 = _mm_aesdec_si128(x2, rk[r]);
+            x3 = _mm_aesdec_si128(x3, rk[r]);
+        }
+        store(out + 16 * i, _mm_xor_si128(_mm_aesdeclast_si128(x0, rk[0]), prev));
+        store(out + 16 * (i + 1), _mm_xor_si128(_mm_aesdeclast_si128(x1, rk[0]), c0));
+        store(out + 16 * (i + 2), _mm_xor_si128(_mm_aesdeclast_si128(x2, rk[0]), c1));
+        store(out + 16 * (i + 3), _mm_xor_si128(_mm_aesdeclast_si128(x3, rk[0]), c2));
+        prev = c3;
+    }
+    for (; i < nBlocks; ++i) {
+        const __m128i c = load(in + 16 * i);
+        __m128i x = _mm_xor_si128(c, rk[nRounds]);
+        for (int r = nRounds - 1; r > 0; --r) {
+            x = _mm_aesdec_si128(x, rk[r]);
+        }
+        store(out + 16 * i, _mm_xor_si128(_mm_aesdeclast_si128(x, rk[0]), prev));
+        prev = c;
+    }
+    store(cbc, prev);
+}
+
+__attribute__((target("aes,sse2"))) static void aesniEncryptBlocks(const unsigned int *w, int nRounds, unsigned char *prevOut, const unsigned char *in, unsigned char *out, int nBlocks)
+{
+    __m128i rk[15];
+    for (int r = 0; r <= nRounds; ++r) {
+        rk[r] = aesRoundKey(&w[r * 4]);
+    }
+
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prevOut));
+    for (int i = 0; i < nBlocks; ++i) {
+        x = _mm_xor_si128(x, _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * i)));
+        x = _mm_xor_si128(x, rk[0]);
+        for (int r = 1; r < nRounds; ++r) {
+            x = _mm_aesenc_si128(x, rk[r]);
+        }
+        x = _mm_aesenclast_si128(x, rk[nRounds]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16 * i), x);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(prevOut), x);
+}
+
+#endif
+
+// These return false if the CPU has no AES instructions, or they are
+// disabled.
+
+static bool fastAESDecrypt([[maybe_unused]] const unsigned int *w, [[maybe_unused]] int nRounds, [[maybe_unused]] unsigned char *cbc, [[maybe_unused]] const unsigned char *in, [[maybe_unused]] unsigned char *out, [[maybe_unused]] int nBlocks)
+{
+#if DECRYPT_X86_INTRINSICS
+    if (cpuInstructionsEnabled && cpuHasAES()) {
+        aesniDecryptBlocks(w, nRounds, cbc, in, out, nBlocks);
+        return true;
+    }
+#endif
+    return false;
+}
+
+static bool fastAESEncrypt([[maybe_unused]] const unsigned int *w, [[maybe_unused]] int nRounds, [[maybe_unused]] unsigned char *prevOut, [[maybe_unused]] const unsigned char *in, [[maybe_unused]] unsigned char *out, [[maybe_unused]] int nBlocks)
+{
+#if DECRYPT_X86_INTRINSICS
+    if (cpuInstructionsEnabled && cpuHasAES()) {
+        aesniEncryptBlocks(w, nRounds, prevOut, in, out, nBlocks);
+        return true;
+    }
+#endif
+    return false;
+}
+
 //------------------------------------------------------------------------
 // AES decryption
 //------------------------------------------------------------------------
@@ -1155,6 +1333,51 @@ static void aes256DecryptBlock(DecryptAES256State *s, const unsigned char *in, b
     }
 }
 
+// CBC encryption of <nBlocks> blocks, chained to the previous output in
+// s->buf, which is updated.
+static void aesEncryptBlocks(DecryptAESState *s, const unsigned char *in, unsigned char *out, int nBlocks)
+{
+    if (fastAESEncrypt(s->w, 10, s->buf, in, out, nBlocks)) {
+        return;
+    }
+    for (int i = 0; i < nBlocks; ++i) {
+        aesEncryptBlock(s, in + 16 * i);
+        memcpy(out + 16 * i, s->buf, 16);
+    }
+}
+
+// Decrypt the <n> bytes at <data> in place, ignoring an incomplete last
+// block.  If <last> is set, the data ends the stream and the padding is
+// removed.  Returns the number of decrypted bytes.
+template<typename State>
+static int aesDecryptData(State *s, unsigned char *data, int n, bool last)
+{
+    const int nBlocks = n / 16;
+    if (nBlocks == 0) {
+        return 0;
+    }
+    if (!fastAESDecrypt(s->w, static_cast<int>(std::size(s->w)) / 4 - 1, s->cbc, data, data, nBlocks)) {
+        for (int i = 0; i < nBlocks; ++i) {
+            if constexpr (std::is_same_v<State, DecryptAES256State>) {
+                aes256DecryptBlock(s, data + 16 * i, false);
+            } else {
+                aesDecryptBlock(s, data + 16 * i, false);
+            }
+            memcpy(data + 16 * i, s->buf, 16);
+        }
+    }
+
+    int len = 16 * nBlocks;
+    if (last) {
+        int pad = data[len - 1];
+        if (pad < 1 || pad > 16) { // this should never happen
+            pad = 16;
+        }
+        len -= pad;
+    }
+    return len;
+}
+
 //------------------------------------------------------------------------
 // MD5 message digest
 //------------------------------------------------------------------------
@@ -1469,7 +1692,68 @@ static void sha256HashBlock(const unsigned char *blk, unsigned int *H)
     H[7] += h;
 }
 
-static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
+#if DECRYPT_X86_INTRINSICS
+
+// The SHA instructions keep the state as ABEF and CDGH.
+__attribute__((target("sha,sse4.1,ssse3"))) static void shaniHashBlocks(const unsigned char *data, int nBlocks, unsigned int *H)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[0])), 0xb1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&H[4])), 0x1b); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0); // CDGH
+
+    for (int blk = 0; blk < nBlocks; ++blk) {
+        const __m128i saved0 = state0;
+        const __m128i saved1 = state1;
+        __m128i W[16];
+        for (int i = 0; i < 16; ++i) {
+            if (i < 4) {
+                W[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 64 * blk + 16 * i)), byteSwap);
+            } else {
+                W[i] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(W[i - 4], W[i - 3]), _mm_alignr_epi8(W[i - 1], W[i - 2], 4)), W[i - 1]);
+            }
+            __m128i msg = _mm_add_epi32(W[i], _mm_loadu_si128(reinterpret_cast<const __m128i *>(&sha256K[4 * i])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1); // DCHG
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[0]), _mm_blend_epi16(tmp, state1, 0xf0)); // DCBA
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&H[4]), _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+#endif
+
+// Returns false if the CPU has no SHA instructions, or they are disabled.
+static bool fastSHA256([[maybe_unused]] const unsigned char *data, [[maybe_unused]] int nBlocks, [[maybe_unused]] unsigned int *H)
+{
+#if DECRYPT_X86_INTRINSICS
+    if (cpuInstructionsEnabled && cpuHasSHA()) {
+        shaniHashBlocks(data, nBlocks, H);
+        return true;
+    }
+#endif
+    return false;
+}
+
+static void sha256HashBlocks(const unsigned char *data, int nBlocks, unsigned int *H)
+{
+    if (fastSHA256(data, nBlocks, H)) {
+        return;
+    }
+    for (int i = 0; i < nBlocks; ++i) {
+        sha256HashBlock(data + 64 * i, H);
+    }
+}
+
+void sha256(const unsigned char *msg, int msgLen, unsigned char *hash)
 {
     unsigned char blk[64];
     unsigned int H[8];
@@ -1484,10 +1768,8 @@ static void sha256(unsigned char *msg, int msgLen, unsigned char *hash)
     H[6] = 0x1f83d9ab;
     H[7] = 0x5be0cd19;
 
-    blkLen = 0;
-    for (i = 0; i + 64 <= msgLen; i += 64) {
-        sha256HashBlock(msg + i, H);
-    }
+    sha256HashBlocks(msg, msgLen / 64, H);
+    i = msgLen - msgLen % 64;
     blkLen = msgLen - i;
     if (blkLen > 0) {
         memcpy(blk, msg + i, blkLen);
@@ -1799,10 +2081,7 @@ static void revision6Hash(const GooString *inputPassword, unsigned char *K, cons
         state.paddingReached = false;
         aesKeyExpansion(&state, aesKey, 16, false);
 
-        for (int i = 0; i < (4 * sequenceLength); i++) {
-            aesEncryptBlock(&state, K1 + (16 * i));
-            memcpy(E + (16 * i), state.buf, 16);
-        }
+        aesEncryptBlocks(&state, K1, E, 4 * sequenceLength);
         memcpy(BE16byteNumber, E, 16);
         // c.Taking the first 16 Bytes of E as unsigned big-endian integer,
         // compute the remainder,modulo 3.
@@ -34,12 +34,13 @@
 #include "goo/GooString.h"
 #include "Object.h"
 #include "Stream.h"
+#include "poppler_private_export.h"
 
 //------------------------------------------------------------------------
 // Decrypt
 //------------------------------------------------------------------------
 
-class Decrypt
+class POPPLER_PRIVATE_EXPORT Decrypt
 {
 public:
     // Generate a file key.  The <fileKey> buffer must have space for at
@@ -50,6 +51,10 @@ public:
     static bool makeFileKey(int encRevision, int keyLength, const GooString *ownerKey, const GooString *userKey, const GooString *ownerEnc, const GooString *userEnc, int permissions, const GooString *fileID, const GooString *ownerPassword,
                             const GooString *userPassword, unsigned char *fileKey, bool encryptMetadata, bool *ownerPasswordOk);
 
+    // Use the AES and SHA-256 instructions of the CPU, if it has them.
+    // On by default; the tests turn it off to check the portable code.
+    static void setCPUInstructionsEnabled(bool enabled);
+
 private:
     static bool makeFileKey2(int encRevision, int keyLength, const GooString *ownerKey, const GooString *userKey, int permissions, const GooString *fileID, const GooString *userPassword, unsigned char *fileKey, bool encryptMetadata);
 };
@@ -91,7 +96,7 @@ struct DecryptAES256State
     int bufIdx;
 };
 
-class BaseCryptStream : public FilterStream
+class POPPLER_PRIVATE_EXPORT BaseCryptStream : public FilterStream
 {
 public:
     BaseCryptStream(std::unique_ptr<Stream> strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref);
@@ -124,7 +129,7 @@ protected:
 // EncryptStream / DecryptStream
 //------------------------------------------------------------------------
 
-class EncryptStream : public BaseCryptStream
+class POPPLER_PRIVATE_EXPORT EncryptStream : public BaseCryptStream
 {
 public:
     EncryptStream(Stream &strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref);
@@ -137,18 +142,38 @@ private:
     void init();
 };
 
-class DecryptStream : public BaseCryptStream
+class POPPLER_PRIVATE_EXPORT DecryptStream : public BaseCryptStream
 {
 public:
     DecryptStream(std::unique_ptr<Stream> strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref);
     DecryptStream(Stream &strA, const unsigned char *fileKey, CryptAlgorithm algoA, int keyLength, Ref ref);
     ~DecryptStream() override;
     [[nodiscard]] bool rewind() override;
-    int lookChar() override;
+    int getChar() override
+    {
+        if (bufPtr >= bufEnd && !fillBuf()) {
+            return EOF;
+        }
+        ++charactersRead;
+        return *bufPtr++;
+    }
+    int lookChar() override { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr; }
+
+private:
+    bool hasGetChars() override { return true; }
+    int getChars(int nChars, unsigned char *buffer) override;
+    bool fillBuf();
+    int decrypt(unsigned char *data, int size);
+
+    // the data is decrypted a buffer at a time
+    unsigned char buf[4096];
+    unsigned char *bufPtr;
+    unsigned char *bufEnd;
 };
 
 //------------------------------------------------------------------------
 
 extern void md5(const unsigned char *msg, int msgLen, unsigned char *digest);
+extern POPPLER_PRIVATE_EXPORT void sha256(const unsigned char *msg, int msgLen, unsigned char *hash);
 
 #endif
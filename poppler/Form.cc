@@ -47,6 +47,7 @@
 
 #include <config.h>
 
+#include <algorithm>
 #include <array>
 #include <set>
 #include <limits>
@@ -54,6 +55,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
+#include <thread>
 #include "goo/ft_utils.h"
 #include "goo/gfile.h"
 #include "goo/GooString.h"
@@ -2330,21 +2332,16 @@ void FormFieldSignature::hashSignedDataBlock(CryptoSign::VerificationInterface *
     if (!handler) {
         return;
     }
-    const int BLOCK_SIZE = 4096;
-    unsigned char signed_data_buffer[BLOCK_SIZE];
+    std::vector<unsigned char> signed_data_buffer(std::min<Goffset>(block_len, 1024 * 1024));
 
     Goffset i = 0;
     while (i < block_len) {
-        Goffset bytes_left = block_len - i;
-        if (bytes_left < BLOCK_SIZE) {
-            doc->getBaseStream()->doGetChars(static_cast<int>(bytes_left), signed_data_buffer);
-            handler->addData(signed_data_buffer, static_cast<int>(bytes_left));
-            i = block_len;
-        } else {
-            doc->getBaseStream()->doGetChars(BLOCK_SIZE, signed_data_buffer);
-            handler->addData(signed_data_buffer, BLOCK_SIZE);
-            i += BLOCK_SIZE;
+        const int n = doc->getBaseStream()->doGetChars(static_cast<int>(std::min<Goffset>(block_len - i, signed_data_buffer.size())), signed_data_buffer.data());
+        if (n <= 0) {
+            break;
         }
+        handler->addData(signed_data_buffer.data(), n);
+        i += n;
     }
 }
 
@@ -2358,46 +2355,34 @@ void FormWidgetSignature::setSignatureType(CryptoSign::SignatureType fst)
     static_cast<FormFieldSignature *>(field)->setSignatureType(fst);
 }
 
-SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, bool forceRevalidation, time_t validationTime, bool ocspRevocationCheck, bool enableAIA, const std::function<void()> &doneCallback)
+// Check the signature and create its handler.  Returns false if the
+// signature is not to be validated (again), otherwise the ranges of the
+// file to hash are stored in <ranges>.
+bool FormFieldSignature::startValidation(bool forceRevalidation, std::vector<SignedRange> *ranges)
 {
     auto backend = CryptoSign::Factory::createActive();
     if (!backend) {
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     if (signature_info->getSignatureValStatus() != SIGNATURE_NOT_VERIFIED && !forceRevalidation) {
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     if (signature.empty()) {
         error(errSyntaxError, 0, "Invalid or missing Signature string");
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     if (!byte_range.isArray()) {
         error(errSyntaxError, 0, "Invalid or missing ByteRange array");
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     int arrayLen = byte_range.arrayGetLength();
     if (arrayLen < 2) {
         error(errSyntaxError, 0, "Too few elements in ByteRange array");
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     // Some signatures are supposed to be padded with zeroes, but are instead padded with crap
@@ -2405,16 +2390,13 @@ SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, boo
     auto [unpadded, _] = getCheckedSignature();
     if (!unpadded) {
         error(errSyntaxError, 0, "Invalid or missing Signature string");
-        return signature_info;
+        return false;
     }
 
     signature_handler = backend->createVerificationHandler(std::move(*unpadded), signature_type);
 
     if (!signature_handler) {
-        if (doneCallback) {
-            doneCallback();
-        }
-        return signature_info;
+        return false;
     }
 
     Goffset fileLength = doc->getBaseStream()->getLength();
@@ -2424,10 +2406,7 @@ SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, boo
 
         if (!offsetObj.isIntOrInt64() || !lenObj.isIntOrInt64()) {
             error(errSyntaxError, 0, "Illegal values in ByteRange array");
-            if (doneCallback) {
-                doneCallback();
-            }
-            return signature_info;
+            return false;
         }
 
         Goffset offset = offsetObj.getIntOrInt64();
@@ -2435,22 +2414,24 @@ SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, boo
 
         if (offset < 0 || offset >= fileLength || len < 0 || len > fileLength || offset + len > fileLength) {
             error(errSyntaxError, 0, "Illegal values in ByteRange array");
-            if (doneCallback) {
-                doneCallback();
-            }
-            return signature_info;
+            return false;
         }
 
-        doc->getBaseStream()->setPos(offset);
-        hashSignedDataBlock(signature_handler.get(), len);
+        ranges->push_back({ .offset = offset, .length = len });
     }
 
+    return true;
+}
+
+// Validate the signature once its signed data has been hashed.
+void FormFieldSignature::finishValidation(bool doVerifyCert, time_t validationTime, bool ocspRevocationCheck, bool enableAIA, const std::function<void()> &doneCallback)
+{
     if (!signature_info->isSubfilterSupported()) {
         error(errUnimplemented, 0, "Unable to validate this type of signature");
         if (doneCallback) {
             doneCallback();
         }
-        return signature_info;
+        return;
     }
     const SignatureValidationStatus sig_val_state = signature_handler->validateSignature();
     signature_info->setSignatureValStatus(sig_val_state);
@@ -2469,14 +2450,145 @@ SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, boo
         if (doneCallback) {
             doneCallback();
         }
-        return signature_info;
+        return;
     }
 
     signature_handler->validateCertificateAsync(std::chrono::system_clock::from_time_t(validationTime), ocspRevocationCheck, enableAIA, doneCallback);
+}
+
+SignatureInfo *FormFieldSignature::validateSignatureAsync(bool doVerifyCert, bool forceRevalidation, time_t validationTime, bool ocspRevocationCheck, bool enableAIA, const std::function<void()> &doneCallback)
+{
+    std::vector<SignedRange> ranges;
+    if (!startValidation(forceRevalidation, &ranges)) {
+        if (doneCallback) {
+            doneCallback();
+        }
+        return signature_info;
+    }
 
+    for (const SignedRange &range : ranges) {
+        doc->getBaseStream()->setPos(range.offset);
+        hashSignedDataBlock(signature_handler.get(), range.length);
+    }
+
+    finishValidation(doVerifyCert, validationTime, ocspRevocationCheck, enableAIA, doneCallback);
     return signature_info;
 }
 
+std::vector<SignatureInfo *> FormFieldSignature::validateSignaturesAsync(const std::vector<FormFieldSignature *> &signatures, bool doVerifyCert, bool forceRevalidation, time_t validationTime, bool ocspRevocationCheck, bool enableAIA)
+{
+    struct HashJob
+    {
+        CryptoSign::VerificationInterface *handler;
+        std::vector<SignedRange> ranges;
+        size_t next; // the first range not completely hashed
+    };
+
+    std::vector<FormFieldSignature *> started;
+    std::vector<HashJob> jobs;
+    for (FormFieldSignature *field : signatures) {
+        std::vector<SignedRange> ranges;
+        if (!field->startValidation(forceRevalidation, &ranges)) {
+            continue;
+        }
+        started.push_back(field);
+        // the single pass needs ranges in file order, which is always the
+        // case in practice; hash the other signatures on their own
+        bool inOrder = field->doc == signatures.front()->doc;
+        for (size_t i = 1; i < ranges.size() && inOrder; ++i) {
+            inOrder = ranges[i].offset >= ranges[i - 1].offset + ranges[i - 1].length;
+        }
+        if (inOrder) {
+            jobs.push_back({ .handler = field->signature_handler.get(), .ranges = std::move(ranges), .next = 0 });
+        } else {
+            for (const SignedRange &range : ranges) {
+                field->doc->getBaseStream()->setPos(range.offset);
+                field->hashSignedDataBlock(field->signature_handler.get(), range.length);
+            }
+        }
+    }
+
+    if (!jobs.empty()) {
+        Goffset begin = std::numeric_limits<Goffset>::max();
+        Goffset end = 0;
+        for (const HashJob &job : jobs) {
+            for (const SignedRange &range : job.ranges) {
+                if (range.length > 0) {
+                    begin = std::min(begin, range.offset);
+                    end = std::max(end, range.offset + range.length);
+                }
+            }
+        }
+
+        struct Chunk
+        {
+            std::vector<unsigned char> data;
+            Goffset pos = 0;
+            int len = 0;
+        };
+        const int chunkSize = static_cast<int>(std::min<Goffset>(std::max<Goffset>(end - begin, 0), 4 * 1024 * 1024));
+        Chunk cur, next;
+        cur.data.resize(chunkSize);
+        next.data.resize(chunkSize);
+        BaseStream *str = signatures.front()->doc->getBaseStream();
+        const auto readChunk = [&](Chunk &chunk, Goffset pos) {
+            chunk.pos = pos;
+            chunk.len = pos < end ? str->doGetChars(static_cast<int>(std::min<Goffset>(end - pos, chunkSize)), chunk.data.data()) : 0;
+        };
+
+        // feed the parts of <chunk> signed by jobs <first>, <first> +
+        // nThreads, ... to their handlers
+        const int nThreads = static_cast<int>(std::clamp<size_t>(std::thread::hardware_concurrency(), 1, jobs.size()));
+        const auto hashChunk = [&](int first, Chunk &chunk) {
+            const Goffset chunkEnd = chunk.pos + chunk.len;
+            for (size_t i = first; i < jobs.size(); i += nThreads) {
+                HashJob &job = jobs[i];
+                for (; job.next < job.ranges.size(); ++job.next) {
+                    const SignedRange &range = job.ranges[job.next];
+                    const Goffset from = std::max(range.offset, chunk.pos);
+                    const Goffset to = std::min(range.offset + range.length, chunkEnd);
+                    if (from < to) {
+                        job.handler->addData(chunk.data.data() + (from - chunk.pos), static_cast<int>(to - from));
+                    }
+                    if (range.offset + range.length > chunkEnd) {
+                        break;
+                    }
+                }
+            }
+        };
+
+        // the other threads hash a chunk while this one reads the next
+        // one, then hashes its share
+        if (begin < end) {
+            str->setPos(begin);
+            readChunk(cur, begin);
+        }
+        while (cur.len > 0) {
+            std::vector<std::thread> threads;
+            for (int i = 1; i < nThreads; ++i) {
+                threads.emplace_back(hashChunk, i, std::ref(cur));
+            }
+            readChunk(next, cur.pos + cur.len);
+            hashChunk(0, cur);
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            std::swap(cur, next);
+        }
+    }
+
+    for (FormFieldSignature *field : started) {
+        field->finishValidation(doVerifyCert, validationTime, ocspRevocationCheck, enableAIA, {});
+    }
+
+    std::vector<SignatureInfo *> infos;
+    infos.reserve(signatures.size());
+    for (const FormFieldSignature *field : signatures) {
+        infos.push_back(field->signature_info);
+    }
+    return infos;
+}
+
 CertificateValidationStatus FormFieldSignature::validateSignatureResult()
 {
     if (!signature_handler) {
@@ -621,6 +621,13 @@ public:
 
     CertificateValidationStatus validateSignatureResult();
 
+    // Like validateSignatureAsync for several signatures of the same
+    // document, without a callback.  The data signed by all of them is
+    // read in a single pass over the file and the hashes of the
+    // different signatures are computed in parallel.  Returns the
+    // SignatureInfo of each signature.
+    static std::vector<SignatureInfo *> validateSignaturesAsync(const std::vector<FormFieldSignature *> &signatures, bool doVerifyCert, bool forceRevalidation, time_t validationTime, bool ocspRevocationCheck, bool enableAIA);
+
     // returns a list with the boundaries of the signed ranges
     // the elements of the list are of type Goffset
     std::vector<Goffset> getSignedRangeBounds() const;
@@ -655,8 +662,16 @@ public:
     FormWidget *getCreateWidget();
 
 private:
+    struct SignedRange
+    {
+        Goffset offset;
+        Goffset length;
+    };
+
     void parseInfo();
     void hashSignedDataBlock(CryptoSign::VerificationInterface *handler, Goffset block_len);
+    bool startValidation(bool forceRevalidation, std::vector<SignedRange> *ranges);
+    void finishValidation(bool doVerifyCert, time_t validationTime, bool ocspRevocationCheck, bool enableAIA, const std::function<void()> &doneCallback);
 
     CryptoSign::SignatureType signature_type = CryptoSign::SignatureType::unsigned_signature_field;
     Object byte_range;
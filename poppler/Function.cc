@@ -37,7 +37,10 @@
 #include <cstring>
 #include <cctype>
 #include <cmath>
+#include <algorithm>
+#include <bit>
 #include <numbers>
+#include <unordered_map>
 #include "goo/gmem.h"
 #include "goo/gstrtod.h"
 #include "Object.h"
@@ -178,6 +181,13 @@ bool Function::init(Dict *dict)
     return true;
 }
 
+void Function::transformMany(const double *in, double *out, int count) const
+{
+    for (int i = 0; i < count; ++i) {
+        transform(in + i * m, out + i * n);
+    }
+}
+
 //------------------------------------------------------------------------
 // IdentityFunction
 //------------------------------------------------------------------------
@@ -1087,6 +1097,588 @@ void PSStack::roll(int n, int j)
     }
 }
 
+// Type 4 functions are also compiled for a simple register machine.
+// As long as the operands of copy, index and roll are constants, and
+// both branches of an ifelse leave the stack with the same shape, the
+// layout of the stack is known at each point of the function: stack
+// slots can then be mapped to registers, the stack manipulation
+// operators disappear, and operators whose operands are constants are
+// evaluated at compile time.  The types of all the values are known as
+// well, so no type checks are needed at run time.  Functions which
+// can't be compiled (or which would report an error) are run by the
+// interpreter instead.
+//
+// Registers hold doubles; booleans are stored as 0 or 1, and integers
+// as their exact values.
+
+enum PSInstrOp
+{
+    psiAbsInt,
+    psiAbsReal,
+    psiAddInt,
+    psiAddReal,
+    psiAndInt,
+    psiAndBool,
+    psiAtan,
+    psiBitshift,
+    psiCeiling,
+    psiCos,
+    psiCvi,
+    psiDiv,
+    psiEq,
+    psiExp,
+    psiFloor,
+    psiGe,
+    psiGt,
+    psiIdiv,
+    psiLe,
+    psiLn,
+    psiLog,
+    psiLt,
+    psiMod,
+    psiMulInt,
+    psiMulReal,
+    psiNe,
+    psiNegInt,
+    psiNegReal,
+    psiNotInt,
+    psiNotBool,
+    psiOrInt,
+    psiOrBool,
+    psiRound,
+    psiSin,
+    psiSqrt,
+    psiSubInt,
+    psiSubReal,
+    psiTruncate,
+    psiXorInt,
+    psiXorBool,
+    psiMove, // dst = src1
+    psiJump, // jump by src2 instructions
+    psiJumpIfFalse // jump by src2 instructions if src1 is false
+};
+
+struct PSInstr
+{
+    PSInstrOp op;
+    int dst; // destination register
+    int src1, src2; // source registers (src1 only for unary operators)
+};
+
+// Execute an instruction other than a jump.  Returns false if the
+// result can't be computed without the interpreter.
+static inline bool execPSInstr(const PSInstr &instr, double *regs)
+{
+    const double r1 = regs[instr.src1];
+    const double r2 = regs[instr.src2];
+    const int i1 = static_cast<int>(r1);
+    const int i2 = static_cast<int>(r2);
+    double &dst = regs[instr.dst];
+
+    switch (instr.op) {
+    case psiAbsInt:
+        dst = abs(i1);
+        break;
+    case psiAbsReal:
+        dst = fabs(r1);
+        break;
+    case psiAddInt:
+        dst = static_cast<int>(static_cast<unsigned int>(i1) + static_cast<unsigned int>(i2));
+        break;
+    case psiAddReal:
+        dst = r1 + r2;
+        break;
+    case psiAndInt:
+        dst = i1 & i2;
+        break;
+    case psiAndBool:
+        dst = r1 != 0 && r2 != 0;
+        break;
+    case psiAtan: {
+        double result = atan2(r1, r2) * 180.0 / std::numbers::pi;
+        if (result < 0) {
+            result += 360.0;
+        }
+        dst = result;
+        break;
+    }
+    case psiBitshift:
+        if (i2 > 0) {
+            dst = i1 << i2;
+        } else if (i2 < 0) {
+            dst = static_cast<int>(static_cast<unsigned int>(i1) >> -i2);
+        } else {
+            dst = i1;
+        }
+        break;
+    case psiCeiling:
+        dst = ceil(r1);
+        break;
+    case psiCos:
+        dst = cos(r1 * std::numbers::pi / 180.0);
+        break;
+    case psiCvi:
+        dst = static_cast<int>(r1);
+        break;
+    case psiDiv:
+        dst = r1 / r2;
+        break;
+    case psiEq:
+        dst = r1 == r2;
+        break;
+    case psiExp:
+        dst = pow(r1, r2);
+        break;
+    case psiFloor:
+        dst = floor(r1);
+        break;
+    case psiGe:
+        dst = r1 >= r2;
+        break;
+    case psiGt:
+        dst = r1 > r2;
+        break;
+    case psiIdiv:
+        if (unlikely(i2 == 0 || (i2 == -1 && i1 == INT_MIN))) {
+            return false;
+        }
+        dst = i1 / i2;
+        break;
+    case psiLe:
+        dst = r1 <= r2;
+        break;
+    case psiLn:
+        dst = log(r1);
+        break;
+    case psiLog:
+        dst = log10(r1);
+        break;
+    case psiLt:
+        dst = r1 < r2;
+        break;
+    case psiMod:
+        if (unlikely(i2 == 0 || (i2 == -1 && i1 == INT_MIN))) {
+            return false;
+        }
+        dst = i1 % i2;
+        break;
+    case psiMulInt: {
+        int result;
+        if (checkedMultiply(i1, i2, &result)) {
+            return false;
+        }
+        dst = result;
+        break;
+    }
+    case psiMulReal:
+        dst = r1 * r2;
+        break;
+    case psiNe:
+        dst = r1 != r2;
+        break;
+    case psiNegInt:
+        dst = -i1;
+        break;
+    case psiNegReal:
+        dst = -r1;
+        break;
+    case psiNotInt:
+        dst = ~i1;
+        break;
+    case psiNotBool:
+        dst = r1 == 0;
+        break;
+    case psiOrInt:
+        dst = i1 | i2;
+        break;
+    case psiOrBool:
+        dst = r1 != 0 || r2 != 0;
+        break;
+    case psiRound:
+        dst = (r1 >= 0) ? floor(r1 + 0.5) : ceil(r1 - 0.5);
+        break;
+    case psiSin:
+        dst = sin(r1 * std::numbers::pi / 180.0);
+        break;
+    case psiSqrt:
+        dst = sqrt(r1);
+        break;
+    case psiSubInt:
+        dst = static_cast<int>(static_cast<unsigned int>(i1) - static_cast<unsigned int>(i2));
+        break;
+    case psiSubReal:
+        dst = r1 - r2;
+        break;
+    case psiTruncate:
+        dst = (r1 >= 0) ? floor(r1) : ceil(r1);
+        break;
+    case psiXorInt:
+        dst = i1 ^ i2;
+        break;
+    case psiXorBool:
+        dst = (r1 != 0) != (r2 != 0);
+        break;
+    case psiMove:
+        dst = r1;
+        break;
+    case psiJump:
+    case psiJumpIfFalse:
+        return false;
+    }
+    return true;
+}
+
+// A value on the stack of a function being compiled: either a constant
+// or the contents of a register.
+struct PSOperand
+{
+    PSObjectType type; // psBool, psInt or psReal
+    int reg; // register, or -1 for constants
+    double val; // value of constants
+
+    bool operator==(const PSOperand &other) const { return type == other.type && reg == other.reg && (reg >= 0 || val == other.val); }
+};
+
+class PSCompiler
+{
+public:
+    PSCompiler(const std::vector<PSObject> &codeA, std::vector<double> *regsA) : code(codeA), regs(regsA) { }
+
+    // Compile the block starting at <codePtr>, which operates on
+    // <stack>, appending the instructions to <out>.
+    bool compileBlock(int codePtr, std::vector<PSOperand> *stack, std::vector<PSInstr> *out);
+
+    // Return the register holding <x>.
+    int getReg(const PSOperand &x);
+
+private:
+    bool compileBranches(int condReg, int thenPtr, int elsePtr, std::vector<PSOperand> *stack, std::vector<PSInstr> *out);
+    bool emit(PSInstrOp op, PSObjectType resultType, int nArgs, std::vector<PSOperand> *stack, std::vector<PSInstr> *out);
+    int newReg()
+    {
+        regs->push_back(0);
+        return static_cast<int>(regs->size()) - 1;
+    }
+
+    const std::vector<PSObject> &code;
+    std::vector<double> *regs;
+    std::unordered_map<uint64_t, int> constRegs; // registers holding constants, by value
+};
+
+int PSCompiler::getReg(const PSOperand &x)
+{
+    if (x.reg >= 0) {
+        return x.reg;
+    }
+    const uint64_t key = std::bit_cast<uint64_t>(x.val);
+    const auto it = constRegs.find(key);
+    if (it != constRegs.end()) {
+        return it->second;
+    }
+    const int reg = newReg();
+    (*regs)[reg] = x.val;
+    constRegs.emplace(key, reg);
+    return reg;
+}
+
+// Replace the <nArgs> top values of <stack> with the result of <op>;
+// the operator is evaluated right away if its operands are constants.
+bool PSCompiler::emit(PSInstrOp op, PSObjectType resultType, int nArgs, std::vector<PSOperand> *stack, std::vector<PSInstr> *out)
+{
+    const PSOperand b = stack->back();
+    const PSOperand a = (*stack)[stack->size() - nArgs];
+
+    stack->resize(stack->size() - nArgs);
+    if (a.reg < 0 && b.reg < 0) {
+        double tmp[3] = { a.val, b.val, 0 };
+        if (!execPSInstr(PSInstr { .op = op, .dst = 2, .src1 = 0, .src2 = 1 }, tmp)) {
+            return false;
+        }
+        stack->push_back(PSOperand { .type = resultType, .reg = -1, .val = tmp[2] });
+    } else {
+        const int src1 = getReg(a);
+        const int src2 = getReg(b);
+        const int dst = newReg();
+        out->push_back(PSInstr { .op = op, .dst = dst, .src1 = src1, .src2 = src2 });
+        stack->push_back(PSOperand { .type = resultType, .reg = dst, .val = 0 });
+    }
+    return true;
+}
+
+bool PSCompiler::compileBlock(int codePtr, std::vector<PSOperand> *stack, std::vector<PSInstr> *out)
+{
+    while (true) {
+        const PSObject &obj = code[codePtr++];
+        if (obj.type == psInt) {
+            stack->push_back(PSOperand { .type = psInt, .reg = -1, .val = static_cast<double>(obj.intg) });
+        } else if (obj.type == psReal) {
+            stack->push_back(PSOperand { .type = psReal, .reg = -1, .val = obj.real });
+        } else if (obj.type != psOperator) {
+            return false;
+        } else {
+            const size_t depth = stack->size();
+            const auto type = [stack](size_t i) { return (*stack)[stack->size() - 1 - i].type; };
+            const bool num1 = depth >= 1 && type(0) != psBool;
+            const bool int1 = depth >= 1 && type(0) == psInt;
+            const bool bool1 = depth >= 1 && type(0) == psBool;
+            const bool nums2 = depth >= 2 && type(0) != psBool && type(1) != psBool;
+            const bool ints2 = depth >= 2 && type(0) == psInt && type(1) == psInt;
+            const bool bools2 = depth >= 2 && type(0) == psBool && type(1) == psBool;
+            bool ok = true;
+
+            switch (obj.op) {
+            case psOpAbs:
+                ok = num1 && emit(int1 ? psiAbsInt : psiAbsReal, type(0), 1, stack, out);
+                break;
+            case psOpAdd:
+                ok = nums2 && emit(ints2 ? psiAddInt : psiAddReal, ints2 ? psInt : psReal, 2, stack, out);
+                break;
+            case psOpAnd:
+                ok = (ints2 || bools2) && emit(ints2 ? psiAndInt : psiAndBool, type(0), 2, stack, out);
+                break;
+            case psOpAtan:
+                ok = nums2 && emit(psiAtan, psReal, 2, stack, out);
+                break;
+            case psOpBitshift:
+                ok = ints2 && emit(psiBitshift, psInt, 2, stack, out);
+                break;
+            case psOpCeiling:
+                ok = num1 && (int1 || emit(psiCeiling, psReal, 1, stack, out));
+                break;
+            case psOpCopy: {
+                ok = int1 && stack->back().reg < 0;
+                if (ok) {
+                    const int n = static_cast<int>(stack->back().val);
+                    stack->pop_back();
+                    ok = n >= 0 && static_cast<size_t>(n) <= stack->size();
+                    if (ok) {
+                        const size_t first = stack->size() - n;
+                        for (int i = 0; i < n; ++i) {
+                            stack->push_back((*stack)[first + i]);
+                        }
+                    }
+                }
+                break;
+            }
+            case psOpCos:
+                ok = num1 && emit(psiCos, psReal, 1, stack, out);
+                break;
+            case psOpCvi:
+                ok = num1 && (int1 || emit(psiCvi, psInt, 1, stack, out));
+                break;
+            case psOpCvr:
+                ok = num1;
+                if (ok) {
+                    stack->back().type = psReal;
+                }
+                break;
+            case psOpDiv:
+                ok = nums2 && emit(psiDiv, psReal, 2, stack, out);
+                break;
+            case psOpDup:
+                ok = depth >= 1;
+                if (ok) {
+                    stack->push_back(stack->back());
+                }
+                break;
+            case psOpEq:
+                ok = (nums2 || bools2) && emit(psiEq, psBool, 2, stack, out);
+                break;
+            case psOpExch:
+                ok = depth >= 2;
+                if (ok) {
+                    std::swap((*stack)[depth - 1], (*stack)[depth - 2]);
+                }
+                break;
+            case psOpExp:
+                ok = nums2 && emit(psiExp, psReal, 2, stack, out);
+                break;
+            case psOpFalse:
+                stack->push_back(PSOperand { .type = psBool, .reg = -1, .val = 0 });
+                break;
+            case psOpFloor:
+                ok = num1 && (int1 || emit(psiFloor, psReal, 1, stack, out));
+                break;
+            case psOpGe:
+                ok = nums2 && emit(psiGe, psBool, 2, stack, out);
+                break;
+            case psOpGt:
+                ok = nums2 && emit(psiGt, psBool, 2, stack, out);
+                break;
+            case psOpIdiv:
+                ok = ints2 && emit(psiIdiv, psInt, 2, stack, out);
+                break;
+            case psOpIndex: {
+                ok = int1 && stack->back().reg < 0;
+                if (ok) {
+                    const int i = static_cast<int>(stack->back().val);
+                    stack->pop_back();
+                    ok = i >= 0 && static_cast<size_t>(i) < stack->size();
+                    if (ok) {
+                        stack->push_back((*stack)[stack->size() - 1 - i]);
+                    }
+                }
+                break;
+            }
+            case psOpLe:
+                ok = nums2 && emit(psiLe, psBool, 2, stack, out);
+                break;
+            case psOpLn:
+                ok = num1 && emit(psiLn, psReal, 1, stack, out);
+                break;
+            case psOpLog:
+                ok = num1 && emit(psiLog, psReal, 1, stack, out);
+                break;
+            case psOpLt:
+                ok = nums2 && emit(psiLt, psBool, 2, stack, out);
+                break;
+            case psOpMod:
+                ok = ints2 && emit(psiMod, psInt, 2, stack, out);
+                break;
+            case psOpMul:
+                ok = nums2 && emit(ints2 ? psiMulInt : psiMulReal, ints2 ? psInt : psReal, 2, stack, out);
+                break;
+            case psOpNe:
+                ok = (nums2 || bools2) && emit(psiNe, psBool, 2, stack, out);
+                break;
+            case psOpNeg:
+                ok = num1 && emit(int1 ? psiNegInt : psiNegReal, type(0), 1, stack, out);
+                break;
+            case psOpNot:
+                ok = (int1 || bool1) && emit(int1 ? psiNotInt : psiNotBool, type(0), 1, stack, out);
+                break;
+            case psOpOr:
+                ok = (ints2 || bools2) && emit(ints2 ? psiOrInt : psiOrBool, type(0), 2, stack, out);
+                break;
+            case psOpPop:
+                ok = depth >= 1;
+                if (ok) {
+                    stack->pop_back();
+                }
+                break;
+            case psOpRoll: {
+                ok = ints2 && stack->back().reg < 0 && (*stack)[depth - 2].reg < 0;
+                if (ok) {
+                    int j = static_cast<int>(stack->back().val);
+                    const int n = static_cast<int>((*stack)[depth - 2].val);
+                    stack->resize(depth - 2);
+                    // same as PSStack::roll
+                    if (n == 0 || j == INT_MIN) {
+                        break;
+                    }
+                    if (j >= 0) {
+                        j %= n;
+                    } else {
+                        j = -j % n;
+                        if (j != 0) {
+                            j = n - j;
+                        }
+                    }
+                    if (n <= 0 || j == 0 || n > psStackSize || static_cast<size_t>(n) > stack->size()) {
+                        break;
+                    }
+                    std::rotate(stack->end() - n, stack->end() - j, stack->end());
+                }
+                break;
+            }
+            case psOpRound:
+                ok = num1 && (int1 || emit(psiRound, psReal, 1, stack, out));
+                break;
+            case psOpSin:
+                ok = num1 && emit(psiSin, psReal, 1, stack, out);
+                break;
+            case psOpSqrt:
+                ok = num1 && emit(psiSqrt, psReal, 1, stack, out);
+                break;
+            case psOpSub:
+                ok = nums2 && emit(ints2 ? psiSubInt : psiSubReal, ints2 ? psInt : psReal, 2, stack, out);
+                break;
+            case psOpTrue:
+                stack->push_back(PSOperand { .type = psBool, .reg = -1, .val = 1 });
+                break;
+            case psOpTruncate:
+                ok = num1 && (int1 || emit(psiTruncate, psReal, 1, stack, out));
+                break;
+            case psOpXor:
+                ok = (ints2 || bools2) && emit(ints2 ? psiXorInt : psiXorBool, type(0), 2, stack, out);
+                break;
+            case psOpIf:
+            case psOpIfelse: {
+                ok = bool1;
+                if (ok) {
+                    const PSOperand cond = stack->back();
+                    const int thenPtr = codePtr + 2;
+                    const int elsePtr = obj.op == psOpIfelse ? code[codePtr].blk : -1;
+                    const int nextPtr = code[codePtr + 1].blk;
+                    stack->pop_back();
+                    if (cond.reg >= 0) {
+                        ok = compileBranches(cond.reg, thenPtr, elsePtr, stack, out);
+                    } else if (cond.val != 0) {
+                        ok = compileBlock(thenPtr, stack, out);
+                    } else if (elsePtr >= 0) {
+                        ok = compileBlock(elsePtr, stack, out);
+                    }
+                    codePtr = nextPtr;
+                }
+                break;
+            }
+            case psOpReturn:
+                return true;
+            }
+
+            if (!ok) {
+                return false;
+            }
+        }
+        if (stack->size() > static_cast<size_t>(psStackSize)) {
+            return false;
+        }
+    }
+}
+
+bool PSCompiler::compileBranches(int condReg, int thenPtr, int elsePtr, std::vector<PSOperand> *stack, std::vector<PSInstr> *out)
+{
+    std::vector<PSOperand> thenStack = *stack;
+    std::vector<PSOperand> elseStack = *stack;
+    std::vector<PSInstr> thenCode, elseCode;
+
+    if (!compileBlock(thenPtr, &thenStack, &thenCode)) {
+        return false;
+    }
+    if (elsePtr >= 0 && !compileBlock(elsePtr, &elseStack, &elseCode)) {
+        return false;
+    }
+    if (thenStack.size() != elseStack.size()) {
+        return false;
+    }
+
+    // values which differ between the branches are moved to a new
+    // register at the end of each branch
+    *stack = thenStack;
+    for (size_t i = 0; i < thenStack.size(); ++i) {
+        if (thenStack[i] == elseStack[i]) {
+            continue;
+        }
+        if (thenStack[i].type != elseStack[i].type) {
+            return false;
+        }
+        const int thenReg = getReg(thenStack[i]);
+        const int elseReg = getReg(elseStack[i]);
+        const int reg = newReg();
+        thenCode.push_back(PSInstr { .op = psiMove, .dst = reg, .src1 = thenReg, .src2 = 0 });
+        elseCode.push_back(PSInstr { .op = psiMove, .dst = reg, .src1 = elseReg, .src2 = 0 });
+        (*stack)[i] = PSOperand { .type = thenStack[i].type, .reg = reg, .val = 0 };
+    }
+
+    out->push_back(PSInstr { .op = psiJumpIfFalse, .dst = 0, .src1 = condReg, .src2 = static_cast<int>(thenCode.size()) + (elseCode.empty() ? 1 : 2) });
+    out->insert(out->end(), thenCode.begin(), thenCode.end());
+    if (!elseCode.empty()) {
+        out->push_back(PSInstr { .op = psiJump, .dst = 0, .src1 = 0, .src2 = static_cast<int>(elseCode.size()) + 1 });
+        out->insert(out->end(), elseCode.begin(), elseCode.end());
+    }
+    return true;
+}
+
 PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict)
 {
     Stream *str;
@@ -1095,6 +1687,7 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict)
     int i;
 
     ok = false;
+    compiled = false;
     int recursionCounter = 0;
 
     //----- initialize the generic stuff
@@ -1132,6 +1725,9 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict)
     }
     str->close();
 
+    //----- compile the function
+    compiled = compile();
+
     //----- set up the cache
     for (i = 0; i < m; ++i) {
         in[i] = domain[i][0];
@@ -1153,6 +1749,11 @@ PostScriptFunction::PostScriptFunction(const PostScriptFunction *func, PrivateTa
 
     codeString = func->codeString;
 
+    compiled = func->compiled;
+    prog = func->prog;
+    progOut = func->progOut;
+    progRegs = func->progRegs;
+
     cacheIn = func->cacheIn;
     cacheOut = func->cacheOut;
 
@@ -1163,7 +1764,6 @@ PostScriptFunction::~PostScriptFunction() = default;
 
 void PostScriptFunction::transform(const double *in, double *out) const
 {
-    PSStack stack;
     int i;
 
     // check the cache
@@ -1179,6 +1779,47 @@ void PostScriptFunction::transform(const double *in, double *out) const
         return;
     }
 
+    transformTuple(in, out);
+
+    // save current result in the cache
+    for (i = 0; i < m; ++i) {
+        cacheIn[i] = in[i];
+    }
+    for (i = 0; i < n; ++i) {
+        cacheOut[i] = out[i];
+    }
+}
+
+void PostScriptFunction::transformMany(const double *in, double *out, int count) const
+{
+    for (int i = 0; i < count; ++i) {
+        transformTuple(in + i * m, out + i * n);
+    }
+}
+
+void PostScriptFunction::transformTuple(const double *in, double *out) const
+{
+    PSStack stack;
+    int i;
+
+    if (compiled) {
+        for (i = 0; i < m; ++i) {
+            progRegs[i] = in[i];
+        }
+        // if this fails, the interpreter takes over (and reports the error)
+        if (execCompiled()) {
+            for (i = 0; i < n; ++i) {
+                out[i] = progRegs[progOut[i]];
+                if (out[i] < range[i][0]) {
+                    out[i] = range[i][0];
+                } else if (out[i] > range[i][1]) {
+                    out[i] = range[i][1];
+                }
+            }
+            return;
+        }
+    }
+
     for (i = 0; i < m; ++i) {
         //~ may need to check for integers here
         stack.pushReal(in[i]);
@@ -1198,14 +1839,56 @@ void PostScriptFunction::transform(const double *in, double *out) const
     //   error(errSyntaxWarning, -1,
     //         "Extra values on stack at end of PostScript function");
     // }
+}
 
-    // save current result in the cache
-    for (i = 0; i < m; ++i) {
-        cacheIn[i] = in[i];
+bool PostScriptFunction::compile()
+{
+    PSCompiler compiler(code, &progRegs);
+    std::vector<PSOperand> stack;
+
+    // the inputs are pushed as reals, in registers 0 .. m-1
+    progRegs.assign(m, 0);
+    for (int i = 0; i < m; ++i) {
+        stack.push_back(PSOperand { .type = psReal, .reg = i, .val = 0 });
     }
-    for (i = 0; i < n; ++i) {
-        cacheOut[i] = out[i];
+
+    bool compileOk = compiler.compileBlock(0, &stack, &prog) && stack.size() >= static_cast<size_t>(n);
+    if (compileOk) {
+        progOut.resize(n);
+        for (int i = 0; i < n; ++i) {
+            const PSOperand &x = stack[stack.size() - n + i];
+            if (x.type == psBool) {
+                compileOk = false;
+                break;
+            }
+            progOut[i] = compiler.getReg(x);
+        }
+    }
+    if (!compileOk) {
+        prog.clear();
+        progOut.clear();
+        progRegs.clear();
+    }
+    return compileOk;
+}
+
+bool PostScriptFunction::execCompiled() const
+{
+    double *regs = progRegs.data();
+    const PSInstr *instr = prog.data();
+    const PSInstr *end = instr + prog.size();
+
+    while (instr < end) {
+        if (instr->op == psiJump || (instr->op == psiJumpIfFalse && regs[instr->src1] == 0)) {
+            instr += instr->src2;
+            continue;
+        }
+        if (instr->op != psiJumpIfFalse && !execPSInstr(*instr, regs)) {
+            return false;
+        }
+        ++instr;
     }
+    return true;
 }
 
 bool PostScriptFunction::parseCode(Stream *str, int *codePtr, int &recursionCounter)
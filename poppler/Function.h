@@ -39,6 +39,7 @@ class Dict;
 class Object;
 class Stream;
 struct PSObject;
+struct PSInstr;
 class PSStack;
 struct RefRecursionChecker;
 
@@ -93,11 +94,19 @@ public:
     // Transform an input tuple into an output tuple.
     virtual void transform(const double *in, double *out) const = 0;
 
+    // Transform <count> input tuples, stored one after the other in
+    // <in>, into <count> output tuples stored the same way in <out>.
+    void transform(const double *in, double *out, int count) const { transformMany(in, out, count); }
+
     virtual bool isOk() const = 0;
 
 protected:
     static std::unique_ptr<Function> parse(Object *funcObj, RefRecursionChecker &usedParents);
 
+    // Implementation of the batch transform; the default one transforms
+    // the tuples one by one.
+    virtual void transformMany(const double *in, double *out, int count) const;
+
     explicit Function(const Function *func);
 
     int m, n; // size of input and output tuples
@@ -260,14 +269,24 @@ public:
 
     explicit PostScriptFunction(const PostScriptFunction *func, PrivateTag /*unused*/ = {});
 
+protected:
+    void transformMany(const double *in, double *out, int count) const override;
+
 private:
     bool parseCode(Stream *str, int *codePtr, int &recursionCounter);
     std::string getToken(Stream *str);
     void resizeCode(int newSize);
     void exec(PSStack *stack, int codePtr) const;
+    bool compile();
+    bool execCompiled() const;
+    void transformTuple(const double *in, double *out) const;
 
     std::string codeString;
     std::vector<PSObject> code;
+    bool compiled; // set if the code was compiled into prog
+    std::vector<PSInstr> prog; // compiled code
+    std::vector<int> progOut; // registers holding the outputs
+    mutable std::vector<double> progRegs; // register file (inputs come first)
     mutable std::array<double, funcMaxInputs> cacheIn;
     mutable std::array<double, funcMaxOutputs> cacheOut;
     bool ok;
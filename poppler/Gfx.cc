@@ -144,8 +144,8 @@ constexpr GfxColorComp patchColorDelta = dblToCol((3. / 256.0));
 const Operator Gfx::opTab[] = {
     { .name = "\"", .numArgs = 3, .tchk = { tchkNum, tchkNum, tchkString }, .func = &Gfx::opMoveSetShowText },
     { .name = "'", .numArgs = 1, .tchk = { tchkString }, .func = &Gfx::opMoveShowText },
-    { .name = "B", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFillStroke },
-    { .name = "B*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOFillStroke },
+    { .name = "B", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFillStroke, .pathOp = true },
+    { .name = "B*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOFillStroke, .pathOp = true },
     { .name = "BDC", .numArgs = 2, .tchk = { tchkName, tchkProps }, .func = &Gfx::opBeginMarkedContent },
     { .name = "BI", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opBeginImage },
     { .name = "BMC", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opBeginMarkedContent },
@@ -158,7 +158,7 @@ const Operator Gfx::opTab[] = {
     { .name = "EMC", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEndMarkedContent },
     { .name = "ET", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEndText },
     { .name = "EX", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEndIgnoreUndef },
-    { .name = "F", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFill },
+    { .name = "F", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFill, .pathOp = true },
     { .name = "G", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetStrokeGray },
     { .name = "ID", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opImageData },
     { .name = "J", .numArgs = 1, .tchk = { tchkInt }, .func = &Gfx::opSetLineCap },
@@ -167,7 +167,7 @@ const Operator Gfx::opTab[] = {
     { .name = "MP", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opMarkPoint },
     { .name = "Q", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opRestore },
     { .name = "RG", .numArgs = 3, .tchk = { tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetStrokeRGBColor },
-    { .name = "S", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opStroke },
+    { .name = "S", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opStroke, .pathOp = true },
     { .name = "SC", .numArgs = -4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetStrokeColor },
     { .name = "SCN",
       .numArgs = -33,
@@ -187,42 +187,42 @@ const Operator Gfx::opTab[] = {
     { .name = "Ts", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetTextRise },
     { .name = "Tw", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetWordSpacing },
     { .name = "Tz", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetHorizScaling },
-    { .name = "W", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opClip },
-    { .name = "W*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOClip },
-    { .name = "b", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseFillStroke },
-    { .name = "b*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseEOFillStroke },
-    { .name = "c", .numArgs = 6, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo },
+    { .name = "W", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opClip, .pathOp = true },
+    { .name = "W*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOClip, .pathOp = true },
+    { .name = "b", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseFillStroke, .pathOp = true },
+    { .name = "b*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseEOFillStroke, .pathOp = true },
+    { .name = "c", .numArgs = 6, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo, .pathOp = true },
     { .name = "cm", .numArgs = 6, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opConcat },
     { .name = "cs", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opSetFillColorSpace },
     { .name = "d", .numArgs = 2, .tchk = { tchkArray, tchkNum }, .func = &Gfx::opSetDash },
     { .name = "d0", .numArgs = 2, .tchk = { tchkNum, tchkNum }, .func = &Gfx::opSetCharWidth },
     { .name = "d1", .numArgs = 6, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetCacheDevice },
-    { .name = "f", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFill },
-    { .name = "f*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOFill },
+    { .name = "f", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opFill, .pathOp = true },
+    { .name = "f*", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEOFill, .pathOp = true },
     { .name = "g", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetFillGray },
     { .name = "gs", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opSetExtGState },
-    { .name = "h", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opClosePath },
+    { .name = "h", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opClosePath, .pathOp = true },
     { .name = "i", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetFlat },
     { .name = "j", .numArgs = 1, .tchk = { tchkInt }, .func = &Gfx::opSetLineJoin },
     { .name = "k", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetFillCMYKColor },
-    { .name = "l", .numArgs = 2, .tchk = { tchkNum, tchkNum }, .func = &Gfx::opLineTo },
-    { .name = "m", .numArgs = 2, .tchk = { tchkNum, tchkNum }, .func = &Gfx::opMoveTo },
-    { .name = "n", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEndPath },
+    { .name = "l", .numArgs = 2, .tchk = { tchkNum, tchkNum }, .func = &Gfx::opLineTo, .pathOp = true },
+    { .name = "m", .numArgs = 2, .tchk = { tchkNum, tchkNum }, .func = &Gfx::opMoveTo, .pathOp = true },
+    { .name = "n", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opEndPath, .pathOp = true },
     { .name = "q", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opSave },
-    { .name = "re", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opRectangle },
+    { .name = "re", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opRectangle, .pathOp = true },
     { .name = "rg", .numArgs = 3, .tchk = { tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetFillRGBColor },
     { .name = "ri", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opSetRenderingIntent },
-    { .name = "s", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseStroke },
+    { .name = "s", .numArgs = 0, .tchk = { tchkNone }, .func = &Gfx::opCloseStroke, .pathOp = true },
     { .name = "sc", .numArgs = -4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opSetFillColor },
     { .name = "scn",
       .numArgs = -33,
       .tchk = { tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN,
                 tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN, tchkSCN },
       .func = &Gfx::opSetFillColorN },
-    { .name = "sh", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opShFill },
-    { .name = "v", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo1 },
+    { .name = "sh", .numArgs = 1, .tchk = { tchkName }, .func = &Gfx::opShFill, .pathOp = true },
+    { .name = "v", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo1, .pathOp = true },
     { .name = "w", .numArgs = 1, .tchk = { tchkNum }, .func = &Gfx::opSetLineWidth },
-    { .name = "y", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo2 },
+    { .name = "y", .numArgs = 4, .tchk = { tchkNum, tchkNum, tchkNum, tchkNum }, .func = &Gfx::opCurveTo2, .pathOp = true },
 };
 
 static inline bool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB, unsigned int nComps, double delta)
@@ -481,6 +481,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict, double hDPI,
     baseMatrix = state->getCTM();
     displayDepth = 0;
     ocState = true;
+    textOnly = !out->needNonText() && !out->needPaths();
     parser = nullptr;
     abortCheckCbk = abortCheckCbkA;
     abortCheckCbkData = abortCheckCbkDataA;
@@ -537,6 +538,7 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict, const PDFRectangle &box,
     baseMatrix = state->getCTM();
     displayDepth = 0;
     ocState = true;
+    textOnly = !out->needNonText() && !out->needPaths();
     parser = nullptr;
     abortCheckCbk = abortCheckCbkA;
     abortCheckCbkData = abortCheckCbkDataA;
@@ -775,6 +777,12 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs)
             return;
         }
     }
+
+    // path operators have no effect on text
+    if (textOnly && op->pathOp) {
+        return;
+    }
+
     for (i = 0; i < numArgs; ++i) {
         if (!checkArg(&argPtr[i], op->tchk[i])) {
             error(errSyntaxError, getPos(), "Arg #{0:d} to '{1:s}' operator is wrong type ({2:s})", i, name, argPtr[i].getTypeName());
@@ -843,6 +851,69 @@ Goffset Gfx::getPos()
     return parser ? parser->getPos() : -1;
 }
 
+static bool isContentDelimiter(unsigned char c)
+{
+    return Lexer::isSpace(c) || (c != '\0' && strchr("()<>[]{}/%", c));
+}
+
+static bool isTextOrXObjectOp(const char *token, int len)
+{
+    if (len == 1) {
+        return token[0] == '\'' || token[0] == '"';
+    }
+    if (len == 2) {
+        return (token[0] == 'T' && (token[1] == 'j' || token[1] == 'J')) || (token[0] == 'D' && token[1] == 'o');
+    }
+    return false;
+}
+
+// Check if a form XObject may show text, i.e. if its content stream
+// has any text showing or XObject operator.  This only splits the
+// content into tokens, which is much cheaper than interpreting it, so
+// text-only devices can skip forms that only contain paths (e.g. in
+// maps and CAD drawings).  Strings and inline image data aren't
+// recognized, which can only lead to false positives.
+bool Gfx::formMayShowText(Stream *str, const Object &ref)
+{
+    if (ref.isRef()) {
+        const auto it = formHasText.find(ref.getRef().num);
+        if (it != formHasText.end()) {
+            return it->second;
+        }
+    }
+
+    bool found = true;
+    if (str->rewind()) {
+        unsigned char buf[4096];
+        char token[2];
+        int tokenLen = 0;
+        int n;
+        found = false;
+        while (!found && (n = str->doGetChars(sizeof(buf), buf)) > 0) {
+            for (int i = 0; i < n && !found; ++i) {
+                if (isContentDelimiter(buf[i])) {
+                    found = isTextOrXObjectOp(token, tokenLen);
+                    tokenLen = 0;
+                } else {
+                    if (tokenLen < 2) {
+                        token[tokenLen] = static_cast<char>(buf[i]);
+                    }
+                    if (tokenLen < 3) {
+                        ++tokenLen;
+                    }
+                }
+            }
+        }
+        found = found || isTextOrXObjectOp(token, tokenLen);
+        str->close();
+    }
+
+    if (ref.isRef()) {
+        formHasText[ref.getRef().num] = found;
+    }
+    return found;
+}
+
 //------------------------------------------------------------------------
 // graphics state operators
 //------------------------------------------------------------------------
@@ -4174,9 +4245,9 @@ void Gfx::opXObject(Object args[], int /*numArgs*/)
         }
     } else if (obj2.isName("Form")) {
         Object refObj = res->lookupXObjectNF(name);
-        bool shouldDoForm = true;
+        bool shouldDoForm = !textOnly || formMayShowText(obj1Stream, refObj);
         std::set<int>::iterator drawingFormIt;
-        if (refObj.isRef()) {
+        if (shouldDoForm && refObj.isRef()) {
             const int num = refObj.getRef().num;
             bool inserted;
             std::tie(drawingFormIt, inserted) = formsDrawing.insert(num);
@@ -4352,9 +4423,7 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
                 goto err1;
             }
             n = height * ((width + 7) / 8);
-            for (i = 0; i < n; ++i) {
-                str->getChar();
-            }
+            (void)str->discardChars(n);
             str->close();
 
             // draw it
@@ -4667,9 +4736,7 @@ void Gfx::doImage(Object *ref, Stream *str, bool inlineImg)
                 goto err1;
             }
             n = height * ((width * colorMap.getNumPixelComps() * colorMap.getBits() + 7) / 8);
-            for (i = 0; i < n; ++i) {
-                str->getChar();
-            }
+            (void)str->discardChars(n);
             str->close();
 
             // draw it
@@ -44,6 +44,7 @@
 #include "PopplerCache.h"
 
 #include <stack>
+#include <unordered_map>
 #include <vector>
 
 class PDFDoc;
@@ -106,6 +107,8 @@ struct Operator
     int numArgs;
     TchkType tchk[maxArgs];
     void (Gfx::*func)(Object args[], int numArgs);
+    bool pathOp = false; // path construction, path painting, clipping or
+                         //   shading operator
 };
 
 //------------------------------------------------------------------------
@@ -235,6 +238,8 @@ private:
     int displayDepth;
     bool ocState; // true if drawing is enabled, false if
                   //   disabled
+    bool textOnly; // true if the output device only needs text, in
+                   //   which case path operators are skipped
 
     MarkedContentStack *mcStack; // current BMC/EMC stack
 
@@ -242,6 +247,7 @@ private:
 
     std::set<int> formsDrawing; // the forms/patterns that are being drawn
     std::set<int> charProcDrawing; // the charProc that are being drawn
+    std::unordered_map<int, bool> formHasText; // cache for formMayShowText()
 
     bool // callback to check for an abort
             (*abortCheckCbk)(void *data);
@@ -254,6 +260,7 @@ private:
     static const Operator *findOp(const char *name);
     static bool checkArg(Object *arg, TchkType type);
     Goffset getPos();
+    bool formMayShowText(Stream *str, const Object &ref);
 
     int bottomGuard();
 
@@ -169,8 +169,6 @@ static const char *gfxColorSpaceModeNames[] = { "DeviceGray", "CalGray", "Device
 
 #if USE_CMS
 
-static const std::map<unsigned int, unsigned int>::size_type CMSCACHE_LIMIT = 2048;
-
 #    include <lcms2.h>
 #    define LCMS_FLAGS (cmsFLAGS_NOOPTIMIZE | cmsFLAGS_BLACKPOINTCOMPENSATION)
 
@@ -369,6 +367,27 @@ std::unique_ptr<GfxColorSpace> GfxColorSpace::parse(GfxResources *res, Object *c
 
 void GfxColorSpace::createMapping(std::vector<std::unique_ptr<GfxSeparationColorSpace>> * /*separationList*/, size_t /*maxSepComps*/) { }
 
+void GfxColorSpace::getGrays(const GfxColor *colors, GfxGray *grays, int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        getGray(colors[i], &grays[i]);
+    }
+}
+
+void GfxColorSpace::getRGBs(const GfxColor *colors, GfxRGB *rgbs, int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        getRGB(colors[i], &rgbs[i]);
+    }
+}
+
+void GfxColorSpace::getCMYKs(const GfxColor *colors, GfxCMYK *cmyks, int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        getCMYK(colors[i], &cmyks[i]);
+    }
+}
+
 void GfxColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange, int /*maxImgPixel*/) const
 {
     int i;
@@ -1852,150 +1871,163 @@ void GfxICCBasedColorSpace::buildTransforms(GfxState *state)
 }
 #endif
 
-void GfxICCBasedColorSpace::getGray(const GfxColor &color, GfxGray *gray) const
-{
 #if USE_CMS
-    if (transform != nullptr && transform->getTransformPixelType() == PT_GRAY) {
-        unsigned char in[gfxColorMaxComps];
-        unsigned char out[gfxColorMaxComps];
+// Run <n> colors through the (single color) transform, using the cache.
+// The results are the output bytes of the transform, packed into an
+// unsigned int with the first one in the most significant position.
+void GfxICCBasedColorSpace::transformColors(const GfxColor *colors, unsigned int *values, int n) const
+{
+    const int nOut = (transform->getTransformPixelType() == PT_CMYK) ? 4 : (transform->getTransformPixelType() == PT_RGB) ? 3 : 1;
+    std::vector<unsigned char> missIn, missOut;
+    std::vector<unsigned int> missKeys;
+    std::vector<int> missIdx;
 
+    for (int i = 0; i < n; ++i) {
+        unsigned char in[gfxColorMaxComps];
         if (nComps == 3 && transform->getInputPixelType() == PT_Lab) {
-            in[0] = colToByte(dblToCol(colToDbl(color.c[0]) / 100.0));
-            in[1] = colToByte(dblToCol((colToDbl(color.c[1]) + 128.0) / 255.0));
-            in[2] = colToByte(dblToCol((colToDbl(color.c[2]) + 128.0) / 255.0));
+            in[0] = colToByte(dblToCol(colToDbl(colors[i].c[0]) / 100.0));
+            in[1] = colToByte(dblToCol((colToDbl(colors[i].c[1]) + 128.0) / 255.0));
+            in[2] = colToByte(dblToCol((colToDbl(colors[i].c[2]) + 128.0) / 255.0));
         } else {
-            for (int i = 0; i < nComps; i++) {
-                in[i] = colToByte(color.c[i]);
-            }
-        }
-        if (nComps <= 4) {
-            unsigned int key = 0;
             for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            auto it = cmsCache.find(key);
-            if (it != cmsCache.end()) {
-                unsigned int value = it->second;
-                *gray = byteToCol(value & 0xff);
-                return;
+                in[j] = colToByte(colors[i].c[j]);
             }
         }
-        transform->doTransform(in, out, 1);
-        *gray = byteToCol(out[0]);
-        if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            unsigned int value = out[0];
-            cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+        unsigned int key = 0;
+        for (int j = 0; j < nComps; j++) {
+            key = (key << 8) + in[j];
         }
-    } else {
-        GfxRGB rgb;
-        getRGB(color, &rgb);
-        *gray = clip01(static_cast<GfxColorComp>(0.3 * rgb.r + 0.59 * rgb.g + 0.11 * rgb.b + 0.5));
+        if (cmsCache.lookup(key, &values[i])) {
+            continue;
+        }
+        missIn.insert(missIn.end(), in, in + nComps);
+        missKeys.push_back(key);
+        missIdx.push_back(i);
     }
-#else
-    alt->getGray(color, gray);
+    if (missIdx.empty()) {
+        return;
+    }
+
+    // convert all the colors that weren't cached in one go
+    missOut.resize(missIdx.size() * nOut);
+    transform->doTransform(missIn.data(), missOut.data(), missIdx.size());
+    for (size_t i = 0; i < missIdx.size(); ++i) {
+        unsigned int value = 0;
+        for (int j = 0; j < nOut; j++) {
+            value = (value << 8) + missOut[i * nOut + j];
+        }
+        values[missIdx[i]] = value;
+        cmsCache.insert(missKeys[i], value);
+    }
+}
 #endif
+
+void GfxICCBasedColorSpace::getGray(const GfxColor &color, GfxGray *gray) const
+{
+    getGrays(&color, gray, 1);
 }
 
-void GfxICCBasedColorSpace::getRGB(const GfxColor &color, GfxRGB *rgb) const
+void GfxICCBasedColorSpace::getGrays(const GfxColor *colors, GfxGray *grays, int n) const
 {
 #if USE_CMS
-    if (transform != nullptr && transform->getTransformPixelType() == PT_RGB) {
-        unsigned char in[gfxColorMaxComps];
-        unsigned char out[gfxColorMaxComps];
+    if (transform != nullptr && transform->getTransformPixelType() == PT_GRAY) {
+        unsigned int value1;
+        std::vector<unsigned int> valuesN;
+        unsigned int *values = &value1;
 
-        if (nComps == 3 && transform->getInputPixelType() == PT_Lab) {
-            in[0] = colToByte(dblToCol(colToDbl(color.c[0]) / 100.0));
-            in[1] = colToByte(dblToCol((colToDbl(color.c[1]) + 128.0) / 255.0));
-            in[2] = colToByte(dblToCol((colToDbl(color.c[2]) + 128.0) / 255.0));
-        } else {
-            for (int i = 0; i < nComps; i++) {
-                in[i] = colToByte(color.c[i]);
-            }
+        if (n > 1) {
+            valuesN.resize(n);
+            values = valuesN.data();
         }
-        if (nComps <= 4) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            auto it = cmsCache.find(key);
-            if (it != cmsCache.end()) {
-                unsigned int value = it->second;
-                rgb->r = byteToCol(value >> 16);
-                rgb->g = byteToCol((value >> 8) & 0xff);
-                rgb->b = byteToCol(value & 0xff);
-                return;
-            }
+        transformColors(colors, values, n);
+        for (int i = 0; i < n; ++i) {
+            grays[i] = byteToCol(values[i] & 0xff);
         }
-        transform->doTransform(in, out, 1);
-        rgb->r = byteToCol(out[0]);
-        rgb->g = byteToCol(out[1]);
-        rgb->b = byteToCol(out[2]);
-        if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            unsigned int value = (out[0] << 16) + (out[1] << 8) + out[2];
-            cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+    } else if (n == 1) {
+        GfxRGB rgb;
+        getRGB(colors[0], &rgb);
+        grays[0] = clip01(static_cast<GfxColorComp>(0.3 * rgb.r + 0.59 * rgb.g + 0.11 * rgb.b + 0.5));
+    } else {
+        std::vector<GfxRGB> rgbs(n);
+        getRGBs(colors, rgbs.data(), n);
+        for (int i = 0; i < n; ++i) {
+            grays[i] = clip01(static_cast<GfxColorComp>(0.3 * rgbs[i].r + 0.59 * rgbs[i].g + 0.11 * rgbs[i].b + 0.5));
         }
-    } else if (transform != nullptr && transform->getTransformPixelType() == PT_CMYK) {
-        unsigned char in[gfxColorMaxComps];
-        unsigned char out[gfxColorMaxComps];
-        double c, m, y, k, c1, m1, y1, k1, r, g, b;
+    }
+#else
+    alt->getGrays(colors, grays, n);
+#endif
+}
 
-        if (nComps == 3 && transform->getInputPixelType() == PT_Lab) {
-            in[0] = colToByte(dblToCol(colToDbl(color.c[0]) / 100.0));
-            in[1] = colToByte(dblToCol((colToDbl(color.c[1]) + 128.0) / 255.0));
-            in[2] = colToByte(dblToCol((colToDbl(color.c[2]) + 128.0) / 255.0));
-        } else {
-            for (int i = 0; i < nComps; i++) {
-                in[i] = colToByte(color.c[i]);
-            }
-        }
-        if (nComps <= 4) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
+void GfxICCBasedColorSpace::getRGB(const GfxColor &color, GfxRGB *rgb) const
+{
+    getRGBs(&color, rgb, 1);
+}
+
+void GfxICCBasedColorSpace::getRGBs(const GfxColor *colors, GfxRGB *rgbs, int n) const
+{
+#if USE_CMS
+    if (transform != nullptr && (transform->getTransformPixelType() == PT_RGB || transform->getTransformPixelType() == PT_CMYK)) {
+        unsigned int value1;
+        std::vector<unsigned int> valuesN;
+        unsigned int *values = &value1;
+
+        if (n > 1) {
+            valuesN.resize(n);
+            values = valuesN.data();
+        }
+        transformColors(colors, values, n);
+
+        if (transform->getTransformPixelType() == PT_RGB) {
+            for (int i = 0; i < n; ++i) {
+                rgbs[i].r = byteToCol(values[i] >> 16);
+                rgbs[i].g = byteToCol((values[i] >> 8) & 0xff);
+                rgbs[i].b = byteToCol(values[i] & 0xff);
             }
-            auto it = cmsCache.find(key);
-            if (it != cmsCache.end()) {
-                unsigned int value = it->second;
-                rgb->r = byteToCol(value >> 16);
-                rgb->g = byteToCol((value >> 8) & 0xff);
-                rgb->b = byteToCol(value & 0xff);
-                return;
+        } else {
+            double c, m, y, k, c1, m1, y1, k1, r, g, b;
+            for (int i = 0; i < n; ++i) {
+                c = byteToDbl(values[i] >> 24);
+                m = byteToDbl((values[i] >> 16) & 0xff);
+                y = byteToDbl((values[i] >> 8) & 0xff);
+                k = byteToDbl(values[i] & 0xff);
+                c1 = 1 - c;
+                m1 = 1 - m;
+                y1 = 1 - y;
+                k1 = 1 - k;
+                cmykToRGBMatrixMultiplication(c, m, y, k, c1, m1, y1, k1, r, g, b);
+                rgbs[i].r = clip01(dblToCol(r));
+                rgbs[i].g = clip01(dblToCol(g));
+                rgbs[i].b = clip01(dblToCol(b));
             }
         }
-        transform->doTransform(in, out, 1);
-        c = byteToDbl(out[0]);
-        m = byteToDbl(out[1]);
-        y = byteToDbl(out[2]);
-        k = byteToDbl(out[3]);
-        c1 = 1 - c;
-        m1 = 1 - m;
-        y1 = 1 - y;
-        k1 = 1 - k;
-        cmykToRGBMatrixMultiplication(c, m, y, k, c1, m1, y1, k1, r, g, b);
-        rgb->r = clip01(dblToCol(r));
-        rgb->g = clip01(dblToCol(g));
-        rgb->b = clip01(dblToCol(b));
-        if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            unsigned int value = (dblToByte(r) << 16) + (dblToByte(g) << 8) + dblToByte(b);
-            cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+    } else {
+        alt->getRGBs(colors, rgbs, n);
+    }
+#else
+    alt->getRGBs(colors, rgbs, n);
+#endif
+}
+
+void GfxICCBasedColorSpace::getGrayLine(unsigned char *in, unsigned char *out, int length)
+{
+#if USE_CMS
+    if (transform != nullptr && transform->getTransformPixelType() == PT_GRAY && transform->getInputPixelType() != PT_Lab) {
+        transform->doTransform(in, out, length);
+    } else if (lineTransform != nullptr) {
+        auto *tmp = static_cast<unsigned char *>(gmallocn(3 * length, sizeof(unsigned char)));
+        getRGBLine(in, tmp, length);
+        unsigned char *current = tmp;
+        for (int i = 0; i < length; ++i) {
+            out[i] = static_cast<unsigned char>(0.3 * current[0] + 0.59 * current[1] + 0.11 * current[2] + 0.5);
+            current += 3;
         }
+        gfree(tmp);
     } else {
-        alt->getRGB(color, rgb);
+        alt->getGrayLine(in, out, length);
     }
 #else
-    alt->getRGB(color, rgb);
+    alt->getGrayLine(in, out, length);
 #endif
 }
 
@@ -2010,6 +2042,14 @@ void GfxICCBasedColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int
             out[i] = (current[0] << 16) | (current[1] << 8) | current[2];
         }
         gfree(tmp);
+    } else if (lineTransform != nullptr && lineTransform->getTransformPixelType() == PT_CMYK) {
+        auto *tmp = static_cast<unsigned char *>(gmallocn(3 * length, sizeof(unsigned char)));
+        getRGBLine(in, tmp, length);
+        for (int i = 0; i < length; ++i) {
+            unsigned char *current = tmp + (i * 3);
+            out[i] = (current[0] << 16) | (current[1] << 8) | current[2];
+        }
+        gfree(tmp);
     } else {
         alt->getRGBLine(in, out, length);
     }
@@ -2167,73 +2207,61 @@ void GfxICCBasedColorSpace::getDeviceNLine(unsigned char *in, unsigned char *out
 }
 
 void GfxICCBasedColorSpace::getCMYK(const GfxColor &color, GfxCMYK *cmyk) const
+{
+    getCMYKs(&color, cmyk, 1);
+}
+
+void GfxICCBasedColorSpace::getCMYKs(const GfxColor *colors, GfxCMYK *cmyks, int n) const
 {
 #if USE_CMS
     if (transform != nullptr && transform->getTransformPixelType() == PT_CMYK) {
-        unsigned char in[gfxColorMaxComps];
-        unsigned char out[gfxColorMaxComps];
+        unsigned int value1;
+        std::vector<unsigned int> valuesN;
+        unsigned int *values = &value1;
 
-        if (nComps == 3 && transform->getInputPixelType() == PT_Lab) {
-            in[0] = colToByte(dblToCol(colToDbl(color.c[0]) / 100.0));
-            in[1] = colToByte(dblToCol((colToDbl(color.c[1]) + 128.0) / 255.0));
-            in[2] = colToByte(dblToCol((colToDbl(color.c[2]) + 128.0) / 255.0));
-        } else {
-            for (int i = 0; i < nComps; i++) {
-                in[i] = colToByte(color.c[i]);
-            }
+        if (n > 1) {
+            valuesN.resize(n);
+            values = valuesN.data();
         }
-        if (nComps <= 4) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            auto it = cmsCache.find(key);
-            if (it != cmsCache.end()) {
-                unsigned int value = it->second;
-                cmyk->c = byteToCol(value >> 24);
-                cmyk->m = byteToCol((value >> 16) & 0xff);
-                cmyk->y = byteToCol((value >> 8) & 0xff);
-                cmyk->k = byteToCol(value & 0xff);
-                return;
-            }
-        }
-        transform->doTransform(in, out, 1);
-        cmyk->c = byteToCol(out[0]);
-        cmyk->m = byteToCol(out[1]);
-        cmyk->y = byteToCol(out[2]);
-        cmyk->k = byteToCol(out[3]);
-        if (nComps <= 4 && cmsCache.size() <= CMSCACHE_LIMIT) {
-            unsigned int key = 0;
-            for (int j = 0; j < nComps; j++) {
-                key = (key << 8) + in[j];
-            }
-            unsigned int value = (out[0] << 24) + (out[1] << 16) + (out[2] << 8) + out[3];
-            cmsCache.insert(std::pair<unsigned int, unsigned int>(key, value));
+        transformColors(colors, values, n);
+        for (int i = 0; i < n; ++i) {
+            cmyks[i].c = byteToCol(values[i] >> 24);
+            cmyks[i].m = byteToCol((values[i] >> 16) & 0xff);
+            cmyks[i].y = byteToCol((values[i] >> 8) & 0xff);
+            cmyks[i].k = byteToCol(values[i] & 0xff);
         }
     } else if (nComps != 4 && transform != nullptr && transform->getTransformPixelType() == PT_RGB) {
-        GfxRGB rgb;
+        GfxRGB rgb1;
+        std::vector<GfxRGB> rgbsN;
+        GfxRGB *rgbs = &rgb1;
         GfxColorComp c, m, y, k;
 
-        getRGB(color, &rgb);
-        c = clip01(gfxColorComp1 - rgb.r);
-        m = clip01(gfxColorComp1 - rgb.g);
-        y = clip01(gfxColorComp1 - rgb.b);
-        k = c;
-        if (m < k) {
-            k = m;
+        if (n > 1) {
+            rgbsN.resize(n);
+            rgbs = rgbsN.data();
         }
-        if (y < k) {
-            k = y;
+        getRGBs(colors, rgbs, n);
+        for (int i = 0; i < n; ++i) {
+            c = clip01(gfxColorComp1 - rgbs[i].r);
+            m = clip01(gfxColorComp1 - rgbs[i].g);
+            y = clip01(gfxColorComp1 - rgbs[i].b);
+            k = c;
+            if (m < k) {
+                k = m;
+            }
+            if (y < k) {
+                k = y;
+            }
+            cmyks[i].c = c - k;
+            cmyks[i].m = m - k;
+            cmyks[i].y = y - k;
+            cmyks[i].k = k;
         }
-        cmyk->c = c - k;
-        cmyk->m = m - k;
-        cmyk->y = y - k;
-        cmyk->k = k;
     } else {
-        alt->getCMYK(color, cmyk);
+        alt->getCMYKs(colors, cmyks, n);
     }
 #else
-    alt->getCMYK(color, cmyk);
+    alt->getCMYKs(colors, cmyks, n);
 #endif
 }
 
@@ -2246,6 +2274,15 @@ bool GfxICCBasedColorSpace::useGetRGBLine() const
 #endif
 }
 
+bool GfxICCBasedColorSpace::useGetGrayLine() const
+{
+#if USE_CMS
+    return (transform != nullptr && transform->getTransformPixelType() == PT_GRAY && transform->getInputPixelType() != PT_Lab) || lineTransform != nullptr || alt->useGetGrayLine();
+#else
+    return alt->useGetGrayLine();
+#endif
+}
+
 bool GfxICCBasedColorSpace::useGetCMYKLine() const
 {
 #if USE_CMS
@@ -2576,6 +2613,127 @@ void GfxIndexedColorSpace::getDefaultRanges(double *decodeLow, double *decodeRan
     decodeRange[0] = maxImgPixel;
 }
 
+//------------------------------------------------------------------------
+// line conversion for the tint transform color spaces
+//------------------------------------------------------------------------
+
+// Convert a line of colors in <alt>, given as doubles, to bytes that
+// can be passed to its line conversion functions.
+static std::vector<unsigned char> altLineToBytes(GfxColorSpace *alt, const std::vector<double> &line, int length)
+{
+    double low[gfxColorMaxComps], range[gfxColorMaxComps];
+    const int n = alt->getNComps();
+    std::vector<unsigned char> bytes(static_cast<size_t>(length) * n);
+
+    alt->getDefaultRanges(low, range, 255);
+    for (int i = 0; i < length; ++i) {
+        for (int j = 0; j < n; ++j) {
+            const double x = range[j] != 0 ? (line[i * n + j] - low[j]) / range[j] : 0;
+            bytes[i * n + j] = (x <= 0) ? 0 : (x >= 1) ? 255 : static_cast<unsigned char>(x * 255 + 0.5);
+        }
+    }
+    return bytes;
+}
+
+static inline void altLineGetColor(GfxColorSpace *alt, const std::vector<double> &line, int i, GfxColor *color)
+{
+    const int n = alt->getNComps();
+    for (int j = 0; j < n; ++j) {
+        color->c[j] = dblToCol(line[i * n + j]);
+    }
+}
+
+// The following functions convert a line of colors in <alt>, using its
+// line conversion function if it has one, and pixel by pixel otherwise.
+
+static void altLineToGray(GfxColorSpace *alt, const std::vector<double> &line, unsigned char *out, int length)
+{
+    if (alt->useGetGrayLine()) {
+        std::vector<unsigned char> bytes = altLineToBytes(alt, line, length);
+        alt->getGrayLine(bytes.data(), out, length);
+        return;
+    }
+    GfxColor color;
+    GfxGray gray;
+    for (int i = 0; i < length; ++i) {
+        altLineGetColor(alt, line, i, &color);
+        alt->getGray(color, &gray);
+        out[i] = colToByte(gray);
+    }
+}
+
+static void altLineToRGB(GfxColorSpace *alt, const std::vector<double> &line, unsigned int *out, int length)
+{
+    if (alt->useGetRGBLine()) {
+        std::vector<unsigned char> bytes = altLineToBytes(alt, line, length);
+        alt->getRGBLine(bytes.data(), out, length);
+        return;
+    }
+    GfxColor color;
+    GfxRGB rgb;
+    for (int i = 0; i < length; ++i) {
+        altLineGetColor(alt, line, i, &color);
+        alt->getRGB(color, &rgb);
+        out[i] = (static_cast<int>(colToByte(rgb.r)) << 16) | (static_cast<int>(colToByte(rgb.g)) << 8) | (static_cast<int>(colToByte(rgb.b)) << 0);
+    }
+}
+
+static void altLineToRGB(GfxColorSpace *alt, const std::vector<double> &line, unsigned char *out, int length)
+{
+    if (alt->useGetRGBLine()) {
+        std::vector<unsigned char> bytes = altLineToBytes(alt, line, length);
+        alt->getRGBLine(bytes.data(), out, length);
+        return;
+    }
+    GfxColor color;
+    GfxRGB rgb;
+    for (int i = 0; i < length; ++i) {
+        altLineGetColor(alt, line, i, &color);
+        alt->getRGB(color, &rgb);
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+    }
+}
+
+static void altLineToRGBX(GfxColorSpace *alt, const std::vector<double> &line, unsigned char *out, int length)
+{
+    if (alt->useGetRGBLine()) {
+        std::vector<unsigned char> bytes = altLineToBytes(alt, line, length);
+        alt->getRGBXLine(bytes.data(), out, length);
+        return;
+    }
+    GfxColor color;
+    GfxRGB rgb;
+    for (int i = 0; i < length; ++i) {
+        altLineGetColor(alt, line, i, &color);
+        alt->getRGB(color, &rgb);
+        *out++ = colToByte(rgb.r);
+        *out++ = colToByte(rgb.g);
+        *out++ = colToByte(rgb.b);
+        *out++ = 255;
+    }
+}
+
+static void altLineToCMYK(GfxColorSpace *alt, const std::vector<double> &line, unsigned char *out, int length)
+{
+    if (alt->useGetCMYKLine()) {
+        std::vector<unsigned char> bytes = altLineToBytes(alt, line, length);
+        alt->getCMYKLine(bytes.data(), out, length);
+        return;
+    }
+    GfxColor color;
+    GfxCMYK cmyk;
+    for (int i = 0; i < length; ++i) {
+        altLineGetColor(alt, line, i, &color);
+        alt->getCMYK(color, &cmyk);
+        *out++ = colToByte(cmyk.c);
+        *out++ = colToByte(cmyk.m);
+        *out++ = colToByte(cmyk.y);
+        *out++ = colToByte(cmyk.k);
+    }
+}
+
 //------------------------------------------------------------------------
 // GfxSeparationColorSpace
 //------------------------------------------------------------------------
@@ -2749,6 +2907,105 @@ void GfxSeparationColorSpace::getDeviceN(const GfxColor &color, GfxColor *device
     }
 }
 
+std::vector<double> GfxSeparationColorSpace::mapLineToAlt(const unsigned char *in, int length)
+{
+    const int n = alt->getNComps();
+
+    // evaluate the tint transform for all the 8-bit tint values
+    if (altLookup.empty()) {
+        const int outSize = func->getOutputSize();
+        std::vector<double> x(256), y(256 * outSize);
+        for (int i = 0; i < 256; ++i) {
+            x[i] = byteToDbl(i);
+        }
+        func->transform(x.data(), y.data(), 256);
+        altLookup.resize(256 * n);
+        for (int i = 0; i < 256; ++i) {
+            std::copy_n(&y[i * outSize], n, &altLookup[i * n]);
+        }
+    }
+
+    std::vector<double> line(static_cast<size_t>(length) * n);
+    for (int i = 0; i < length; ++i) {
+        std::copy_n(&altLookup[in[i] * n], n, &line[i * n]);
+    }
+    return line;
+}
+
+void GfxSeparationColorSpace::getGrayLine(unsigned char *in, unsigned char *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->compare("Black") == 0) {
+        for (int i = 0; i < length; ++i) {
+            out[i] = 255 - in[i];
+        }
+        return;
+    }
+    altLineToGray(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxSeparationColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->compare("Black") == 0) {
+        for (int i = 0; i < length; ++i) {
+            const unsigned int gray = 255 - in[i];
+            out[i] = (gray << 16) | (gray << 8) | gray;
+        }
+        return;
+    }
+    altLineToRGB(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxSeparationColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->compare("Black") == 0) {
+        for (int i = 0; i < length; ++i) {
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+        }
+        return;
+    }
+    altLineToRGB(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxSeparationColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    if (alt->getMode() == csDeviceGray && name->compare("Black") == 0) {
+        for (int i = 0; i < length; ++i) {
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255 - in[i];
+            *out++ = 255;
+        }
+        return;
+    }
+    altLineToRGBX(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxSeparationColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    int comp = -1;
+
+    if (name->compare("Cyan") == 0) {
+        comp = 0;
+    } else if (name->compare("Magenta") == 0) {
+        comp = 1;
+    } else if (name->compare("Yellow") == 0) {
+        comp = 2;
+    } else if (name->compare("Black") == 0) {
+        comp = 3;
+    }
+    if (comp >= 0) {
+        for (int i = 0; i < length; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                *out++ = (j == comp) ? in[i] : 0;
+            }
+        }
+        return;
+    }
+    altLineToCMYK(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
 void GfxSeparationColorSpace::getDefaultColor(GfxColor *color) const
 {
     color->c[0] = gfxColorComp1;
@@ -2805,11 +3062,24 @@ void GfxSeparationColorSpace::createMapping(std::vector<std::unique_ptr<GfxSepar
 // GfxDeviceNColorSpace
 //------------------------------------------------------------------------
 
+// Number of samples along each input of the sampled tint transform of
+// DeviceN color spaces: the grid is limited to 32768 points, and must
+// have at least three samples per input to be useful.
+static int deviceNLookupGridSize(int nComps)
+{
+    int size = 256;
+    while (size >= 3 && std::pow(size, nComps) > 32768) {
+        --size;
+    }
+    return size >= 3 ? size : 0;
+}
+
 GfxDeviceNColorSpace::GfxDeviceNColorSpace(int nCompsA, std::vector<std::string> &&namesA, std::unique_ptr<GfxColorSpace> &&altA, std::unique_ptr<Function> funcA, std::vector<std::unique_ptr<GfxSeparationColorSpace>> &&sepsCSA)
     : nComps(nCompsA), names(std::move(namesA)), alt(std::move(altA))
 {
     func = std::move(funcA);
     sepsCS = std::move(sepsCSA);
+    lookupGridSize = deviceNLookupGridSize(nComps);
     nonMarking = true;
     overprintMask = 0;
     for (int i = 0; i < nComps; ++i) {
@@ -2838,6 +3108,7 @@ GfxDeviceNColorSpace::GfxDeviceNColorSpace(int nCompsA, const std::vector<std::s
 {
     func = std::move(funcA);
     sepsCS = std::move(sepsCSA);
+    lookupGridSize = deviceNLookupGridSize(nComps);
     mapping = mappingA;
     nonMarking = nonMarkingA;
     overprintMask = overprintMaskA;
@@ -2998,6 +3269,118 @@ void GfxDeviceNColorSpace::getDeviceN(const GfxColor &color, GfxColor *deviceN)
     }
 }
 
+std::vector<double> GfxDeviceNColorSpace::mapLineToAlt(const unsigned char *in, int length)
+{
+    const int n = alt->getNComps();
+    const int inSize = func->getInputSize();
+    const int outSize = func->getOutputSize();
+    std::vector<double> line(static_cast<size_t>(length) * n);
+
+    // without a lookup table, evaluate the tint transform for each pixel
+    if (lookupGridSize == 0) {
+        double x[gfxColorMaxComps], c[funcMaxOutputs];
+        for (int i = 0; i < length; ++i) {
+            for (int k = 0; k < nComps; ++k) {
+                x[k] = byteToDbl(in[i * nComps + k]);
+            }
+            func->transform(x, c);
+            std::copy_n(c, n, &line[i * n]);
+        }
+        return line;
+    }
+
+    // the grid points are numbered with the last input varying fastest
+    const int g = lookupGridSize;
+    int stride[gfxColorMaxComps];
+    int nPoints = 1;
+    for (int k = nComps - 1; k >= 0; --k) {
+        stride[k] = nPoints;
+        nPoints *= g;
+    }
+
+    // sample the tint transform on the grid
+    if (altLookup.empty()) {
+        std::vector<double> x(static_cast<size_t>(nPoints) * inSize), y(static_cast<size_t>(nPoints) * outSize);
+        for (int p = 0; p < nPoints; ++p) {
+            for (int k = 0; k < inSize; ++k) {
+                x[p * inSize + k] = static_cast<double>((p / stride[k]) % g) / (g - 1);
+            }
+        }
+        func->transform(x.data(), y.data(), nPoints);
+        altLookup.resize(static_cast<size_t>(nPoints) * n);
+        for (int p = 0; p < nPoints; ++p) {
+            std::copy_n(&y[p * outSize], n, &altLookup[p * n]);
+        }
+    }
+
+    // grid cell and position within the cell of each input value
+    int cell[256];
+    double frac[256];
+    for (int v = 0; v < 256; ++v) {
+        const double t = v * (g - 1) / 255.0;
+        cell[v] = std::min(static_cast<int>(t), g - 2);
+        frac[v] = t - cell[v];
+    }
+
+    // simplex interpolation: sort the inputs by their position in the
+    // cell, and walk from the lowest corner of the cell to the highest
+    // one, moving along one input at a time
+    int order[gfxColorMaxComps];
+    for (int i = 0; i < length; ++i) {
+        const unsigned char *pix = &in[i * nComps];
+        int base = 0;
+        for (int k = 0; k < nComps; ++k) {
+            base += cell[pix[k]] * stride[k];
+            int r = k;
+            while (r > 0 && frac[pix[order[r - 1]]] < frac[pix[k]]) {
+                order[r] = order[r - 1];
+                --r;
+            }
+            order[r] = k;
+        }
+
+        double *out = &line[i * n];
+        const double w0 = 1 - frac[pix[order[0]]];
+        for (int j = 0; j < n; ++j) {
+            out[j] = w0 * altLookup[base * n + j];
+        }
+        int corner = base;
+        for (int r = 0; r < nComps; ++r) {
+            corner += stride[order[r]];
+            const double w = frac[pix[order[r]]] - (r + 1 < nComps ? frac[pix[order[r + 1]]] : 0);
+            for (int j = 0; j < n; ++j) {
+                out[j] += w * altLookup[corner * n + j];
+            }
+        }
+    }
+    return line;
+}
+
+void GfxDeviceNColorSpace::getGrayLine(unsigned char *in, unsigned char *out, int length)
+{
+    altLineToGray(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxDeviceNColorSpace::getRGBLine(unsigned char *in, unsigned int *out, int length)
+{
+    altLineToRGB(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxDeviceNColorSpace::getRGBLine(unsigned char *in, unsigned char *out, int length)
+{
+    altLineToRGB(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxDeviceNColorSpace::getRGBXLine(unsigned char *in, unsigned char *out, int length)
+{
+    altLineToRGBX(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
+void GfxDeviceNColorSpace::getCMYKLine(unsigned char *in, unsigned char *out, int length)
+{
+    altLineToCMYK(alt.get(), mapLineToAlt(in, length), out, length);
+}
+
 void GfxDeviceNColorSpace::getDefaultColor(GfxColor *color) const
 {
     int i;
@@ -3801,12 +4184,18 @@ void GfxUnivariateShading::setupCache(const Matrix *ctm, double xMin, double yMi
         for (j = 0; j < cacheSize; ++j) {
             cacheBounds[j] = tMin + j * step;
             cacheCoeff[j] = coeff;
+        }
 
-            for (i = 0; i < nComps; ++i) {
-                cacheValues[j * nComps + i] = 0;
-            }
+        // evaluate the functions for all the cache entries at once
+        if (getNFuncs() == 1) {
+            funcs[0]->transform(cacheBounds, cacheValues, cacheSize);
+        } else {
+            std::vector<double> values(cacheSize);
             for (i = 0; i < getNFuncs(); ++i) {
-                funcs[i]->transform(&cacheBounds[j], &cacheValues[j * nComps + i]);
+                funcs[i]->transform(cacheBounds, values.data(), cacheSize);
+                for (j = 0; j < cacheSize; ++j) {
+                    cacheValues[j * nComps + i] = values[j];
+                }
             }
         }
     }
@@ -5577,14 +5966,20 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode, std::unique_ptr<Gf
             byte_lookup = static_cast<unsigned char *>(gmallocn((maxPixel + 1), nComps2));
             useByteLookup = true;
         }
+        // evaluate the tint transform for all the pixel values at once
+        const int sepOutSize = sepFunc->getOutputSize();
+        std::vector<double> sepIn(maxPixel + 1), sepOut((maxPixel + 1) * sepOutSize);
+        for (i = 0; i <= maxPixel; ++i) {
+            sepIn[i] = decodeLow[0] + (i * decodeRange[0]) / maxPixel;
+        }
+        sepFunc->transform(sepIn.data(), sepOut.data(), maxPixel + 1);
         for (k = 0; k < nComps2; ++k) {
             lookup2[k] = static_cast<GfxColorComp *>(gmallocn(maxPixel + 1, sizeof(GfxColorComp)));
             for (i = 0; i <= maxPixel; ++i) {
-                x[0] = decodeLow[0] + (i * decodeRange[0]) / maxPixel;
-                sepFunc->transform(x, y);
-                lookup2[k][i] = dblToCol(y[k]);
+                const double mappedSep = sepOut[i * sepOutSize + k];
+                lookup2[k][i] = dblToCol(mappedSep);
                 if (useByteLookup) {
-                    byte_lookup[i * nComps2 + k] = static_cast<unsigned char>(y[k] * 255);
+                    byte_lookup[i * nComps2 + k] = static_cast<unsigned char>(mappedSep * 255);
                 }
             }
         }
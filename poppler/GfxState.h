@@ -252,6 +252,50 @@ private:
     unsigned int transformPixelType;
 };
 
+// Fixed-size cache of single color conversions done with a
+// GfxColorTransform, keyed by the packed input bytes of the color (at
+// most 4 components).  Entries that hash to the same slot replace each
+// other.
+class GfxColorTransformCache
+{
+public:
+    bool lookup(unsigned int key, unsigned int *value) const
+    {
+        if (!entries) {
+            return false;
+        }
+        const Entry &entry = (*entries)[slot(key)];
+        if (!entry.valid || entry.key != key) {
+            return false;
+        }
+        *value = entry.value;
+        return true;
+    }
+
+    void insert(unsigned int key, unsigned int value)
+    {
+        if (!entries) {
+            entries = std::make_unique<std::array<Entry, cacheSize>>();
+        }
+        (*entries)[slot(key)] = { .key = key, .value = value, .valid = true };
+    }
+
+private:
+    static constexpr int cacheBits = 11;
+    static constexpr int cacheSize = 1 << cacheBits;
+
+    struct Entry
+    {
+        unsigned int key = 0;
+        unsigned int value = 0;
+        bool valid = false;
+    };
+
+    static unsigned int slot(unsigned int key) { return (key * 2654435761U) >> (32 - cacheBits); }
+
+    std::unique_ptr<std::array<Entry, cacheSize>> entries; // allocated on first insert
+};
+
 class POPPLER_PRIVATE_EXPORT GfxColorSpace
 {
 public:
@@ -272,6 +316,12 @@ public:
     virtual void getRGB(const GfxColor &color, GfxRGB *rgb) const = 0;
     virtual void getCMYK(const GfxColor &color, GfxCMYK *cmyk) const = 0;
     virtual void getDeviceN(const GfxColor &color, GfxColor *deviceN) const = 0;
+
+    // Convert <n> colors at once to gray, RGB, or CMYK.
+    virtual void getGrays(const GfxColor *colors, GfxGray *grays, int n) const;
+    virtual void getRGBs(const GfxColor *colors, GfxRGB *rgbs, int n) const;
+    virtual void getCMYKs(const GfxColor *colors, GfxCMYK *cmyks, int n) const;
+
     virtual void getGrayLine(unsigned char * /*in*/, unsigned char * /*out*/, int /*length*/) { error(errInternal, -1, "GfxColorSpace::getGrayLine this should not happen"); }
     virtual void getRGBLine(unsigned char * /*in*/, unsigned int * /*out*/, int /*length*/) { error(errInternal, -1, "GfxColorSpace::getRGBLine (first variant) this should not happen"); }
     virtual void getRGBLine(unsigned char * /*in*/, unsigned char * /*out*/, int /*length*/) { error(errInternal, -1, "GfxColorSpace::getRGBLine (second variant) this should not happen"); }
@@ -595,6 +645,10 @@ public:
     void getRGB(const GfxColor &color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor &color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor &color, GfxColor *deviceN) const override;
+    void getGrays(const GfxColor *colors, GfxGray *grays, int n) const override;
+    void getRGBs(const GfxColor *colors, GfxRGB *rgbs, int n) const override;
+    void getCMYKs(const GfxColor *colors, GfxCMYK *cmyks, int n) const override;
+    void getGrayLine(unsigned char *in, unsigned char *out, int length) override;
     void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
     void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
     void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
@@ -602,6 +656,7 @@ public:
     void getDeviceNLine(unsigned char *in, unsigned char *out, int length) override;
 
     bool useGetRGBLine() const override;
+    bool useGetGrayLine() const override;
     bool useGetCMYKLine() const override;
     bool useGetDeviceNLine() const override;
 
@@ -632,7 +687,8 @@ private:
     int getIntent() { return (transform != nullptr) ? transform->getIntent() : 0; }
     std::shared_ptr<GfxColorTransform> transform;
     std::shared_ptr<GfxColorTransform> lineTransform; // color transform for line
-    mutable std::map<unsigned int, unsigned int> cmsCache;
+    mutable GfxColorTransformCache cmsCache;
+    void transformColors(const GfxColor *colors, unsigned int *values, int n) const;
 #endif
 };
 //------------------------------------------------------------------------
@@ -708,6 +764,15 @@ public:
     void getRGB(const GfxColor &color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor &color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor &color, GfxColor *deviceN) const override;
+    void getGrayLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+
+    bool useGetRGBLine() const override { return true; }
+    bool useGetGrayLine() const override { return true; }
+    bool useGetCMYKLine() const override { return true; }
 
     void createMapping(std::vector<std::unique_ptr<GfxSeparationColorSpace>> *separationList, size_t maxSepComps) override;
 
@@ -725,10 +790,15 @@ public:
                             PrivateTag /*unused*/ = {});
 
 private:
+    // Map a line of tint values to the alternate color space.
+    std::vector<double> mapLineToAlt(const unsigned char *in, int length);
+
     const std::unique_ptr<GooString> name; // colorant name
     const std::unique_ptr<GfxColorSpace> alt; // alternate color space
     std::unique_ptr<Function> func; // tint transform (into alternate color space)
     bool nonMarking;
+    std::vector<double> altLookup; // tint transform for each 8-bit tint value
+                                   //   (built on first use)
 };
 
 //------------------------------------------------------------------------
@@ -754,6 +824,15 @@ public:
     void getRGB(const GfxColor &color, GfxRGB *rgb) const override;
     void getCMYK(const GfxColor &color, GfxCMYK *cmyk) const override;
     void getDeviceN(const GfxColor &color, GfxColor *deviceN) const override;
+    void getGrayLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned int *out, int length) override;
+    void getRGBLine(unsigned char *in, unsigned char *out, int length) override;
+    void getRGBXLine(unsigned char *in, unsigned char *out, int length) override;
+    void getCMYKLine(unsigned char *in, unsigned char *out, int length) override;
+
+    bool useGetRGBLine() const override { return lookupGridSize > 0; }
+    bool useGetGrayLine() const override { return lookupGridSize > 0; }
+    bool useGetCMYKLine() const override { return lookupGridSize > 0; }
 
     void createMapping(std::vector<std::unique_ptr<GfxSeparationColorSpace>> *separationList, size_t maxSepComps) override;
 
@@ -777,6 +856,15 @@ private:
     std::unique_ptr<Function> func; // tint transform (into alternate color space)
     bool nonMarking;
     std::vector<std::unique_ptr<GfxSeparationColorSpace>> sepsCS; // list of separation cs for spot colorants;
+
+    // Map a line of colors (nComps bytes per pixel) to the alternate
+    // color space, interpolating in a sampled version of the tint
+    // transform.
+    std::vector<double> mapLineToAlt(const unsigned char *in, int length);
+
+    int lookupGridSize; // number of samples of the tint transform along
+                        //   each input, or 0 if there are too many inputs
+    std::vector<double> altLookup; // sampled tint transform (built on first use)
 };
 
 //------------------------------------------------------------------------
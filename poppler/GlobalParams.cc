@@ -60,6 +60,7 @@
 #include <config.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
 #include <filesystem>
@@ -76,6 +77,7 @@
 #include "goo/glibc.h"
 #include "goo/GooString.h"
 #include "goo/gfile.h"
+#include "goo/grandom.h"
 #include "Error.h"
 #include "NameToCharCode.h"
 #include "CharCodeToUnicode.h"
@@ -388,6 +390,212 @@ const SysFontInfo *SysFontList::find(const std::string &name, bool fixedWidth, b
     return fi;
 }
 
+#if WITH_FONTCONFIGURATION_FONTCONFIG
+
+//------------------------------------------------------------------------
+// FcLookupCache
+//------------------------------------------------------------------------
+
+// Result of a fontconfig font search.
+struct FcLookupResult
+{
+    std::string path; // empty if no usable font was found
+    int fontNum = 0;
+    SysFontType type = sysFontTTF;
+    bool bold = false; // style of the matched font
+    bool italic = false;
+    bool oblique = false;
+    std::string name; // substitute name, or family for per-char lookups
+    std::string style; // only set for per-char lookups
+};
+
+// Memo of fontconfig searches.  Keys are built from the (unsubstituted)
+// pattern given to fontconfig, so they cover everything that influences
+// the result.  The memo can be saved to disk and reloaded by later
+// processes; it is discarded if the fontconfig configuration or font
+// directories changed in the meantime.
+class FcLookupCache
+{
+public:
+    FcLookupCache() = default;
+    ~FcLookupCache();
+    FcLookupCache(const FcLookupCache &) = delete;
+    FcLookupCache &operator=(const FcLookupCache &) = delete;
+
+    // Build the key for a search for <pattern>, and optionally for a font
+    // containing <uChar>.
+    static std::string makeKey(FcPattern *pattern, std::optional<Unicode> uChar);
+
+    bool lookup(const std::string &key, FcLookupResult *result);
+    void insert(const std::string &key, const FcLookupResult &result);
+
+    // Load entries from <fileNameA>, and save all entries there on
+    // destruction.
+    void setFile(const std::string &fileNameA);
+
+private:
+    static std::string configSignature();
+    void load();
+    void save();
+
+    std::mutex mutex;
+    std::unordered_map<std::string, FcLookupResult> entries;
+    std::string fileName;
+    bool dirty = false;
+};
+
+FcLookupCache::~FcLookupCache()
+{
+    if (!fileName.empty() && dirty) {
+        save();
+    }
+}
+
+std::string FcLookupCache::makeKey(FcPattern *pattern, std::optional<Unicode> uChar)
+{
+    std::string key;
+    FcChar8 *s = FcNameUnparse(pattern);
+    if (!s) {
+        return {};
+    }
+    if (uChar) {
+        key = "U" + std::to_string(*uChar) + ":";
+    } else {
+        key = "F:";
+    }
+    key.append(reinterpret_cast<char *>(s));
+    free(s);
+    return key;
+}
+
+bool FcLookupCache::lookup(const std::string &key, FcLookupResult *result)
+{
+    std::scoped_lock lock(mutex);
+    const auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+    *result = it->second;
+    return true;
+}
+
+void FcLookupCache::insert(const std::string &key, const FcLookupResult &result)
+{
+    std::scoped_lock lock(mutex);
+    entries.insert_or_assign(key, result);
+    dirty = true;
+}
+
+void FcLookupCache::setFile(const std::string &fileNameA)
+{
+    std::scoped_lock lock(mutex);
+    fileName = fileNameA;
+    load();
+}
+
+// Identify the fontconfig setup: its version, its configuration files
+// and its font directories, with their modification times.  Adding or
+// removing a font changes the modification time of its directory.
+std::string FcLookupCache::configSignature()
+{
+    std::string sig = std::to_string(FcGetVersion());
+    auto addPaths = [&sig](FcStrList *list) {
+        if (!list) {
+            return;
+        }
+        while (FcChar8 *path = FcStrListNext(list)) {
+            std::error_code ec;
+            const auto mtime = std::filesystem::last_write_time(reinterpret_cast<char *>(path), ec);
+            sig.push_back('\0');
+            sig.append(reinterpret_cast<char *>(path));
+            sig.push_back('\0');
+            sig.append(ec ? "-" : std::to_string(mtime.time_since_epoch().count()));
+        }
+        FcStrListDone(list);
+    };
+    addPaths(FcConfigGetConfigFiles(nullptr));
+    addPaths(FcConfigGetFontDirs(nullptr));
+    return std::to_string(std::hash<std::string> {}(sig));
+}
+
+static bool readCacheString(FILE *f, std::string *s)
+{
+    size_t len;
+    if (fscanf(f, "%zu:", &len) != 1 || len > 65536) {
+        return false;
+    }
+    s->resize(len);
+    return fread(s->data(), 1, len, f) == len;
+}
+
+static void writeCacheString(FILE *f, const std::string &s)
+{
+    fprintf(f, "%zu:", s.size());
+    fwrite(s.data(), 1, s.size(), f);
+}
+
+static const char *fcLookupCacheHeader = "poppler-fc-lookup-cache 1";
+
+void FcLookupCache::load()
+{
+    FILE *f = openFile(fileName.c_str(), "rb");
+    if (!f) {
+        return;
+    }
+    std::string header, sig;
+    if (readCacheString(f, &header) && header == fcLookupCacheHeader && readCacheString(f, &sig) && sig == configSignature()) {
+        std::string key;
+        FcLookupResult result;
+        int type, bold, italic, oblique;
+        while (readCacheString(f, &key) && readCacheString(f, &result.path) && readCacheString(f, &result.name) && readCacheString(f, &result.style)
+               && fscanf(f, " %d %d %d %d %d\n", &result.fontNum, &type, &bold, &italic, &oblique) == 5) {
+            if (type < sysFontPFA || type > sysFontTTC) {
+                break;
+            }
+            result.type = static_cast<SysFontType>(type);
+            result.bold = bold;
+            result.italic = italic;
+            result.oblique = oblique;
+            entries.try_emplace(key, result);
+        }
+    }
+    fclose(f);
+}
+
+void FcLookupCache::save()
+{
+    // write to a temporary file first, so that concurrent processes never
+    // see a partial file
+    unsigned int suffix;
+    grandom_fill(reinterpret_cast<unsigned char *>(&suffix), sizeof(suffix));
+    const std::string tmpFileName = fileName + ".tmp" + std::to_string(suffix);
+    FILE *f = openFile(tmpFileName.c_str(), "wb");
+    if (!f) {
+        error(errIO, -1, "Couldn't write font lookup cache '{0:s}'", tmpFileName.c_str());
+        return;
+    }
+    writeCacheString(f, fcLookupCacheHeader);
+    writeCacheString(f, configSignature());
+    for (const auto &[key, result] : entries) {
+        writeCacheString(f, key);
+        writeCacheString(f, result.path);
+        writeCacheString(f, result.name);
+        writeCacheString(f, result.style);
+        fprintf(f, " %d %d %d %d %d\n", result.fontNum, static_cast<int>(result.type), result.bold, result.italic, result.oblique);
+    }
+    if (fclose(f) != 0) {
+        std::filesystem::remove(tmpFileName);
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpFileName, fileName, ec);
+    if (ec) {
+        std::filesystem::remove(tmpFileName, ec);
+    }
+}
+
+#endif
+
 #define globalParamsLocker() const std::scoped_lock locker(mutex)
 #define unicodeMapCacheLocker() const std::scoped_lock locker(unicodeMapCacheMutex)
 #define cMapCacheLocker() const std::scoped_lock locker(cMapCacheMutex)
@@ -434,6 +642,14 @@ GlobalParams::GlobalParams(std::string customPopplerDataDir) : popplerDataDir(st
     nameToUnicodeZapfDingbats = new NameToCharCode();
     nameToUnicodeText = new NameToCharCode();
     sysFonts = new SysFontList();
+#if WITH_FONTCONFIGURATION_FONTCONFIG
+    fcLookupCache = new FcLookupCache();
+    if (const char *cacheFile = getenv("POPPLER_FONT_LOOKUP_CACHE"); cacheFile && *cacheFile) {
+        fcLookupCache->setFile(cacheFile);
+    }
+#else
+    fcLookupCache = nullptr;
+#endif
     textEncoding = std::string { "UTF-8" };
     printCommands = false;
     profileCommands = false;
@@ -562,6 +778,9 @@ GlobalParams::~GlobalParams()
     delete nameToUnicodeZapfDingbats;
     delete nameToUnicodeText;
     delete sysFonts;
+#if WITH_FONTCONFIGURATION_FONTCONFIG
+    delete fcLookupCache;
+#endif
 
     delete unicodeMapCache;
     delete cMapCache;
@@ -923,6 +1142,104 @@ static bool supportedFontForEmbedding(Unicode uChar, const char *filepath, int f
 // not needed for fontconfig
 void GlobalParams::setupBaseFonts(const char * /*unused*/) { }
 
+// Ask fontconfig for a font file matching <p> (which is modified).
+static FcLookupResult fcFindSystemFontFile(FcPattern *p, const GfxFont &font)
+{
+    FcLookupResult result;
+    FcChar8 *s;
+    char *ext;
+    FcResult res;
+    FcFontSet *set;
+    int i;
+    FcLangSet *lb = nullptr;
+
+    FcConfigSubstitute(nullptr, p, FcMatchPattern);
+    FcDefaultSubstitute(p);
+    set = FcFontSort(nullptr, p, FcFalse, nullptr, &res);
+    if (!set) {
+        return result;
+    }
+
+    // find the language we want the font to support
+    const char *lang = getFontLang(font);
+    if (strcmp(lang, "xx") != 0) {
+        lb = FcLangSetCreate();
+        FcLangSetAdd(lb, reinterpret_cast<const FcChar8 *>(lang));
+    }
+
+    /*
+      scan twice.
+      first: fonts support the language
+      second: all fonts (fall back)
+    */
+    while (result.path.empty()) {
+        for (i = 0; i < set->nfont; ++i) {
+            res = FcPatternGetString(set->fonts[i], FC_FILE, 0, &s);
+            if (res != FcResultMatch || !s) {
+                continue;
+            }
+            if (lb != nullptr) {
+                FcLangSet *l;
+                res = FcPatternGetLangSet(set->fonts[i], FC_LANG, 0, &l);
+                if (res != FcResultMatch || !FcLangSetContains(l, lb)) {
+                    continue;
+                }
+            }
+            FcChar8 *s2;
+            res = FcPatternGetString(set->fonts[i], FC_FULLNAME, 0, &s2);
+            if (res == FcResultMatch && s2) {
+                result.name = reinterpret_cast<char *>(s2);
+            } else {
+                // fontconfig does not extract fullname for some fonts
+                // create the fullname from family and style
+                res = FcPatternGetString(set->fonts[i], FC_FAMILY, 0, &s2);
+                if (res == FcResultMatch && s2) {
+                    result.name = reinterpret_cast<char *>(s2);
+                    res = FcPatternGetString(set->fonts[i], FC_STYLE, 0, &s2);
+                    if (res == FcResultMatch && s2) {
+                        const std::string style = { reinterpret_cast<char *>(s2) };
+                        if (style != "Regular") {
+                            result.name.append(" ");
+                            result.name.append(style);
+                        }
+                    }
+                }
+            }
+            ext = strrchr(reinterpret_cast<char *>(s), '.');
+            if (!ext) {
+                continue;
+            }
+            if (!strncasecmp(ext, ".ttf", 4) || !strncasecmp(ext, ".ttc", 4) || !strncasecmp(ext, ".otf", 4)) {
+                result.type = (!strncasecmp(ext, ".ttc", 4)) ? sysFontTTC : sysFontTTF;
+            } else if (!strncasecmp(ext, ".pfa", 4) || !strncasecmp(ext, ".pfb", 4)) {
+                result.type = (!strncasecmp(ext, ".pfa", 4)) ? sysFontPFA : sysFontPFB;
+            } else {
+                continue;
+            }
+            int weight = FC_WEIGHT_NORMAL, slant = FC_SLANT_ROMAN;
+            FcPatternGetInteger(set->fonts[i], FC_WEIGHT, 0, &weight);
+            FcPatternGetInteger(set->fonts[i], FC_SLANT, 0, &slant);
+            result.bold = weight == FC_WEIGHT_DEMIBOLD || weight == FC_WEIGHT_BOLD || weight == FC_WEIGHT_EXTRABOLD || weight == FC_WEIGHT_BLACK;
+            result.italic = slant == FC_SLANT_ITALIC;
+            result.oblique = slant == FC_SLANT_OBLIQUE;
+            result.fontNum = 0;
+            FcPatternGetInteger(set->fonts[i], FC_INDEX, 0, &result.fontNum);
+            result.path = reinterpret_cast<char *>(s);
+            break;
+        }
+        if (lb != nullptr) {
+            FcLangSetDestroy(lb);
+            lb = nullptr;
+        } else {
+            /* scan all fonts of the list */
+            break;
+        }
+    }
+    FcFontSetDestroy(set);
+
+    return result;
+}
+
 std::optional<std::string> GlobalParams::findBase14FontFile(const std::string &base14Name, const GfxFont &font, GooString *substituteFontName)
 {
     SysFontType type;
@@ -950,135 +1267,29 @@ std::optional<std::string> GlobalParams::findSystemFontFile(const GfxFont &font,
         *fontNum = fi->fontNum;
         substituteName.assign(fi->substituteName->toStr());
     } else {
-        FcChar8 *s;
-        char *ext;
-        FcResult res;
-        FcFontSet *set;
-        int i;
-        FcLangSet *lb = nullptr;
         p = buildFcPattern(font, base14Name);
 
         if (!p) {
             goto fin;
         }
-        FcConfigSubstitute(nullptr, p, FcMatchPattern);
-        FcDefaultSubstitute(p);
-        set = FcFontSort(nullptr, p, FcFalse, nullptr, &res);
-        if (!set) {
-            goto fin;
-        }
-
-        // find the language we want the font to support
-        const char *lang = getFontLang(font);
-        if (strcmp(lang, "xx") != 0) {
-            lb = FcLangSetCreate();
-            FcLangSetAdd(lb, reinterpret_cast<const FcChar8 *>(lang));
-        }
-
-        /*
-          scan twice.
-          first: fonts support the language
-          second: all fonts (fall back)
-        */
-        while (fi == nullptr) {
-            for (i = 0; i < set->nfont; ++i) {
-                res = FcPatternGetString(set->fonts[i], FC_FILE, 0, &s);
-                if (res != FcResultMatch || !s) {
-                    continue;
-                }
-                if (lb != nullptr) {
-                    FcLangSet *l;
-                    res = FcPatternGetLangSet(set->fonts[i], FC_LANG, 0, &l);
-                    if (res != FcResultMatch || !FcLangSetContains(l, lb)) {
-                        continue;
-                    }
-                }
-                FcChar8 *s2;
-                res = FcPatternGetString(set->fonts[i], FC_FULLNAME, 0, &s2);
-                if (res == FcResultMatch && s2) {
-                    substituteName.assign(reinterpret_cast<char *>(s2));
-                } else {
-                    // fontconfig does not extract fullname for some fonts
-                    // create the fullname from family and style
-                    res = FcPatternGetString(set->fonts[i], FC_FAMILY, 0, &s2);
-                    if (res == FcResultMatch && s2) {
-                        substituteName.assign(reinterpret_cast<char *>(s2));
-                        res = FcPatternGetString(set->fonts[i], FC_STYLE, 0, &s2);
-                        if (res == FcResultMatch && s2) {
-                            const std::string style = { reinterpret_cast<char *>(s2) };
-                            if (style != "Regular") {
-                                substituteName.append(" ");
-                                substituteName.append(style);
-                            }
-                        }
-                    }
-                }
-                ext = strrchr(reinterpret_cast<char *>(s), '.');
-                if (!ext) {
-                    continue;
-                }
-                if (!strncasecmp(ext, ".ttf", 4) || !strncasecmp(ext, ".ttc", 4) || !strncasecmp(ext, ".otf", 4)) {
-                    int weight, slant;
-                    bool bold = font.isBold();
-                    bool italic = font.isItalic();
-                    bool oblique = false;
-                    FcPatternGetInteger(set->fonts[i], FC_WEIGHT, 0, &weight);
-                    FcPatternGetInteger(set->fonts[i], FC_SLANT, 0, &slant);
-                    if (weight == FC_WEIGHT_DEMIBOLD || weight == FC_WEIGHT_BOLD || weight == FC_WEIGHT_EXTRABOLD || weight == FC_WEIGHT_BLACK) {
-                        bold = true;
-                    }
-                    if (slant == FC_SLANT_ITALIC) {
-                        italic = true;
-                    }
-                    if (slant == FC_SLANT_OBLIQUE) {
-                        oblique = true;
-                    }
-                    *fontNum = 0;
-                    *type = (!strncasecmp(ext, ".ttc", 4)) ? sysFontTTC : sysFontTTF;
-                    FcPatternGetInteger(set->fonts[i], FC_INDEX, 0, fontNum);
-                    auto sfi =
-                            std::make_unique<SysFontInfo>(std::make_unique<GooString>(*fontName), bold, italic, oblique, font.isFixedWidth(), std::make_unique<GooString>(reinterpret_cast<char *>(s)), *type, *fontNum, substituteName.copy());
-                    fi = sfi.get();
-                    sysFonts->addFcFont(std::move(sfi));
-                    path = std::string(reinterpret_cast<char *>(s));
-                } else if (!strncasecmp(ext, ".pfa", 4) || !strncasecmp(ext, ".pfb", 4)) {
-                    int weight, slant;
-                    bool bold = font.isBold();
-                    bool italic = font.isItalic();
-                    bool oblique = false;
-                    FcPatternGetInteger(set->fonts[i], FC_WEIGHT, 0, &weight);
-                    FcPatternGetInteger(set->fonts[i], FC_SLANT, 0, &slant);
-                    if (weight == FC_WEIGHT_DEMIBOLD || weight == FC_WEIGHT_BOLD || weight == FC_WEIGHT_EXTRABOLD || weight == FC_WEIGHT_BLACK) {
-                        bold = true;
-                    }
-                    if (slant == FC_SLANT_ITALIC) {
-                        italic = true;
-                    }
-                    if (slant == FC_SLANT_OBLIQUE) {
-                        oblique = true;
-                    }
-                    *fontNum = 0;
-                    *type = (!strncasecmp(ext, ".pfa", 4)) ? sysFontPFA : sysFontPFB;
-                    FcPatternGetInteger(set->fonts[i], FC_INDEX, 0, fontNum);
-                    auto sfi =
-                            std::make_unique<SysFontInfo>(std::make_unique<GooString>(*fontName), bold, italic, oblique, font.isFixedWidth(), std::make_unique<GooString>(reinterpret_cast<char *>(s)), *type, *fontNum, substituteName.copy());
-                    fi = sfi.get();
-                    sysFonts->addFcFont(std::move(sfi));
-                    path = std::string(reinterpret_cast<char *>(s));
-                } else {
-                    continue;
-                }
-                break;
-            }
-            if (lb != nullptr) {
-                FcLangSetDestroy(lb);
-                lb = nullptr;
-            } else {
-                /* scan all fonts of the list */
-                break;
+        FcLookupResult result;
+        const std::string key = FcLookupCache::makeKey(p, {});
+        if (key.empty() || !fcLookupCache->lookup(key, &result)) {
+            result = fcFindSystemFontFile(p, font);
+            if (!key.empty()) {
+                fcLookupCache->insert(key, result);
             }
         }
-        FcFontSetDestroy(set);
+        substituteName.assign(result.name);
+        if (!result.path.empty()) {
+            *type = result.type;
+            *fontNum = result.fontNum;
+            auto sfi = std::make_unique<SysFontInfo>(std::make_unique<GooString>(*fontName), font.isBold() || result.bold, font.isItalic() || result.italic, result.oblique, font.isFixedWidth(), std::make_unique<GooString>(result.path), *type,
+                                                     *fontNum, substituteName.copy());
+            fi = sfi.get();
+            sysFonts->addFcFont(std::move(sfi));
+            path = result.path;
+        }
     }
     if (!path && (fi = sysFonts->find(*fontName, font.isFixedWidth(), false))) {
         path = fi->path->toStr();
@@ -1130,15 +1341,28 @@ FamilyStyleFontSearchResult GlobalParams::findSystemFontFileForFamilyAndStyle(co
     return {};
 }
 
-UCharFontSearchResult GlobalParams::findSystemFontFileForUChar(Unicode uChar, const GfxFont &fontToEmulate) // NOLINT(readability-convert-member-functions-to-static)
+UCharFontSearchResult GlobalParams::findSystemFontFileForUChar(Unicode uChar, const GfxFont &fontToEmulate)
 {
     FcPattern *pattern = buildFcPattern(fontToEmulate, nullptr);
+    if (!pattern) {
+        return {};
+    }
+
+    FcLookupResult result;
+    const std::string key = FcLookupCache::makeKey(pattern, uChar);
+    if (!key.empty() && fcLookupCache->lookup(key, &result)) {
+        FcPatternDestroy(pattern);
+        if (result.path.empty()) {
+            return {};
+        }
+        return UCharFontSearchResult(result.path, result.fontNum, result.name, result.style);
+    }
 
     FcConfigSubstitute(nullptr, pattern, FcMatchPattern);
     FcDefaultSubstitute(pattern);
 
-    FcResult result = FcResultMatch;
-    FcFontSet *fontSet = FcFontSort(nullptr, pattern, FcFalse, nullptr, &result);
+    FcResult fcResult = FcResultMatch;
+    FcFontSet *fontSet = FcFontSort(nullptr, pattern, FcFalse, nullptr, &fcResult);
     FcPatternDestroy(pattern);
 
     if (fontSet) {
@@ -1164,12 +1388,22 @@ UCharFontSearchResult GlobalParams::findSystemFontFileForUChar(Unicode uChar, co
             const char *filepath = reinterpret_cast<char *>(fcFilePath);
 
             if (supportedFontForEmbedding(uChar, filepath, faceIndex)) {
-                return UCharFontSearchResult(filepath, faceIndex, reinterpret_cast<char *>(fcFamily), reinterpret_cast<char *>(fcStyle));
+                result.path = filepath;
+                result.fontNum = faceIndex;
+                result.name = reinterpret_cast<char *>(fcFamily);
+                result.style = reinterpret_cast<char *>(fcStyle);
+                break;
             }
         }
     }
 
-    return {};
+    if (!key.empty()) {
+        fcLookupCache->insert(key, result);
+    }
+    if (result.path.empty()) {
+        return {};
+    }
+    return UCharFontSearchResult(result.path, result.fontNum, result.name, result.style);
 }
 #elif WITH_FONTCONFIGURATION_ANDROID
 // Uses the font file mapping created by GlobalParams::setupBaseFonts
@@ -1544,6 +1778,15 @@ void GlobalParams::setErrQuiet(bool errQuietA)
     errQuiet = errQuietA;
 }
 
+void GlobalParams::setFontLookupCacheFile(const std::string &fileName) // NOLINT(readability-convert-member-functions-to-static)
+{
+#if WITH_FONTCONFIGURATION_FONTCONFIG
+    fcLookupCache->setFile(fileName);
+#else
+    (void)fileName;
+#endif
+}
+
 #ifdef ANDROID
 void GlobalParams::setFontDir(const std::string &fontDir)
 {
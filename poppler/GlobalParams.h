@@ -65,6 +65,7 @@ class GlobalParams;
 class GfxFont;
 class Stream;
 class SysFontList;
+class FcLookupCache;
 
 //------------------------------------------------------------------------
 
@@ -164,6 +165,11 @@ public:
     void setPrintCommands(bool printCommandsA);
     void setProfileCommands(bool profileCommandsA);
     void setErrQuiet(bool errQuietA);
+    // Persist the results of system font lookups in <fileName>: they are
+    // loaded now, and saved back when this object is destroyed.  Only
+    // used with fontconfig.  The constructor does this with the file
+    // named by the POPPLER_FONT_LOOKUP_CACHE environment variable, if set.
+    void setFontLookupCacheFile(const std::string &fileName);
 #ifdef ANDROID
     static void setFontDir(const std::string &fontDir);
 #endif
@@ -209,6 +215,7 @@ private:
     // font files: font name mapped to path
     std::unordered_map<std::string, std::string> fontFiles;
     SysFontList *sysFonts; // system fonts
+    FcLookupCache *fcLookupCache; // memo of fontconfig lookups
     std::string textEncoding; // encoding (unicodeMap) to use for text
                               //   output
     bool printCommands; // print the drawing commands
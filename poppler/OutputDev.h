@@ -105,6 +105,13 @@ public:
     // Does this device need non-text content?
     virtual bool needNonText() { return true; }
 
+    // Does this device need paths, i.e. the path construction, path
+    // painting, clipping and shading operators?  This is only checked
+    // for devices that don't need non-text content; if it returns
+    // false, those operators are skipped, as well as form XObjects
+    // that don't show any text.
+    virtual bool needPaths() { return true; }
+
     // Does this device require incCharCount to be called for text on
     // non-shown layers?
     virtual bool needCharCount() { return false; }
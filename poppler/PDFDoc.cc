@@ -70,8 +70,8 @@
 #include <config.h>
 #include <poppler-config.h>
 
-#include <array>
 #include <cctype>
+#include <condition_variable>
 #include <cstdio>
 #include <cerrno>
 #include <climits>
@@ -79,9 +79,13 @@
 #include <cstddef>
 #include <cstring>
 #include <ctime>
+#include <deque>
 #include <iomanip>
+#include <mutex>
 #include <regex>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <sys/stat.h>
 #include "CryptoSignBackend.h"
 #include "goo/GooString.h"
@@ -819,6 +823,16 @@ Hints *PDFDoc::getHints()
 }
 
 int PDFDoc::savePageAs(const std::string &name, int pageNo)
+{
+    // marking the page objects changes the page dictionary and the
+    // annotations and form fields in the XRef; put them back afterwards
+    xref->recordModifiedObjects();
+    const int res = saveSinglePage(name, pageNo);
+    xref->undoModifiedObjects();
+    return res;
+}
+
+int PDFDoc::saveSinglePage(const std::string &name, int pageNo)
 {
     FILE *f;
 
@@ -1017,6 +1031,8 @@ int PDFDoc::saveAs(OutStream *outStr, PDFWriteMode mode)
         saveWithoutChangesAs(outStr);
     } else if (mode == writeForceRewrite) {
         saveCompleteRewrite(outStr);
+    } else if (mode == writeCompact) {
+        saveCompactRewrite(outStr);
     } else {
         saveIncrementalUpdate(outStr);
     }
@@ -1054,15 +1070,12 @@ int PDFDoc::saveWithoutChangesAs(OutStream *outStr)
     if (!copyStr->rewind()) {
         return errFileIO;
     }
-    while (copyStr->lookChar() != EOF) {
-        std::array<unsigned char, 4096> array;
-        size_t size = copyStr->doGetChars(array.size(), array.data());
-        auto sizeWritten = outStr->write(std::span(array.data(), size));
-        if (size != sizeWritten) {
-            return errFileIO;
-        }
-    }
+    outStr->copyFrom(copyStr.get(), -1);
+    const bool copiedAll = copyStr->lookChar() == EOF;
     copyStr->close();
+    if (!copiedAll) {
+        return errFileIO;
+    }
 
     return errNone;
 }
@@ -1074,14 +1087,7 @@ void PDFDoc::saveIncrementalUpdate(OutStream *outStr)
     if (!copyStr->rewind()) {
         // some err;
     }
-    while (copyStr->lookChar() != EOF) {
-        std::array<unsigned char, 4096> array;
-        size_t size = copyStr->doGetChars(array.size(), array.data());
-        auto sizeWritten = outStr->write(std::span(array.data(), size));
-        if (size != sizeWritten) {
-            // Write error of some sort
-        }
-    }
+    outStr->copyFrom(copyStr.get(), -1);
     copyStr->close();
 
     unsigned char *fileKey;
@@ -1147,6 +1153,54 @@ void PDFDoc::saveIncrementalUpdate(OutStream *outStr)
     delete uxref;
 }
 
+//------------------------------------------------------------------------
+// RewriteBuffer
+//
+// An object serialized in memory by a saveCompleteRewrite() thread.  The
+// raw data of large streams read from a file is not buffered: the writing
+// thread copies it straight from the input file instead.
+//------------------------------------------------------------------------
+
+class RewriteBuffer : public StringOutStream
+{
+public:
+    Goffset copyFrom(BaseStream *str, Goffset length) override
+    {
+        if (str->getKind() != strFile || length < 65536) {
+            return StringOutStream::copyFrom(str, length);
+        }
+        std::unique_ptr<BaseStream> copyStr = str->copy();
+        copyStr->setPos(str->getPos());
+        rawCopies.push_back({ .bufPos = getString().size(), .str = std::move(copyStr), .length = length });
+        return length;
+    }
+
+    // Write the buffered data and the raw stream data to <outStr>.
+    void writeTo(OutStream *outStr)
+    {
+        const std::string &data = getString();
+        size_t pos = 0;
+        for (RawCopy &rawCopy : rawCopies) {
+            outStr->write(std::span(reinterpret_cast<const unsigned char *>(data.data()) + pos, rawCopy.bufPos - pos));
+            pos = rawCopy.bufPos;
+            if (outStr->copyFrom(rawCopy.str.get(), rawCopy.length) < rawCopy.length) {
+                error(errSyntaxError, -1, "PDFDoc::writeRawStream: EOF reading stream");
+            }
+        }
+        outStr->write(std::span(reinterpret_cast<const unsigned char *>(data.data()) + pos, data.size() - pos));
+    }
+
+private:
+    struct RawCopy
+    {
+        size_t bufPos; // where the data goes in the buffer
+        std::unique_ptr<BaseStream> str;
+        Goffset length;
+    };
+
+    std::vector<RawCopy> rawCopies;
+};
+
 void PDFDoc::saveCompleteRewrite(OutStream *outStr)
 {
     // Make sure that special flags are set, because we are going to read
@@ -1161,6 +1215,14 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
     writeHeader(outStr, getPDFMajorVersion(), getPDFMinorVersion());
     XRef *uxref = new XRef();
     uxref->add(0, 65535, 0, false);
+
+    // collect the objects to write
+    struct RewriteObject
+    {
+        Ref ref;
+        bool unencrypted; // write the object without encrypting it
+    };
+    std::vector<RewriteObject> objs;
     xref->lock();
     for (int i = 0; i < xref->getNumObjects(); i++) {
         Ref ref;
@@ -1181,32 +1243,353 @@ void PDFDoc::saveCompleteRewrite(OutStream *outStr)
         } else if (type == xrefEntryUncompressed) {
             ref.num = i;
             ref.gen = xref->getEntry(i)->gen;
-            Object obj1 = xref->fetch(ref, 1 /* recursion */);
-            Goffset offset = writeObjectHeader(&ref, outStr);
             // Write unencrypted objects in unencrypted form
-            if (xref->getEntry(i)->getFlag(XRefEntry::Unencrypted)) {
-                writeObject(&obj1, outStr, nullptr, cryptRC4, 0, 0, 0);
-            } else {
-                writeObject(&obj1, outStr, fileKey, encAlgorithm, keyLength, ref);
-            }
-            writeObjectFooter(outStr);
-            uxref->add(ref, offset, true);
+            objs.push_back({ .ref = ref, .unencrypted = xref->getEntry(i)->getFlag(XRefEntry::Unencrypted) });
         } else if (type == xrefEntryCompressed) {
             ref.num = i;
             ref.gen = 0; // compressed entries have gen == 0
-            Object obj1 = xref->fetch(ref, 1 /* recursion */);
-            Goffset offset = writeObjectHeader(&ref, outStr);
-            writeObject(&obj1, outStr, fileKey, encAlgorithm, keyLength, ref);
-            writeObjectFooter(outStr);
-            uxref->add(ref, offset, true);
+            objs.push_back({ .ref = ref, .unencrypted = false });
         }
     }
     xref->unlock();
+
+    // Reading, recompressing and encrypting streams is the bulk of the
+    // work, so for documents read from a file this is done by several
+    // threads, which serialize the objects into memory buffers, while
+    // this one writes the buffers in order and records their offsets.
+    // XRef::fetch() serializes the parsing itself.
+    const auto serialize = [&](const RewriteObject &rewriteObj, OutStream *objStr) {
+        Ref ref = rewriteObj.ref;
+        Object obj1 = xref->fetch(ref, 1 /* recursion */);
+        writeObjectHeader(&ref, objStr);
+        if (rewriteObj.unencrypted) {
+            writeObject(&obj1, objStr, nullptr, cryptRC4, 0, 0, 0);
+        } else {
+            writeObject(&obj1, objStr, fileKey, encAlgorithm, keyLength, ref);
+        }
+        writeObjectFooter(objStr);
+    };
+
+    int nThreads = 1;
+    if (str->getKind() == strFile) {
+        nThreads = static_cast<int>(std::min<size_t>(std::thread::hardware_concurrency(), objs.size() / 16));
+    }
+    if (nThreads <= 1) {
+        for (const RewriteObject &rewriteObj : objs) {
+            uxref->add(rewriteObj.ref, outStr->getPos(), true);
+            serialize(rewriteObj, outStr);
+        }
+    } else {
+        // the number of buffers that can be waiting to be written
+        const size_t window = 4 * nThreads;
+        std::vector<std::unique_ptr<RewriteBuffer>> buffers(objs.size());
+        size_t next = 0; // the next object to serialize
+        size_t written = 0; // the number of objects written
+        std::mutex queueMutex;
+        std::condition_variable queueCond;
+
+        std::vector<std::thread> threads;
+        threads.reserve(nThreads);
+        for (int i = 0; i < nThreads; ++i) {
+            threads.emplace_back([&] {
+                while (true) {
+                    size_t idx;
+                    {
+                        std::unique_lock<std::mutex> locker(queueMutex);
+                        queueCond.wait(locker, [&] { return next >= objs.size() || next < written + window; });
+                        if (next >= objs.size()) {
+                            return;
+                        }
+                        idx = next++;
+                    }
+                    auto buf = std::make_unique<RewriteBuffer>();
+                    serialize(objs[idx], buf.get());
+                    {
+                        const std::scoped_lock locker(queueMutex);
+                        buffers[idx] = std::move(buf);
+                    }
+                    queueCond.notify_all();
+                }
+            });
+        }
+        for (size_t idx = 0; idx < objs.size(); ++idx) {
+            std::unique_ptr<RewriteBuffer> buf;
+            {
+                std::unique_lock<std::mutex> locker(queueMutex);
+                queueCond.wait(locker, [&] { return buffers[idx] != nullptr; });
+                buf = std::move(buffers[idx]);
+            }
+            uxref->add(objs[idx].ref, outStr->getPos(), true);
+            buf->writeTo(outStr);
+            {
+                const std::scoped_lock locker(queueMutex);
+                written = idx + 1;
+            }
+            queueCond.notify_all();
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
     Goffset uxrefOffset = outStr->getPos();
     writeXRefTableTrailer(uxrefOffset, uxref, true /* write all entries */, uxref->getNumObjects(), outStr, false /* complete rewrite */);
     delete uxref;
 }
 
+// Add the references in <obj> to <refs>.
+static void collectRefs(const Object &obj, std::vector<Ref> *refs)
+{
+    switch (obj.getType()) {
+    case objRef:
+        refs->push_back(obj.getRef());
+        break;
+    case objArray: {
+        Array *array = obj.getArray();
+        for (int i = 0; i < array->getLength(); ++i) {
+            collectRefs(array->getNF(i), refs);
+        }
+        break;
+    }
+    case objDict: {
+        Dict *dict = obj.getDict();
+        for (int i = 0; i < dict->getLength(); ++i) {
+            collectRefs(dict->getValNF(i), refs);
+        }
+        break;
+    }
+    case objStream: {
+        // stream lengths are written as direct objects
+        Dict *dict = obj.getStream()->getDict();
+        for (int i = 0; i < dict->getLength(); ++i) {
+            if (dict->getKey(i) != "Length") {
+                collectRefs(dict->getValNF(i), refs);
+            }
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Return a copy of <obj> where the references are replaced according to
+// <newNums> (old object number -> new object number).  References to
+// objects that aren't written become null.
+static Object renumberRefs(const Object &obj, const std::unordered_map<int, int> &newNums, XRef *xRef)
+{
+    switch (obj.getType()) {
+    case objRef: {
+        const auto it = newNums.find(obj.getRef().num);
+        if (it == newNums.end() || it->second == 0) {
+            return Object::null();
+        }
+        return Object(Ref { .num = it->second, .gen = 0 });
+    }
+    case objArray: {
+        Array *array = obj.getArray();
+        auto newArray = std::make_unique<Array>(xRef);
+        for (int i = 0; i < array->getLength(); ++i) {
+            newArray->add(renumberRefs(array->getNF(i), newNums, xRef));
+        }
+        return Object(std::move(newArray));
+    }
+    case objDict: {
+        Dict *dict = obj.getDict();
+        auto newDict = std::make_unique<Dict>(xRef);
+        for (int i = 0; i < dict->getLength(); ++i) {
+            newDict->add(dict->getKey(i), renumberRefs(dict->getValNF(i), newNums, xRef));
+        }
+        return Object(std::move(newDict));
+    }
+    default:
+        return obj.copy();
+    }
+}
+
+void PDFDoc::saveCompactRewrite(OutStream *outStr)
+{
+    // Streams are copied without being decrypted, so they can't be
+    // renumbered in encrypted documents
+    if (xref->isEncrypted()) {
+        saveCompleteRewrite(outStr);
+        return;
+    }
+
+    constexpr int maxObjStmObjects = 100;
+
+    // Find the objects reachable from the trailer, in breadth-first
+    // order, and number them from 1.  Copied streams that have the same
+    // dictionary (ignoring /Length) and the same data are written once:
+    // they are grouped by dictionary and length, and only compared
+    // with streams of the same group.
+    std::vector<Object> objs; // the objects to write; objs[i] is number i + 1
+    std::unordered_map<int, int> newNums; // 0 for objects that aren't written
+    std::deque<Ref> queue;
+    std::unordered_map<std::string, std::vector<size_t>> streamGroups;
+    std::unordered_map<size_t, size_t> streamHashes; // hash of the data of some objs[i]
+
+    const auto streamData = [](Stream *stream) {
+        StringOutStream buf;
+        writeRawStream(stream, &buf);
+        return std::move(buf.getString());
+    };
+    const auto findDuplicate = [&](Stream *stream) -> int {
+        if (stream->getKind() == strWeird || stream->getKind() == strCrypt) {
+            return 0;
+        }
+        std::unique_ptr<Dict> dict = stream->getDict()->copy(xref);
+        Object length = dict->lookup("Length");
+        dict->remove("Length");
+        StringOutStream key;
+        writeDictionary(dict.get(), &key, xref, 0, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 }, nullptr);
+        writeObject(&length, &key, xref, 0, nullptr, cryptRC4, 0, { .num = 0, .gen = 0 });
+        std::vector<size_t> &group = streamGroups[key.getString()];
+        if (!group.empty()) {
+            const std::string data = streamData(stream);
+            const size_t hash = std::hash<std::string> {}(data);
+            for (const size_t idx : group) {
+                auto it = streamHashes.find(idx);
+                if (it == streamHashes.end()) {
+                    it = streamHashes.emplace(idx, std::hash<std::string> {}(streamData(objs[idx].getStream()))).first;
+                }
+                if (it->second == hash && streamData(objs[idx].getStream()) == data) {
+                    return static_cast<int>(idx) + 1;
+                }
+            }
+            streamHashes.emplace(objs.size(), hash);
+        }
+        group.push_back(objs.size());
+        return 0;
+    };
+
+    const auto enqueue = [&](Ref ref) {
+        if (ref.num > 0 && newNums.emplace(ref.num, 0).second) {
+            queue.push_back(ref);
+        }
+    };
+    enqueue({ .num = xref->getRootNum(), .gen = xref->getRootGen() });
+    const Object info = xref->getDocInfoNF();
+    if (info.isRef()) {
+        enqueue(info.getRef());
+    }
+    std::vector<Ref> refs;
+    while (!queue.empty()) {
+        const Ref ref = queue.front();
+        queue.pop_front();
+        Object obj = xref->fetch(ref);
+        if (obj.isNull() || obj.isError()) {
+            continue;
+        }
+        if (obj.isStream()) {
+            const int duplicate = findDuplicate(obj.getStream());
+            if (duplicate) {
+                newNums[ref.num] = duplicate;
+                continue;
+            }
+        }
+        objs.push_back(std::move(obj));
+        newNums[ref.num] = static_cast<int>(objs.size());
+        refs.clear();
+        collectRefs(objs.back(), &refs);
+        for (const Ref &r : refs) {
+            enqueue(r);
+        }
+    }
+    streamGroups.clear();
+    streamHashes.clear();
+
+    // Write the streams as indirect objects, and the other objects in
+    // object streams, which are numbered after them
+    int major = getPDFMajorVersion();
+    int minor = getPDFMinorVersion();
+    if (major < 2 && minor < 5) {
+        // object streams need PDF 1.5
+        major = 1;
+        minor = 5;
+    }
+    writeHeader(outStr, major, minor);
+    XRef *uxref = new XRef();
+    uxref->add(0, 65535, 0, false);
+    int objStmNum = static_cast<int>(objs.size()) + 1;
+    StringOutStream objStmIndex, objStmData;
+    int objStmCount = 0;
+    const auto writeObjStm = [&] {
+        if (objStmCount == 0) {
+            return;
+        }
+        Ref objStmRef = { .num = objStmNum++, .gen = 0 };
+        std::string data = std::move(objStmIndex.getString());
+        const int first = static_cast<int>(data.size());
+        data.append(objStmData.getString());
+        auto dict = std::make_unique<Dict>(xref);
+        dict->add("Type", Object::name("ObjStm"));
+        dict->add("N", Object(objStmCount));
+        dict->add("First", Object(first));
+        dict->add("Filter", Object::name("FlateDecode"));
+        Object obj(std::make_unique<MemStream>(data.c_str(), 0, data.size(), Object(std::move(dict))));
+        const Goffset offset = writeObjectHeader(&objStmRef, outStr);
+        writeObject(&obj, outStr, xref, 0, nullptr, cryptRC4, 0, objStmRef);
+        writeObjectFooter(outStr);
+        uxref->add(objStmRef, offset, true);
+        objStmIndex.getString().clear();
+        objStmData.getString().clear();
+        objStmCount = 0;
+    };
+    for (size_t i = 0; i < objs.size(); ++i) {
+        Ref ref = { .num = static_cast<int>(i) + 1, .gen = 0 };
+        Object &obj = objs[i];
+        if (obj.isStream()) {
+            // renumber the dictionary in place, restoring it afterwards as
+            // modified objects share their stream with the XRef.  An
+            // indirect /Length is resolved with the old numbers, and
+            // written directly.
+            Dict *dict = obj.getStream()->getDict();
+            Object length = dict->lookup("Length");
+            std::vector<std::pair<std::string, Object>> saved;
+            for (int j = 0; j < dict->getLength(); ++j) {
+                saved.emplace_back(dict->getKey(j), dict->getValNF(j).copy());
+            }
+            for (const auto &[key, val] : saved) {
+                dict->set(key, key == "Length" ? std::move(length) : renumberRefs(val, newNums, xref));
+            }
+            const Goffset offset = writeObjectHeader(&ref, outStr);
+            writeObject(&obj, outStr, xref, 0, nullptr, cryptRC4, 0, ref);
+            writeObjectFooter(outStr);
+            uxref->add(ref, offset, true);
+            for (auto &[key, val] : saved) {
+                dict->set(key, std::move(val));
+            }
+        } else {
+            Object renumbered = renumberRefs(obj, newNums, xref);
+            objStmIndex.printf("%i %lli ", ref.num, objStmData.getPos());
+            writeObject(&renumbered, &objStmData, xref, 0, nullptr, cryptRC4, 0, ref);
+            uxref->addCompressed(ref.num, objStmNum, objStmCount);
+            if (++objStmCount == maxObjStmObjects) {
+                writeObjStm();
+            }
+        }
+        obj.setToNull();
+    }
+    writeObjStm();
+
+    // Write a compressed xref stream
+    Ref uxrefStreamRef = { .num = objStmNum, .gen = 0 };
+    const Goffset uxrefOffset = outStr->getPos();
+    uxref->add(uxrefStreamRef, uxrefOffset, true);
+    Ref rootRef = { .num = 1, .gen = 0 };
+    Object trailerDict = createTrailerDict(uxrefStreamRef.num + 1, false, 0, &rootRef, getXRef(), fileName ? fileName->c_str() : nullptr, uxrefOffset);
+    Object newInfo = renumberRefs(info, newNums, xref);
+    if (newInfo.isRef()) {
+        trailerDict.dictSet("Info", std::move(newInfo));
+    } else {
+        trailerDict.dictRemove("Info");
+    }
+    trailerDict.dictSet("Filter", Object::name("FlateDecode"));
+    writeXRefStreamTrailer(std::move(trailerDict), uxref, &uxrefStreamRef, uxrefOffset, outStr, getXRef());
+    delete uxref;
+}
+
 std::string PDFDoc::sanitizedName(const std::string &name)
 {
     std::string sanitizedName;
@@ -1261,8 +1644,10 @@ void PDFDoc::writeStream(Stream *str, OutStream *outStr)
         return;
     }
     outStr->printf("stream\r\n");
-    for (int c = str->getChar(); c != EOF; c = str->getChar()) {
-        outStr->printf("%c", c);
+    unsigned char buf[4096];
+    int n;
+    while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+        outStr->write(std::span(buf, n));
     }
     outStr->printf("\r\nendstream\r\n");
 }
@@ -1287,13 +1672,9 @@ void PDFDoc::writeRawStream(Stream *str, OutStream *outStr)
         error(errSyntaxError, -1, "PDFDoc::writeRawStream, rewind failed");
         return;
     }
-    for (Goffset i = 0; i < length; i++) {
-        int c = str->getUnfilteredChar();
-        if (unlikely(c == EOF)) {
-            error(errSyntaxError, -1, "PDFDoc::writeRawStream: EOF reading stream");
-            break;
-        }
-        outStr->printf("%c", c);
+    // the unfiltered data is the data of the base stream, copy it as is
+    if (length > 0 && outStr->copyFrom(str->getBaseStream(), length) < length) {
+        error(errSyntaxError, -1, "PDFDoc::writeRawStream: EOF reading stream");
     }
     (void)str->rewind();
     outStr->printf("\r\nendstream\r\n");
@@ -1331,23 +1712,22 @@ void PDFDoc::writeString(const std::string &s, OutStream *outStr, const unsigned
         outStr->printf("%s", stream.str().c_str());
         outStr->printf("> ");
     } else {
-        const char *c = sCopy.c_str();
-        outStr->printf("(");
-        for (size_t i = 0; i < sCopy.size(); i++) {
-            char unescaped = *(c + i) & 0x000000ff;
+        std::string escaped = "(";
+        for (const char unescaped : sCopy) {
             // escape if needed
             if (unescaped == '\r') {
-                outStr->printf("\\r");
+                escaped.append("\\r");
             } else if (unescaped == '\n') {
-                outStr->printf("\\n");
+                escaped.append("\\n");
             } else {
                 if (unescaped == '(' || unescaped == ')' || unescaped == '\\') {
-                    outStr->printf("%c", '\\');
+                    escaped.push_back('\\');
                 }
-                outStr->printf("%c", unescaped);
+                escaped.push_back(unescaped);
             }
         }
-        outStr->printf(") ");
+        escaped.append(") ");
+        outStr->write(std::span(reinterpret_cast<const unsigned char *>(escaped.data()), escaped.size()));
     }
 }
 
@@ -1464,12 +1844,11 @@ void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned in
             if (!stream->rewind()) {
                 break;
             }
-            // recalculate stream length
-            Goffset tmp = 0;
-            for (int c = stream->getChar(); c != EOF; c = stream->getChar()) {
-                tmp++;
-            }
-            stream->getDict()->set("Length", Object(tmp));
+            // encode the stream only once, keeping the data to write it
+            // after the dictionary with its recalculated length
+            std::string data;
+            stream->fillString(data);
+            stream->getDict()->set("Length", Object(static_cast<Goffset>(data.size())));
 
             // Remove Stream encoding
             auto *internalStream = dynamic_cast<AutoFreeMemStream *>(stream);
@@ -1482,7 +1861,9 @@ void PDFDoc::writeObject(Object *obj, OutStream *outStr, XRef *xRef, unsigned in
             stream->getDict()->remove("DecodeParms");
 
             writeDictionary(stream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
-            writeStream(stream, outStr);
+            outStr->printf("stream\r\n");
+            outStr->write(std::span(reinterpret_cast<const unsigned char *>(data.data()), data.size()));
+            outStr->printf("\r\nendstream\r\n");
         } else if (fileKey != nullptr && stream->getKind() == strFile && static_cast<FileStream *>(stream)->getNeedsEncryptionOnSave()) {
             auto *encStream = new EncryptStream(*stream, fileKey, encAlgorithm, keyLength, ref);
             writeDictionary(encStream->getDict(), outStr, xRef, numOffset, fileKey, encAlgorithm, keyLength, ref, alreadyWrittenDicts);
@@ -1654,12 +2035,17 @@ void PDFDoc::writeXRefTableTrailer(Goffset uxrefOffset, XRef *uxref, bool writeA
     const char *fileNameA = fileName ? fileName->c_str() : nullptr;
     // file size (doesn't include the trailer)
     unsigned int fileSize = 0;
-    int c;
     if (!str->rewind()) {
         return;
     }
-    while ((c = str->getChar()) != EOF) {
-        fileSize++;
+    if (file && str->getKind() == strFile) {
+        fileSize = static_cast<unsigned int>(file->size() - str->getStart());
+    } else {
+        unsigned char buf[16384];
+        int n;
+        while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+            fileSize += n;
+        }
     }
     str->close();
     Ref ref;
@@ -85,7 +85,9 @@ enum PDFWriteMode
 {
     writeStandard,
     writeForceRewrite,
-    writeForceIncremental
+    writeForceIncremental,
+    writeCompact // rewrite only the objects reachable from the trailer, packing
+                 // them in object streams and deduplicating identical streams
 };
 
 enum PDFSubtype
@@ -304,7 +306,8 @@ public:
     // Return the PDF ID in the trailer dictionary (if any).
     bool getID(GooString *permanent_id, GooString *update_id) const;
 
-    // Save one page with another name.
+    // Save one page with another name.  The document is left unchanged,
+    // so that any number of its pages can be saved one after the other.
     int savePageAs(const std::string &name, int pageNo);
     // Save this file with another name.
     int saveAs(const std::string &name, PDFWriteMode mode = writeStandard);
@@ -380,6 +383,8 @@ private:
     static void writeString(const std::string &s, OutStream *outStr, const unsigned char *fileKey, CryptAlgorithm encAlgorithm, int keyLength, Ref ref);
     void saveIncrementalUpdate(OutStream *outStr);
     void saveCompleteRewrite(OutStream *outStr);
+    void saveCompactRewrite(OutStream *outStr);
+    int saveSinglePage(const std::string &name, int pageNo);
 
     std::unique_ptr<Page> parsePage(int page);
 
@@ -77,12 +77,9 @@ static std::string decryptedString(const std::string &s, const unsigned char *fi
     if (!decrypt.rewind()) {
         return {};
     }
-    std::string res;
-    res.reserve(s.size());
-    int c;
-    while ((c = decrypt.getChar()) != EOF) {
-        res.push_back(static_cast<char>(c));
-    }
+    // the decrypted string is never longer than the encrypted one
+    std::string res(s.size(), '\0');
+    res.resize(decrypt.doGetChars(static_cast<int>(s.size()), reinterpret_cast<unsigned char *>(res.data())));
     return res;
 }
 
@@ -87,6 +87,10 @@
 
 static const double s_minLineWidth = 0.0;
 
+// Maximum number of entries in the color ramp of axial and radial
+// shading patterns.
+static constexpr int splashMaxRampSize = 16384;
+
 static inline void convertGfxColor(SplashColorPtr dest, const SplashColorMode colorMode, const GfxColorSpace *colorSpace, const GfxColor &src)
 {
     switch (colorMode) {
@@ -131,6 +135,55 @@ static inline void convertGfxColor(SplashColorPtr dest, const SplashColorMode co
     }
 }
 
+// Convert <n> colors at once, so that color spaces that support it can
+// batch the conversions; the results are stored <destStride> bytes apart.
+static void convertGfxColors(SplashColorPtr dest, int destStride, const SplashColorMode colorMode, const GfxColorSpace *colorSpace, const GfxColor *src, int n)
+{
+    switch (colorMode) {
+    case splashModeMono1:
+    case splashModeMono8: {
+        std::vector<GfxGray> grays(n);
+        colorSpace->getGrays(src, grays.data(), n);
+        for (int i = 0; i < n; ++i, dest += destStride) {
+            dest[0] = colToByte(grays[i]);
+            memset(&dest[1], 0, splashMaxColorComps - 1);
+        }
+        break;
+    }
+    case splashModeXBGR8:
+    case splashModeBGR8:
+    case splashModeRGB8: {
+        std::vector<GfxRGB> rgbs(n);
+        colorSpace->getRGBs(src, rgbs.data(), n);
+        for (int i = 0; i < n; ++i, dest += destStride) {
+            dest[0] = colToByte(rgbs[i].r);
+            dest[1] = colToByte(rgbs[i].g);
+            dest[2] = colToByte(rgbs[i].b);
+            dest[3] = colorMode == splashModeXBGR8 ? 255 : 0;
+            memset(&dest[4], 0, splashMaxColorComps - 4);
+        }
+        break;
+    }
+    case splashModeCMYK8: {
+        std::vector<GfxCMYK> cmyks(n);
+        colorSpace->getCMYKs(src, cmyks.data(), n);
+        for (int i = 0; i < n; ++i, dest += destStride) {
+            dest[0] = colToByte(cmyks[i].c);
+            dest[1] = colToByte(cmyks[i].m);
+            dest[2] = colToByte(cmyks[i].y);
+            dest[3] = colToByte(cmyks[i].k);
+            memset(&dest[4], 0, splashMaxColorComps - 4);
+        }
+        break;
+    }
+    case splashModeDeviceN8:
+        for (int i = 0; i < n; ++i, dest += destStride) {
+            convertGfxColor(dest, colorMode, colorSpace, src[i]);
+        }
+        break;
+    }
+}
+
 // Copy a color according to the color mode.
 // Use convertGfxShortColor() below when the destination is a bitmap
 // to avoid overwriting cells.
@@ -190,13 +243,14 @@ SplashGouraudPattern::~SplashGouraudPattern() = default;
 
 void SplashGouraudPattern::getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2)
 {
-    GfxColor c0, c1, c2;
-    shading->getTriangle(i, x0, y0, &c0, x1, y1, &c1, x2, y2, &c2);
+    GfxColor c[3];
+    shading->getTriangle(i, x0, y0, &c[0], x1, y1, &c[1], x2, y2, &c[2]);
 
-    const GfxColorSpace *srcColorSpace = shading->getColorSpace();
-    convertGfxColor(color0, mode, srcColorSpace, c0);
-    convertGfxColor(color1, mode, srcColorSpace, c1);
-    convertGfxColor(color2, mode, srcColorSpace, c2);
+    SplashColor converted[3];
+    convertGfxColors(converted[0], sizeof(SplashColor), mode, shading->getColorSpace(), c, 3);
+    memcpy(color0, converted[0], sizeof(SplashColor));
+    memcpy(color1, converted[1], sizeof(SplashColor));
+    memcpy(color2, converted[2], sizeof(SplashColor));
 }
 
 void SplashGouraudPattern::getParameterizedColor(double colorinterp, SplashColorMode mode, SplashColorPtr dest)
@@ -215,6 +269,139 @@ void SplashGouraudPattern::getParameterizedColor(double colorinterp, SplashColor
     }
 }
 
+//------------------------------------------------------------------------
+// SplashPatchMeshPattern
+//------------------------------------------------------------------------
+
+// Each patch is split into cells which are at most this many pixels
+// across in device space, and into at most splashPatchMaxSteps cells
+// along each side.
+static constexpr double splashPatchCellSize = 4;
+static constexpr int splashPatchMaxSteps = 64;
+
+SplashPatchMeshPattern::SplashPatchMeshPattern(GfxPatchMeshShading *shadingA, const std::array<double, 6> &matrixA)
+{
+    shading = shadingA;
+    matrix = matrixA;
+    gfxMode = shadingA->getColorSpace()->getMode();
+    nColorComps = shading->isParameterized() ? 1 : shading->getColorSpace()->getNComps();
+    for (int i = 0; i < shading->getNPatches(); ++i) {
+        tessellate(shading->getPatch(i));
+    }
+}
+
+SplashPatchMeshPattern::~SplashPatchMeshPattern() = default;
+
+void SplashPatchMeshPattern::tessellate(const GfxPatch *patch)
+{
+    // the size of the patch in device space, estimated from its
+    // control points, gives the number of cells along each side
+    double xMin, yMin, xMax, yMax;
+    xMin = xMax = patch->x[0][0] * matrix[0] + patch->y[0][0] * matrix[2];
+    yMin = yMax = patch->x[0][0] * matrix[1] + patch->y[0][0] * matrix[3];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            const double tx = patch->x[i][j] * matrix[0] + patch->y[i][j] * matrix[2];
+            const double ty = patch->x[i][j] * matrix[1] + patch->y[i][j] * matrix[3];
+            xMin = std::min(xMin, tx);
+            xMax = std::max(xMax, tx);
+            yMin = std::min(yMin, ty);
+            yMax = std::max(yMax, ty);
+        }
+    }
+    const double size = std::hypot(xMax - xMin, yMax - yMin);
+    if (!std::isfinite(size)) {
+        return;
+    }
+    const int n = std::clamp(static_cast<int>(std::ceil(size / splashPatchCellSize)), 1, splashPatchMaxSteps);
+
+    // cubic Bernstein polynomials for each grid step
+    std::vector<std::array<double, 4>> bernstein(n + 1);
+    for (int k = 0; k <= n; ++k) {
+        const double t = static_cast<double>(k) / n;
+        const double t1 = 1 - t;
+        bernstein[k] = { t1 * t1 * t1, 3 * t * t1 * t1, 3 * t * t * t1, t * t * t };
+    }
+
+    // the grid points: the first index of the control points (and of
+    // the corner colors) runs along u, the second one along v
+    const int first = static_cast<int>(vertexX.size());
+    for (int ku = 0; ku <= n; ++ku) {
+        const double u = static_cast<double>(ku) / n;
+        for (int kv = 0; kv <= n; ++kv) {
+            const double v = static_cast<double>(kv) / n;
+            double x = 0, y = 0;
+            for (int i = 0; i < 4; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    const double b = bernstein[ku][i] * bernstein[kv][j];
+                    x += b * patch->x[i][j];
+                    y += b * patch->y[i][j];
+                }
+            }
+            vertexX.push_back(x);
+            vertexY.push_back(y);
+            for (int c = 0; c < nColorComps; ++c) {
+                vertexColors.push_back((1 - u) * ((1 - v) * patch->color[0][0].c[c] + v * patch->color[0][1].c[c]) + u * ((1 - v) * patch->color[1][0].c[c] + v * patch->color[1][1].c[c]));
+            }
+        }
+    }
+
+    for (int ku = 0; ku < n; ++ku) {
+        for (int kv = 0; kv < n; ++kv) {
+            const int v00 = first + ku * (n + 1) + kv;
+            const int v01 = v00 + 1;
+            const int v10 = v00 + n + 1;
+            const int v11 = v10 + 1;
+            triangles.insert(triangles.end(), { v00, v01, v11, v00, v11, v10 });
+        }
+    }
+}
+
+void SplashPatchMeshPattern::getParametrizedTriangle(int i, double *x0, double *y0, double *color0, double *x1, double *y1, double *color1, double *x2, double *y2, double *color2)
+{
+    const int *v = &triangles[3 * i];
+    *x0 = vertexX[v[0]];
+    *y0 = vertexY[v[0]];
+    *color0 = vertexColors[v[0]];
+    *x1 = vertexX[v[1]];
+    *y1 = vertexY[v[1]];
+    *color1 = vertexColors[v[1]];
+    *x2 = vertexX[v[2]];
+    *y2 = vertexY[v[2]];
+    *color2 = vertexColors[v[2]];
+}
+
+void SplashPatchMeshPattern::getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2)
+{
+    const int *v = &triangles[3 * i];
+    GfxColor c[3];
+    for (int k = 0; k < 3; ++k) {
+        for (int m = 0; m < nColorComps; ++m) {
+            // the patch colors are stored as color components already
+            c[k].c[m] = static_cast<GfxColorComp>(vertexColors[v[k] * nColorComps + m]);
+        }
+    }
+    *x0 = vertexX[v[0]];
+    *y0 = vertexY[v[0]];
+    *x1 = vertexX[v[1]];
+    *y1 = vertexY[v[1]];
+    *x2 = vertexX[v[2]];
+    *y2 = vertexY[v[2]];
+
+    SplashColor converted[3];
+    convertGfxColors(converted[0], sizeof(SplashColor), mode, shading->getColorSpace(), c, 3);
+    memcpy(color0, converted[0], sizeof(SplashColor));
+    memcpy(color1, converted[1], sizeof(SplashColor));
+    memcpy(color2, converted[2], sizeof(SplashColor));
+}
+
+void SplashPatchMeshPattern::getParameterizedColor(double t, SplashColorMode mode, SplashColorPtr dest)
+{
+    GfxColor src;
+    shading->getParameterizedColor(t, &src);
+    convertGfxShortColor(dest, mode, shading->getColorSpace(), src);
+}
+
 //------------------------------------------------------------------------
 // SplashFunctionPattern
 //------------------------------------------------------------------------
@@ -291,28 +478,77 @@ SplashUnivariatePattern::SplashUnivariatePattern(SplashColorMode colorModeA, Gfx
     stateA->getUserClipBBox(&xMin, &yMin, &xMax, &yMax);
     shadingA->setupCache(&ctm, xMin, yMin, xMax, yMax);
     gfxMode = shadingA->getColorSpace()->getMode();
+
+    // the color ramp has (about) one entry per device pixel along the
+    // visible part of the shading
+    double sMin, sMax;
+    shadingA->getParameterRange(&sMin, &sMax, xMin, yMin, xMax, yMax);
+    const double tA = t0 + sMin * dt;
+    const double tB = t0 + sMax * dt;
+    const double size = ceil(ctm.norm() * shadingA->getDistance(sMin, sMax));
+    rampSize = (size >= 2) ? static_cast<int>(std::min<double>(size, splashMaxRampSize)) : 2;
+    rampTMin = std::min(tA, tB);
+    rampScale = (std::max(tA, tB) > rampTMin) ? (rampSize - 1) / (std::max(tA, tB) - rampTMin) : 0;
 }
 
 SplashUnivariatePattern::~SplashUnivariatePattern() = default;
 
+const unsigned char *SplashUnivariatePattern::getRampColor(double t) const
+{
+    if (ramp.empty()) {
+        const int nComps = shading->getColorSpace()->getNComps();
+        std::vector<GfxColor> colors(rampSize);
+
+        for (int i = 0; i < rampSize; ++i) {
+            const double rampT = (rampScale > 0) ? rampTMin + i / rampScale : rampTMin;
+            const int filled = shading->getColor(rampT, &colors[i]);
+            for (int j = filled; j < nComps; ++j) {
+                colors[i].c[j] = 0;
+            }
+        }
+        ramp.resize(rampSize * splashMaxColorComps);
+        convertGfxColors(ramp.data(), splashMaxColorComps, colorMode, shading->getColorSpace(), colors.data(), rampSize);
+    }
+
+    const int i = std::clamp(static_cast<int>((t - rampTMin) * rampScale + 0.5), 0, rampSize - 1);
+    return &ramp[i * splashMaxColorComps];
+}
+
 bool SplashUnivariatePattern::getColor(int x, int y, SplashColorPtr c) const
 {
-    GfxColor gfxColor;
     double xc, yc, t;
 
     ictm.transform(x, y, &xc, &yc);
     if (!getParameter(xc, yc, &t)) {
         return false;
     }
+    memcpy(c, getRampColor(t), splashMaxColorComps);
+    return true;
+}
 
-    const int filled = shading->getColor(t, &gfxColor);
-    if (unlikely(filled < shading->getColorSpace()->getNComps())) {
-        for (int i = filled; i < shading->getColorSpace()->getNComps(); ++i) {
-            gfxColor.c[i] = 0;
+void SplashUnivariatePattern::getColorSpan(int x0, int x1, int y, SplashColorPtr c, bool *valid) const
+{
+    const int n = x1 - x0 + 1;
+    double xc, yc;
+
+    if (n <= 0) {
+        return;
+    }
+    std::vector<double> t(n);
+    ictm.transform(x0, y, &xc, &yc);
+    getParameters(xc, yc, ictm.m[0], ictm.m[1], n, t.data(), valid);
+    for (int i = 0; i < n; ++i) {
+        if (valid[i]) {
+            memcpy(c + i * splashMaxColorComps, getRampColor(t[i]), splashMaxColorComps);
         }
     }
-    convertGfxColor(c, colorMode, shading->getColorSpace(), gfxColor);
-    return true;
+}
+
+void SplashUnivariatePattern::getParameters(double xs, double ys, double dxs, double dys, int n, double *t, bool *valid) const
+{
+    for (int i = 0; i < n; ++i) {
+        valid[i] = getParameter(xs + i * dxs, ys + i * dys, &t[i]);
+    }
 }
 
 bool SplashUnivariatePattern::testPosition(int x, int y) const
@@ -487,6 +723,27 @@ bool SplashAxialPattern::getParameter(double xc, double yc, double *t) const
     return true;
 }
 
+void SplashAxialPattern::getParameters(double xs, double ys, double dxs, double dys, int n, double *t, bool *valid) const
+{
+    // s is linear in the position, so it can be computed incrementally
+    const double s0 = ((xs - x0) * dx + (ys - y0) * dy) * mul;
+    const double ds = (dxs * dx + dys * dy) * mul;
+
+    for (int i = 0; i < n; ++i) {
+        const double s = s0 + i * ds;
+        valid[i] = true;
+        if (0 <= s && s <= 1) {
+            t[i] = t0 + dt * s;
+        } else if (s < 0 && shading->getExtend0()) {
+            t[i] = t0;
+        } else if (s > 1 && shading->getExtend1()) {
+            t[i] = t1;
+        } else {
+            valid[i] = false;
+        }
+    }
+}
+
 //------------------------------------------------------------------------
 // Type 3 font cache size parameters
 constexpr int type3FontCacheAssoc = 8;
@@ -4420,20 +4677,38 @@ bool SplashOutputDev::tilingPatternFill(GfxState *state, Gfx *gfxA, Catalog * /*
     return retValue;
 }
 
-bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraudTriangleShading *shading)
+// Is the shading color space <shadingMode> the color space of the
+// bitmap, so that its colors can be used as they are?
+static bool isDirectColorTranslation(SplashColorMode colorMode, GfxColorSpaceMode shadingMode)
 {
-    GfxColorSpaceMode shadingMode = shading->getColorSpace()->getMode();
-    bool bDirectColorTranslation = false; // triggers an optimization.
     switch (colorMode) {
     case splashModeRGB8:
-        bDirectColorTranslation = (shadingMode == csDeviceRGB);
-        break;
+        return shadingMode == csDeviceRGB;
     case splashModeCMYK8:
     case splashModeDeviceN8:
-        bDirectColorTranslation = (shadingMode == csDeviceCMYK);
-        break;
+        return shadingMode == csDeviceCMYK;
     default:
-        break;
+        return false;
+    }
+}
+
+bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraudTriangleShading *shading)
+{
+    const bool bDirectColorTranslation = isDirectColorTranslation(colorMode, shading->getColorSpace()->getMode()); // triggers an optimization.
+    // Splash interpolates the vertex colors of non-parameterized
+    // shadings linearly in device space, which only matches the
+    // subdivision done by Gfx if the colors are not converted, or if
+    // every triangle has a single color
+    if (!shading->isParameterized() && !bDirectColorTranslation) {
+        const int nComps = shading->getColorSpace()->getNComps();
+        for (int i = 0; i < shading->getNTriangles(); ++i) {
+            double x0, y0, x1, y1, x2, y2;
+            GfxColor c0, c1, c2;
+            shading->getTriangle(i, &x0, &y0, &c0, &x1, &y1, &c1, &x2, &y2, &c2);
+            if (!std::equal(c0.c, c0.c + nComps, c1.c) || !std::equal(c0.c, c0.c + nComps, c2.c)) {
+                return false;
+            }
+        }
     }
     // restore vector antialias because we support it here
     SplashGouraudPattern splashShading(bDirectColorTranslation, shading);
@@ -4444,6 +4719,22 @@ bool SplashOutputDev::gouraudTriangleShadedFill(GfxState * /*state*/, GfxGouraud
     return retVal;
 }
 
+bool SplashOutputDev::patchMeshShadedFill(GfxState * /*state*/, GfxPatchMeshShading *shading)
+{
+    // the triangles are written to the bitmap a byte per component,
+    // and the colors are interpolated in device space as above
+    if (colorMode == splashModeMono1 || (!shading->isParameterized() && !isDirectColorTranslation(colorMode, shading->getColorSpace()->getMode()))) {
+        return false;
+    }
+    SplashPatchMeshPattern splashShading(shading, splash->getMatrix());
+    // restore vector antialias because we support it here
+    const bool vaa = getVectorAntialias();
+    setVectorAntialias(true);
+    const bool retVal = splash->gouraudTriangleShadedFill(&splashShading);
+    setVectorAntialias(vaa);
+    return retVal;
+}
+
 bool SplashOutputDev::univariateShadedFill(GfxState *state, SplashUnivariatePattern *pattern)
 {
     double xMin, yMin, xMax, yMax;
@@ -93,12 +93,18 @@ public:
 
     bool getColor(int x, int y, SplashColorPtr c) const override;
 
+    void getColorSpan(int x0, int x1, int y, SplashColorPtr c, bool *valid) const override;
+
     bool testPosition(int x, int y) const override;
 
     bool isStatic() const override { return false; }
 
     virtual bool getParameter(double xs, double ys, double *t) const = 0;
 
+    // Compute the parameters of <n> points, starting at (<xs>, <ys>) and
+    // moving by (<dxs>, <dys>) from one to the next.
+    virtual void getParameters(double xs, double ys, double dxs, double dys, int n, double *t, bool *valid) const;
+
     GfxUnivariateShading *getShading() { return shading; }
 
     bool isCMYK() const override { return gfxMode == csDeviceCMYK; }
@@ -110,6 +116,16 @@ protected:
     GfxState *state;
     SplashColorMode colorMode;
     GfxColorSpaceMode gfxMode;
+
+private:
+    const unsigned char *getRampColor(double t) const;
+
+    // color ramp: the colors of the shading, converted to colorMode, for
+    // rampSize values of t evenly spread over [rampTMin, rampTMax]; it is
+    // built on first use
+    int rampSize;
+    double rampTMin, rampScale;
+    mutable std::vector<unsigned char> ramp;
 };
 
 class SplashAxialPattern : public SplashUnivariatePattern
@@ -123,6 +139,8 @@ public:
 
     bool getParameter(double xc, double yc, double *t) const override;
 
+    void getParameters(double xs, double ys, double dxs, double dys, int n, double *t, bool *valid) const override;
+
 private:
     double x0, y0, x1, y1;
     double dx, dy, mul;
@@ -163,6 +181,46 @@ private:
     GfxColorSpaceMode gfxMode;
 };
 
+// see GfxState.h, GfxPatchMeshShading
+// The patches are tessellated into triangles fine enough (in device
+// space) to be rasterized by Splash::gouraudTriangleShadedFill.
+class SplashPatchMeshPattern : public SplashGouraudColor
+{
+public:
+    SplashPatchMeshPattern(GfxPatchMeshShading *shading, const std::array<double, 6> &matrix);
+
+    SplashPattern *copy() const override { return new SplashPatchMeshPattern(shading, matrix); }
+
+    ~SplashPatchMeshPattern() override;
+
+    bool getColor(int /*x*/, int /*y*/, SplashColorPtr /*c*/) const override { return false; }
+
+    bool testPosition(int /*x*/, int /*y*/) const override { return false; }
+
+    bool isStatic() const override { return false; }
+
+    bool isCMYK() const override { return gfxMode == csDeviceCMYK; }
+
+    bool isParameterized() override { return shading->isParameterized(); }
+    int getNTriangles() override { return static_cast<int>(triangles.size() / 3); }
+    void getParametrizedTriangle(int i, double *x0, double *y0, double *color0, double *x1, double *y1, double *color1, double *x2, double *y2, double *color2) override;
+
+    void getNonParametrizedTriangle(int i, SplashColorMode mode, double *x0, double *y0, SplashColorPtr color0, double *x1, double *y1, SplashColorPtr color1, double *x2, double *y2, SplashColorPtr color2) override;
+
+    void getParameterizedColor(double t, SplashColorMode mode, SplashColorPtr dest) override;
+
+private:
+    void tessellate(const GfxPatch *patch);
+
+    GfxPatchMeshShading *shading;
+    std::array<double, 6> matrix;
+    GfxColorSpaceMode gfxMode;
+    int nColorComps; // number of color values per vertex
+    std::vector<double> vertexX, vertexY;
+    std::vector<double> vertexColors;
+    std::vector<int> triangles; // three vertex indices per triangle
+};
+
 // see GfxState.h, GfxRadialShading
 class SplashRadialPattern : public SplashUnivariatePattern
 {
@@ -208,7 +266,7 @@ public:
     // Does this device use functionShadedFill(), axialShadedFill(), and
     // radialShadedFill()?  If this returns false, these shaded fills
     // will be reduced to a series of other drawing operations.
-    bool useShadedFills(int type) override { return type >= 1 && type <= 5; }
+    bool useShadedFills(int type) override { return type >= 1 && type <= 7; }
 
     // Does this device use upside-down coordinates?
     // (Upside-down means (0,0) is the top left corner of the page.)
@@ -269,6 +327,7 @@ public:
     bool axialShadedFill(GfxState *state, GfxAxialShading *shading, double tMin, double tMax) override;
     bool radialShadedFill(GfxState *state, GfxRadialShading *shading, double tMin, double tMax) override;
     bool gouraudTriangleShadedFill(GfxState *state, GfxGouraudTriangleShading *shading) override;
+    bool patchMeshShadedFill(GfxState *state, GfxPatchMeshShading *shading) override;
 
     //----- path clipping
     void clip(GfxState *state) override;
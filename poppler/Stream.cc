@@ -60,6 +60,7 @@
 #include <climits>
 #include <cstring>
 #include <cctype>
+#include <algorithm>
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "poppler-config.h"
@@ -410,6 +411,23 @@ OutStream::OutStream() = default;
 
 OutStream::~OutStream() = default;
 
+Goffset OutStream::copyFrom(BaseStream *str, Goffset length)
+{
+    std::vector<unsigned char> buf(length < 0 ? 65536 : std::min<Goffset>(length, 65536));
+    Goffset done = 0;
+    while (length < 0 || done < length) {
+        const int n = str->doGetChars(static_cast<int>(length < 0 ? buf.size() : std::min<Goffset>(length - done, buf.size())), buf.data());
+        if (n <= 0) {
+            break;
+        }
+        if (write(std::span(buf.data(), n)) != static_cast<size_t>(n)) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
 //------------------------------------------------------------------------
 // FileOutStream
 //------------------------------------------------------------------------
@@ -449,6 +467,67 @@ void FileOutStream::printf(const char *format, ...)
     va_end(argptr);
 }
 
+Goffset FileOutStream::copyFrom(BaseStream *str, Goffset length)
+{
+#ifndef _WIN32
+    // copy from file to file without going through user space
+    if (str->getKind() == strFile) {
+        fflush(f);
+        const int fd = fileno(f);
+        const Goffset n = static_cast<FileStream *>(str)->copyTo(fd, length);
+        // the FILE may keep its own idea of the position
+        Gfseek(f, lseek(fd, 0, SEEK_CUR), SEEK_SET);
+        return n;
+    }
+#endif
+    return OutStream::copyFrom(str, length);
+}
+
+//------------------------------------------------------------------------
+// StringOutStream
+//------------------------------------------------------------------------
+StringOutStream::StringOutStream() = default;
+
+StringOutStream::~StringOutStream() = default;
+
+void StringOutStream::close() { }
+
+Goffset StringOutStream::getPos()
+{
+    return static_cast<Goffset>(buf.size());
+}
+
+void StringOutStream::put(char c)
+{
+    buf.push_back(c);
+}
+
+size_t StringOutStream::write(std::span<const unsigned char> data)
+{
+    buf.append(reinterpret_cast<const char *>(data.data()), data.size());
+    return data.size();
+}
+
+void StringOutStream::printf(const char *format, ...)
+{
+    char small[256];
+    va_list argptr;
+    va_start(argptr, format);
+    va_list argptr2;
+    va_copy(argptr2, argptr);
+    const int n = vsnprintf(small, sizeof(small), format, argptr);
+    if (n >= static_cast<int>(sizeof(small))) {
+        const size_t pos = buf.size();
+        buf.resize(pos + n + 1);
+        vsnprintf(buf.data() + pos, n + 1, format, argptr2);
+        buf.resize(pos + n);
+    } else if (n > 0) {
+        buf.append(small, n);
+    }
+    va_end(argptr2);
+    va_end(argptr);
+}
+
 //------------------------------------------------------------------------
 // BaseStream
 //------------------------------------------------------------------------
@@ -988,6 +1067,29 @@ bool FileStream::fillBuf()
     return bufPtr < bufEnd;
 }
 
+// Read from the current position into <buffer>, bypassing the (empty)
+// internal buffer.
+int FileStream::readDirect(int nChars, unsigned char *buffer)
+{
+    bufPos += bufEnd - buf;
+    bufPtr = bufEnd = buf;
+    if (limited) {
+        if (bufPos >= start + length) {
+            return 0;
+        }
+        if (bufPos + nChars > start + length) {
+            nChars = static_cast<int>(start + length - bufPos);
+        }
+    }
+    const int n = file->read(reinterpret_cast<char *>(buffer), nChars, offset);
+    if (n <= 0) {
+        return 0;
+    }
+    offset += n;
+    bufPos += n;
+    return n;
+}
+
 void FileStream::setPos(Goffset pos, int dir)
 {
     Goffset size;
@@ -1012,6 +1114,23 @@ void FileStream::moveStart(Goffset delta)
     bufPos = start;
 }
 
+#ifndef _WIN32
+Goffset FileStream::copyTo(int fd, Goffset n)
+{
+    const Goffset pos = getPos();
+    Goffset end = file->size();
+    if (limited) {
+        end = std::min(end, start + length);
+    }
+    if (n < 0 || n > end - pos) {
+        n = std::max<Goffset>(end - pos, 0);
+    }
+    const Goffset done = file->copyTo(fd, pos, n);
+    setPos(pos + done);
+    return done;
+}
+#endif
+
 //------------------------------------------------------------------------
 // CachedFileStream
 //------------------------------------------------------------------------
@@ -52,6 +52,7 @@
 #include <vector>
 #include <span>
 #include <optional>
+#include <string>
 
 #include "poppler-config.h"
 #include "poppler_private_export.h"
@@ -306,6 +307,10 @@ public:
     virtual size_t write(std::span<const unsigned char> data) = 0;
 
     virtual void printf(const char *format, ...) GCC_PRINTF_FORMAT(2, 3) = 0;
+
+    // Copy the next <length> bytes of <str>, or all the remaining ones if
+    // <length> is negative.  Returns the number of bytes copied.
+    virtual Goffset copyFrom(BaseStream *str, Goffset length);
 };
 
 //------------------------------------------------------------------------
@@ -328,11 +333,42 @@ public:
 
     void printf(const char *format, ...) override GCC_PRINTF_FORMAT(2, 3);
 
+    Goffset copyFrom(BaseStream *str, Goffset length) override;
+
 private:
     FILE *f;
     Goffset start;
 };
 
+//------------------------------------------------------------------------
+// StringOutStream
+//
+// An OutStream that appends to a string in memory.
+//------------------------------------------------------------------------
+class POPPLER_PRIVATE_EXPORT StringOutStream : public OutStream
+{
+public:
+    StringOutStream();
+
+    ~StringOutStream() override;
+
+    void close() override;
+
+    Goffset getPos() override;
+
+    void put(char c) override;
+
+    size_t write(std::span<const unsigned char> data) override;
+
+    void printf(const char *format, ...) override GCC_PRINTF_FORMAT(2, 3);
+
+    // Get the data written so far.
+    std::string &getString() { return buf; }
+
+private:
+    std::string buf;
+};
+
 //------------------------------------------------------------------------
 // BaseStream
 //
@@ -568,8 +604,16 @@ public:
     bool getNeedsEncryptionOnSave() const { return needsEncryptionOnSave; }
     void setNeedsEncryptionOnSave(bool needsEncryptionOnSaveA) { needsEncryptionOnSave = needsEncryptionOnSaveA; }
 
+#ifndef _WIN32
+    // Copy the next <n> bytes, or all the remaining ones if <n> is
+    // negative, to the file descriptor <fd>.  Returns the number of bytes
+    // copied.
+    Goffset copyTo(int fd, Goffset n);
+#endif
+
 private:
     bool fillBuf();
+    int readDirect(int nChars, unsigned char *buffer);
 
     bool hasGetChars() override { return true; }
     int getChars(int nChars, unsigned char *buffer) override
@@ -579,6 +623,15 @@ private:
         n = 0;
         while (n < nChars) {
             if (bufPtr >= bufEnd) {
+                // read large blocks straight into the caller's buffer
+                if (nChars - n >= fileStreamBufSize) {
+                    m = readDirect(nChars - n, buffer + n);
+                    if (m <= 0) {
+                        break;
+                    }
+                    n += m;
+                    continue;
+                }
                 if (!fillBuf()) {
                     break;
                 }
@@ -58,13 +58,17 @@
 
 #include <config.h>
 
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstddef>
 #include <cmath>
 #include <cfloat>
 #include <algorithm>
+#include <array>
 #include <functional>
+#include <future>
+#include <unordered_map>
 #if defined(_WIN32) || defined(__CYGWIN__)
 #    include <fcntl.h> // for O_BINARY
 #    include <io.h> // for _setmode
@@ -75,6 +79,7 @@
 #include "Error.h"
 #include "GlobalParams.h"
 #include "UnicodeMap.h"
+#include "UnicodeMapFuncs.h"
 #include "UnicodeTypeTable.h"
 #include "Link.h"
 #include "TextOutputDev.h"
@@ -203,15 +208,32 @@ inline bool isAscii7(Unicode uchar)
 
 }
 
+// Append <u> to <s> in the encoding of <uMap>.  UTF-8, the default text
+// encoding, is encoded directly instead of going through the map.
+static inline void appendMappedChar(GooString *s, const UnicodeMap *uMap, bool utf8, Unicode u)
+{
+    char buf[8];
+
+    if (utf8 && u < 0x80) {
+        s->push_back(static_cast<char>(u));
+    } else if (utf8) {
+        s->append(buf, mapUTF8(u, buf, sizeof(buf)));
+    } else {
+        s->append(buf, uMap->mapUnicode(u, buf, sizeof(buf)));
+    }
+}
+
 static int reorderText(const Unicode *text, int len, const UnicodeMap *uMap, bool primaryLR, GooString *s, Unicode *u)
 {
-    char lre[8], rle[8], popdf[8], buf[8];
-    int lreLen = 0, rleLen = 0, popdfLen = 0, n;
+    char lre[8], rle[8], popdf[8];
+    int lreLen = 0, rleLen = 0, popdfLen = 0;
     int nCols, i, j, k;
+    bool utf8 = false;
 
     nCols = 0;
 
     if (s) {
+        utf8 = uMap->match("UTF-8");
         lreLen = uMap->mapUnicode(0x202a, lre, sizeof(lre));
         rleLen = uMap->mapUnicode(0x202b, rle, sizeof(rle));
         popdfLen = uMap->mapUnicode(0x202c, popdf, sizeof(popdf));
@@ -226,8 +248,7 @@ static int reorderText(const Unicode *text, int len, const UnicodeMap *uMap, boo
             }
             for (k = i; k < j; ++k) {
                 if (s) {
-                    n = uMap->mapUnicode(text[k], buf, sizeof(buf));
-                    s->append(buf, n);
+                    appendMappedChar(s, uMap, utf8, text[k]);
                 }
                 if (u) {
                     u[nCols] = text[k];
@@ -245,8 +266,7 @@ static int reorderText(const Unicode *text, int len, const UnicodeMap *uMap, boo
                 }
                 for (k = j - 1; k >= i; --k) {
                     if (s) {
-                        n = uMap->mapUnicode(text[k], buf, sizeof(buf));
-                        s->append(buf, n);
+                        appendMappedChar(s, uMap, utf8, text[k]);
                     }
                     if (u) {
                         u[nCols] = text[k];
@@ -275,8 +295,7 @@ static int reorderText(const Unicode *text, int len, const UnicodeMap *uMap, boo
             }
             for (k = i; k > j; --k) {
                 if (s) {
-                    n = uMap->mapUnicode(text[k], buf, sizeof(buf));
-                    s->append(buf, n);
+                    appendMappedChar(s, uMap, utf8, text[k]);
                 }
                 if (u) {
                     u[nCols] = text[k];
@@ -294,8 +313,7 @@ static int reorderText(const Unicode *text, int len, const UnicodeMap *uMap, boo
                 }
                 for (k = j + 1; k <= i; ++k) {
                     if (s) {
-                        n = uMap->mapUnicode(text[k], buf, sizeof(buf));
-                        s->append(buf, n);
+                        appendMappedChar(s, uMap, utf8, text[k]);
                     }
                     if (u) {
                         u[nCols] = text[k];
@@ -417,10 +435,11 @@ GfxFont::WritingMode TextFontInfo::getWMode() const
 // TextWord
 //------------------------------------------------------------------------
 
-TextWord::TextWord(const GfxState *state, int rotA, double fontSizeA)
+TextWord::TextWord(const GfxState *state, int rotA, double fontSizeA, bool keepGlyphsA)
 {
     rot = rotA;
     fontSize = fontSizeA;
+    keepGlyphs = keepGlyphsA;
     spaceAfter = false;
     next = nullptr;
     invisible = state->getRender() == 3;
@@ -444,7 +463,10 @@ TextWord::~TextWord() = default;
 
 void TextWord::addChar(TextFontInfo *fontA, double x, double y, double dx, double dy, int charPosA, int charLen, CharCode c, Unicode u, const Matrix &textMatA)
 {
-    chars.push_back(CharInfo { .text = u, .charcode = c, .charPos = charPosA, .edge = 0.0, .font = fontA, .textMat = textMatA });
+    chars.push_back(CharInfo { .text = u, .charPos = charPosA, .edge = 0.0, .font = fontA });
+    if (keepGlyphs) {
+        glyphs.push_back(GlyphInfo { .charcode = c, .textMat = textMatA });
+    }
     charPosEnd = charPosA + charLen;
 
     if (len() == 1) {
@@ -645,7 +667,10 @@ bool TextWord::addCombining(TextFontInfo *fontA, double fontSizeA, double x, dou
 
         // Add character, but don't adjust edge / bounding box because
         // combining character's positioning could be odd.
-        chars.emplace_back(CharInfo { .text = cCurrent, .charcode = c, .charPos = charPosA, .edge = edgeMid, .font = fontA, .textMat = textMatA });
+        chars.emplace_back(CharInfo { .text = cCurrent, .charPos = charPosA, .edge = edgeMid, .font = fontA });
+        if (keepGlyphs) {
+            glyphs.emplace_back(GlyphInfo { .charcode = c, .textMat = textMatA });
+        }
         charPosEnd = charPosA + charLen;
 
         return true;
@@ -675,15 +700,18 @@ bool TextWord::addCombining(TextFontInfo *fontA, double fontSizeA, double x, dou
 
         fontSize = fontSizeA;
         // move combining character to after base character
-        chars.emplace_back(CharInfo { .text = cPrev, .charcode = chars.back().charcode, .charPos = charPosA, .edge = edgeMid, .font = chars.back().font, .textMat = chars.back().textMat });
+        chars.emplace_back(CharInfo { .text = cPrev, .charPos = charPosA, .edge = edgeMid, .font = chars.back().font });
+        if (keepGlyphs) {
+            const GlyphInfo prevGlyph = glyphs.back();
+            glyphs.push_back(prevGlyph);
+            glyphs[glyphs.size() - 2] = GlyphInfo { .charcode = c, .textMat = textMatA };
+        }
 
         auto &lastChar = chars[chars.size() - 2];
 
         charPosEnd = charPosA + charLen;
         lastChar.text = u;
-        lastChar.charcode = c;
         lastChar.font = fontA;
-        lastChar.textMat = textMatA;
 
         if (len() == 2) {
             setInitialBounds(fontA, x, y);
@@ -753,6 +781,7 @@ void TextWord::merge(TextWord *word)
         yMax = word->yMax;
     }
     chars.insert(chars.end(), word->chars.begin(), word->chars.end());
+    glyphs.insert(glyphs.end(), word->glyphs.begin(), word->glyphs.end());
     edgeEnd = word->edgeEnd;
     charPosEnd = word->charPosEnd;
     if (!link) {
@@ -760,6 +789,14 @@ void TextWord::merge(TextWord *word)
     }
 }
 
+void TextWord::removeFirstChars(int n)
+{
+    chars.erase(chars.begin(), chars.begin() + n);
+    if (keepGlyphs) {
+        glyphs.erase(glyphs.begin(), glyphs.begin() + n);
+    }
+}
+
 inline int TextWord::primaryCmp(const TextWord *word) const
 {
     double cmp;
@@ -1737,7 +1774,7 @@ void TextBlock::coalesce(const UnicodeMap *uMap, double fixedPitch)
                         word1 = prevWord->next;
                     } else if (keep.first != 0) {
                         // Discard first part of second word
-                        word1->chars.erase(word1->chars.begin(), word1->chars.begin() + keep.first);
+                        word1->removeFirstChars(keep.first);
                         if (word1->rot == 0) {
                             word1->xMin = word0->xMax;
                         } else if (word1->rot == 2) {
@@ -1767,7 +1804,7 @@ void TextBlock::coalesce(const UnicodeMap *uMap, double fixedPitch)
                     pool->setPool(idx1, word1->next);
                     delete word1;
                 } else if (keep.first != 0) {
-                    word1->chars.erase(word1->chars.begin(), word1->chars.begin() + keep.first);
+                    word1->removeFirstChars(keep.first);
                     word1->xMin = word0->xMax;
                 }
             }
@@ -2127,7 +2164,7 @@ bool TextBlock::isBelow(const TextBlock *blk) const
     return below;
 }
 
-bool TextBlock::isBeforeByRule1(const TextBlock *blk1)
+bool TextBlock::isBeforeByRule1(const TextBlock *blk1) const
 {
     bool before = false;
     bool overlap = false;
@@ -2159,7 +2196,7 @@ bool TextBlock::isBeforeByRule1(const TextBlock *blk1)
     return before;
 }
 
-bool TextBlock::isBeforeByRule2(const TextBlock *blk1)
+bool TextBlock::isBeforeByRule2(const TextBlock *blk1) const
 {
     double cmp = 0;
     int rotLR = rot;
@@ -2185,18 +2222,454 @@ bool TextBlock::isBeforeByRule2(const TextBlock *blk1)
     return cmp <= 0;
 }
 
+//------------------------------------------------------------------------
+// TextBlockIndex
+//------------------------------------------------------------------------
+
+// Indexes over the blocks of a page, used by TextPage::coalesce to find
+// the neighbours of a block without comparing it against every other
+// block.  Blocks are identified by their position in the block list.
+//
+// The grid stores each block in every cell its bounding box overlaps.
+// The key lists keep the blocks sorted by the coordinates compared by
+// the reading order rules, and skip the blocks which have already been
+// visited by the reading order sort.
+class TextBlockIndex
+{
+public:
+    TextBlockIndex(TextBlock *blkList, int nBlocksA);
+
+    TextBlockIndex(const TextBlockIndex &) = delete;
+    TextBlockIndex &operator=(const TextBlockIndex &) = delete;
+
+    TextBlock *getBlock(int i) const { return blocks[i]; }
+
+    // Call f(i) for each block i whose bounding box may intersect the
+    // rectangle [x0,x1]x[y0,y1]; f may be called more than once for the
+    // same block.
+    template<typename F>
+    void forEach(double x0, double y0, double x1, double y1, F f) const
+    {
+        if (!(x0 <= x1 && y0 <= y1)) {
+            return;
+        }
+        const int cx1 = cellX(x1);
+        const int cy1 = cellY(y1);
+        for (int cy = cellY(y0); cy <= cy1; ++cy) {
+            for (int cx = cellX(x0); cx <= cx1; ++cx) {
+                for (int i : cells[cy * nx + cx]) {
+                    f(i);
+                }
+            }
+        }
+        for (int i : bigBlocks) {
+            f(i);
+        }
+    }
+
+    // For each block, get the first block in the list whose top left
+    // corner is below and to the right of the block's bottom right
+    // corner, or -1 if there is none.
+    void getFirstBelowRight(std::vector<int> &result) const;
+
+    // Set up the key lists for the reading order sort; this needs the
+    // extended bounding boxes and the table ids.
+    void initReadingOrder(int primaryRot, bool primaryLR);
+
+    bool isVisited(int i) const { return visited[i]; }
+    void setVisited(int i);
+
+    // Get the unvisited blocks which may come before block <i> in
+    // reading order, in block list order.
+    void getBeforeCandidates(int i, std::vector<int> &result);
+
+    // Returns true if there is a block blk3 such that <blk1> is before
+    // blk3, and blk3 is before <blk2>, by rule 1.
+    bool isRule1Between(const TextBlock *blk1, const TextBlock *blk2) const;
+
+private:
+    // The blocks, sorted by a key, with links to skip the visited ones.
+    struct KeyList
+    {
+        std::vector<double> keys;
+        std::vector<int> blks;
+        std::vector<int> skip; // first unvisited position >= p, if not p itself
+
+        void init(std::vector<std::pair<double, int>> &entries, std::vector<int> &pos);
+        int firstUnvisited(int p);
+        void getPrefix(double maxKey, std::vector<int> &result);
+    };
+
+    // The key lists for one table (or for all the blocks which are not
+    // part of a table): the table entries, by yMin; all blocks, for rule
+    // 1; and the blocks for each value of rule 2's rotation.  Entries of
+    // the same table are only compared with each other by position, so
+    // they don't need to look at each other's rule lists.
+    struct KeyGroup
+    {
+        KeyList tableList, rule1List, rule2Lists[4];
+        int nUnvisited;
+    };
+
+    int cellX(double x) const;
+    int cellY(double y) const;
+    double rule1Key(const TextBlock *blk) const;
+    int getRotLR(const TextBlock *blk) const { return primaryLR ? blk->rot : (blk->rot + 2) % 4; }
+
+    std::vector<TextBlock *> blocks;
+    std::vector<bool> visited;
+
+    // the grid; blocks which would take up more than maxBlockCells
+    // cells are kept on a separate list, and checked by every query
+    static constexpr int maxBlockCells = 16;
+    static constexpr int maxGridSize = 1024;
+    int nx, ny;
+    double gridXMin, gridYMin, gridXScale, gridYScale;
+    std::vector<std::vector<int>> cells;
+    std::vector<int> bigBlocks;
+
+    // the key groups: group 0 holds the blocks outside of tables, group
+    // t + 1 the entries of table t; liveGroups are the groups which still
+    // have unvisited blocks
+    int primaryRot;
+    bool primaryLR;
+    std::vector<KeyGroup> groups;
+    std::vector<int> liveGroups, liveGroupPos;
+    std::vector<int> tablePos, rule1Pos, rule2Pos;
+
+    // all blocks, sorted by rule1Key
+    std::vector<double> rule1Keys;
+    std::vector<int> rule1Blks;
+};
+
+TextBlockIndex::TextBlockIndex(TextBlock *blkList, int nBlocksA)
+{
+    blocks.reserve(nBlocksA);
+    for (TextBlock *blk = blkList; blk; blk = blk->next) {
+        blocks.push_back(blk);
+    }
+    visited.resize(blocks.size(), false);
+    primaryRot = 0;
+    primaryLR = true;
+
+    double xMax, yMax;
+    gridXMin = gridYMin = DBL_MAX;
+    xMax = yMax = -DBL_MAX;
+    for (const TextBlock *blk : blocks) {
+        gridXMin = std::min(gridXMin, blk->xMin);
+        gridYMin = std::min(gridYMin, blk->yMin);
+        xMax = std::max(xMax, blk->xMax);
+        yMax = std::max(yMax, blk->yMax);
+    }
+
+    // about one cell per block, with the cells roughly square
+    const double n = static_cast<double>(std::max<size_t>(blocks.size(), 1));
+    const double aspect = (xMax > gridXMin && yMax > gridYMin) ? (xMax - gridXMin) / (yMax - gridYMin) : 1;
+    nx = static_cast<int>(std::clamp(std::round(std::sqrt(n * aspect)), 1.0, static_cast<double>(maxGridSize)));
+    ny = static_cast<int>(std::clamp(std::round(n / nx), 1.0, static_cast<double>(maxGridSize)));
+    gridXScale = (xMax > gridXMin) ? nx / (xMax - gridXMin) : 0;
+    gridYScale = (yMax > gridYMin) ? ny / (yMax - gridYMin) : 0;
+    cells.resize(nx * ny);
+    for (int i = 0; i < static_cast<int>(blocks.size()); ++i) {
+        const TextBlock *blk = blocks[i];
+        const int cx0 = cellX(blk->xMin);
+        const int cy0 = cellY(blk->yMin);
+        const int cx1 = cellX(blk->xMax);
+        const int cy1 = cellY(blk->yMax);
+        if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > maxBlockCells) {
+            bigBlocks.push_back(i);
+            continue;
+        }
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                cells[cy * nx + cx].push_back(i);
+            }
+        }
+    }
+}
+
+int TextBlockIndex::cellX(double x) const
+{
+    const double t = (x - gridXMin) * gridXScale;
+    if (!(t > 0)) {
+        return 0;
+    }
+    return t < nx ? static_cast<int>(t) : nx - 1;
+}
+
+int TextBlockIndex::cellY(double y) const
+{
+    const double t = (y - gridYMin) * gridYScale;
+    if (!(t > 0)) {
+        return 0;
+    }
+    return t < ny ? static_cast<int>(t) : ny - 1;
+}
+
+void TextBlockIndex::getFirstBelowRight(std::vector<int> &result) const
+{
+    const int n = static_cast<int>(blocks.size());
+    std::vector<int> points, queries;
+    std::vector<double> ys;
+
+    // sweep the blocks from right to left, adding each block's top left
+    // corner to a Fenwick tree over yMin (in decreasing order), which
+    // keeps the lowest block index; NaN coordinates never match
+    result.assign(n, -1);
+    for (int i = 0; i < n; ++i) {
+        const TextBlock *blk = blocks[i];
+        if (blk->xMin < DBL_MAX && blk->yMin < DBL_MAX) {
+            points.push_back(i);
+            ys.push_back(blk->yMin);
+        }
+        if (!std::isnan(blk->xMax) && !std::isnan(blk->yMax)) {
+            queries.push_back(i);
+        }
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    std::sort(points.begin(), points.end(), [this](int a, int b) { return blocks[a]->xMin > blocks[b]->xMin; });
+    std::sort(queries.begin(), queries.end(), [this](int a, int b) { return blocks[a]->xMax > blocks[b]->xMax; });
+
+    const int m = static_cast<int>(ys.size());
+    std::vector<int> tree(m + 1, INT_MAX);
+    size_t p = 0;
+    for (int q : queries) {
+        const TextBlock *blk = blocks[q];
+        for (; p < points.size() && blocks[points[p]]->xMin > blk->xMax; ++p) {
+            for (int r = m - static_cast<int>(std::lower_bound(ys.begin(), ys.end(), blocks[points[p]]->yMin) - ys.begin()); r <= m; r += r & -r) {
+                tree[r] = std::min(tree[r], points[p]);
+            }
+        }
+        int best = INT_MAX;
+        for (int r = m - static_cast<int>(std::upper_bound(ys.begin(), ys.end(), blk->yMax) - ys.begin()); r > 0; r -= r & -r) {
+            best = std::min(best, tree[r]);
+        }
+        if (best != INT_MAX) {
+            result[q] = best;
+        }
+    }
+}
+
+void TextBlockIndex::KeyList::init(std::vector<std::pair<double, int>> &entries, std::vector<int> &pos)
+{
+    std::sort(entries.begin(), entries.end());
+    keys.resize(entries.size());
+    blks.resize(entries.size());
+    skip.resize(entries.size() + 1);
+    for (size_t p = 0; p < entries.size(); ++p) {
+        keys[p] = entries[p].first;
+        blks[p] = entries[p].second;
+        pos[entries[p].second] = static_cast<int>(p);
+    }
+    for (size_t p = 0; p <= entries.size(); ++p) {
+        skip[p] = static_cast<int>(p);
+    }
+}
+
+int TextBlockIndex::KeyList::firstUnvisited(int p)
+{
+    int q = p;
+    while (skip[q] != q) {
+        q = skip[q];
+    }
+    // compress the path
+    while (skip[p] != q) {
+        const int next = skip[p];
+        skip[p] = q;
+        p = next;
+    }
+    return q;
+}
+
+void TextBlockIndex::KeyList::getPrefix(double maxKey, std::vector<int> &result)
+{
+    for (int p = firstUnvisited(0); p < static_cast<int>(keys.size()) && keys[p] <= maxKey; p = firstUnvisited(p + 1)) {
+        result.push_back(blks[p]);
+    }
+}
+
+double TextBlockIndex::rule1Key(const TextBlock *blk) const
+{
+    double key = 0;
+
+    // isBeforeByRule1(blk1) implies rule1Key(this) < rule1Key(blk1)
+    switch (primaryRot) {
+    case 0:
+        key = blk->EyMin;
+        break;
+    case 1:
+        key = -blk->ExMax;
+        break;
+    case 2:
+        key = -blk->EyMax;
+        break;
+    case 3:
+        key = blk->ExMin;
+        break;
+    }
+    return std::isnan(key) ? -HUGE_VAL : key;
+}
+
+void TextBlockIndex::initReadingOrder(int primaryRotA, bool primaryLRA)
+{
+    const int n = static_cast<int>(blocks.size());
+    int nGroups;
+
+    primaryRot = primaryRotA;
+    primaryLR = primaryLRA;
+
+    nGroups = 1;
+    for (const TextBlock *blk : blocks) {
+        nGroups = std::max(nGroups, blk->tableId + 2);
+    }
+    std::vector<std::vector<std::pair<double, int>>> tableEntries(nGroups), rule1Entries(nGroups);
+    std::vector<std::array<std::vector<std::pair<double, int>>, 4>> rule2Entries(nGroups);
+    std::vector<std::pair<double, int>> allRule1Entries;
+
+    for (int i = 0; i < n; ++i) {
+        const TextBlock *blk = blocks[i];
+        const int g = blk->tableId + 1;
+        double key;
+
+        if (blk->tableId >= 0) {
+            key = blk->yMin;
+            tableEntries[g].emplace_back(std::isnan(key) ? -HUGE_VAL : key, i);
+        }
+        rule1Entries[g].emplace_back(rule1Key(blk), i);
+        allRule1Entries.emplace_back(rule1Key(blk), i);
+
+        // isBeforeByRule2(blk1) implies that key <= the matching
+        // coordinate of blk1, see getBeforeCandidates
+        const int rotLR = getRotLR(blk);
+        switch (rotLR) {
+        case 0:
+            key = blk->ExMax;
+            break;
+        case 1:
+            key = blk->EyMin;
+            break;
+        case 2:
+            key = -blk->ExMin;
+            break;
+        case 3:
+        default:
+            key = -blk->EyMax;
+            break;
+        }
+        rule2Entries[g][rotLR].emplace_back(std::isnan(key) ? -HUGE_VAL : key, i);
+    }
+
+    tablePos.assign(n, -1);
+    rule1Pos.assign(n, -1);
+    rule2Pos.assign(n, -1);
+    groups.clear();
+    groups.resize(nGroups);
+    liveGroups.clear();
+    liveGroupPos.assign(nGroups, -1);
+    for (int g = 0; g < nGroups; ++g) {
+        KeyGroup &group = groups[g];
+        group.nUnvisited = static_cast<int>(rule1Entries[g].size());
+        group.tableList.init(tableEntries[g], tablePos);
+        group.rule1List.init(rule1Entries[g], rule1Pos);
+        for (int rotLR = 0; rotLR < 4; ++rotLR) {
+            group.rule2Lists[rotLR].init(rule2Entries[g][rotLR], rule2Pos);
+        }
+        if (group.nUnvisited > 0) {
+            liveGroupPos[g] = static_cast<int>(liveGroups.size());
+            liveGroups.push_back(g);
+        }
+    }
+
+    std::sort(allRule1Entries.begin(), allRule1Entries.end());
+    rule1Keys.resize(n);
+    rule1Blks.resize(n);
+    for (int p = 0; p < n; ++p) {
+        rule1Keys[p] = allRule1Entries[p].first;
+        rule1Blks[p] = allRule1Entries[p].second;
+    }
+}
+
+void TextBlockIndex::setVisited(int i)
+{
+    const int g = blocks[i]->tableId + 1;
+    KeyGroup &group = groups[g];
+
+    visited[i] = true;
+    if (tablePos[i] >= 0) {
+        group.tableList.skip[tablePos[i]] = tablePos[i] + 1;
+    }
+    group.rule1List.skip[rule1Pos[i]] = rule1Pos[i] + 1;
+    group.rule2Lists[getRotLR(blocks[i])].skip[rule2Pos[i]] = rule2Pos[i] + 1;
+
+    if (--group.nUnvisited == 0) {
+        const int last = liveGroups.back();
+        liveGroups[liveGroupPos[g]] = last;
+        liveGroupPos[last] = liveGroupPos[g];
+        liveGroups.pop_back();
+        liveGroupPos[g] = -1;
+    }
+}
+
+void TextBlockIndex::getBeforeCandidates(int i, std::vector<int> &result)
+{
+    const TextBlock *blk1 = blocks[i];
+    const int g1 = blk1->tableId + 1;
+
+    result.clear();
+
+    // table entries before blk1 are left of it on the same row, or above it
+    if (blk1->tableId >= 0) {
+        groups[g1].tableList.getPrefix(blk1->yMax, result);
+    }
+
+    for (int g : liveGroups) {
+        if (g == g1 && g1 > 0) {
+            continue;
+        }
+        KeyGroup &group = groups[g];
+
+        // blocks before blk1 by rule 1
+        group.rule1List.getPrefix(rule1Key(blk1), result);
+
+        // blocks before blk1 by rule 2
+        group.rule2Lists[0].getPrefix(blk1->ExMin, result);
+        group.rule2Lists[1].getPrefix(blk1->EyMax, result);
+        group.rule2Lists[2].getPrefix(-blk1->ExMax, result);
+        group.rule2Lists[3].getPrefix(-blk1->EyMin, result);
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+bool TextBlockIndex::isRule1Between(const TextBlock *blk1, const TextBlock *blk2) const
+{
+    const double key2 = rule1Key(blk2);
+    auto it = std::upper_bound(rule1Keys.begin(), rule1Keys.end(), rule1Key(blk1));
+    for (size_t p = it - rule1Keys.begin(); p < rule1Keys.size() && rule1Keys[p] < key2; ++p) {
+        TextBlock *blk3 = blocks[rule1Blks[p]];
+        if (blk3 == blk2 || blk3 == blk1) {
+            continue;
+        }
+        if (blk1->isBeforeByRule1(blk3) && blk3->isBeforeByRule1(blk2)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Sort into reading order by performing a topological sort using the rules
 // given in "High Performance Document Layout Analysis", T.M. Breuel, 2003.
 // See http://pubs.iupr.org/#2003-breuel-sdiut
 // Topological sort is done by depth first search, see
 // http://en.wikipedia.org/wiki/Topological_sorting
-int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted, int sortPos, bool *visited, TextBlock **cache, int cacheSize)
+int TextBlock::visitDepthFirst(TextBlockIndex *index, int pos1, TextBlock **sorted, int sortPos)
 {
-    int pos2;
-    TextBlock *blk1, *blk2, *blk3;
+    TextBlock *blk1, *blk2;
     bool before;
 
-    if (visited[pos1]) {
+    if (index->isVisited(pos1)) {
         return sortPos;
     }
 
@@ -2206,14 +2679,15 @@ int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted,
   printf("visited: %d %.2f..%.2f %.2f..%.2f\n",
 	 sortPos, blk1->ExMin, blk1->ExMax, blk1->EyMin, blk1->EyMax);
 #endif
-    visited[pos1] = true;
-    pos2 = -1;
-    for (blk2 = blkList; blk2; blk2 = blk2->next) {
-        pos2++;
-        if (visited[pos2]) {
-            // skip visited nodes
+    index->setVisited(pos1);
+    std::vector<int> candidates;
+    index->getBeforeCandidates(pos1, candidates);
+    for (int pos2 : candidates) {
+        if (index->isVisited(pos2)) {
+            // skip nodes visited while handling the previous candidates
             continue;
         }
+        blk2 = index->getBlock(pos2);
         before = false;
 
         // is blk2 before blk1? (for table entries)
@@ -2244,28 +2718,7 @@ int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted,
                 // Rule (2) blk2 left of blk1, and no intervening blk3
                 //          such that blk1 is before blk3 by rule 1,
                 //          and blk3 is before blk2 by rule 1.
-                before = true;
-                for (int i = 0; i < cacheSize && cache[i]; ++i) {
-                    if (blk1->isBeforeByRule1(cache[i]) && cache[i]->isBeforeByRule1(blk2)) {
-                        before = false;
-                        std::rotate(cache, cache + i, cache + i + 1);
-                        break;
-                    }
-                }
-
-                if (before) {
-                    for (blk3 = blkList; blk3; blk3 = blk3->next) {
-                        if (blk3 == blk2 || blk3 == blk1) {
-                            continue;
-                        }
-                        if (blk1->isBeforeByRule1(blk3) && blk3->isBeforeByRule1(blk2)) {
-                            before = false;
-                            std::copy_backward(cache, cache + cacheSize - 1, cache + cacheSize);
-                            cache[0] = blk3;
-                            break;
-                        }
-                    }
-                }
+                before = !index->isRule1Between(blk1, blk2);
 #if 0 // for debugging
         if (before) {
 	  printf("rule2: %.2f..%.2f %.2f..%.2f %.2f..%.2f %.2f..%.2f\n",
@@ -2278,7 +2731,7 @@ int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted,
         if (before) {
             // blk2 is before blk1, so it needs to be visited
             // before we can add blk1 to the sorted list.
-            sortPos = blk2->visitDepthFirst(blkList, pos2, sorted, sortPos, visited, cache, cacheSize);
+            sortPos = blk2->visitDepthFirst(index, pos2, sorted, sortPos);
         }
     }
 #if 0 // for debugging
@@ -2289,14 +2742,6 @@ int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted,
     return sortPos;
 }
 
-int TextBlock::visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted, int sortPos, bool *visited)
-{
-    const int blockCacheSize = 4;
-    TextBlock *blockCache[blockCacheSize];
-    std::fill(blockCache, blockCache + blockCacheSize, nullptr);
-    return visitDepthFirst(blkList, pos1, sorted, sortPos, visited, blockCache, blockCacheSize);
-}
-
 //------------------------------------------------------------------------
 // TextFlow
 //------------------------------------------------------------------------
@@ -2430,6 +2875,235 @@ TextWordList::TextWordList(const TextPage *text, bool physLayout)
 
 TextWordList::~TextWordList() = default;
 
+//------------------------------------------------------------------------
+// TextRectIndex
+//------------------------------------------------------------------------
+
+// A uniform grid over a list of rectangles, used to find the rectangle
+// nearest to a point and the rectangles containing a point without
+// looking at all of them.  Rectangles are identified by their position
+// in the list; of several rectangles at the same distance, the first one
+// is returned, as a linear scan would do.
+class TextRectIndex
+{
+public:
+    explicit TextRectIndex(std::vector<PDFRectangle> &&rectsA);
+
+    // Return the index of the rectangle nearest to (<x>,<y>), using the
+    // manhattan distance, or -1 if there are no rectangles.
+    int findNearest(double x, double y) const;
+
+    // Return the index of the first rectangle containing (<x>,<y>), or -1.
+    int findContaining(double x, double y) const;
+
+private:
+    // max number of grid cells along each axis
+    static constexpr int maxGridSize = 1024;
+    // rectangles covering more cells than this are kept apart and
+    // always checked
+    static constexpr int maxRectCells = 16;
+
+    static double distance(const PDFRectangle &r, double x, double y) { return fmax(r.x1 - x, 0.0) + fmax(x - r.x2, 0.0) + fmax(r.y1 - y, 0.0) + fmax(y - r.y2, 0.0); }
+
+    int cellX(double x) const;
+    int cellY(double y) const;
+
+    std::vector<PDFRectangle> rects;
+    double x0, y0, cellW, cellH, slack;
+    int nx, ny;
+    std::vector<int> cellStart; // the rectangles of cell c are
+    std::vector<int> cellRects; //   cellRects[cellStart[c] .. cellStart[c+1]-1]
+    std::vector<int> bigRects;
+};
+
+TextRectIndex::TextRectIndex(std::vector<PDFRectangle> &&rectsA) : rects(std::move(rectsA))
+{
+    double x1, y1;
+
+    x0 = y0 = x1 = y1 = 0;
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const PDFRectangle &r = rects[i];
+        if (i == 0) {
+            x0 = r.x1;
+            y0 = r.y1;
+            x1 = r.x2;
+            y1 = r.y2;
+        } else {
+            x0 = fmin(x0, r.x1);
+            y0 = fmin(y0, r.y1);
+            x1 = fmax(x1, r.x2);
+            y1 = fmax(y1, r.y2);
+        }
+    }
+
+    // about one rectangle per cell, with roughly square cells
+    const double w = fmax(x1 - x0, 1), h = fmax(y1 - y0, 1);
+    const double nCells = std::max<double>(static_cast<double>(rects.size()), 1);
+    nx = std::clamp(static_cast<int>(ceil(sqrt(nCells * w / h))), 1, maxGridSize);
+    ny = std::clamp(static_cast<int>(ceil(nCells / nx)), 1, maxGridSize);
+    cellW = w / nx;
+    cellH = h / ny;
+    // cell boundaries and rectangle coordinates are rounded differently
+    slack = 1e-9 * (w + h);
+
+    std::vector<int> count(nx * ny + 1, 0);
+    const auto forEachCell = [this](const PDFRectangle &r, auto f) {
+        const int cx0 = cellX(r.x1), cx1 = cellX(r.x2), cy0 = cellY(r.y1), cy1 = cellY(r.y2);
+        if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > maxRectCells) {
+            return false;
+        }
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                f(cy * nx + cx);
+            }
+        }
+        return true;
+    };
+    for (const PDFRectangle &r : rects) {
+        forEachCell(r, [&count](int c) { ++count[c + 1]; });
+    }
+    for (int c = 0; c < nx * ny; ++c) {
+        count[c + 1] += count[c];
+    }
+    cellStart = count;
+    cellRects.resize(count[nx * ny]);
+    for (int i = 0; i < static_cast<int>(rects.size()); ++i) {
+        if (!forEachCell(rects[i], [this, &count, i](int c) { cellRects[count[c]++] = i; })) {
+            bigRects.push_back(i);
+        }
+    }
+}
+
+int TextRectIndex::cellX(double x) const
+{
+    const double c = floor((x - x0) / cellW);
+    return c >= nx ? nx - 1 : c >= 0 ? static_cast<int>(c) : 0;
+}
+
+int TextRectIndex::cellY(double y) const
+{
+    const double c = floor((y - y0) / cellH);
+    return c >= ny ? ny - 1 : c >= 0 ? static_cast<int>(c) : 0;
+}
+
+int TextRectIndex::findNearest(double x, double y) const
+{
+    int best = -1;
+    double bestD = 0;
+
+    const auto check = [&](int i) {
+        const double d = distance(rects[i], x, y);
+        if (best < 0 || d < bestD || (d == bestD && i < best)) {
+            best = i;
+            bestD = d;
+        }
+    };
+    const auto checkCell = [&](int cx, int cy) {
+        const int c = cy * nx + cx;
+        for (int k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+            check(cellRects[k]);
+        }
+    };
+
+    for (int i : bigRects) {
+        check(i);
+    }
+
+    // look at rings of cells of increasing radius around the point's
+    // cell, until the next ring is farther than the best rectangle
+    const int cx = cellX(x), cy = cellY(y);
+    for (int r = 0;; ++r) {
+        if (r > 0) {
+            double bound = DBL_MAX;
+            bool more = false;
+            if (cx - r >= 0) {
+                bound = fmin(bound, x - (x0 + (cx - r + 1) * cellW));
+                more = true;
+            }
+            if (cx + r < nx) {
+                bound = fmin(bound, x0 + (cx + r) * cellW - x);
+                more = true;
+            }
+            if (cy - r >= 0) {
+                bound = fmin(bound, y - (y0 + (cy - r + 1) * cellH));
+                more = true;
+            }
+            if (cy + r < ny) {
+                bound = fmin(bound, y0 + (cy + r) * cellH - y);
+                more = true;
+            }
+            if (!more || (best >= 0 && bound > bestD + slack)) {
+                break;
+            }
+        }
+        for (int j = std::max(cy - r, 0); j <= std::min(cy + r, ny - 1); ++j) {
+            if (j == cy - r || j == cy + r) {
+                for (int i = std::max(cx - r, 0); i <= std::min(cx + r, nx - 1); ++i) {
+                    checkCell(i, j);
+                }
+            } else {
+                if (cx - r >= 0) {
+                    checkCell(cx - r, j);
+                }
+                if (cx + r < nx) {
+                    checkCell(cx + r, j);
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+int TextRectIndex::findContaining(double x, double y) const
+{
+    int best = -1;
+
+    const auto check = [&](int i) {
+        const PDFRectangle &r = rects[i];
+        if ((best < 0 || i < best) && r.x1 <= x && x <= r.x2 && r.y1 <= y && y <= r.y2) {
+            best = i;
+        }
+    };
+
+    for (int i : bigRects) {
+        check(i);
+    }
+    const int c = cellY(y) * nx + cellX(x);
+    for (int k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+        check(cellRects[k]);
+    }
+    return best;
+}
+
+//------------------------------------------------------------------------
+// TextSelectionIndex
+//------------------------------------------------------------------------
+
+// The lines of a block, for blocks with many lines.
+struct TextLineIndex
+{
+    std::vector<TextLine *> lines;
+    std::unique_ptr<TextRectIndex> index;
+};
+
+// Spatial indexes of the blocks, lines and words of a TextPage, used by
+// the selection and hit testing functions.  Built when first needed
+// after the page has been coalesced.
+struct TextSelectionIndex
+{
+    std::vector<TextBlock *> blocks; // all blocks, in reading order
+    std::vector<TextFlow *> blockFlows; // the flow of each block
+    std::unique_ptr<TextRectIndex> blockIndex;
+    double xMin, yMin, xMax, yMax; // corners of the text, see visitSelection
+    bool lastBlockIsLast; // the last block is the last one of the last flow
+
+    std::unordered_map<const TextBlock *, TextLineIndex> lineIndexes;
+
+    std::vector<TextWord *> words; // all words, in reading order
+    std::unique_ptr<TextRectIndex> wordIndex;
+};
+
 //------------------------------------------------------------------------
 // TextPage
 //------------------------------------------------------------------------
@@ -2520,6 +3194,7 @@ void TextPage::clear()
     fonts.clear();
     underlines.clear();
     links.clear();
+    selectionIndex.reset();
 
     diagonal = false;
     curWord = nullptr;
@@ -2639,7 +3314,7 @@ void TextPage::beginWord(const GfxState *state)
         rot = (rot + 1) & 3;
     }
 
-    curWord = new TextWord(state, rot, curFontSize);
+    curWord = new TextWord(state, rot, curFontSize, keepGlyphs);
 }
 
 void TextPage::addChar(const GfxState *state, double x, double y, double dx, double dy, CharCode c, int nBytes, const Unicode *u, int uLen)
@@ -2647,7 +3322,7 @@ void TextPage::addChar(const GfxState *state, double x, double y, double dx, dou
     double x1, y1, w1, h1, dx2, dy2, base, sp, delta;
     bool overlap;
     int i;
-    Matrix mat;
+    Matrix mat {};
 
     // subtract char and word spacing from the dx,dy values
     sp = state->getCharSpace();
@@ -2687,11 +3362,13 @@ void TextPage::addChar(const GfxState *state, double x, double y, double dx, dou
         return;
     }
 
-    state->getFontTransMat(mat.m.data(), &mat.m[1], &mat.m[2], &mat.m[3]);
-    mat.m[0] *= state->getHorizScaling();
-    mat.m[1] *= state->getHorizScaling();
-    mat.m[4] = x1;
-    mat.m[5] = y1;
+    if (keepGlyphs) {
+        state->getFontTransMat(mat.m.data(), &mat.m[1], &mat.m[2], &mat.m[3]);
+        mat.m[0] *= state->getHorizScaling();
+        mat.m[1] *= state->getHorizScaling();
+        mat.m[4] = x1;
+        mat.m[5] = y1;
+    }
 
     if (mergeCombining && curWord && uLen == 1 && curWord->addCombining(curFont, curFontSize, x1, y1, w1, h1, charPos, nBytes, c, u[0], mat)) {
         charPos += nBytes;
@@ -2835,25 +3512,285 @@ void TextPage::addLink(int xMin, int yMin, int xMax, int yMax, AnnotLink *link)
     links.emplace_back(std::make_unique<TextLink>(xMin, yMin, xMax, yMax, link));
 }
 
-void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML)
+TextBlock *TextPage::buildBlocks(int rot, double minColSpacing1, const UnicodeMap *uMap, double fixedPitch, TextBlock **lastBlk, int *nBlks, int *charCount)
 {
-    coalesce(physLayout, fixedPitch, doHTML, TextOutputDev::minColSpacing1_default);
+    TextWord *word0, *word1, *word2;
+    TextBlock *blk;
+    int baseIdx, startBaseIdx, n;
+    double minBase, maxBase, newMinBase, newMaxBase;
+    double fontSize, colSpace1, colSpace2, lineSpace, intraLineSpace;
+    bool found;
+
+    std::unique_ptr<TextPool> &pool = pools[rot];
+    int poolMinBaseIdx = pool->minBaseIdx;
+    TextBlock *blkList = nullptr;
+
+    *lastBlk = nullptr;
+    *nBlks = 0;
+    *charCount = 0;
+
+    // add blocks until no more words are left
+    while (true) {
+
+        // find the first non-empty line in the pool
+        for (; poolMinBaseIdx <= pool->maxBaseIdx && !pool->getPool(poolMinBaseIdx); ++poolMinBaseIdx) {
+            ;
+        }
+        if (poolMinBaseIdx > pool->maxBaseIdx) {
+            break;
+        }
+
+        // look for the left-most word in the first four lines of the
+        // pool -- this avoids starting with a superscript word
+        startBaseIdx = poolMinBaseIdx;
+        for (baseIdx = poolMinBaseIdx + 1; baseIdx < poolMinBaseIdx + 4 && baseIdx <= pool->maxBaseIdx; ++baseIdx) {
+            if (!pool->getPool(baseIdx)) {
+                continue;
+            }
+            if (pool->getPool(baseIdx)->primaryCmp(pool->getPool(startBaseIdx)) < 0) {
+                startBaseIdx = baseIdx;
+            }
+        }
+
+        // create a new block
+        word0 = pool->getPool(startBaseIdx);
+        pool->setPool(startBaseIdx, word0->next);
+        word0->next = nullptr;
+        blk = new TextBlock(this, rot);
+        blk->addWord(word0);
+
+        fontSize = word0->fontSize;
+        minBase = maxBase = word0->base;
+        colSpace1 = minColSpacing1 * fontSize;
+        colSpace2 = minColSpacing2 * fontSize;
+        lineSpace = maxLineSpacingDelta * fontSize;
+        intraLineSpace = maxIntraLineDelta * fontSize;
+
+        // add words to the block
+        do {
+            found = false;
+
+            // look for words on the line above the current top edge of
+            // the block
+            newMinBase = minBase;
+            for (baseIdx = pool->getBaseIdx(minBase); baseIdx >= pool->getBaseIdx(minBase - lineSpace); --baseIdx) {
+                word0 = nullptr;
+                word1 = pool->getPool(baseIdx);
+                while (word1) {
+                    if (word1->base < minBase && word1->base >= minBase - lineSpace && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax && word1->xMax > blk->xMin) : (word1->yMin < blk->yMax && word1->yMax > blk->yMin))
+                        && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta1 * fontSize) {
+                        word2 = word1;
+                        if (word0) {
+                            word0->next = word1->next;
+                        } else {
+                            pool->setPool(baseIdx, word1->next);
+                        }
+                        word1 = word1->next;
+                        word2->next = nullptr;
+                        blk->addWord(word2);
+                        found = true;
+                        newMinBase = word2->base;
+                    } else {
+                        word0 = word1;
+                        word1 = word1->next;
+                    }
+                }
+            }
+            minBase = newMinBase;
+
+            // look for words on the line below the current bottom edge of
+            // the block
+            newMaxBase = maxBase;
+            for (baseIdx = pool->getBaseIdx(maxBase); baseIdx <= pool->getBaseIdx(maxBase + lineSpace); ++baseIdx) {
+                word0 = nullptr;
+                word1 = pool->getPool(baseIdx);
+                while (word1) {
+                    if (word1->base > maxBase && word1->base <= maxBase + lineSpace && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax && word1->xMax > blk->xMin) : (word1->yMin < blk->yMax && word1->yMax > blk->yMin))
+                        && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta1 * fontSize) {
+                        word2 = word1;
+                        if (word0) {
+                            word0->next = word1->next;
+                        } else {
+                            pool->setPool(baseIdx, word1->next);
+                        }
+                        word1 = word1->next;
+                        word2->next = nullptr;
+                        blk->addWord(word2);
+                        found = true;
+                        newMaxBase = word2->base;
+                    } else {
+                        word0 = word1;
+                        word1 = word1->next;
+                    }
+                }
+            }
+            maxBase = newMaxBase;
+
+            // look for words that are on lines already in the block, and
+            // that overlap the block horizontally
+            for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
+                word0 = nullptr;
+                word1 = pool->getPool(baseIdx);
+                while (word1) {
+                    if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
+                        && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax + colSpace1 && word1->xMax > blk->xMin - colSpace1) : (word1->yMin < blk->yMax + colSpace1 && word1->yMax > blk->yMin - colSpace1))
+                        && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta2 * fontSize) {
+                        word2 = word1;
+                        if (word0) {
+                            word0->next = word1->next;
+                        } else {
+                            pool->setPool(baseIdx, word1->next);
+                        }
+                        word1 = word1->next;
+                        word2->next = nullptr;
+                        blk->addWord(word2);
+                        found = true;
+                    } else {
+                        word0 = word1;
+                        word1 = word1->next;
+                    }
+                }
+            }
+
+            // only check for outlying words (the next two chunks of code)
+            // if we didn't find anything else
+            if (found) {
+                continue;
+            }
+
+            // scan down the left side of the block, looking for words
+            // that are near (but not overlapping) the block; if there are
+            // three or fewer, add them to the block
+            n = 0;
+            for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
+                word1 = pool->getPool(baseIdx);
+                while (word1) {
+                    if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
+                        && ((rot == 0 || rot == 2) ? (word1->xMax <= blk->xMin && word1->xMax > blk->xMin - colSpace2) : (word1->yMax <= blk->yMin && word1->yMax > blk->yMin - colSpace2))
+                        && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
+                        ++n;
+                        break;
+                    }
+                    word1 = word1->next;
+                }
+            }
+            if (n > 0 && n <= 3) {
+                for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
+                    word0 = nullptr;
+                    word1 = pool->getPool(baseIdx);
+                    while (word1) {
+                        if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
+                            && ((rot == 0 || rot == 2) ? (word1->xMax <= blk->xMin && word1->xMax > blk->xMin - colSpace2) : (word1->yMax <= blk->yMin && word1->yMax > blk->yMin - colSpace2))
+                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
+                            word2 = word1;
+                            if (word0) {
+                                word0->next = word1->next;
+                            } else {
+                                pool->setPool(baseIdx, word1->next);
+                            }
+                            word1 = word1->next;
+                            word2->next = nullptr;
+                            blk->addWord(word2);
+                            if (word2->base < minBase) {
+                                minBase = word2->base;
+                            } else if (word2->base > maxBase) {
+                                maxBase = word2->base;
+                            }
+                            found = true;
+                            break;
+                        }
+                        word0 = word1;
+                        word1 = word1->next;
+                    }
+                }
+            }
+
+            // scan down the right side of the block, looking for words
+            // that are near (but not overlapping) the block; if there are
+            // three or fewer, add them to the block
+            n = 0;
+            for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
+                word1 = pool->getPool(baseIdx);
+                while (word1) {
+                    if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
+                        && ((rot == 0 || rot == 2) ? (word1->xMin >= blk->xMax && word1->xMin < blk->xMax + colSpace2) : (word1->yMin >= blk->yMax && word1->yMin < blk->yMax + colSpace2))
+                        && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
+                        ++n;
+                        break;
+                    }
+                    word1 = word1->next;
+                }
+            }
+            if (n > 0 && n <= 3) {
+                for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
+                    word0 = nullptr;
+                    word1 = pool->getPool(baseIdx);
+                    while (word1) {
+                        if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
+                            && ((rot == 0 || rot == 2) ? (word1->xMin >= blk->xMax && word1->xMin < blk->xMax + colSpace2) : (word1->yMin >= blk->yMax && word1->yMin < blk->yMax + colSpace2))
+                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
+                            word2 = word1;
+                            if (word0) {
+                                word0->next = word1->next;
+                            } else {
+                                pool->setPool(baseIdx, word1->next);
+                            }
+                            word1 = word1->next;
+                            word2->next = nullptr;
+                            blk->addWord(word2);
+                            if (word2->base < minBase) {
+                                minBase = word2->base;
+                            } else if (word2->base > maxBase) {
+                                maxBase = word2->base;
+                            }
+                            found = true;
+                            break;
+                        }
+                        word0 = word1;
+                        word1 = word1->next;
+                    }
+                }
+            }
+
+        } while (found);
+
+        //~ need to compute the primary writing mode (horiz/vert) in
+        //~ addition to primary rotation
+
+        // coalesce the block, and add it to the list
+        blk->coalesce(uMap, fixedPitch);
+        if (*lastBlk) {
+            (*lastBlk)->next = blk;
+        } else {
+            blkList = blk;
+        }
+        *lastBlk = blk;
+        *charCount += blk->charCount;
+        ++*nBlks;
+    }
+
+    return blkList;
+}
+
+void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML)
+{
+    coalesce(physLayout, fixedPitch, doHTML, TextOutputDev::minColSpacing1_default);
 }
 
 void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double minColSpacing1)
 {
-    TextWord *word0, *word1, *word2;
+    TextWord *word0;
     TextLine *line;
     TextBlock *blkList, *blk, *lastBlk, *blk0, *blk1, *blk2;
     TextFlow *flow, *lastFlow;
-    int rot, poolMinBaseIdx, baseIdx, startBaseIdx, endBaseIdx;
-    double minBase, maxBase, newMinBase, newMaxBase;
-    double fontSize, colSpace1, colSpace2, lineSpace, intraLineSpace, blkSpace;
-    bool found;
+    int startBaseIdx, endBaseIdx;
+    double blkSpace;
     int count[4];
     int lrCount;
-    int col1, col2;
-    int j, n;
+    int col1;
+    int j;
+
+    selectionIndex.reset();
 
     if (rawOrder) {
         primaryRot = 0;
@@ -3027,252 +3964,41 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
 
     //~ add an outer loop for writing mode (vertical text)
 
-    // build blocks for each rotation value
-    for (rot = 0; rot < 4; ++rot) {
-        std::unique_ptr<TextPool> &pool = pools[rot];
-        poolMinBaseIdx = pool->minBaseIdx;
+    // build blocks for each rotation value; the pools don't share any
+    // words, so this is done in parallel
+    TextBlock *rotBlkList[4], *rotLastBlk[4];
+    int rotNBlocks[4];
+    std::vector<std::future<void>> rotTasks;
+    int lastRot = -1;
+    const auto buildRotBlocks = [&](int r) { rotBlkList[r] = buildBlocks(r, minColSpacing1, uMap, fixedPitch, &rotLastBlk[r], &rotNBlocks[r], &count[r]); };
+    for (int rot = 0; rot < 4; ++rot) {
+        rotBlkList[rot] = rotLastBlk[rot] = nullptr;
+        rotNBlocks[rot] = 0;
         count[rot] = 0;
-
-        // add blocks until no more words are left
-        while (true) {
-
-            // find the first non-empty line in the pool
-            for (; poolMinBaseIdx <= pool->maxBaseIdx && !pool->getPool(poolMinBaseIdx); ++poolMinBaseIdx) {
-                ;
+        if (pools[rot]->minBaseIdx <= pools[rot]->maxBaseIdx) {
+            if (lastRot >= 0) {
+                rotTasks.push_back(std::async(std::launch::async, buildRotBlocks, lastRot));
             }
-            if (poolMinBaseIdx > pool->maxBaseIdx) {
-                break;
-            }
-
-            // look for the left-most word in the first four lines of the
-            // pool -- this avoids starting with a superscript word
-            startBaseIdx = poolMinBaseIdx;
-            for (baseIdx = poolMinBaseIdx + 1; baseIdx < poolMinBaseIdx + 4 && baseIdx <= pool->maxBaseIdx; ++baseIdx) {
-                if (!pool->getPool(baseIdx)) {
-                    continue;
-                }
-                if (pool->getPool(baseIdx)->primaryCmp(pool->getPool(startBaseIdx)) < 0) {
-                    startBaseIdx = baseIdx;
-                }
-            }
-
-            // create a new block
-            word0 = pool->getPool(startBaseIdx);
-            pool->setPool(startBaseIdx, word0->next);
-            word0->next = nullptr;
-            blk = new TextBlock(this, rot);
-            blk->addWord(word0);
-
-            fontSize = word0->fontSize;
-            minBase = maxBase = word0->base;
-            colSpace1 = minColSpacing1 * fontSize;
-            colSpace2 = minColSpacing2 * fontSize;
-            lineSpace = maxLineSpacingDelta * fontSize;
-            intraLineSpace = maxIntraLineDelta * fontSize;
-
-            // add words to the block
-            do {
-                found = false;
-
-                // look for words on the line above the current top edge of
-                // the block
-                newMinBase = minBase;
-                for (baseIdx = pool->getBaseIdx(minBase); baseIdx >= pool->getBaseIdx(minBase - lineSpace); --baseIdx) {
-                    word0 = nullptr;
-                    word1 = pool->getPool(baseIdx);
-                    while (word1) {
-                        if (word1->base < minBase && word1->base >= minBase - lineSpace && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax && word1->xMax > blk->xMin) : (word1->yMin < blk->yMax && word1->yMax > blk->yMin))
-                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta1 * fontSize) {
-                            word2 = word1;
-                            if (word0) {
-                                word0->next = word1->next;
-                            } else {
-                                pool->setPool(baseIdx, word1->next);
-                            }
-                            word1 = word1->next;
-                            word2->next = nullptr;
-                            blk->addWord(word2);
-                            found = true;
-                            newMinBase = word2->base;
-                        } else {
-                            word0 = word1;
-                            word1 = word1->next;
-                        }
-                    }
-                }
-                minBase = newMinBase;
-
-                // look for words on the line below the current bottom edge of
-                // the block
-                newMaxBase = maxBase;
-                for (baseIdx = pool->getBaseIdx(maxBase); baseIdx <= pool->getBaseIdx(maxBase + lineSpace); ++baseIdx) {
-                    word0 = nullptr;
-                    word1 = pool->getPool(baseIdx);
-                    while (word1) {
-                        if (word1->base > maxBase && word1->base <= maxBase + lineSpace && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax && word1->xMax > blk->xMin) : (word1->yMin < blk->yMax && word1->yMax > blk->yMin))
-                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta1 * fontSize) {
-                            word2 = word1;
-                            if (word0) {
-                                word0->next = word1->next;
-                            } else {
-                                pool->setPool(baseIdx, word1->next);
-                            }
-                            word1 = word1->next;
-                            word2->next = nullptr;
-                            blk->addWord(word2);
-                            found = true;
-                            newMaxBase = word2->base;
-                        } else {
-                            word0 = word1;
-                            word1 = word1->next;
-                        }
-                    }
-                }
-                maxBase = newMaxBase;
-
-                // look for words that are on lines already in the block, and
-                // that overlap the block horizontally
-                for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
-                    word0 = nullptr;
-                    word1 = pool->getPool(baseIdx);
-                    while (word1) {
-                        if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
-                            && ((rot == 0 || rot == 2) ? (word1->xMin < blk->xMax + colSpace1 && word1->xMax > blk->xMin - colSpace1) : (word1->yMin < blk->yMax + colSpace1 && word1->yMax > blk->yMin - colSpace1))
-                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta2 * fontSize) {
-                            word2 = word1;
-                            if (word0) {
-                                word0->next = word1->next;
-                            } else {
-                                pool->setPool(baseIdx, word1->next);
-                            }
-                            word1 = word1->next;
-                            word2->next = nullptr;
-                            blk->addWord(word2);
-                            found = true;
-                        } else {
-                            word0 = word1;
-                            word1 = word1->next;
-                        }
-                    }
-                }
-
-                // only check for outlying words (the next two chunks of code)
-                // if we didn't find anything else
-                if (found) {
-                    continue;
-                }
-
-                // scan down the left side of the block, looking for words
-                // that are near (but not overlapping) the block; if there are
-                // three or fewer, add them to the block
-                n = 0;
-                for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
-                    word1 = pool->getPool(baseIdx);
-                    while (word1) {
-                        if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
-                            && ((rot == 0 || rot == 2) ? (word1->xMax <= blk->xMin && word1->xMax > blk->xMin - colSpace2) : (word1->yMax <= blk->yMin && word1->yMax > blk->yMin - colSpace2))
-                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
-                            ++n;
-                            break;
-                        }
-                        word1 = word1->next;
-                    }
-                }
-                if (n > 0 && n <= 3) {
-                    for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
-                        word0 = nullptr;
-                        word1 = pool->getPool(baseIdx);
-                        while (word1) {
-                            if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
-                                && ((rot == 0 || rot == 2) ? (word1->xMax <= blk->xMin && word1->xMax > blk->xMin - colSpace2) : (word1->yMax <= blk->yMin && word1->yMax > blk->yMin - colSpace2))
-                                && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
-                                word2 = word1;
-                                if (word0) {
-                                    word0->next = word1->next;
-                                } else {
-                                    pool->setPool(baseIdx, word1->next);
-                                }
-                                word1 = word1->next;
-                                word2->next = nullptr;
-                                blk->addWord(word2);
-                                if (word2->base < minBase) {
-                                    minBase = word2->base;
-                                } else if (word2->base > maxBase) {
-                                    maxBase = word2->base;
-                                }
-                                found = true;
-                                break;
-                            }
-                            word0 = word1;
-                            word1 = word1->next;
-                        }
-                    }
-                }
-
-                // scan down the right side of the block, looking for words
-                // that are near (but not overlapping) the block; if there are
-                // three or fewer, add them to the block
-                n = 0;
-                for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
-                    word1 = pool->getPool(baseIdx);
-                    while (word1) {
-                        if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
-                            && ((rot == 0 || rot == 2) ? (word1->xMin >= blk->xMax && word1->xMin < blk->xMax + colSpace2) : (word1->yMin >= blk->yMax && word1->yMin < blk->yMax + colSpace2))
-                            && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
-                            ++n;
-                            break;
-                        }
-                        word1 = word1->next;
-                    }
-                }
-                if (n > 0 && n <= 3) {
-                    for (baseIdx = pool->getBaseIdx(minBase - intraLineSpace); baseIdx <= pool->getBaseIdx(maxBase + intraLineSpace); ++baseIdx) {
-                        word0 = nullptr;
-                        word1 = pool->getPool(baseIdx);
-                        while (word1) {
-                            if (word1->base >= minBase - intraLineSpace && word1->base <= maxBase + intraLineSpace
-                                && ((rot == 0 || rot == 2) ? (word1->xMin >= blk->xMax && word1->xMin < blk->xMax + colSpace2) : (word1->yMin >= blk->yMax && word1->yMin < blk->yMax + colSpace2))
-                                && fabs(word1->fontSize - fontSize) < maxBlockFontSizeDelta3 * fontSize) {
-                                word2 = word1;
-                                if (word0) {
-                                    word0->next = word1->next;
-                                } else {
-                                    pool->setPool(baseIdx, word1->next);
-                                }
-                                word1 = word1->next;
-                                word2->next = nullptr;
-                                blk->addWord(word2);
-                                if (word2->base < minBase) {
-                                    minBase = word2->base;
-                                } else if (word2->base > maxBase) {
-                                    maxBase = word2->base;
-                                }
-                                found = true;
-                                break;
-                            }
-                            word0 = word1;
-                            word1 = word1->next;
-                        }
-                    }
-                }
-
-            } while (found);
-
-            //~ need to compute the primary writing mode (horiz/vert) in
-            //~ addition to primary rotation
+            lastRot = rot;
+        }
+    }
+    if (lastRot >= 0) {
+        buildRotBlocks(lastRot);
+    }
+    for (std::future<void> &task : rotTasks) {
+        task.get();
+    }
 
-            // coalesce the block, and add it to the list
-            blk->coalesce(uMap, fixedPitch);
+    for (int rot = 0; rot < 4; ++rot) {
+        if (rotBlkList[rot]) {
             if (lastBlk) {
-                lastBlk->next = blk;
+                lastBlk->next = rotBlkList[rot];
             } else {
-                blkList = blk;
+                blkList = rotBlkList[rot];
             }
-            lastBlk = blk;
-            count[rot] += blk->charCount;
-            ++nBlocks;
+            lastBlk = rotLastBlk[rot];
+            nBlocks += rotNBlocks[rot];
         }
-
         if (count[rot] > count[primaryRot]) {
             primaryRot = rot;
         }
@@ -3377,61 +4103,102 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
         }
         std::sort(blocks, blocks + nBlocks, &TextBlock::cmpXYPrimaryRot);
 
-        // column assignment
+        // column assignment: sweep the blocks in xy order; the blocks which
+        // end before the current one starts are folded into leftCol, so
+        // only the ones overlapping it (the active ones) are compared
+        const auto startOf = [this](const TextBlock *b) {
+            switch (primaryRot) {
+            case 0:
+                return b->xMin;
+            case 1:
+                return b->yMin;
+            case 2:
+                return -b->xMax;
+            case 3:
+            default:
+                return -b->yMax;
+            }
+        };
+        const auto endOf = [this](const TextBlock *b) {
+            switch (primaryRot) {
+            case 0:
+                return b->xMax;
+            case 1:
+                return b->yMax;
+            case 2:
+                return -b->xMin;
+            case 3:
+            default:
+                return -b->yMin;
+            }
+        };
+        const auto overlapCol = [this](const TextBlock *b0, const TextBlock *b1) {
+            int col = 0; // make gcc happy
+            switch (primaryRot) {
+            case 0:
+                if (b0->xMin > b1->xMax) {
+                    col = b1->col + b1->nColumns + 3;
+                } else if (b1->xMax == b1->xMin) {
+                    col = b1->col;
+                } else {
+                    col = b1->col + static_cast<int>(((b0->xMin - b1->xMin) / (b1->xMax - b1->xMin)) * b1->nColumns);
+                }
+                break;
+            case 1:
+                if (b0->yMin > b1->yMax) {
+                    col = b1->col + b1->nColumns + 3;
+                } else if (b1->yMax == b1->yMin) {
+                    col = b1->col;
+                } else {
+                    col = b1->col + static_cast<int>(((b0->yMin - b1->yMin) / (b1->yMax - b1->yMin)) * b1->nColumns);
+                }
+                break;
+            case 2:
+                if (b0->xMax < b1->xMin) {
+                    col = b1->col + b1->nColumns + 3;
+                } else if (b1->xMin == b1->xMax) {
+                    col = b1->col;
+                } else {
+                    col = b1->col + static_cast<int>(((b0->xMax - b1->xMax) / (b1->xMin - b1->xMax)) * b1->nColumns);
+                }
+                break;
+            case 3:
+                if (b0->yMax < b1->yMin) {
+                    col = b1->col + b1->nColumns + 3;
+                } else if (b1->yMin == b1->yMax) {
+                    col = b1->col;
+                } else {
+                    col = b1->col + static_cast<int>(((b0->yMax - b1->yMax) / (b1->yMin - b1->yMax)) * b1->nColumns);
+                }
+                break;
+            }
+            return col;
+        };
+        std::vector<int> active;
+        int leftCol = 0;
         for (i = 0; i < nBlocks; ++i) {
             blk0 = blocks[i];
-            col1 = 0;
-            for (j = 0; j < i; ++j) {
-                blk1 = blocks[j];
-                col2 = 0; // make gcc happy
-                switch (primaryRot) {
-                case 0:
-                    if (blk0->xMin > blk1->xMax) {
-                        col2 = blk1->col + blk1->nColumns + 3;
-                    } else if (blk1->xMax == blk1->xMin) {
-                        col2 = blk1->col;
-                    } else {
-                        col2 = blk1->col + static_cast<int>(((blk0->xMin - blk1->xMin) / (blk1->xMax - blk1->xMin)) * blk1->nColumns);
-                    }
-                    break;
-                case 1:
-                    if (blk0->yMin > blk1->yMax) {
-                        col2 = blk1->col + blk1->nColumns + 3;
-                    } else if (blk1->yMax == blk1->yMin) {
-                        col2 = blk1->col;
-                    } else {
-                        col2 = blk1->col + static_cast<int>(((blk0->yMin - blk1->yMin) / (blk1->yMax - blk1->yMin)) * blk1->nColumns);
-                    }
-                    break;
-                case 2:
-                    if (blk0->xMax < blk1->xMin) {
-                        col2 = blk1->col + blk1->nColumns + 3;
-                    } else if (blk1->xMin == blk1->xMax) {
-                        col2 = blk1->col;
-                    } else {
-                        col2 = blk1->col + static_cast<int>(((blk0->xMax - blk1->xMax) / (blk1->xMin - blk1->xMax)) * blk1->nColumns);
-                    }
-                    break;
-                case 3:
-                    if (blk0->yMax < blk1->yMin) {
-                        col2 = blk1->col + blk1->nColumns + 3;
-                    } else if (blk1->yMin == blk1->yMax) {
-                        col2 = blk1->col;
-                    } else {
-                        col2 = blk1->col + static_cast<int>(((blk0->yMax - blk1->yMax) / (blk1->yMin - blk1->yMax)) * blk1->nColumns);
-                    }
-                    break;
-                }
-                if (col2 > col1) {
-                    col1 = col2;
+            const double start0 = startOf(blk0);
+            col1 = leftCol;
+            for (size_t k = 0; k < active.size();) {
+                blk1 = blocks[active[k]];
+                if (endOf(blk1) < start0) {
+                    leftCol = std::max(leftCol, blk1->col + blk1->nColumns + 3);
+                    active[k] = active.back();
+                    active.pop_back();
+                } else {
+                    col1 = std::max(col1, overlapCol(blk0, blk1));
+                    ++k;
                 }
             }
+            col1 = std::max(col1, leftCol);
             blk0->col = col1;
             for (line = blk0->lines; line; line = line->next) {
                 for (j = 0; j <= line->len; ++j) {
                     line->col[j] += col1;
                 }
             }
+            active.push_back(i);
         }
     }
 
@@ -3459,14 +4226,22 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
 
     //----- reading order sort
 
-    // compute space on left and right sides of each block
+    TextBlockIndex index(blkList, nBlocks);
+
+    // compute space on left and right sides of each block; only the
+    // blocks overlapping it along the secondary axis matter
     for (int i = 0; i < nBlocks; ++i) {
         blk0 = blocks[i];
-        for (j = 0; j < nBlocks; ++j) {
-            blk1 = blocks[j];
-            if (blk1 != blk0) {
-                blk0->updatePriMinMax(blk1);
-            }
+        const auto update = [blk0, &index](int k) {
+            const TextBlock *other = index.getBlock(k);
+            if (other != blk0) {
+                blk0->updatePriMinMax(other);
+            }
+        };
+        if (primaryRot == 0 || primaryRot == 2) {
+            index.forEach(-DBL_MAX, blk0->yMin, DBL_MAX, blk0->yMax, update);
+        } else {
+            index.forEach(blk0->xMin, -DBL_MAX, blk0->xMax, DBL_MAX, update);
         }
     }
 
@@ -3475,10 +4250,6 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
 #endif
 
     int sortPos = 0;
-    bool *visited = static_cast<bool *>(gmallocn(nBlocks, sizeof(bool)));
-    for (int i = 0; i < nBlocks; i++) {
-        visited[i] = false;
-    }
 
     double bxMin0, byMin0, bxMin1, byMin1;
     int numTables = 0;
@@ -3489,7 +4260,11 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
     double deltaX, deltaY;
     TextBlock *fblk2 = nullptr, *fblk3 = nullptr, *fblk4 = nullptr;
 
-    for (blk1 = blkList; blk1; blk1 = blk1->next) {
+    std::vector<int> firstBelowRight;
+    index.getFirstBelowRight(firstBelowRight);
+
+    for (int pos1 = 0; pos1 < nBlocks; ++pos1) {
+        blk1 = index.getBlock(pos1);
         blk1->ExMin = blk1->xMin;
         blk1->ExMax = blk1->xMax;
         blk1->EyMin = blk1->yMin;
@@ -3509,20 +4284,46 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
          *  fblk3 is under blk1 and overlap with blk1 in x axis
          *  fblk4 is under blk1 and on the right of blk1
          *  and they are closest to blk1
+         *  (the three cases exclude each other; on ties, the first block
+         *  in the list wins)
          */
-        for (blk2 = blkList; blk2; blk2 = blk2->next) {
-            if (blk2 != blk1) {
-                if (blk2->yMin <= blk1->yMax && blk2->yMax >= blk1->yMin && blk2->xMin > blk1->xMax && blk2->xMin < bxMin0) {
-                    bxMin0 = blk2->xMin;
-                    fblk2 = blk2;
-                } else if (blk2->xMin <= blk1->xMax && blk2->xMax >= blk1->xMin && blk2->yMin > blk1->yMax && blk2->yMin < byMin0) {
-                    byMin0 = blk2->yMin;
-                    fblk3 = blk2;
-                } else if (blk2->xMin > blk1->xMax && blk2->xMin < bxMin1 && blk2->yMin > blk1->yMax && blk2->yMin < byMin1) {
-                    bxMin1 = blk2->xMin;
-                    byMin1 = blk2->yMin;
-                    fblk4 = blk2;
-                }
+        int fpos2 = -1, fpos3 = -1;
+        index.forEach(blk1->xMax, blk1->yMin, DBL_MAX, blk1->yMax, [&](int k) {
+            blk2 = index.getBlock(k);
+            if (blk2 != blk1 && blk2->yMin <= blk1->yMax && blk2->yMax >= blk1->yMin && blk2->xMin > blk1->xMax && (blk2->xMin < bxMin0 || (blk2->xMin == bxMin0 && k < fpos2))) {
+                bxMin0 = blk2->xMin;
+                fblk2 = blk2;
+                fpos2 = k;
+            }
+        });
+        index.forEach(blk1->xMin, blk1->yMax, blk1->xMax, DBL_MAX, [&](int k) {
+            blk2 = index.getBlock(k);
+            if (blk2 != blk1 && blk2->xMin <= blk1->xMax && blk2->xMax >= blk1->xMin && blk2->yMin > blk1->yMax && (blk2->yMin < byMin0 || (blk2->yMin == byMin0 && k < fpos3))) {
+                byMin0 = blk2->yMin;
+                fblk3 = blk2;
+                fpos3 = k;
+            }
+        });
+
+        // fblk4 is only used together with fblk2 and fblk3; it is the end
+        // of the chain of blocks (in list order) each of which is above
+        // and to the left of the previous one
+        if (fblk2 != nullptr && fblk3 != nullptr) {
+            int fpos4 = firstBelowRight[pos1];
+            while (fpos4 >= 0) {
+                fblk4 = index.getBlock(fpos4);
+                bxMin1 = fblk4->xMin;
+                byMin1 = fblk4->yMin;
+                int next = INT_MAX;
+                index.forEach(blk1->xMax, blk1->yMax, bxMin1, byMin1, [&](int k) {
+                    if (k > fpos4 && k < next) {
+                        blk2 = index.getBlock(k);
+                        if (blk2->xMin > blk1->xMax && blk2->xMin < bxMin1 && blk2->yMin > blk1->yMax && blk2->yMin < byMin1) {
+                            next = k;
+                        }
+                    }
+                });
+                fpos4 = (next == INT_MAX) ? -1 : next;
             }
         }
 
@@ -3690,9 +4491,10 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
             double xMax = DBL_MAX;
             double xMin = DBL_MIN;
 
-            for (blk2 = blkList; blk2; blk2 = blk2->next) {
+            index.forEach(-DBL_MAX, blk1->yMin, DBL_MAX, blk1->yMax, [&](int k) {
+                blk2 = index.getBlock(k);
                 if (blk2 == blk1) {
-                    continue;
+                    return;
                 }
 
                 if (blk1->yMin <= blk2->yMax && blk1->yMax >= blk2->yMin) {
@@ -3704,11 +4506,12 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
                         xMin = blk2->xMax;
                     }
                 }
-            }
+            });
 
-            for (blk2 = blkList; blk2; blk2 = blk2->next) {
+            index.forEach(std::min(xMin, blk1->ExMin), blk1->yMax, xMax, DBL_MAX, [&](int k) {
+                blk2 = index.getBlock(k);
                 if (blk2 == blk1) {
-                    continue;
+                    return;
                 }
 
                 if (blk2->xMax > blk1->ExMax && blk2->xMax <= xMax && blk2->yMin >= blk1->yMax) {
@@ -3718,17 +4521,13 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
                 if (blk2->xMin < blk1->ExMin && blk2->xMin >= xMin && blk2->yMin >= blk1->yMax) {
                     blk1->ExMin = blk2->xMin;
                 }
-            }
+            });
         }
     }
 
-    int i = -1;
-    for (blk1 = blkList; blk1; blk1 = blk1->next) {
-        i++;
-        sortPos = blk1->visitDepthFirst(blkList, i, blocks, sortPos, visited);
-    }
-    if (visited) {
-        gfree(visited);
+    index.initReadingOrder(primaryRot, primaryLR);
+    for (int i = 0; i < nBlocks; ++i) {
+        sortPos = index.getBlock(i)->visitDepthFirst(&index, i, blocks, sortPos);
     }
 
 #if 0 // for debugging
@@ -3767,7 +4566,7 @@ void TextPage::coalesce(bool physLayout, double fixedPitch, bool doHTML, double
     flows = lastFlow = nullptr;
     // assume blocks are already in reading order,
     // and construct flows accordingly.
-    for (i = 0; i < nBlocks; i++) {
+    for (int i = 0; i < nBlocks; i++) {
         blk = blocks[i];
         blk->next = nullptr;
         if (flow) {
@@ -4211,20 +5010,64 @@ bool TextPage::findText(const Unicode *s, int len, bool startAtTop, bool stopAtB
     return false;
 }
 
-GooString TextPage::getText(const std::optional<PDFRectangle> &area, EndOfLineKind textEOL, bool physLayout, EndOfLineHyphenMode hyphenMode) const
+// Collects the output of TextPage::dump and passes it to the output
+// function in large chunks, instead of once per line fragment, space and
+// end of line.  Without an output function, the text is appended
+// directly to a string.
+class TextOutputBuffer
 {
-    TextOutputFunc dumpToString = [](void *stream, const char *text, int len) {
-        auto *s = static_cast<GooString *>(stream);
-        s->append(text, len);
-    };
+public:
+    TextOutputBuffer(TextOutputFunc outputFuncA, void *outputStreamA) : outputFunc(outputFuncA), outputStream(outputStreamA), buf(&ownBuf) { }
+    explicit TextOutputBuffer(GooString *s) : outputFunc(nullptr), outputStream(nullptr), buf(s) { }
+    ~TextOutputBuffer() { flush(); }
+
+    TextOutputBuffer(const TextOutputBuffer &) = delete;
+    TextOutputBuffer &operator=(const TextOutputBuffer &) = delete;
+
+    // The string to append to; call flushIfFull() afterwards.
+    GooString *getString() { return buf; }
+
+    void append(const char *text, int len)
+    {
+        buf->append(text, len);
+        flushIfFull();
+    }
+
+    void flushIfFull()
+    {
+        if (outputFunc && buf->size() >= chunkSize) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (outputFunc && !buf->empty()) {
+            (*outputFunc)(outputStream, buf->c_str(), buf->size());
+            buf->clear();
+        }
+    }
+
+private:
+    static constexpr size_t chunkSize = 16384;
 
+    TextOutputFunc outputFunc;
+    void *outputStream;
+    GooString ownBuf;
+    GooString *buf;
+};
+
+GooString TextPage::getText(const std::optional<PDFRectangle> &area, EndOfLineKind textEOL, bool physLayout, EndOfLineHyphenMode hyphenMode) const
+{
     GooString s;
 
     if (!physLayout && !rawOrder && area) {
         error(errInternal, -1, "physical layout false, rawOrder false and an area does not work well together");
     }
 
-    dump(&s, dumpToString, physLayout, textEOL, false, true, area, hyphenMode);
+    // the text is encoded straight into s
+    TextOutputBuffer out(&s);
+    dump(&out, physLayout, textEOL, false, true, area, hyphenMode);
     return s;
 }
 
@@ -4614,9 +5457,14 @@ void TextSelectionPainter::endPage()
     for (const TextWordSelection *sel : *selectionList) {
         int begin = sel->begin;
 
+        // the glyphs can't be drawn if they weren't kept
+        if (sel->word->glyphs.empty()) {
+            continue;
+        }
+
         while (begin < sel->end) {
             TextFontInfo *font = sel->word->chars[begin].font;
-            const Matrix *mat = &sel->word->chars[begin].textMat;
+            const Matrix *mat = &sel->word->glyphs[begin].textMat;
 
             state->setTextMat(mat->m[0], mat->m[1], mat->m[2], mat->m[3], 0, 0);
             state->setFont(font->gfxFont, 1);
@@ -4624,15 +5472,15 @@ void TextSelectionPainter::endPage()
 
             int fEnd = begin + 1;
             while (fEnd < sel->end && font->matches(sel->word->chars[fEnd].font) //
-                   && mat->m[0] == sel->word->chars[fEnd].textMat.m[0] && mat->m[1] == sel->word->chars[fEnd].textMat.m[1] //
-                   && mat->m[2] == sel->word->chars[fEnd].textMat.m[2] && mat->m[3] == sel->word->chars[fEnd].textMat.m[3]) {
+                   && mat->m[0] == sel->word->glyphs[fEnd].textMat.m[0] && mat->m[1] == sel->word->glyphs[fEnd].textMat.m[1] //
+                   && mat->m[2] == sel->word->glyphs[fEnd].textMat.m[2] && mat->m[3] == sel->word->glyphs[fEnd].textMat.m[3]) {
                 fEnd++;
             }
 
             /* The only purpose of this string is to let the output device query
              * it's length.  Might want to change this interface later. */
             string.clear();
-            std::for_each(sel->word->chars.begin() + begin, sel->word->chars.begin() + fEnd, [&string](const auto c) { string.push_back(c.charcode); });
+            std::for_each(sel->word->glyphs.begin() + begin, sel->word->glyphs.begin() + fEnd, [&string](const auto &g) { string.push_back(g.charcode); });
             out->beginString(state, string);
 
             for (int j = begin; j < fEnd; j++) {
@@ -4640,7 +5488,8 @@ void TextSelectionPainter::endPage()
                 if (j != begin && charJ.charPos == sel->word->chars[j - 1].charPos) {
                     continue;
                 }
-                out->drawChar(state, charJ.textMat.m[4], charJ.textMat.m[5], 0, 0, 0, 0, charJ.charcode, 1, nullptr, 0);
+                const auto &glyphJ = sel->word->glyphs[j];
+                out->drawChar(state, glyphJ.textMat.m[4], glyphJ.textMat.m[5], 0, 0, 0, 0, glyphJ.charcode, 1, nullptr, 0);
             }
             out->endString(state);
             begin = fEnd;
@@ -4834,14 +5683,28 @@ void TextBlock::visitSelection(TextSelectionVisitor *visitor, const PDFRectangle
 
     // find the nearest line to the selection points
     // using the manhattan distance.
-    for (p = this->lines; p; p = p->next) {
-        count++;
+    if (nLines >= TextPage::minIndexedLines) {
+        const TextLineIndex &lineIndex = page->getLineIndex(this);
         for (i = 0; i < 2; i++) {
-            d = fmax(p->xMin - x[i], 0.0) + fmax(x[i] - p->xMax, 0.0) + fmax(p->yMin - y[i], 0.0) + fmax(y[i] - p->yMax, 0.0);
-            if (!best_line[i] || all[i] || d < best_d[i]) {
-                best_line[i] = p;
-                best_count[i] = count;
-                best_d[i] = d;
+            if (all[i]) {
+                best_line[i] = lineIndex.lines.back();
+                best_count[i] = lineIndex.lines.size();
+            } else if (!best_line[i]) {
+                const int best = lineIndex.index->findNearest(x[i], y[i]);
+                best_line[i] = lineIndex.lines[best];
+                best_count[i] = best + 1;
+            }
+        }
+    } else {
+        for (p = this->lines; p; p = p->next) {
+            count++;
+            for (i = 0; i < 2; i++) {
+                d = fmax(p->xMin - x[i], 0.0) + fmax(x[i] - p->xMax, 0.0) + fmax(p->yMin - y[i], 0.0) + fmax(y[i] - p->yMax, 0.0);
+                if (!best_line[i] || all[i] || d < best_d[i]) {
+                    best_line[i] = p;
+                    best_count[i] = count;
+                    best_d[i] = d;
+                }
             }
         }
     }
@@ -4900,57 +5763,47 @@ void TextBlock::visitSelection(TextSelectionVisitor *visitor, const PDFRectangle
 void TextPage::visitSelection(TextSelectionVisitor *visitor, const PDFRectangle &selection, SelectionStyle style)
 {
     PDFRectangle child_selection;
-    double x[2], y[2], d, best_d[2];
+    double x[2], y[2];
     double xMin, yMin, xMax, yMax;
     TextFlow *flow, *best_flow[2];
     TextBlock *blk, *best_block[2];
-    int i, count = 0, best_count[2], start, stop;
+    int i, best_count[2], start, stop;
 
     if (!flows) {
         return;
     }
 
+    const TextSelectionIndex &index = getSelectionIndex();
+    if (index.blocks.empty()) {
+        return;
+    }
+
     x[0] = selection.x1;
     y[0] = selection.y1;
     x[1] = selection.x2;
     y[1] = selection.y2;
 
-    xMin = pageWidth;
-    yMin = pageHeight;
-    xMax = 0.0;
-    yMax = 0.0;
-
-    for (i = 0; i < 2; i++) {
-        best_block[i] = nullptr;
-        best_flow[i] = nullptr;
-        best_count[i] = 0;
-        best_d[i] = 0;
-    }
+    xMin = index.xMin;
+    yMin = index.yMin;
+    xMax = index.xMax;
+    yMax = index.yMax;
 
     // find the nearest blocks to the selection points
     // using the manhattan distance.
-    for (flow = flows; flow; flow = flow->next) {
-        for (blk = flow->blocks; blk; blk = blk->next) {
-            count++;
-            // the first/last blocks in reading order are
-            // often not the closest to the page corners;
-            // track the corners, force those blocks to
-            // be selected if the selection runs across
-            // multiple pages.
-            xMin = fmin(xMin, blk->xMin);
-            yMin = fmin(yMin, blk->yMin);
-            xMax = fmax(xMax, blk->xMax);
-            yMax = fmax(yMax, blk->yMax);
-            for (i = 0; i < 2; i++) {
-                d = fmax(blk->xMin - x[i], 0.0) + fmax(x[i] - blk->xMax, 0.0) + fmax(blk->yMin - y[i], 0.0) + fmax(y[i] - blk->yMax, 0.0);
-                if (!best_block[i] || d < best_d[i] || (!blk->next && !flow->next && x[i] >= fmin(xMax, pageWidth) && y[i] >= fmin(yMax, pageHeight))) {
-                    best_block[i] = blk;
-                    best_flow[i] = flow;
-                    best_count[i] = count;
-                    best_d[i] = d;
-                }
-            }
+    for (i = 0; i < 2; i++) {
+        int best;
+        // the first/last blocks in reading order are
+        // often not the closest to the page corners;
+        // force the last block to be selected if the
+        // selection runs across multiple pages.
+        if (index.lastBlockIsLast && x[i] >= fmin(xMax, pageWidth) && y[i] >= fmin(yMax, pageHeight)) {
+            best = index.blocks.size() - 1;
+        } else {
+            best = index.blockIndex->findNearest(x[i], y[i]);
         }
+        best_block[i] = index.blocks[best];
+        best_flow[i] = index.blockFlows[best];
+        best_count[i] = best + 1;
     }
     for (i = 0; i < 2; i++) {
         if (primaryLR) {
@@ -5049,6 +5902,74 @@ std::vector<std::vector<std::unique_ptr<TextWordSelection>>> TextPage::getSelect
     return dumper.takeWordList();
 }
 
+const TextSelectionIndex &TextPage::getSelectionIndex()
+{
+    if (selectionIndex) {
+        return *selectionIndex;
+    }
+    selectionIndex = std::make_unique<TextSelectionIndex>();
+    TextSelectionIndex &index = *selectionIndex;
+
+    std::vector<PDFRectangle> rects;
+    index.xMin = pageWidth;
+    index.yMin = pageHeight;
+    index.xMax = 0.0;
+    index.yMax = 0.0;
+    index.lastBlockIsLast = false;
+    for (TextFlow *flow = flows; flow; flow = flow->next) {
+        for (TextBlock *blk = flow->blocks; blk; blk = blk->next) {
+            index.blocks.push_back(blk);
+            index.blockFlows.push_back(flow);
+            rects.push_back(blk->getBBox());
+            index.xMin = fmin(index.xMin, blk->xMin);
+            index.yMin = fmin(index.yMin, blk->yMin);
+            index.xMax = fmax(index.xMax, blk->xMax);
+            index.yMax = fmax(index.yMax, blk->yMax);
+            index.lastBlockIsLast = !blk->next && !flow->next;
+        }
+    }
+    index.blockIndex = std::make_unique<TextRectIndex>(std::move(rects));
+    return index;
+}
+
+const TextLineIndex &TextPage::getLineIndex(const TextBlock *blk)
+{
+    getSelectionIndex();
+    TextLineIndex &lineIndex = selectionIndex->lineIndexes[blk];
+    if (!lineIndex.index) {
+        std::vector<PDFRectangle> rects;
+        for (TextLine *line = blk->lines; line; line = line->next) {
+            lineIndex.lines.push_back(line);
+            rects.push_back({ line->xMin, line->yMin, line->xMax, line->yMax });
+        }
+        lineIndex.index = std::make_unique<TextRectIndex>(std::move(rects));
+    }
+    return lineIndex;
+}
+
+const TextWord *TextPage::findWordAt(double x, double y)
+{
+    if (rawOrder || !flows) {
+        return nullptr;
+    }
+    getSelectionIndex();
+    TextSelectionIndex &index = *selectionIndex;
+    if (!index.wordIndex) {
+        std::vector<PDFRectangle> rects;
+        for (const TextBlock *blk : index.blocks) {
+            for (const TextLine *line = blk->lines; line; line = line->next) {
+                for (TextWord *word = line->words; word; word = word->next) {
+                    index.words.push_back(word);
+                    rects.push_back(word->getBBox());
+                }
+            }
+        }
+        index.wordIndex = std::make_unique<TextRectIndex>(std::move(rects));
+    }
+    const int i = index.wordIndex->findContaining(x, y);
+    return i < 0 ? nullptr : index.words[i];
+}
+
 bool TextPage::findCharRange(int pos, int length, double *xMin, double *yMin, double *xMax, double *yMax) const
 {
     TextBlock *blk;
@@ -5236,6 +6157,13 @@ static int appendInlineLinkURI(const AnnotLink *link, const UnicodeMap *uMap, Go
 }
 
 void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayout, EndOfLineKind textEOL, bool pageBreaks, bool suppressLastEol, std::optional<PDFRectangle> area, EndOfLineHyphenMode hyphenMode) const
+{
+    TextOutputBuffer out(outputFunc, outputStream);
+
+    dump(&out, physLayout, textEOL, pageBreaks, suppressLastEol, area, hyphenMode);
+}
+
+void TextPage::dump(TextOutputBuffer *out, bool physLayout, EndOfLineKind textEOL, bool pageBreaks, bool suppressLastEol, std::optional<PDFRectangle> area, EndOfLineHyphenMode hyphenMode) const
 {
     const UnicodeMap *uMap;
     char space[8], eol[16], eop[8];
@@ -5271,7 +6199,6 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
     // output the page in raw (content stream) order
     if (rawOrder) {
 
-        GooString s;
         std::vector<Unicode> uText;
 
         for (TextWord *word = rawWords; word; word = word->next) {
@@ -5281,25 +6208,22 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
                     continue;
                 }
             }
-            s.clear();
             uText.resize(word->len());
             std::ranges::transform(word->chars, uText.begin(), [](auto &c) { return c.text; });
-            dumpFragment(uText.data(), uText.size(), uMap, &s);
-            (*outputFunc)(outputStream, s.c_str(), s.size());
+            dumpFragment(uText.data(), uText.size(), uMap, out->getString());
 
             if (inlineLinkURIs && word->link && (!word->next || word->next->link != word->link)) {
-                s.clear();
-                appendInlineLinkURI(word->link, uMap, &s);
-                (*outputFunc)(outputStream, s.c_str(), s.size());
+                appendInlineLinkURI(word->link, uMap, out->getString());
             }
+            out->flushIfFull();
 
             if (!word->next) {
                 continue;
             }
             if (fabs(word->next->base - word->base) >= maxIntraLineDelta * word->fontSize) {
-                (*outputFunc)(outputStream, eol, eolLen);
+                out->append(eol, eolLen);
             } else if (fabs(word->next->xMin - word->xMax) > minDupBreakOverlap * word->fontSize) {
-                (*outputFunc)(outputStream, space, spaceLen);
+                out->append(space, spaceLen);
             }
         }
 
@@ -5366,7 +6290,6 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
     printf("\n");
 #endif
 
-        GooString s;
         // generate output
         int col = 0;
         for (size_t i = 0; i < frags.size(); ++i) {
@@ -5374,37 +6297,34 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
 
             // column alignment
             for (; col < frag.col; ++col) {
-                (*outputFunc)(outputStream, space, spaceLen);
+                out->append(space, spaceLen);
             }
 
             // print the line
-            s.clear();
-            col += dumpFragment(frag.line->text + frag.start, frag.len, uMap, &s);
-            (*outputFunc)(outputStream, s.c_str(), s.size());
+            col += dumpFragment(frag.line->text + frag.start, frag.len, uMap, out->getString());
 
             if (inlineLinkURIs) {
-                s.clear();
                 int offset = 0;
                 for (const TextWord *word = frag.line->words; word && offset < frag.start + frag.len; word = word->next) {
                     const int wordEnd = offset + static_cast<int>(word->len());
                     if (word->link && (!word->next || word->next->link != word->link) && wordEnd > frag.start) {
-                        col += appendInlineLinkURI(word->link, uMap, &s);
+                        col += appendInlineLinkURI(word->link, uMap, out->getString());
                     }
                     offset = wordEnd + (word->spaceAfter ? 1 : 0);
                 }
-                (*outputFunc)(outputStream, s.c_str(), s.size());
             }
+            out->flushIfFull();
 
             // print one or more returns if necessary
             if (i == frags.size() - 1) {
                 if (!suppressLastEol) {
-                    (*outputFunc)(outputStream, eol, eolLen);
+                    out->append(eol, eolLen);
                 }
             } else if (frags[i + 1].col < col || fabs(frags[i + 1].base - frag.base) > maxIntraLineDelta * frag.line->words->fontSize) {
                 int d = static_cast<int>((frags[i + 1].base - frag.base) / frag.line->words->fontSize);
                 d = std::clamp(d, 1, 5);
                 for (; d > 0; --d) {
-                    (*outputFunc)(outputStream, eol, eolLen);
+                    out->append(eol, eolLen);
                 }
                 col = 0;
             }
@@ -5412,7 +6332,6 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
 
         // output the page, "undoing" the layout
     } else {
-        GooString s;
         for (TextFlow *flow = flows; flow; flow = flow->next) {
             for (TextBlock *blk = flow->blocks; blk; blk = blk->next) {
                 for (TextLine *line = blk->lines; line; line = line->next) {
@@ -5432,11 +6351,8 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
                         return false;
                     }();
                     const int n = suppressHyphen ? line->len - 1 : line->len;
-                    s.clear();
-                    dumpFragment(line->text, n, uMap, &s);
-                    (*outputFunc)(outputStream, s.c_str(), s.size());
+                    dumpFragment(line->text, n, uMap, out->getString());
                     if (inlineLinkURIs) {
-                        s.clear();
                         for (const TextWord *word = line->words; word; word = word->next) {
                             const TextWord *nextWord = word->next;
                             if (!nextWord) {
@@ -5447,23 +6363,23 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc, bool physLayo
                                 }
                             }
                             if (word->link && (!nextWord || nextWord->link != word->link)) {
-                                appendInlineLinkURI(word->link, uMap, &s);
+                                appendInlineLinkURI(word->link, uMap, out->getString());
                             }
                         }
-                        (*outputFunc)(outputStream, s.c_str(), s.size());
                     }
+                    out->flushIfFull();
                     if (!suppressHyphen) {
-                        (*outputFunc)(outputStream, eol, eolLen);
+                        out->append(eol, eolLen);
                     }
                 }
             }
-            (*outputFunc)(outputStream, eol, eolLen);
+            out->append(eol, eolLen);
         }
     }
 
     // end of page
     if (pageBreaks) {
-        (*outputFunc)(outputStream, eop, eopLen);
+        out->append(eop, eopLen);
     }
 }
 
@@ -5733,6 +6649,9 @@ void TextOutputDev::endPage()
     if (outputStream) {
         text->dump(outputStream, outputFunc, physLayout, textEOL, textPageBreaks, false, std::nullopt, hyphenMode);
     }
+    if (streamOnly) {
+        text->clear();
+    }
     currentPage = nullptr;
 }
 
@@ -5971,6 +6890,12 @@ void TextOutputDev::setInlineLinkURIs(bool inlineLinkURIsA)
     text->setInlineLinkURIs(inlineLinkURIsA);
 }
 
+void TextOutputDev::setStreamOnly(bool streamOnlyA)
+{
+    streamOnly = streamOnlyA;
+    text->setKeepGlyphs(!streamOnly);
+}
+
 const TextFlow *TextOutputDev::getFlows() const
 {
     return text->getFlows();
@@ -59,12 +59,16 @@ class TextPool;
 class TextLine;
 class TextLineFrag;
 class TextBlock;
+class TextBlockIndex;
 class TextFlow;
 class TextLink;
 class TextUnderline;
 class TextWordList;
 class TextPage;
 class TextSelectionVisitor;
+class TextOutputBuffer;
+struct TextLineIndex;
+struct TextSelectionIndex;
 
 //------------------------------------------------------------------------
 
@@ -144,8 +148,10 @@ private:
 class POPPLER_PRIVATE_EXPORT TextWord
 {
 public:
-    // Constructor.
-    TextWord(const GfxState *state, int rotA, double fontSize);
+    // Constructor.  If <keepGlyphsA> is false, the char codes and text
+    // matrices of the characters, which are only needed to draw them
+    // again, are not kept.
+    TextWord(const GfxState *state, int rotA, double fontSize, bool keepGlyphsA = true);
 
     // Destructor.
     ~TextWord();
@@ -218,6 +224,7 @@ public:
 
 private:
     void setInitialBounds(TextFontInfo *fontA, double x, double y);
+    void removeFirstChars(int n);
 
     int rot; // rotation, multiple of 90 degrees
              //   (0, 1, 2, or 3)
@@ -231,13 +238,20 @@ private:
     struct CharInfo
     {
         Unicode text;
-        CharCode charcode;
         int charPos;
         double edge;
         TextFontInfo *font;
-        Matrix textMat;
     };
     std::vector<CharInfo> chars;
+
+    // glyph info for each character (only if keepGlyphs is set)
+    struct GlyphInfo
+    {
+        CharCode charcode;
+        Matrix textMat;
+    };
+    std::vector<GlyphInfo> glyphs;
+    bool keepGlyphs;
     int charPosEnd = 0;
     double edgeEnd = 0;
 
@@ -429,12 +443,11 @@ public:
     int getLineCount() const { return nLines; }
 
 private:
-    bool isBeforeByRule1(const TextBlock *blk1);
+    bool isBeforeByRule1(const TextBlock *blk1) const;
     bool isBeforeByRepeatedRule1(const TextBlock *blkList, const TextBlock *blk1);
-    bool isBeforeByRule2(const TextBlock *blk1);
+    bool isBeforeByRule2(const TextBlock *blk1) const;
 
-    int visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted, int sortPos, bool *visited);
-    int visitDepthFirst(TextBlock *blkList, int pos1, TextBlock **sorted, int sortPos, bool *visited, TextBlock **cache, int cacheSize);
+    int visitDepthFirst(TextBlockIndex *index, int pos1, TextBlock **sorted, int sortPos);
 
     TextPage *page; // the parent page
     int rot; // text rotation
@@ -460,6 +473,7 @@ private:
 
     friend class TextLine;
     friend class TextLineFrag;
+    friend class TextBlockIndex;
     friend class TextFlow;
     friend class TextWordList;
     friend class TextPage;
@@ -643,6 +657,11 @@ public:
 
     [[nodiscard]] std::vector<std::vector<std::unique_ptr<TextWordSelection>>> getSelectionWords(const PDFRectangle &selection, SelectionStyle style);
 
+    // Find the word whose bounding box contains (<x>,<y>), the first
+    // one in reading order if there are several.  Returns nullptr if
+    // there is none, or if the page is in raw order.
+    const TextWord *findWordAt(double x, double y);
+
     // Find a string by character position and length.  If found, sets
     // the text bounding rectangle and returns true; otherwise returns
     // false.
@@ -660,23 +679,40 @@ public:
 
     void setInlineLinkURIs(bool inlineLinkURIsA);
 
+    // If false, the words don't keep the char codes and text matrices
+    // of their characters, so selections can't be drawn with glyphs.
+    void setKeepGlyphs(bool keep) { keepGlyphs = keep; }
+
     // Build a flat word list, in content stream order (if
     // this->rawOrder is true), physical layout order (if <physLayout>
     // is true and this->rawOrder is false), or reading order (if both
     // flags are false).
     std::unique_ptr<TextWordList> makeWordList(bool physLayout);
 
-private:
+    // Discard all the text of the page.
     void clear();
+
+private:
+    // Build the blocks for rotation <rot> from the words in its pool, and
+    // return the head of their list.
+    TextBlock *buildBlocks(int rot, double minColSpacing1, const UnicodeMap *uMap, double fixedPitch, TextBlock **lastBlk, int *nBlks, int *charCount);
     static void assignColumns(TextLineFrag *frags, int nFrags, bool rot);
+    void dump(TextOutputBuffer *out, bool physLayout, EndOfLineKind textEOL, bool pageBreaks, bool suppressLastEol, std::optional<PDFRectangle> area, EndOfLineHyphenMode hyphenMode) const;
     int dumpFragment(const Unicode *text, int len, const UnicodeMap *uMap, GooString *s) const;
     static void adjustRotation(TextLine *line, int start, int end, double *xMin, double *xMax, double *yMin, double *yMax);
+    const TextSelectionIndex &getSelectionIndex();
+    const TextLineIndex &getLineIndex(const TextBlock *blk);
+
+    // blocks with at least this many lines get a line index for
+    // selections
+    static constexpr int minIndexedLines = 32;
 
     bool rawOrder; // keep text in content stream order
     bool discardDiag; // discard diagonal text
     bool inlineLinkURIs = false;
     bool mergeCombining; // merge when combining and base characters
                          // are drawn on top of each other
+    bool keepGlyphs = true; // keep the info needed to draw the glyphs again
 
     double pageWidth, pageHeight; // width and height of current page
     TextWord *curWord; // currently active string
@@ -710,6 +746,8 @@ private:
     std::vector<std::unique_ptr<TextUnderline>> underlines;
     std::vector<std::unique_ptr<TextLink>> links;
 
+    std::unique_ptr<TextSelectionIndex> selectionIndex; // built when first needed
+
     friend class TextLine;
     friend class TextLineFrag;
     friend class TextBlock;
@@ -795,6 +833,10 @@ public:
     // Does this device need non-text content?
     bool needNonText() override { return false; }
 
+    // Does this device need paths?  They are only used to find
+    // underlines and links in HTML mode.
+    bool needPaths() override { return doHTML; }
+
     // Does this device require incCharCount to be called for text on
     // non-shown layers?
     bool needCharCount() override { return true; }
@@ -877,6 +919,14 @@ public:
 
     void setInlineLinkURIs(bool inlineLinkURIsA);
 
+    // If true, the text of each page is only written to the output
+    // file or function, which gets it in chunks of about 16 KB at the
+    // end of the page: the per-character glyph info is not kept, and
+    // the page's text is discarded as soon as it has been written, so
+    // getText(), findText(), takeText(), etc. won't find anything.
+    // This about halves the memory used for the text of a dense page.
+    void setStreamOnly(bool streamOnlyA);
+
     // Get the head of the linked list of TextFlows for the
     // last rasterized page.
     const TextFlow *getFlows() const;
@@ -905,6 +955,7 @@ private:
                       // to skip watermarks drawn on top of body text, etc.
     bool doHTML; // extra processing for HTML conversion
     bool inlineLinkURIs = false;
+    bool streamOnly = false; // discard the text once it has been written
     Page *currentPage = nullptr;
     bool ok; // set up ok?
     bool textPageBreaks; // insert end-of-page markers?
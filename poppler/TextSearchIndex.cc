@@ -0,0 +1,390 @@
+//========================================================================
+//
+// TextSearchIndex.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "goo/gfile.h"
+#include "goo/gmem.h"
+#include "Error.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Stream.h"
+#include "TextOutputDev.h"
+#include "UnicodeMap.h"
+#include "UnicodeMapFuncs.h"
+#include "UnicodeTypeTable.h"
+#include "TextSearchIndex.h"
+
+// file format: magic, version, number of terms, the terms (length and
+// UTF-8 bytes), number of pages, and for each page the number of
+// positions and each position's term id and rectangle; all integers
+// are 32-bit and all numbers little endian
+static const char textSearchIndexMagic[8] = { 'P', 'T', 'X', 'T', 'I', 'D', 'X', '\n' };
+static const uint32_t textSearchIndexVersion = 1;
+
+//------------------------------------------------------------------------
+
+// The text of one page: the folded terms in reading order, and their
+// bounding boxes.
+struct TextSearchPageText
+{
+    std::vector<std::string> terms;
+    std::vector<PDFRectangle> rects;
+};
+
+// Fold <s>[0 .. <len>-1] into a term: normalize it, convert it to
+// uppercase and translate it to ASCII, like TextPage::findText does for
+// case insensitive searches which ignore diacritics.  Characters which
+// have no ASCII equivalent are kept, so that different terms written in
+// other scripts stay different.
+static std::string foldTerm(const Unicode *s, int len)
+{
+    const UnicodeMap *uMap = globalParams->getUnicodeMap("ASCII7");
+    Unicode *norm;
+    int normLen;
+    char buf[8];
+    std::string term;
+
+    norm = unicodeNormalizeNFKC(s, len, &normLen, nullptr);
+    for (int i = 0; i < normLen; ++i) {
+        const Unicode u = unicodeToUpper(norm[i]);
+        const int n = uMap ? uMap->mapUnicode(u, buf, sizeof(buf)) : 0;
+        if (n == 0) {
+            term.append(buf, mapUTF8(u, buf, sizeof(buf)));
+        } else {
+            for (int j = 0; j < n; ++j) {
+                term.push_back(static_cast<char>(unicodeToUpper(static_cast<unsigned char>(buf[j]))));
+            }
+        }
+    }
+
+    gfree(norm);
+    return term;
+}
+
+// Letters and digits make up the terms.  unicodeTypeAlphaNum also
+// accepts the ASCII characters which can be part of numbers, like ','
+// and '-', so those are handled separately.
+static bool isTermChar(Unicode c)
+{
+    if (c < 0x80) {
+        return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    }
+    return unicodeTypeAlphaNum(c);
+}
+
+// Call f(start, end) for each run of letters and digits in <s>.
+template<typename F>
+static void forEachTerm(const Unicode *s, int len, F f)
+{
+    int i = 0;
+    while (i < len) {
+        if (!isTermChar(s[i])) {
+            ++i;
+            continue;
+        }
+        int j = i + 1;
+        while (j < len && isTermChar(s[j])) {
+            ++j;
+        }
+        f(i, j);
+        i = j;
+    }
+}
+
+static void extractPageText(PDFDoc *doc, int pg, TextSearchPageText *pageText)
+{
+    TextOutputDev textOut(nullptr, false, 0, false, false);
+    if (!textOut.isOk()) {
+        return;
+    }
+    doc->displayPage(&textOut, pg, 72, 72, 0, false, true, false);
+    const std::unique_ptr<TextWordList> wordList = textOut.makeWordList();
+
+    std::vector<Unicode> text;
+    for (const TextWord *word : wordList->getWords()) {
+        const int n = word->getLength();
+        text.resize(n);
+        for (int i = 0; i < n; ++i) {
+            text[i] = *word->getChar(i);
+        }
+        forEachTerm(text.data(), n, [&](int start, int end) {
+            PDFRectangle rect;
+            double xMin, yMin, xMax, yMax;
+
+            word->getCharBBox(start, &rect.x1, &rect.y1, &rect.x2, &rect.y2);
+            for (int i = start + 1; i < end; ++i) {
+                word->getCharBBox(i, &xMin, &yMin, &xMax, &yMax);
+                rect.x1 = std::min(rect.x1, xMin);
+                rect.y1 = std::min(rect.y1, yMin);
+                rect.x2 = std::max(rect.x2, xMax);
+                rect.y2 = std::max(rect.y2, yMax);
+            }
+            pageText->terms.push_back(foldTerm(text.data() + start, end - start));
+            pageText->rects.push_back(rect);
+        });
+    }
+}
+
+//------------------------------------------------------------------------
+// TextSearchIndex
+//------------------------------------------------------------------------
+
+TextSearchIndex::TextSearchIndex() = default;
+
+TextSearchIndex::~TextSearchIndex() = default;
+
+std::unique_ptr<TextSearchIndex> TextSearchIndex::build(PDFDoc *doc, int nThreads)
+{
+    std::unique_ptr<TextSearchIndex> index(new TextSearchIndex());
+    const int nPages = doc->getNumPages();
+    std::vector<TextSearchPageText> pageTexts(nPages);
+
+    // the extra threads each need their own document; copies of the
+    // base stream can only be read concurrently for plain files
+    if (nThreads <= 0) {
+        nThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    nThreads = std::min(nThreads, nPages);
+    std::vector<std::unique_ptr<PDFDoc>> docs;
+    if (nThreads > 1 && !doc->isEncrypted() && doc->getBaseStream()->getKind() == strFile) {
+        for (int i = 1; i < nThreads; ++i) {
+            auto docCopy = std::make_unique<PDFDoc>(doc->getBaseStream()->copy());
+            if (!docCopy->isOk() || docCopy->getNumPages() != nPages) {
+                docs.clear();
+                break;
+            }
+            docs.push_back(std::move(docCopy));
+        }
+    }
+
+    std::atomic<int> nextPage(1);
+    const auto extractPages = [&nextPage, &pageTexts, nPages](PDFDoc *d) {
+        for (int pg = nextPage++; pg <= nPages; pg = nextPage++) {
+            extractPageText(d, pg, &pageTexts[pg - 1]);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(docs.size());
+    for (const std::unique_ptr<PDFDoc> &d : docs) {
+        threads.emplace_back(extractPages, d.get());
+    }
+    extractPages(doc);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    // number the terms in page order, so that the index doesn't depend
+    // on the number of threads
+    index->pages.resize(nPages);
+    for (int pg = 0; pg < nPages; ++pg) {
+        TextSearchPageText &pageText = pageTexts[pg];
+        PageTerms &page = index->pages[pg];
+        page.termIds.reserve(pageText.terms.size());
+        for (std::string &term : pageText.terms) {
+            auto [it, inserted] = index->termIds.try_emplace(term, static_cast<int>(index->terms.size()));
+            if (inserted) {
+                index->terms.push_back(std::move(term));
+            }
+            page.termIds.push_back(it->second);
+        }
+        page.rects = std::move(pageText.rects);
+        pageText = TextSearchPageText();
+    }
+    index->buildPostings();
+
+    return index;
+}
+
+void TextSearchIndex::buildPostings()
+{
+    postings.clear();
+    postings.resize(terms.size());
+    for (int pg = 0; pg < static_cast<int>(pages.size()); ++pg) {
+        const std::vector<int> &ids = pages[pg].termIds;
+        for (int pos = 0; pos < static_cast<int>(ids.size()); ++pos) {
+            postings[ids[pos]].push_back(Posting { .page = pg, .pos = pos });
+        }
+    }
+}
+
+std::vector<TextSearchIndex::Match> TextSearchIndex::find(const Unicode *s, int len) const
+{
+    std::vector<Match> matches;
+    std::vector<int> query;
+    bool unknownTerm = false;
+
+    forEachTerm(s, len, [&](int start, int end) {
+        const auto it = termIds.find(foldTerm(s + start, end - start));
+        if (it == termIds.end()) {
+            unknownTerm = true;
+        } else {
+            query.push_back(it->second);
+        }
+    });
+    if (unknownTerm || query.empty()) {
+        return matches;
+    }
+
+    for (const Posting &posting : postings[query[0]]) {
+        const PageTerms &page = pages[posting.page];
+        if (posting.pos + query.size() > page.termIds.size()) {
+            continue;
+        }
+        if (!std::equal(query.begin() + 1, query.end(), page.termIds.begin() + posting.pos + 1)) {
+            continue;
+        }
+        matches.push_back(Match { .page = posting.page + 1, .rects = std::vector<PDFRectangle>(page.rects.begin() + posting.pos, page.rects.begin() + posting.pos + query.size()) });
+    }
+    return matches;
+}
+
+//------------------------------------------------------------------------
+// serialization
+//------------------------------------------------------------------------
+
+static void writeU32(std::string *buf, uint32_t x)
+{
+    for (int i = 0; i < 4; ++i) {
+        buf->push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+    }
+}
+
+static void writeDouble(std::string *buf, double x)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &x, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        buf->push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+}
+
+static bool readU32(FILE *f, uint32_t *x)
+{
+    unsigned char buf[4];
+
+    if (fread(buf, 1, 4, f) != 4) {
+        return false;
+    }
+    *x = buf[0] | (buf[1] << 8) | (buf[2] << 16) | (static_cast<uint32_t>(buf[3]) << 24);
+    return true;
+}
+
+static bool readDouble(FILE *f, double *x)
+{
+    unsigned char buf[8];
+    uint64_t bits = 0;
+
+    if (fread(buf, 1, 8, f) != 8) {
+        return false;
+    }
+    for (int i = 7; i >= 0; --i) {
+        bits = (bits << 8) | buf[i];
+    }
+    memcpy(x, &bits, sizeof(bits));
+    return true;
+}
+
+bool TextSearchIndex::save(const char *fileName) const
+{
+    std::string buf;
+    FILE *f;
+    bool ok;
+
+    buf.append(textSearchIndexMagic, sizeof(textSearchIndexMagic));
+    writeU32(&buf, textSearchIndexVersion);
+    writeU32(&buf, static_cast<uint32_t>(terms.size()));
+    for (const std::string &term : terms) {
+        writeU32(&buf, static_cast<uint32_t>(term.size()));
+        buf.append(term);
+    }
+    writeU32(&buf, static_cast<uint32_t>(pages.size()));
+    for (const PageTerms &page : pages) {
+        writeU32(&buf, static_cast<uint32_t>(page.termIds.size()));
+        for (size_t pos = 0; pos < page.termIds.size(); ++pos) {
+            writeU32(&buf, static_cast<uint32_t>(page.termIds[pos]));
+            writeDouble(&buf, page.rects[pos].x1);
+            writeDouble(&buf, page.rects[pos].y1);
+            writeDouble(&buf, page.rects[pos].x2);
+            writeDouble(&buf, page.rects[pos].y2);
+        }
+    }
+
+    if (!(f = openFile(fileName, "wb"))) {
+        error(errIO, -1, "Couldn't open text search index file '{0:s}'", fileName);
+        return false;
+    }
+    ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        error(errIO, -1, "Couldn't write text search index file '{0:s}'", fileName);
+    }
+    return ok;
+}
+
+std::unique_ptr<TextSearchIndex> TextSearchIndex::load(const char *fileName)
+{
+    std::unique_ptr<TextSearchIndex> index(new TextSearchIndex());
+    char magic[sizeof(textSearchIndexMagic)];
+    uint32_t version, nTerms, nPages, nPositions, len, id;
+    FILE *f;
+    bool ok;
+
+    if (!(f = openFile(fileName, "rb"))) {
+        error(errIO, -1, "Couldn't open text search index file '{0:s}'", fileName);
+        return nullptr;
+    }
+
+    // the counts are checked against the file size, so that a damaged
+    // file can't make us allocate huge amounts of memory
+    const Goffset fileSize = Gfseek(f, 0, SEEK_END) == 0 ? Gftell(f) : 0;
+    Gfseek(f, 0, SEEK_SET);
+
+    ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && !memcmp(magic, textSearchIndexMagic, sizeof(magic)) && readU32(f, &version) && version == textSearchIndexVersion && readU32(f, &nTerms) && nTerms <= fileSize / 4;
+    for (uint32_t i = 0; ok && i < nTerms; ++i) {
+        ok = readU32(f, &len) && len <= fileSize;
+        if (ok) {
+            std::string term(len, '\0');
+            ok = fread(term.data(), 1, len, f) == len && index->termIds.try_emplace(term, static_cast<int>(i)).second;
+            index->terms.push_back(std::move(term));
+        }
+    }
+    ok = ok && readU32(f, &nPages) && nPages <= fileSize / 4;
+    if (ok) {
+        index->pages.resize(nPages);
+    }
+    for (uint32_t pg = 0; ok && pg < nPages; ++pg) {
+        PageTerms &page = index->pages[pg];
+        ok = readU32(f, &nPositions) && nPositions <= fileSize / 36;
+        if (ok) {
+            page.termIds.resize(nPositions);
+            page.rects.resize(nPositions);
+        }
+        for (uint32_t pos = 0; ok && pos < nPositions; ++pos) {
+            PDFRectangle &rect = page.rects[pos];
+            ok = readU32(f, &id) && id < nTerms && readDouble(f, &rect.x1) && readDouble(f, &rect.y1) && readDouble(f, &rect.x2) && readDouble(f, &rect.y2);
+            page.termIds[pos] = static_cast<int>(id);
+        }
+    }
+    fclose(f);
+
+    if (!ok) {
+        error(errSyntaxError, -1, "Invalid text search index file '{0:s}'", fileName);
+        return nullptr;
+    }
+    index->buildPostings();
+    return index;
+}
@@ -0,0 +1,91 @@
+//========================================================================
+//
+// TextSearchIndex.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEXTSEARCHINDEX_H
+#define TEXTSEARCHINDEX_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "poppler_private_export.h"
+#include "CharTypes.h"
+#include "PDFRectangle.h"
+
+class PDFDoc;
+
+//------------------------------------------------------------------------
+// TextSearchIndex
+//------------------------------------------------------------------------
+
+// An inverted index over the text of all the pages of a document.
+//
+// The text of each page is split into terms, i.e. runs of letters and
+// digits, in reading order.  The terms are folded the same way as
+// TextPage::findText does for case insensitive searches that ignore
+// diacritics: NFKC normalization, conversion to uppercase, and
+// translation to ASCII where possible.  Queries are folded the same
+// way, so they match regardless of case and diacritics.
+class POPPLER_PRIVATE_EXPORT TextSearchIndex
+{
+public:
+    struct Match
+    {
+        int page; // page number (starting at 1)
+        std::vector<PDFRectangle> rects; // the bounding box of each matched term
+    };
+
+    TextSearchIndex(const TextSearchIndex &) = delete;
+    TextSearchIndex &operator=(const TextSearchIndex &) = delete;
+    ~TextSearchIndex();
+
+    // Build the index for all the pages of <doc>.  If <nThreads> is
+    // greater than one (or zero, to use the number of processors), the
+    // pages are extracted in parallel, each thread using its own copy
+    // of the document; this is only done for unencrypted documents
+    // read from a file.  The rectangles use the coordinate system of
+    // TextPage, i.e. the one of TextPage::findText results.
+    static std::unique_ptr<TextSearchIndex> build(PDFDoc *doc, int nThreads = 0);
+
+    // Write the index to / read it from a file.  Returns false / nullptr
+    // on errors.
+    bool save(const char *fileName) const;
+    static std::unique_ptr<TextSearchIndex> load(const char *fileName);
+
+    // Find all the occurrences of <s>, which is split into terms like
+    // the page text; a match is a sequence of consecutive terms on one
+    // page.  The matches are sorted by page and position.
+    std::vector<Match> find(const Unicode *s, int len) const;
+
+    int getNumPages() const { return static_cast<int>(pages.size()); }
+    int getNumTerms() const { return static_cast<int>(terms.size()); }
+
+private:
+    struct PageTerms
+    {
+        std::vector<int> termIds; // the term at each position
+        std::vector<PDFRectangle> rects; // the bounding box of each position
+    };
+
+    struct Posting
+    {
+        int page; // index into pages
+        int pos; // position on the page
+    };
+
+    TextSearchIndex();
+    void buildPostings();
+
+    std::vector<std::string> terms; // folded terms, in UTF-8
+    std::unordered_map<std::string, int> termIds;
+    std::vector<PageTerms> pages;
+    std::vector<std::vector<Posting>> postings; // indexed by term id
+};
+
+#endif
@@ -35,9 +35,11 @@
 #include "PDFDocEncoding.h"
 #include "GlobalParams.h"
 #include "UnicodeMap.h"
+#include "UnicodeMapTables.h"
 #include "UTF.h"
 #include "UnicodeMapFuncs.h"
 #include <algorithm>
+#include <array>
 
 #include <config.h>
 
@@ -402,6 +404,25 @@ std::string utf16ToUtf8(const uint16_t *utf16, int maxUtf16)
     return utf8;
 }
 
+// The characters which the ASCII7 unicode map maps to themselves, so
+// that unicodeToAscii7 can copy them without looking them up.
+static constexpr std::array<bool, 0x80> ascii7Identity = [] {
+    std::array<bool, 0x80> identity {};
+    for (const UnicodeMapRange &range : ascii7UnicodeMapRanges) {
+        if (range.nBytes == 1 && range.code == range.start) {
+            for (Unicode u = range.start; u <= range.end && u < 0x80; ++u) {
+                identity[u] = true;
+            }
+        }
+    }
+    return identity;
+}();
+
+static inline bool isAscii7Identity(Unicode u)
+{
+    return u < 0x80 && ascii7Identity[u];
+}
+
 void unicodeToAscii7(std::span<const Unicode> in, Unicode **ucs4_out, int *out_len, const int *in_idx, int **indices)
 {
     const UnicodeMap *uMap = globalParams->getUnicodeMap("ASCII7");
@@ -421,13 +442,23 @@ void unicodeToAscii7(std::span<const Unicode> in, Unicode **ucs4_out, int *out_l
         }
     }
 
-    std::string str;
+    // the output is ASCII, so the characters can be stored directly
+    // instead of going through a text string
+    std::vector<Unicode> ucs4;
+    ucs4.reserve(in.size());
 
     char buf[8]; // 8 is enough for mapping an unicode char to a string
     size_t i;
     int n, k;
 
     for (i = k = 0; i < in.size(); ++i) {
+        if (isAscii7Identity(in[i])) {
+            ucs4.push_back(in[i]);
+            if (indices) {
+                idx[k++] = in_idx[i];
+            }
+            continue;
+        }
         n = uMap->mapUnicode(in[i], buf, sizeof(buf));
         if (!n) {
             // the Unicode char could not be converted to ascii7 counterpart
@@ -435,7 +466,9 @@ void unicodeToAscii7(std::span<const Unicode> in, Unicode **ucs4_out, int *out_l
             buf[0] = 31;
             n = 1;
         }
-        str.append(buf, n);
+        for (int j = 0; j < n; ++j) {
+            ucs4.push_back(static_cast<unsigned char>(buf[j]));
+        }
         if (indices) {
             for (; n > 0; n--) {
                 idx[k++] = in_idx[i];
@@ -443,7 +476,6 @@ void unicodeToAscii7(std::span<const Unicode> in, Unicode **ucs4_out, int *out_l
         }
     }
 
-    std::vector<Unicode> ucs4 = TextStringToUCS4(str);
     *out_len = ucs4.size();
     *ucs4_out = static_cast<Unicode *>(gmallocn(ucs4.size(), sizeof(Unicode)));
     memcpy(*ucs4_out, ucs4.data(), ucs4.size() * sizeof(Unicode));
@@ -131,6 +131,7 @@ std::string POPPLER_PRIVATE_EXPORT utf16ToUtf8(const uint16_t *utf16, int maxUtf
 //   in       - UCS-4 string bytes
 //   len      - number of UCS-4 characters
 //   ucs4_out - if not NULL, allocates and returns UCS-4 string. Free with gfree.
+//              Characters which have no ASCII counterpart are replaced by 31.
 //   out_len  - number of UCS-4 characters in ucs4_out.
 //   in_idx   - if not NULL, the int array returned by the out fourth parameter of
 //              unicodeNormalizeNFKC() function. Optional, needed for @indices out parameter.
@@ -23,7 +23,7 @@
 
 #include "UnicodeMap.h"
 
-static const UnicodeMapRange latin1UnicodeMapRanges[] = {
+static constexpr UnicodeMapRange latin1UnicodeMapRanges[] = {
     { .start = 0x000a, .end = 0x000a, .code = 0x0a, .nBytes = 1 },     { .start = 0x000c, .end = 0x000d, .code = 0x0c, .nBytes = 1 },   { .start = 0x0020, .end = 0x007e, .code = 0x20, .nBytes = 1 },
     { .start = 0x00a0, .end = 0x00a0, .code = 0x20, .nBytes = 1 },     { .start = 0x00a1, .end = 0x00ac, .code = 0xa1, .nBytes = 1 },   { .start = 0x00ae, .end = 0x00ff, .code = 0xae, .nBytes = 1 },
     { .start = 0x010c, .end = 0x010c, .code = 0x43, .nBytes = 1 },     { .start = 0x010d, .end = 0x010d, .code = 0x63, .nBytes = 1 },   { .start = 0x0131, .end = 0x0131, .code = 0x69, .nBytes = 1 },
@@ -47,7 +47,7 @@ static const UnicodeMapRange latin1UnicodeMapRanges[] = {
 };
 #define latin1UnicodeMapLen (sizeof(latin1UnicodeMapRanges) / sizeof(UnicodeMapRange))
 
-static const UnicodeMapRange ascii7UnicodeMapRanges[] = {
+static constexpr UnicodeMapRange ascii7UnicodeMapRanges[] = {
     { .start = 0x000a, .end = 0x000a, .code = 0x0a, .nBytes = 1 },     { .start = 0x000c, .end = 0x000d, .code = 0x0c, .nBytes = 1 },     { .start = 0x0020, .end = 0x005f, .code = 0x20, .nBytes = 1 },
     { .start = 0x0061, .end = 0x007e, .code = 0x61, .nBytes = 1 },     { .start = 0x00a6, .end = 0x00a6, .code = 0x7c, .nBytes = 1 },     { .start = 0x00a9, .end = 0x00a9, .code = 0x286329, .nBytes = 3 },
     { .start = 0x00ae, .end = 0x00ae, .code = 0x285229, .nBytes = 3 }, { .start = 0x00b7, .end = 0x00b7, .code = 0x2a, .nBytes = 1 },     { .start = 0x00bc, .end = 0x00bc, .code = 0x312f34, .nBytes = 3 },
@@ -95,7 +95,7 @@ static const UnicodeMapRange ascii7UnicodeMapRanges[] = {
 };
 #define ascii7UnicodeMapLen (sizeof(ascii7UnicodeMapRanges) / sizeof(UnicodeMapRange))
 
-static const UnicodeMapRange symbolUnicodeMapRanges[] = {
+static constexpr UnicodeMapRange symbolUnicodeMapRanges[] = {
     { .start = 0x0020, .end = 0x0021, .code = 0x20, .nBytes = 1 }, { .start = 0x0023, .end = 0x0023, .code = 0x23, .nBytes = 1 }, { .start = 0x0025, .end = 0x0026, .code = 0x25, .nBytes = 1 },
     { .start = 0x0028, .end = 0x0029, .code = 0x28, .nBytes = 1 }, { .start = 0x002b, .end = 0x002c, .code = 0x2b, .nBytes = 1 }, { .start = 0x002e, .end = 0x003f, .code = 0x2e, .nBytes = 1 },
     { .start = 0x005b, .end = 0x005b, .code = 0x5b, .nBytes = 1 }, { .start = 0x005d, .end = 0x005d, .code = 0x5d, .nBytes = 1 }, { .start = 0x005f, .end = 0x005f, .code = 0x5f, .nBytes = 1 },
@@ -140,7 +140,7 @@ static const UnicodeMapRange symbolUnicodeMapRanges[] = {
 };
 #define symbolUnicodeMapLen (sizeof(symbolUnicodeMapRanges) / sizeof(UnicodeMapRange))
 
-static const UnicodeMapRange zapfDingbatsUnicodeMapRanges[] = {
+static constexpr UnicodeMapRange zapfDingbatsUnicodeMapRanges[] = {
     { .start = 0x0020, .end = 0x0020, .code = 0x20, .nBytes = 1 }, { .start = 0x2192, .end = 0x2192, .code = 0xd5, .nBytes = 1 }, { .start = 0x2194, .end = 0x2195, .code = 0xd6, .nBytes = 1 },
     { .start = 0x2460, .end = 0x2469, .code = 0xac, .nBytes = 1 }, { .start = 0x25a0, .end = 0x25a0, .code = 0x6e, .nBytes = 1 }, { .start = 0x25b2, .end = 0x25b2, .code = 0x73, .nBytes = 1 },
     { .start = 0x25bc, .end = 0x25bc, .code = 0x74, .nBytes = 1 }, { .start = 0x25c6, .end = 0x25c6, .code = 0x75, .nBytes = 1 }, { .start = 0x25cf, .end = 0x25cf, .code = 0x6c, .nBytes = 1 },
@@ -26,7 +26,11 @@
 //
 //========================================================================
 
+#include <array>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <vector>
 #include "CharTypes.h"
 #include "UnicodeTypeTable.h"
 #include "goo/gmem.h"
@@ -677,6 +681,71 @@ Unicode unicodeToUpper(Unicode c)
 
 #define COMBINING_CLASS(u) (((u) <= UNICODE_LAST_CHAR_PART1) ? CC_PART1((u) / 256, (u) % 256) : (((u) >= UNICODE_PART2_START && (u) <= UNICODE_LAST_CHAR) ? CC_PART2(((u) - UNICODE_PART2_START) / 256, (u) % 256) : 0))
 
+// Two-stage lookup table for decomp_table: the first stage maps each 256
+// character page to an entry of the second stage (or to 0 if no character
+// of the page has a decomposition), which holds a bitmap of the characters
+// having a decomposition and the range of decomp_table covering the page.
+// This lets decomp_compat skip the binary search for most characters.
+struct DecompPage
+{
+    uint32_t bits[8];
+    int start, end;
+};
+
+struct DecompIndex
+{
+    std::vector<unsigned short> pages;
+    std::vector<DecompPage> blocks;
+
+    DecompIndex()
+    {
+        pages.resize(decomp_table[DECOMP_TABLE_LENGTH - 1].character / 256 + 1, 0);
+        blocks.emplace_back(); // unused, 0 means "no decompositions"
+        for (int i = 0; i < DECOMP_TABLE_LENGTH; ++i) {
+            const Unicode u = decomp_table[i].character;
+            if (decomp_table[i].offset == -1) {
+                continue;
+            }
+            if (!pages[u / 256]) {
+                pages[u / 256] = blocks.size();
+                blocks.push_back(DecompPage { .bits = {}, .start = i, .end = i + 1 });
+            }
+            DecompPage &block = blocks[pages[u / 256]];
+            block.bits[(u % 256) / 32] |= 1u << (u % 32);
+            block.end = i + 1;
+        }
+    }
+
+    // Returns the decomp_table entry of @u, or nullptr if @u is its own
+    // decomposition.
+    const decomposition *find(Unicode u) const
+    {
+        if (u / 256 >= pages.size() || !pages[u / 256]) {
+            return nullptr;
+        }
+        const DecompPage &block = blocks[pages[u / 256]];
+        if (!(block.bits[(u % 256) / 32] & (1u << (u % 32)))) {
+            return nullptr;
+        }
+        int start = block.start, end = block.end;
+        while (end - start > 1) {
+            const int midpoint = (start + end) / 2;
+            if (u < decomp_table[midpoint].character) {
+                end = midpoint;
+            } else {
+                start = midpoint;
+            }
+        }
+        return &decomp_table[start];
+    }
+};
+
+static const DecompIndex &getDecompIndex()
+{
+    static const DecompIndex decompIndex;
+    return decompIndex;
+}
+
 // Write the compatibility decomposition of @u into @buf, returning the number
 // of characters written. @buf may be NULL, in which case the length of the
 // decomposition is returned but nothing is written. If @u is its own
@@ -685,38 +754,16 @@ Unicode unicodeToUpper(Unicode c)
 // in reverse order.
 static int decomp_compat(Unicode u, Unicode *buf, bool reverseRTL = false)
 {
-    // decomposition tables stored as lists {character, decomp_length, offset}
-    // so we do a binary search
-    int start = 0, end = DECOMP_TABLE_LENGTH;
-    if (u >= decomp_table[start].character && u <= decomp_table[end - 1].character) {
-        while (true) {
-            int midpoint = (start + end) / 2;
-            if (u == decomp_table[midpoint].character) {
-                int offset = decomp_table[midpoint].offset;
-                if (offset == -1) {
-                    break;
-                }
-                int length = decomp_table[midpoint].length, i;
-                if (buf) {
-                    for (i = 0; i < length; ++i) {
-                        if (unicodeTypeR(u) && reverseRTL) {
-                            buf[i] = decomp_expansion[offset + length - i - 1];
-                        } else {
-                            buf[i] = decomp_expansion[offset + i];
-                        }
-                    }
-                }
-                return length;
-            }
-            if (midpoint == start) {
-                break;
-            }
-            if (u > decomp_table[midpoint].character) {
-                start = midpoint;
-            } else {
-                end = midpoint;
+    const decomposition *decomp = u < 0xa0 ? nullptr : getDecompIndex().find(u);
+    if (decomp) {
+        const int offset = decomp->offset, length = decomp->length;
+        if (buf) {
+            const bool reverse = reverseRTL && unicodeTypeR(u);
+            for (int i = 0; i < length; ++i) {
+                buf[i] = decomp_expansion[reverse ? offset + length - i - 1 : offset + i];
             }
         }
+        return length;
     }
     if (buf) {
         *buf = u;
@@ -781,6 +828,50 @@ static bool combine(Unicode base, Unicode add, Unicode *out)
 #define HANGUL_COMPOSE_L_V(l, v) (HANGUL_S_BASE + (HANGUL_T_COUNT * (((v) - HANGUL_V_BASE) + (HANGUL_V_COUNT * ((l) - HANGUL_L_BASE)))))
 #define HANGUL_COMPOSE_LV_T(lv, t) ((lv) + ((t) - HANGUL_T_BASE))
 
+// Latin-1 characters which are their own normalization, i.e. everything
+// but the few characters with a compatibility decomposition.
+static bool isNormalizedLatin1(Unicode u)
+{
+    static const std::array<bool, 256> normalizedLatin1 = [] {
+        std::array<bool, 256> table;
+        for (Unicode c = 0; c < 256; ++c) {
+            Unicode buf[4], composed;
+            const int dlen = decomp_compat(c, buf);
+            table[c] = dlen == 1 ? buf[0] == c : dlen == 2 && combine(buf[0], buf[1], &composed) && composed == c;
+        }
+        return table;
+    }();
+    return u < 256 && normalizedLatin1[u];
+}
+
+// Returns true if the 8 characters at @s are all ASCII; written so that the
+// compiler can vectorize it.
+static inline bool isAsciiBlock(const Unicode *s)
+{
+    Unicode acc = 0;
+    for (int k = 0; k < 8; ++k) {
+        acc |= s[k];
+    }
+    return acc < 0x80;
+}
+
+// Returns the end of the run of characters starting at @i which can be
+// copied to the normalized string as is: ASCII and normalized Latin-1
+// characters are starters which never combine with a following starter,
+// but the last one of a run may combine with a following non-starter, so
+// it is left out unless the run extends to the end of the string.
+static int normalizedRunEnd(const Unicode *in, int i, int len)
+{
+    int j = i;
+    while (j + 8 <= len && isAsciiBlock(in + j)) {
+        j += 8;
+    }
+    while (j < len && isNormalizedLatin1(in[j])) {
+        ++j;
+    }
+    return j < len && j > i ? j - 1 : j;
+}
+
 // Converts Unicode string @in of length @len to its normalization in form
 // NFKC (compatibility decomposition + canonical composition). The length of
 // the resulting Unicode string is returned in @out_len. If non-NULL, @indices
@@ -814,7 +905,18 @@ Unicode *unicodeNormalizeNFKC(const Unicode *in, int len, int *out_len, int **in
 
     for (i = 0, o = 0; i < len;) {
         Unicode u = in[i];
-        if (IS_HANGUL(u)) {
+        const int runEnd = normalizedRunEnd(in, i, len);
+        if (runEnd > i) {
+            memcpy(out + o, in + i, (runEnd - i) * sizeof(Unicode));
+            if (indices) {
+                for (int k = i; k < runEnd; ++k) {
+                    idx[o++] = k;
+                }
+            } else {
+                o += runEnd - i;
+            }
+            i = runEnd;
+        } else if (IS_HANGUL(u)) {
             if (HANGUL_IS_L(u)) {
                 Unicode l = u;
                 if (i + 1 < len && HANGUL_IS_V(in[i + 1])) {
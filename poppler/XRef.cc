@@ -1502,6 +1502,8 @@ bool XRef::getStreamEnd(Goffset streamStart, Goffset *streamEnd)
 {
     int a, b, m;
 
+    xrefLocker();
+
     if (streamEndsLen == 0 || streamStart > streamEnds[streamEndsLen - 1]) {
         return false;
     }
@@ -1581,6 +1583,16 @@ bool XRef::add(int num, int gen, Goffset offs, bool used)
     return true;
 }
 
+bool XRef::addCompressed(int num, int objStmNum, int index)
+{
+    xrefLocker();
+    if (!add(num, index, objStmNum, true)) {
+        return false;
+    }
+    getEntry(num)->type = xrefEntryCompressed;
+    return true;
+}
+
 void XRef::setModifiedObject(const Object *o, Ref r)
 {
     xrefLocker();
@@ -1592,11 +1604,39 @@ void XRef::setModifiedObject(const Object *o, Ref r)
     if (unlikely(e->type == xrefEntryFree)) {
         error(errInternal, -1, "XRef::setModifiedObject on ref: {0:d}, {1:d} that is marked as free. This will cause a memory leak", r.num, r.gen);
     }
+    if (recordingModifiedObjects) {
+        replacedEntries.push_back({ .num = r.num, .obj = std::move(e->obj), .updated = e->getFlag(XRefEntry::Updated) });
+    }
     e->obj = o->copy();
     e->setFlag(XRefEntry::Updated, true);
     setModified();
 }
 
+void XRef::recordModifiedObjects()
+{
+    xrefLocker();
+    recordingModifiedObjects = true;
+    modifiedBeforeRecording = modified;
+    replacedEntries.clear();
+}
+
+void XRef::undoModifiedObjects()
+{
+    xrefLocker();
+    // go backwards, so that an object changed twice gets its first value
+    for (auto it = replacedEntries.rbegin(); it != replacedEntries.rend(); ++it) {
+        XRefEntry *e = getEntry(it->num);
+        e->obj = std::move(it->obj);
+        e->setFlag(XRefEntry::Updated, it->updated);
+    }
+    replacedEntries.clear();
+    recordingModifiedObjects = false;
+    modified = modifiedBeforeRecording;
+    // objects fetched from object streams share their contents with the
+    // cached ones, which may have been changed in place as well
+    objStrs.clear();
+}
+
 Ref XRef::addIndirectObject(const Object &o)
 {
     int entryIndexToUse = -1;
@@ -1753,7 +1793,7 @@ void XRef::XRefStreamWriter::writeEntry(Goffset offset, int gen, XRefEntryType t
 {
     const int entryTotalSize = 1 + offsetSize + 2; /* type + offset + gen */
     char data[16];
-    data[0] = (type == xrefEntryFree) ? 0 : 1;
+    data[0] = (type == xrefEntryFree) ? 0 : (type == xrefEntryCompressed) ? 2 : 1;
     for (int i = offsetSize; i > 0; i--) {
         data[i] = offset & 0xff;
         offset >>= 8;
@@ -39,6 +39,7 @@
 #define XREF_H
 
 #include <functional>
+#include <vector>
 
 #include "poppler_private_export.h"
 #include "Object.h"
@@ -212,10 +213,19 @@ public:
 
     // Write access
     void setModifiedObject(const Object *o, Ref r);
+    // Remember the objects replaced by setModifiedObject from now on, so
+    // that undoModifiedObjects can put them back.  Objects from object
+    // streams are reparsed after undoModifiedObjects, in case the fetched
+    // copies were changed in place.
+    void recordModifiedObjects();
+    void undoModifiedObjects();
     Ref addIndirectObject(const Object &o);
     void removeIndirectObject(Ref r);
     bool add(int num, int gen, Goffset offs, bool used);
     void add(Ref ref, Goffset offs, bool used);
+    // Adds an entry for object <num>, stored at index <index> of
+    // object stream <objStmNum>.
+    bool addCompressed(int num, int objStmNum, int index);
     // Adds a stream object using AutoFreeMemStream.
     // The function takes ownership over dict and buffer.
     // The buffer should be created using gmalloc().
@@ -270,6 +280,16 @@ private:
 
     RefRecursionChecker refsBeingFetched;
 
+    struct ReplacedEntry
+    {
+        int num;
+        Object obj;
+        bool updated;
+    };
+    bool recordingModifiedObjects = false;
+    bool modifiedBeforeRecording = false;
+    std::vector<ReplacedEntry> replacedEntries; // entries changed since recordModifiedObjects, in order
+
     int reserve(int newSize);
     int resize(int newSize);
     void constructTrailerDict(Goffset pos, bool needCatalogDict);
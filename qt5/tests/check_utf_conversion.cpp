@@ -19,6 +19,7 @@ private Q_SLOTS:
     static void testUTF_data();
     static void testUTF();
     static void testUnicodeToAscii7();
+    static void testUnicodeToAscii7Unmapped();
     static void testUnicodeLittleEndian();
 };
 
@@ -130,6 +131,36 @@ void TestUTFConversion::testUnicodeToAscii7()
     free(out_ascii_idx);
 }
 
+void TestUTFConversion::testUnicodeToAscii7Unmapped()
+{
+    globalParams = std::make_unique<GlobalParams>();
+
+    // characters without an ASCII7 counterpart (the CJK ideograph and
+    // the grave accent) become 31; the others map to themselves or to
+    // their ASCII7 counterpart
+    const Unicode in[] = { 'A', 0x4e2d, '`', ' ', 0xe9, '\n', 0xc6, '~' };
+    const int in_idx[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    Unicode *out;
+    int out_len;
+    int *out_ascii_idx;
+
+    unicodeToAscii7(std::span(in), &out, &out_len, in_idx, &out_ascii_idx);
+
+    const char expected_ascii[] = { 'A', 31, 31, ' ', 'e', '\n', 'A', 'E', '~' };
+    const int expected_idx[] = { 0, 1, 2, 3, 4, 5, 6, 6, 7 };
+
+    QCOMPARE(out_len, (int)sizeof(expected_ascii));
+    QVERIFY(compare(out, expected_ascii, out_len));
+    for (int i = 0; i < out_len; i++) {
+        QCOMPARE(out_ascii_idx[i], expected_idx[i]);
+    }
+    QCOMPARE(out_ascii_idx[out_len], 8);
+
+    free(out);
+    free(out_ascii_idx);
+}
+
 void TestUTFConversion::testUnicodeLittleEndian()
 {
     uint16_t UTF16LE_hi[5] { 0xFFFE, 0x4800, 0x4900, 0x2100, 0x1126 }; // UTF16-LE "HI!☑"
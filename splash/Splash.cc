@@ -155,6 +155,12 @@ struct SplashPipe
     // source pattern
     const SplashPattern *pattern;
 
+    // colors of a dynamic pattern for the span being drawn, starting at
+    // x = patternSpanX0 (see Splash::pipeFetchPatternSpan)
+    SplashColorPtr patternSpanColors;
+    bool *patternSpanValid;
+    int patternSpanX0;
+
     // source alpha and color
     unsigned char aInput;
     bool usesShape;
@@ -207,6 +213,7 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y, const SplashPattern
 {
     pipeSetXY(pipe, x, y);
     pipe->pattern = nullptr;
+    pipe->patternSpanColors = nullptr;
 
     // source color
     if (pattern) {
@@ -300,7 +307,14 @@ void Splash::pipeRun(SplashPipe *pipe)
 
     // dynamic pattern
     if (pipe->pattern) {
-        if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
+        if (pipe->patternSpanColors) {
+            const int i = pipe->x - pipe->patternSpanX0;
+            if (!pipe->patternSpanValid[i]) {
+                pipeIncX(pipe);
+                return;
+            }
+            splashColorCopy(pipe->cSrcVal, pipe->patternSpanColors + i * splashMaxColorComps);
+        } else if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
             pipeIncX(pipe);
             return;
         }
@@ -1412,11 +1426,30 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y)
     }
 }
 
+// Get the colors of a dynamic pattern for a whole span at once, so that
+// pipeRun doesn't need to call getColor for each pixel.
+void Splash::pipeFetchPatternSpan(SplashPipe *pipe, int x0, int x1, int y)
+{
+    if (!pipe->pattern || x1 < x0) {
+        return;
+    }
+    const size_t n = x1 - x0 + 1;
+    if (patternSpanColors.size() < n * splashMaxColorComps) {
+        patternSpanColors.resize(n * splashMaxColorComps);
+        patternSpanValid = std::make_unique<bool[]>(n);
+    }
+    pipe->pattern->getColorSpan(x0, x1, y, patternSpanColors.data(), patternSpanValid.get());
+    pipe->patternSpanColors = patternSpanColors.data();
+    pipe->patternSpanValid = patternSpanValid.get();
+    pipe->patternSpanX0 = x0;
+}
+
 inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noClip)
 {
     int x;
 
     if (noClip) {
+        pipeFetchPatternSpan(pipe, x0, x1, y);
         pipeSetXY(pipe, x0, y);
         for (x = x0; x <= x1; ++x) {
             (this->*pipe->run)(pipe);
@@ -1428,6 +1461,7 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noCli
         if (x1 > state->clip->getXMaxI()) {
             x1 = state->clip->getXMaxI();
         }
+        pipeFetchPatternSpan(pipe, x0, x1, y);
         pipeSetXY(pipe, x0, y);
         for (x = x0; x <= x1; ++x) {
             if (state->clip->test(x, y)) {
@@ -1437,6 +1471,7 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y, bool noCli
             }
         }
     }
+    pipe->patternSpanColors = nullptr;
 }
 
 inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adjustLine, unsigned char lineOpacity)
@@ -1457,6 +1492,7 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
     p2 = p1 + aaBuf->getRowSize();
     p3 = p2 + aaBuf->getRowSize();
 #endif
+    pipeFetchPatternSpan(pipe, x0, x1, y);
     pipeSetXY(pipe, x0, y);
     for (x = x0; x <= x1; ++x) {
 
@@ -1488,6 +1524,7 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y, bool adj
             pipeIncX(pipe);
         }
     }
+    pipe->patternSpanColors = nullptr;
 }
 
 //------------------------------------------------------------------------
@@ -2589,6 +2626,20 @@ SplashError Splash::fillChar(double x, double y, int c, SplashFont *font)
     if (debugMode) {
         printf("fillChar: x=%.2f y=%.2f c=%3d=0x%02x='%c'\n", x, y, c, c, c);
     }
+
+    // very large glyphs are not worth rasterizing into a bitmap (they
+    // would not fit in the glyph cache anyway), so fill their outlines
+    if (font->hasLargeGlyphs()) {
+        SplashPath *path = font->getGlyphPath(c);
+        if (!path) {
+            return SplashError::NoGlyph;
+        }
+        path->offset(x, y);
+        const SplashError err = fill(path, false);
+        delete path;
+        return err;
+    }
+
     transform(state->matrix, x, y, &xt, &yt);
     x0 = splashFloor(xt);
     xFrac = splashFloor((xt - x0) * splashFontFraction);
@@ -5645,23 +5696,32 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
             }
         }
     } else {
-        SplashColor color, auxColor1, auxColor2;
+        SplashColor vertexColor[3];
+        SplashColorPtr color[3];
         double scanLimitMapL[2] = { 0., 0. };
         double scanLimitMapR[2] = { 0., 0. };
+        double scanColorMapL[splashMaxColorComps][2];
+        double scanColorMapR[splashMaxColorComps][2];
+        double colorinterp[splashMaxColorComps];
+        double scanColorMap0[splashMaxColorComps];
         int scanEdgeL[2] = { 0, 0 };
         int scanEdgeR[2] = { 0, 0 };
 
-        for (int i = 0; i < shading->getNTriangles(); ++i) {
-            // Sadly this current algorithm only supports shadings where the three triangle vertices have the same color
-            shading->getNonParametrizedTriangle(i, bitmapMode, xdbl + 0, ydbl + 0, reinterpret_cast<SplashColorPtr>(&color), xdbl + 1, ydbl + 1, reinterpret_cast<SplashColorPtr>(&auxColor1), xdbl + 2, ydbl + 2,
-                                                reinterpret_cast<SplashColorPtr>(&auxColor2));
-            if (!splashColorEqual(color, auxColor1) || !splashColorEqual(color, auxColor2)) {
-                if (!bDirectBlit) {
-                    delete blitTarget;
-                }
-                return false;
+        // map the y coordinate of the current scanline to the color at
+        // the LEFT or RIGHT end of the scanline, for each component
+        const auto setScanColorMap = [&](double (*map)[2], const int *scanEdge) {
+            for (int k = 0; k < colorComps; ++k) {
+                map[k][0] = static_cast<double>(color[scanEdge[1]][k] - color[scanEdge[0]][k]) / (y[scanEdge[1]] - y[scanEdge[0]]);
+                map[k][1] = color[scanEdge[0]][k] - y[scanEdge[0]] * map[k][0];
             }
+        };
+
+        for (int i = 0; i < shading->getNTriangles(); ++i) {
+            // the vertex colors are interpolated linearly in the device
+            // color space
+            shading->getNonParametrizedTriangle(i, bitmapMode, xdbl + 0, ydbl + 0, vertexColor[0], xdbl + 1, ydbl + 1, vertexColor[1], xdbl + 2, ydbl + 2, vertexColor[2]);
             for (int m = 0; m < 3; ++m) {
+                color[m] = vertexColor[m];
                 xt = xdbl[m] * userToCanvasMatrix[0] + ydbl[m] * userToCanvasMatrix[2] + userToCanvasMatrix[4];
                 yt = xdbl[m] * userToCanvasMatrix[1] + ydbl[m] * userToCanvasMatrix[3] + userToCanvasMatrix[5];
                 xdbl[m] = xt;
@@ -5676,23 +5736,29 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
             if (y[0] > y[1]) {
                 Guswap(x[0], x[1]);
                 Guswap(y[0], y[1]);
+                Guswap(color[0], color[1]);
             }
             // first two are sorted.
             assert(y[0] <= y[1]);
             if (y[1] > y[2]) {
                 const int tmpX = x[2];
                 const int tmpY = y[2];
+                SplashColorPtr tmpC = color[2];
                 x[2] = x[1];
                 y[2] = y[1];
+                color[2] = color[1];
 
                 if (y[0] > tmpY) {
                     x[1] = x[0];
                     y[1] = y[0];
+                    color[1] = color[0];
                     x[0] = tmpX;
                     y[0] = tmpY;
+                    color[0] = tmpC;
                 } else {
                     x[1] = tmpX;
                     y[1] = tmpY;
+                    color[1] = tmpC;
                 }
             }
             // first three are sorted
@@ -5749,6 +5815,8 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
                 Guswap(scanLimitMapL[1], scanLimitMapR[1]);
                 // FIXME I'm sure there is a more efficient way to check this.
             }
+            setScanColorMap(scanColorMapL, scanEdgeL);
+            setScanColorMap(scanColorMapR, scanEdgeR);
 
             bool hasFurtherSegment = (y[1] < y[2]);
             int scanLineOff = y[0] * rowSize;
@@ -5764,11 +5832,13 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
                         scanEdgeL[1] = 2;
                         scanLimitMapL[0] = static_cast<double>(x[scanEdgeL[1]] - x[scanEdgeL[0]]) / (y[scanEdgeL[1]] - y[scanEdgeL[0]]);
                         scanLimitMapL[1] = x[scanEdgeL[0]] - y[scanEdgeL[0]] * scanLimitMapL[0];
+                        setScanColorMap(scanColorMapL, scanEdgeL);
                     } else if (scanEdgeR[1] == 1) {
                         scanEdgeR[0] = 1;
                         scanEdgeR[1] = 2;
                         scanLimitMapR[0] = static_cast<double>(x[scanEdgeR[1]] - x[scanEdgeR[0]]) / (y[scanEdgeR[1]] - y[scanEdgeR[0]]);
                         scanLimitMapR[1] = x[scanEdgeR[0]] - y[scanEdgeR[0]] * scanLimitMapR[0];
+                        setScanColorMap(scanColorMapR, scanEdgeR);
                     }
                     assert(y[scanEdgeL[0]] < y[scanEdgeL[1]]);
                     assert(y[scanEdgeR[0]] < y[scanEdgeR[1]]);
@@ -5783,6 +5853,15 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
                 const int scanLimitL = splashRound(xa);
                 const int scanLimitR = splashRound(xt);
 
+                // Ok. Now: init the color interpolation depending on the X
+                // coordinate inside of the current scanline:
+                for (int k = 0; k < colorComps; ++k) {
+                    const double ca = yt * scanColorMapL[k][0] + scanColorMapL[k][1];
+                    const double ct = yt * scanColorMapR[k][0] + scanColorMapR[k][1];
+                    scanColorMap0[k] = (scanLimitR == scanLimitL) ? 0. : ((ct - ca) / (scanLimitR - scanLimitL));
+                    colorinterp[k] = ca;
+                }
+
                 // handled by clipping:
                 // assert( scanLimitL >= 0 && scanLimitR < bitmap->getWidth() );
                 assert(scanLimitL <= scanLimitR || abs(scanLimitL - scanLimitR) <= 2); // allow rounding inaccuracies
@@ -5791,6 +5870,7 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
                 int bitmapOff = scanLineOff + scanLimitL * colorComps;
                 if (likely(bitmapOff >= 0)) {
                     for (int X = scanLimitL; X <= scanLimitR && bitmapOff + colorComps <= bitmapOffLimit; ++X, bitmapOff += colorComps) {
+                        const int n = X - scanLimitL;
                         // FIXME : standard rectangular clipping can be done for a
                         // complete scanline which is faster
                         // --> see SplashClip and its methods
@@ -5801,7 +5881,8 @@ bool Splash::gouraudTriangleShadedFill(SplashGouraudColor *shading)
                         assert(bitmapOff == Y * rowSize + colorComps * X && scanLineOff == Y * rowSize);
 
                         for (int k = 0; k < colorComps; ++k) {
-                            bitmapData[bitmapOff + k] = color[k];
+                            const double c = colorinterp[k] + n * scanColorMap0[k];
+                            bitmapData[bitmapOff + k] = (c <= 0) ? 0 : (c >= 255) ? 255 : static_cast<unsigned char>(c + 0.5);
                         }
 
                         // make the shading visible.
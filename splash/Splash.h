@@ -277,6 +277,7 @@ private:
     void pipeRunAADeviceN8(SplashPipe *pipe);
     void pipeSetXY(SplashPipe *pipe, int x, int y);
     void pipeIncX(SplashPipe *pipe);
+    void pipeFetchPatternSpan(SplashPipe *pipe, int x0, int x1, int y);
     void drawPixel(SplashPipe *pipe, int x, int y, bool noClip);
     void drawAAPixelInit();
     void drawAAPixel(SplashPipe *pipe, int x, int y);
@@ -323,6 +324,8 @@ private:
     SplashState *state;
     SplashBitmap *aaBuf;
     int aaBufY;
+    std::vector<unsigned char> patternSpanColors; // see pipeFetchPatternSpan
+    std::unique_ptr<bool[]> patternSpanValid;
     SplashBitmap *alpha0Bitmap; // for non-isolated groups, this is the
                                 //   bitmap containing the alpha0 values
     int alpha0X, alpha0Y; // offset within alpha0Bitmap
@@ -368,16 +368,19 @@ void SplashBitmap::setJpegParams(ImgWriter *writer, WriteImgParams *params)
 #endif
 }
 
-SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, double hDPI, double vDPI, WriteImgParams *params)
+std::unique_ptr<ImgWriter> SplashBitmap::createImgWriter(SplashImageFileFormat format, SplashColorMode modeA, WriteImgParams *params, SplashColorMode *imageWriterFormat)
 {
     ImgWriter *writer;
 
-    SplashColorMode imageWriterFormat = splashModeRGB8;
+    *imageWriterFormat = splashModeRGB8;
 
     switch (format) {
 #if ENABLE_LIBPNG
     case splashFormatPng:
         writer = new PNGWriter();
+        if (params) {
+            static_cast<PNGWriter *>(writer)->setCompressionThreads(params->pngCompressionThreads);
+        }
         break;
 #endif
 
@@ -396,14 +399,14 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, do
 
 #if ENABLE_LIBTIFF
     case splashFormatTiff:
-        switch (mode) {
+        switch (modeA) {
         case splashModeMono1:
             writer = new TiffWriter(TiffWriter::MONOCHROME);
-            imageWriterFormat = splashModeMono1;
+            *imageWriterFormat = splashModeMono1;
             break;
         case splashModeMono8:
             writer = new TiffWriter(TiffWriter::GRAY);
-            imageWriterFormat = splashModeMono8;
+            *imageWriterFormat = splashModeMono8;
             break;
         case splashModeRGB8:
         case splashModeBGR8:
@@ -414,7 +417,7 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, do
             writer = new TiffWriter(TiffWriter::CMYK);
             break;
         default:
-            fprintf(stderr, "TiffWriter: Mode %d not supported\n", mode);
+            fprintf(stderr, "TiffWriter: Mode %d not supported\n", modeA);
             writer = new TiffWriter();
         }
         if (writer && params) {
@@ -423,18 +426,27 @@ SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, do
         break;
 #else
         (void)params;
+        (void)modeA;
 #endif
 
     default:
         // Not the greatest error message, but users of this function should
         // have already checked whether their desired format is compiled in.
         error(errInternal, -1, "Support for this image type not compiled in");
-        return SplashError::Generic;
+        return nullptr;
     }
 
-    const SplashError e = writeImgFile(writer, f, hDPI, vDPI, imageWriterFormat);
-    delete writer;
-    return e;
+    return std::unique_ptr<ImgWriter>(writer);
+}
+
+SplashError SplashBitmap::writeImgFile(SplashImageFileFormat format, FILE *f, double hDPI, double vDPI, WriteImgParams *params)
+{
+    SplashColorMode imageWriterFormat;
+    std::unique_ptr<ImgWriter> writer = createImgWriter(format, mode, params, &imageWriterFormat);
+    if (!writer) {
+        return SplashError::Generic;
+    }
+    return writeImgFile(writer.get(), f, hDPI, vDPI, imageWriterFormat);
 }
 
 #include "poppler/GfxState_helpers.h"
@@ -658,7 +670,7 @@ void SplashBitmap::getCMYKLine(int yl, SplashColorPtr line)
 
 SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI, double vDPI, SplashColorMode imageWriterFormat)
 {
-    if (mode != splashModeRGB8 && mode != splashModeMono8 && mode != splashModeMono1 && mode != splashModeXBGR8 && mode != splashModeBGR8 && mode != splashModeCMYK8 && mode != splashModeDeviceN8) {
+    if (!isWritableMode(mode)) {
         error(errInternal, -1, "unsupported SplashBitmap mode");
         return SplashError::Generic;
     }
@@ -667,6 +679,30 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
         return SplashError::Generic;
     }
 
+    const SplashError e = writeImgRows(writer, imageWriterFormat);
+    if (e != SplashError::NoError) {
+        return e;
+    }
+
+    if (!writer->close()) {
+        return SplashError::Generic;
+    }
+
+    return SplashError::NoError;
+}
+
+bool SplashBitmap::isWritableMode(SplashColorMode modeA)
+{
+    return modeA == splashModeRGB8 || modeA == splashModeMono8 || modeA == splashModeMono1 || modeA == splashModeXBGR8 || modeA == splashModeBGR8 || modeA == splashModeCMYK8 || modeA == splashModeDeviceN8;
+}
+
+SplashError SplashBitmap::writeImgRows(ImgWriter *writer, SplashColorMode imageWriterFormat)
+{
+    if (!isWritableMode(mode)) {
+        error(errInternal, -1, "unsupported SplashBitmap mode");
+        return SplashError::Generic;
+    }
+
     switch (mode) {
     case splashModeCMYK8:
         if (writer->supportCMYK()) {
@@ -678,7 +714,7 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
                 row_pointers[y] = row;
                 row += rowSize;
             }
-            if (!writer->writePointers(row_pointers, height)) {
+            if (!writer->writeRows(row_pointers, height)) {
                 delete[] row_pointers;
                 return SplashError::Generic;
             }
@@ -727,7 +763,7 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
             row_pointers[y] = row;
             row += rowSize;
         }
-        if (!writer->writePointers(row_pointers, height)) {
+        if (!writer->writeRows(row_pointers, height)) {
             delete[] row_pointers;
             return SplashError::Generic;
         }
@@ -780,7 +816,7 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
                 row_pointers[y] = row;
                 row += rowSize;
             }
-            if (!writer->writePointers(row_pointers, height)) {
+            if (!writer->writeRows(row_pointers, height)) {
                 delete[] row_pointers;
                 return SplashError::Generic;
             }
@@ -817,7 +853,7 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
                 row_pointers[y] = row;
                 row += rowSize;
             }
-            if (!writer->writePointers(row_pointers, height)) {
+            if (!writer->writeRows(row_pointers, height)) {
                 delete[] row_pointers;
                 return SplashError::Generic;
             }
@@ -849,9 +885,5 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, double hDPI,
         break;
     }
 
-    if (!writer->close()) {
-        return SplashError::Generic;
-    }
-
     return SplashError::NoError;
 }
@@ -86,12 +86,21 @@ public:
         bool jpegProgressive = false;
         std::string tiffCompression;
         bool jpegOptimize = false;
+        int pngCompressionThreads = 0; // see PNGWriter::setCompressionThreads
     };
 
     SplashError writeImgFile(SplashImageFileFormat format, const char *fileName, double hDPI, double vDPI, WriteImgParams *params = nullptr);
     SplashError writeImgFile(SplashImageFileFormat format, FILE *f, double hDPI, double vDPI, WriteImgParams *params = nullptr);
     SplashError writeImgFile(ImgWriter *writer, FILE *f, double hDPI, double vDPI, SplashColorMode imageWriterFormat);
 
+    // Writing an image in bands: create the writer writeImgFile would use
+    // for a bitmap in <modeA>, init() it with the size of the whole image,
+    // then call writeImgRows on the bitmap of each band, top to bottom,
+    // and finally close() it.  Returns nullptr if <format> is not
+    // supported.
+    static std::unique_ptr<ImgWriter> createImgWriter(SplashImageFileFormat format, SplashColorMode modeA, WriteImgParams *params, SplashColorMode *imageWriterFormat);
+    SplashError writeImgRows(ImgWriter *writer, SplashColorMode imageWriterFormat);
+
     enum ConversionMode
     {
         conversionOpaque,
@@ -126,6 +135,7 @@ private:
     friend class Splash;
 
     static void setJpegParams(ImgWriter *writer, WriteImgParams *params);
+    static bool isWritableMode(SplashColorMode modeA);
 };
 
 #endif
@@ -51,13 +51,13 @@ public:
     bool makeGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap, int x0, int y0, const SplashClip &clip, SplashClipResult *clipRes) override;
 
     // Return the path for a glyph.
-    SplashPath *getGlyphPath(int c) override;
+    SplashPath *makeGlyphPath(int c) override;
 
     // Return the advance of a glyph. (in 0..1 range)
     double getGlyphAdvance(int c) override;
 
 private:
-    FT_Size sizeObj;
+    FT_Size sizeObj = nullptr;
     FT_Matrix matrix;
     FT_Matrix textMatrix;
     double textScale = 0;
@@ -34,28 +34,19 @@
 // SplashFTFontEngine
 //------------------------------------------------------------------------
 
-SplashFTFontEngine::SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA, FT_Library libA)
+SplashFTFontEngine::SplashFTFontEngine(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA)
 {
     aa = aaA;
     enableFreeTypeHinting = enableFreeTypeHintingA;
     enableSlightHinting = enableSlightHintingA;
-    lib = libA;
 }
 
 SplashFTFontEngine *SplashFTFontEngine::init(bool aaA, bool enableFreeTypeHintingA, bool enableSlightHintingA)
 {
-    FT_Library libA;
-
-    if (FT_Init_FreeType(&libA)) {
-        return nullptr;
-    }
-    return new SplashFTFontEngine(aaA, enableFreeTypeHintingA, enableSlightHintingA, libA);
+    return new SplashFTFontEngine(aaA, enableFreeTypeHintingA, enableSlightHintingA);
 }
 
-SplashFTFontEngine::~SplashFTFontEngine()
-{
-    FT_Done_FreeType(lib);
-}
+SplashFTFontEngine::~SplashFTFontEngine() = default;
 
 std::shared_ptr<SplashFontFile> SplashFTFontEngine::loadType1Font(std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, const std::array<const char *, 256> &enc, int faceIndex)
 {
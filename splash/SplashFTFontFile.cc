@@ -24,6 +24,11 @@
 
 #include <config.h>
 
+#include <list>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
 #include "goo/ft_utils.h"
 #include "poppler/GfxFont.h"
 #include "SplashFTFontEngine.h"
@@ -31,92 +36,205 @@
 #include "SplashFTFontFile.h"
 #include "SplashFontFileID.h"
 
+//------------------------------------------------------------------------
+// SplashFTFace
+//------------------------------------------------------------------------
+
+// Faces that are no longer used by any font file are kept around (most
+// recently used first) as long as their font data doesn't exceed this
+// many bytes, so that documents opened one after another can share them.
+static constexpr size_t splashFTFaceCacheMaxSize = 64 * 1024 * 1024;
+static constexpr size_t splashFTFaceCacheMaxFaces = 256;
+
+// A single FreeType library is shared by all faces; FT_New_Face and
+// FT_Done_Face calls on it are serialized by faceCacheMutex.
+static FT_Library ftLib;
+static std::once_flag ftLibOnceFlag;
+
+static std::mutex faceCacheMutex;
+static std::unordered_multimap<size_t, std::weak_ptr<SplashFTFace>> faceCache;
+static std::list<std::shared_ptr<SplashFTFace>> recentFaces;
+static size_t recentFacesSize = 0;
+
+static size_t hashFontSrc(const SplashFontSrc &src, int faceIndex)
+{
+    size_t h;
+
+    if (src.isFile()) {
+        h = std::hash<std::string> {}(src.fileName());
+    } else {
+        h = std::hash<std::string_view> {}(std::string_view(reinterpret_cast<const char *>(src.buf().data()), src.buf().size()));
+    }
+    return h ^ (static_cast<size_t>(faceIndex) * 0x9e3779b97f4a7c15ULL);
+}
+
+std::shared_ptr<SplashFTFace> SplashFTFace::get(std::unique_ptr<SplashFontSrc> srcA, int faceIndexA)
+{
+    std::list<std::shared_ptr<SplashFTFace>> evicted;
+    std::vector<std::shared_ptr<SplashFTFace>> others;
+    std::shared_ptr<SplashFTFace> face;
+    FT_Face ftFaceA;
+
+    std::call_once(ftLibOnceFlag, FT_Init_FreeType, &ftLib);
+    if (!ftLib) {
+        return nullptr;
+    }
+
+    const size_t hashA = hashFontSrc(*srcA, faceIndexA);
+
+    {
+        std::scoped_lock lock(faceCacheMutex);
+
+        // check the cache; the references taken on faces that don't
+        // match may be the last ones once their users release them, so
+        // they are also released after unlocking the mutex
+        auto range = faceCache.equal_range(hashA);
+        for (auto it = range.first; it != range.second; ++it) {
+            std::shared_ptr<SplashFTFace> cached = it->second.lock();
+            if (cached && cached->matches(*srcA, faceIndexA)) {
+                face = std::move(cached);
+                break;
+            }
+            if (cached) {
+                others.push_back(std::move(cached));
+            }
+        }
+
+        // load a new face
+        if (!face) {
+            if (srcA->isFile()) {
+                if (ft_new_face_from_file(ftLib, srcA->fileName().c_str(), faceIndexA, &ftFaceA)) {
+                    return nullptr;
+                }
+            } else {
+                if (FT_New_Memory_Face(ftLib, static_cast<const FT_Byte *>(srcA->buf().data()), srcA->buf().size(), faceIndexA, &ftFaceA)) {
+                    return nullptr;
+                }
+            }
+            face = std::make_shared<SplashFTFace>(ftFaceA, std::move(srcA), faceIndexA, hashA);
+            faceCache.emplace(hashA, face);
+        }
+
+        // move the face to the front of the MRU list, and trim the list;
+        // the evicted faces are released after unlocking the mutex, since
+        // their destructor needs it
+        for (auto it = recentFaces.begin(); it != recentFaces.end(); ++it) {
+            if (*it == face) {
+                recentFacesSize -= face->getSize();
+                recentFaces.erase(it);
+                break;
+            }
+        }
+        recentFaces.push_front(face);
+        recentFacesSize += face->getSize();
+        while (recentFaces.size() > 1 && (recentFacesSize > splashFTFaceCacheMaxSize || recentFaces.size() > splashFTFaceCacheMaxFaces)) {
+            recentFacesSize -= recentFaces.back()->getSize();
+            evicted.splice(evicted.end(), recentFaces, std::prev(recentFaces.end()));
+        }
+    }
+
+    return face;
+}
+
+SplashFTFace::SplashFTFace(FT_Face ftFaceA, std::unique_ptr<SplashFontSrc> srcA, int faceIndexA, size_t hashA, PrivateTag /*unused*/) : ftFace(ftFaceA), src(std::move(srcA)), faceIndex(faceIndexA), hash(hashA) { }
+
+SplashFTFace::~SplashFTFace()
+{
+    std::scoped_lock lock(faceCacheMutex);
+
+    FT_Done_Face(ftFace);
+
+    // remove the (now expired) cache entry
+    auto range = faceCache.equal_range(hash);
+    for (auto it = range.first; it != range.second;) {
+        if (it->second.expired()) {
+            it = faceCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SplashFTFace::matches(const SplashFontSrc &srcA, int faceIndexA) const
+{
+    if (faceIndexA != faceIndex || srcA.isFile() != src->isFile()) {
+        return false;
+    }
+    if (src->isFile()) {
+        return srcA.fileName() == src->fileName();
+    }
+    return srcA.buf() == src->buf();
+}
+
+size_t SplashFTFace::getSize() const
+{
+    return src->isFile() ? 0 : src->buf().size();
+}
+
 //------------------------------------------------------------------------
 // SplashFTFontFile
 //------------------------------------------------------------------------
 
 std::shared_ptr<SplashFontFile> SplashFTFontFile::loadType1Font(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, const std::array<const char *, 256> &encA, int faceIndexA)
 {
-    FT_Face faceA;
     const char *name;
     int i;
 
-    if (src->isFile()) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName().c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, static_cast<const FT_Byte *>(src->buf().data()), src->buf().size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    std::shared_ptr<SplashFTFace> faceA = SplashFTFace::get(std::move(src), faceIndexA);
+    if (!faceA) {
+        return nullptr;
     }
     std::vector<int> codeToGIDA;
     codeToGIDA.resize(256, 0);
-    for (i = 0; i < 256; ++i) {
-        if ((name = encA[i])) {
-            codeToGIDA[i] = static_cast<int>(FT_Get_Name_Index(faceA, const_cast<char *>(name)));
-            if (codeToGIDA[i] == 0) {
-                name = GfxFont::getAlternateName(name);
-                if (name) {
-                    codeToGIDA[i] = FT_Get_Name_Index(faceA, const_cast<char *>(name));
+    {
+        std::scoped_lock lock(faceA->mutex);
+        for (i = 0; i < 256; ++i) {
+            if ((name = encA[i])) {
+                codeToGIDA[i] = static_cast<int>(FT_Get_Name_Index(faceA->ftFace, const_cast<char *>(name)));
+                if (codeToGIDA[i] == 0) {
+                    name = GfxFont::getAlternateName(name);
+                    if (name) {
+                        codeToGIDA[i] = FT_Get_Name_Index(faceA->ftFace, const_cast<char *>(name));
+                    }
                 }
             }
         }
     }
 
-    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(src), faceA, std::move(codeToGIDA), false, true);
+    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(faceA), std::move(codeToGIDA), false, true);
 }
 
 std::shared_ptr<SplashFontFile> SplashFTFontFile::loadCIDFont(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, std::vector<int> &&codeToGIDA, int faceIndexA)
 {
-    FT_Face faceA;
-
-    if (src->isFile()) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName().c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, static_cast<const FT_Byte *>(src->buf().data()), src->buf().size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    std::shared_ptr<SplashFTFace> faceA = SplashFTFace::get(std::move(src), faceIndexA);
+    if (!faceA) {
+        return nullptr;
     }
 
-    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(src), faceA, std::move(codeToGIDA), false, false);
+    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(faceA), std::move(codeToGIDA), false, false);
 }
 
 std::shared_ptr<SplashFontFile> SplashFTFontFile::loadTrueTypeFont(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, std::vector<int> &&codeToGIDA, int faceIndexA)
 {
-    FT_Face faceA;
-
-    if (src->isFile()) {
-        if (ft_new_face_from_file(engineA->lib, src->fileName().c_str(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
-    } else {
-        if (FT_New_Memory_Face(engineA->lib, static_cast<const FT_Byte *>(src->buf().data()), src->buf().size(), faceIndexA, &faceA)) {
-            return nullptr;
-        }
+    std::shared_ptr<SplashFTFace> faceA = SplashFTFace::get(std::move(src), faceIndexA);
+    if (!faceA) {
+        return nullptr;
     }
 
-    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(src), faceA, std::move(codeToGIDA), true, false);
+    return std::make_shared<SplashFTFontFile>(engineA, std::move(idA), std::move(faceA), std::move(codeToGIDA), true, false);
 }
 
-SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> srcA, FT_Face faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/)
-    : SplashFontFile(std::move(idA), std::move(srcA))
+SplashFTFontFile::SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::shared_ptr<SplashFTFace> faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/)
+    : SplashFontFile(std::move(idA), nullptr)
 {
     engine = engineA;
-    face = faceA;
+    face = std::move(faceA);
     codeToGID = std::move(codeToGIDA);
     trueType = trueTypeA;
     type1 = type1A;
 }
 
-SplashFTFontFile::~SplashFTFontFile()
-{
-    if (face) {
-        FT_Done_Face(face);
-    }
-}
+SplashFTFontFile::~SplashFTFontFile() = default;
 
 SplashFont *SplashFTFontFile::makeFont(const std::array<double, 4> &mat, const std::array<double, 4> &textMat)
 {
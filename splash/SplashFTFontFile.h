@@ -32,10 +32,48 @@
 #include "SplashFontFile.h"
 
 #include <memory>
+#include <mutex>
 
 class SplashFontFileID;
 class SplashFTFontEngine;
 
+//------------------------------------------------------------------------
+// SplashFTFace
+//------------------------------------------------------------------------
+
+// A FreeType face, shared by all the SplashFTFontFile objects (of any
+// document in the process) that were loaded from the same font program.
+// FreeType faces are not thread safe, so <mutex> must be held while
+// using <ftFace>.
+class SplashFTFace
+{
+    class PrivateTag
+    {
+    };
+
+public:
+    // Return the face for <srcA>, either from the process-wide face cache
+    // or by loading a new one.
+    static std::shared_ptr<SplashFTFace> get(std::unique_ptr<SplashFontSrc> srcA, int faceIndexA);
+
+    SplashFTFace(FT_Face ftFaceA, std::unique_ptr<SplashFontSrc> srcA, int faceIndexA, size_t hashA, PrivateTag /*unused*/ = {});
+    ~SplashFTFace();
+
+    SplashFTFace(const SplashFTFace &) = delete;
+    SplashFTFace &operator=(const SplashFTFace &) = delete;
+
+    FT_Face ftFace;
+    std::mutex mutex;
+
+private:
+    bool matches(const SplashFontSrc &srcA, int faceIndexA) const;
+    size_t getSize() const;
+
+    const std::unique_ptr<SplashFontSrc> src; // font data, must outlive ftFace
+    const int faceIndex;
+    const size_t hash; // key in the face cache
+};
+
 //------------------------------------------------------------------------
 // SplashFTFontFile
 //------------------------------------------------------------------------
@@ -57,11 +95,11 @@ public:
     // file.
     SplashFont *makeFont(const std::array<double, 4> &mat, const std::array<double, 4> &textMat) override;
 
-    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::unique_ptr<SplashFontSrc> src, FT_Face faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/ = {});
+    SplashFTFontFile(SplashFTFontEngine *engineA, std::unique_ptr<SplashFontFileID> idA, std::shared_ptr<SplashFTFace> faceA, std::vector<int> &&codeToGIDA, bool trueTypeA, bool type1A, PrivateTag /*unused*/ = {});
 
 private:
     SplashFTFontEngine *engine;
-    FT_Face face;
+    std::shared_ptr<SplashFTFace> face;
     std::vector<int> codeToGID;
     bool trueType;
     bool type1;
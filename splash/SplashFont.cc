@@ -22,15 +22,22 @@
 
 #include <config.h>
 
+#include <atomic>
 #include <climits>
 #include <cstring>
 #include "goo/gmem.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashPath.h"
 #include "SplashFontFile.h"
 #include "SplashFont.h"
 
 //------------------------------------------------------------------------
 
+static std::atomic<unsigned long long> glyphPathCacheHits = 0;
+static std::atomic<unsigned long long> glyphPathCacheMisses = 0;
+
+//------------------------------------------------------------------------
+
 struct SplashFontCacheTag
 {
     int c;
@@ -50,6 +57,7 @@ SplashFont::SplashFont(const std::shared_ptr<SplashFontFile> &fontFileA, const s
 
     cache = nullptr;
     cacheTags = nullptr;
+    largeGlyphs = false;
 
     xMin = yMin = xMax = yMax = 0;
 }
@@ -72,6 +80,15 @@ void SplashFont::initCache()
         }
     }
 
+    // very large glyphs are filled as paths, so don't waste memory on
+    // a bitmap cache for them
+    if (glyphSize < 0 || glyphSize > splashFontMaxGlyphBitmapSize) {
+        largeGlyphs = true;
+        cacheSets = 1;
+        cacheAssoc = 0;
+        return;
+    }
+
     // set up the glyph pixmap cache
     cacheAssoc = 8;
     if (glyphSize <= 64) {
@@ -208,3 +225,38 @@ bool SplashFont::getGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap
     }
     return true;
 }
+
+SplashPath *SplashFont::getGlyphPath(int c)
+{
+    SplashPath *path;
+
+    // check the cache
+    auto it = pathCache.find(c);
+    if (it != pathCache.end()) {
+        ++glyphPathCacheHits;
+        path = new SplashPath();
+        path->append(it->second.get());
+        return path;
+    }
+    ++glyphPathCacheMisses;
+
+    // decompose the glyph outline
+    if (!(path = makeGlyphPath(c))) {
+        return nullptr;
+    }
+
+    // insert a copy in the cache; it is simply flushed when full
+    if (pathCache.size() >= splashFontMaxCachedGlyphPaths) {
+        pathCache.clear();
+    }
+    auto cachedPath = std::make_unique<SplashPath>();
+    cachedPath->append(path);
+    pathCache.emplace(c, std::move(cachedPath));
+    return path;
+}
+
+void SplashFont::getGlyphPathCacheStats(unsigned long long *hits, unsigned long long *misses)
+{
+    *hits = glyphPathCacheHits;
+    *misses = glyphPathCacheMisses;
+}
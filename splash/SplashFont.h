@@ -28,6 +28,8 @@
 #include "poppler_private_export.h"
 
 #include <array>
+#include <memory>
+#include <unordered_map>
 
 struct SplashGlyphBitmap;
 struct SplashFontCacheTag;
@@ -42,6 +44,13 @@ static int constexpr splashFontFractionBits = 2;
 static int constexpr splashFontFraction = 1 << splashFontFractionBits;
 static double constexpr splashFontFractionMul = static_cast<double>(1) / static_cast<double>(splashFontFraction);
 
+// Glyphs whose bitmaps would need more than this many bytes are not
+// rasterized into the glyph cache; they are filled as paths instead.
+static int constexpr splashFontMaxGlyphBitmapSize = 1 << 20;
+
+// Maximum number of decomposed glyph outlines kept per font.
+static size_t constexpr splashFontMaxCachedGlyphPaths = 512;
+
 //------------------------------------------------------------------------
 // SplashFont
 //------------------------------------------------------------------------
@@ -81,8 +90,21 @@ public:
     // as described for getGlyph.
     virtual bool makeGlyph(int c, int xFrac, int yFrac, SplashGlyphBitmap *bitmap, int x0, int y0, const SplashClip &clip, SplashClipResult *clipRes) = 0;
 
+    // Get the path for a glyph - this does a cache lookup first, and
+    // if not found, creates a new path and adds it to the cache.  The
+    // caller owns the returned path.
+    SplashPath *getGlyphPath(int c);
+
     // Return the path for a glyph.
-    virtual SplashPath *getGlyphPath(int c) = 0;
+    virtual SplashPath *makeGlyphPath(int c) = 0;
+
+    // Return true if the glyph bitmaps of this font are too large to be
+    // cached, in which case glyphs should be filled with getGlyphPath.
+    bool hasLargeGlyphs() const { return largeGlyphs; }
+
+    // Return the number of glyph path cache hits and misses, summed over
+    // all fonts.
+    static void getGlyphPathCacheStats(unsigned long long *hits, unsigned long long *misses);
 
     // Return the advance of a glyph. (in 0..1 range)
     // < 0 means not known
@@ -112,6 +134,8 @@ protected:
     int glyphSize; // size of glyph bitmaps, in bytes
     int cacheSets; // number of sets in cache
     int cacheAssoc; // cache associativity (glyphs per set)
+    bool largeGlyphs; // glyphs are too large for the bitmap cache
+    std::unordered_map<int, std::unique_ptr<SplashPath>> pathCache; // glyph path cache
 };
 
 #endif
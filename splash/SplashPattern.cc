@@ -31,6 +31,14 @@ SplashPattern::SplashPattern() = default;
 
 SplashPattern::~SplashPattern() = default;
 
+void SplashPattern::getColorSpan(int x0, int x1, int y, SplashColorPtr c, bool *valid) const
+{
+    for (int x = x0; x <= x1; ++x) {
+        *valid++ = getColor(x, y, c);
+        c += splashMaxColorComps;
+    }
+}
+
 //------------------------------------------------------------------------
 // SplashSolidColor
 //------------------------------------------------------------------------
@@ -46,6 +46,12 @@ public:
     // Return the color value for a specific pixel.
     virtual bool getColor(int x, int y, SplashColorPtr c) const = 0;
 
+    // Return the color values for the pixels <x0>..<x1> of row <y>.  The
+    // colors are stored splashMaxColorComps bytes apart in <c>, and
+    // <valid> is set to what getColor would have returned for each
+    // pixel.  The default implementation calls getColor for each pixel.
+    virtual void getColorSpan(int x0, int x1, int y, SplashColorPtr c, bool *valid) const;
+
     // Test if x,y-position is inside pattern.
     virtual bool testPosition(int x, int y) const = 0;
 
@@ -0,0 +1,270 @@
+//========================================================================
+//
+// decrypt-test.cc
+//
+// Checks the AES decryption, the revision 6 key computation and SHA-256
+// against known answers, once with the AES and SHA-256 instructions of
+// the CPU and once with the portable code.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "Decrypt.h"
+#include "Object.h"
+#include "Stream.h"
+#include "goo/GooString.h"
+
+static std::string fromHex(const char *hex)
+{
+    std::string bytes;
+    for (; hex[0] && hex[1]; hex += 2) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        bytes.push_back(static_cast<char>(byte));
+    }
+    return bytes;
+}
+
+// The test messages and plain texts.
+static std::string makeData(int length, int mul, int add)
+{
+    std::string data;
+    for (int i = 0; i < length; ++i) {
+        data.push_back(static_cast<char>((i * mul + add) & 0xff));
+    }
+    return data;
+}
+
+//------------------------------------------------------------------------
+// SHA-256
+//------------------------------------------------------------------------
+
+// The padding takes one block up to 55 bytes and two from 56, and the
+// full blocks are hashed separately from 64 bytes.
+static bool checkSHA256()
+{
+    static const struct
+    {
+        int length;
+        const char *hash;
+    } tests[] = {
+        { 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { 55, "2900465fcb533e05a158fd2b3be0e5e3b03740d83060aa3580e0d98a96bf2384" },
+        { 56, "31454ff48ef36af2f08fd511bdc37d9d5855ac23e992e5ff5445cb6b7674a674" },
+        { 63, "5f6401b96532c36de4e65beec0409b69b1d181864c8009b7a04f43e5d56350d1" },
+        { 64, "94eb5de4943613fd048dc93393ab06877405faa39c11f53e9386083339833e7e" },
+        { 65, "fc518669b6eb4b4dd91827ecacef86689c725bd5bab888fd3b26dbb196eec954" },
+        { 200, "5e48d64839a8bff5e2471507af6a49f9990817df437857f4a2007df41266e1b5" },
+    };
+
+    bool ok = true;
+    for (const auto &test : tests) {
+        const std::string msg = makeData(test.length, 37, 11);
+        unsigned char hash[32];
+        sha256(reinterpret_cast<const unsigned char *>(msg.data()), test.length, hash);
+        if (std::string(reinterpret_cast<char *>(hash), 32) != fromHex(test.hash)) {
+            fprintf(stderr, "SHA-256 of %d bytes is wrong\n", test.length);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// AES decryption
+//------------------------------------------------------------------------
+
+static const char *const aesIV = "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf";
+
+// The file keys; the AES-128 object key is derived from it for object 7.
+static void getFileKey(CryptAlgorithm algo, unsigned char *fileKey)
+{
+    for (int i = 0; i < 32; ++i) {
+        fileKey[i] = static_cast<unsigned char>(algo == cryptAES ? i : 0x20 + i);
+    }
+}
+
+// Decrypt the IV followed by <cipherText>, with getChar() or getChars().
+static std::string decrypt(CryptAlgorithm algo, const std::string &cipherText, bool useGetChars)
+{
+    unsigned char fileKey[32];
+    getFileKey(algo, fileKey);
+    const std::string data = fromHex(aesIV) + cipherText;
+    DecryptStream str(std::make_unique<MemStream>(data.data(), 0, data.size(), Object::null()), fileKey, algo, algo == cryptAES ? 16 : 32, { 7, 0 });
+    if (!str.rewind()) {
+        return {};
+    }
+
+    std::string plainText;
+    if (useGetChars) {
+        unsigned char buf[1000];
+        int n;
+        while ((n = str.doGetChars(sizeof(buf), buf)) > 0) {
+            plainText.append(reinterpret_cast<char *>(buf), n);
+        }
+    } else {
+        int c;
+        while ((c = str.getChar()) != EOF) {
+            plainText.push_back(static_cast<char>(c));
+        }
+    }
+    return plainText;
+}
+
+static bool checkAESDecrypt()
+{
+    // PKCS#7 padded; 32 bytes get a block of padding, and 75 bytes
+    // take more than the 4 blocks that are decrypted together.
+    static const struct
+    {
+        CryptAlgorithm algo;
+        int length;
+        const char *cipherText;
+    } tests[] = {
+        { cryptAES, 13, "5c184efd132499a8fe256598e23364cc" },
+        { cryptAES, 32, "b505eaf89b11fdca26a4fddc839f120fcb8ced1882eedbd07cceab963f309708"
+                        "75137e739a9f9e222ba5e9303de1faf2" },
+        { cryptAES, 75, "b505eaf89b11fdca26a4fddc839f120fcb8ced1882eedbd07cceab963f309708"
+                        "511aaeb422fdd95b5ef2091fb14976736ff09429ccd8746e35da5fbd5843ddb8"
+                        "7716d7d691094c13303a98e4714ce11d" },
+        { cryptAES256, 13, "d5062558d9aedabb0b9b9d1a9a0b951e" },
+        { cryptAES256, 32, "5e424975ea183d61d512fca0f482a40d56f725382e68edd7fee853a5115e9ab5"
+                           "f173d918edc63de8f702cde21c0ee029" },
+        { cryptAES256, 75, "5e424975ea183d61d512fca0f482a40d56f725382e68edd7fee853a5115e9ab5"
+                           "21926424bc17284142804d6c7fbd8326300dada427adf2902f17267992981f3f"
+                           "cee2bbac77e4b59d2295795b90b761d8" },
+    };
+
+    bool ok = true;
+    for (const auto &test : tests) {
+        const std::string plainText = makeData(test.length, 13, 5);
+        for (bool useGetChars : { false, true }) {
+            if (decrypt(test.algo, fromHex(test.cipherText), useGetChars) != plainText) {
+                fprintf(stderr, "AES-%d decryption of %d bytes is wrong\n", test.algo == cryptAES ? 128 : 256, test.length);
+                ok = false;
+            }
+        }
+    }
+
+    // An incomplete last block is dropped, and the padding isn't removed.
+    const std::string truncated = fromHex(tests[2].cipherText).substr(0, 72);
+    // The last bytes of these decrypt to 0 and 17, which are treated as
+    // a block of padding.
+    const std::string badPadding[] = { fromHex("b505eaf89b11fdca26a4fddc839f120f4e0a09154e3dbc59f61dc79b29e29b07"), fromHex("b505eaf89b11fdca26a4fddc839f120f069b13bd00f87372c3c6406653199d86") };
+    for (bool useGetChars : { false, true }) {
+        if (decrypt(cryptAES, truncated, useGetChars) != makeData(64, 13, 5)) {
+            fprintf(stderr, "AES decryption of an incomplete last block is wrong\n");
+            ok = false;
+        }
+        for (const std::string &cipherText : badPadding) {
+            if (decrypt(cryptAES, cipherText, useGetChars) != makeData(16, 13, 5)) {
+                fprintf(stderr, "AES decryption with bad padding is wrong\n");
+                ok = false;
+            }
+        }
+        if (!decrypt(cryptAES, {}, useGetChars).empty()) {
+            fprintf(stderr, "AES decryption of an empty stream is wrong\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Encrypt and decrypt more than the decryption buffer, which getChars()
+// then decrypts straight into its buffer.
+static bool checkAESRoundTrip()
+{
+    bool ok = true;
+    for (CryptAlgorithm algo : { cryptAES, cryptAES256 }) {
+        unsigned char fileKey[32];
+        getFileKey(algo, fileKey);
+        const std::string plainText = makeData(20000, 7, 1);
+        EncryptStream encStr(std::make_unique<MemStream>(plainText.data(), 0, plainText.size(), Object::null()), fileKey, algo, algo == cryptAES ? 16 : 32, { 7, 0 });
+        std::string data;
+        if (encStr.rewind()) {
+            int c;
+            while ((c = encStr.getChar()) != EOF) {
+                data.push_back(static_cast<char>(c));
+            }
+        }
+
+        DecryptStream decStr(std::make_unique<MemStream>(data.data(), 0, data.size(), Object::null()), fileKey, algo, algo == cryptAES ? 16 : 32, { 7, 0 });
+        std::string result;
+        if (decStr.rewind()) {
+            std::string buf(10000, '\0');
+            int n;
+            while ((n = decStr.doGetChars(static_cast<int>(buf.size()), reinterpret_cast<unsigned char *>(buf.data()))) > 0) {
+                result.append(buf, 0, n);
+            }
+        }
+        if (result != plainText) {
+            fprintf(stderr, "AES-%d round trip of %zu bytes is wrong\n", algo == cryptAES ? 128 : 256, plainText.size());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+//------------------------------------------------------------------------
+// Revision 6 file key
+//------------------------------------------------------------------------
+
+// Algorithm 2.B encrypts with AES-128 in CBC mode, a few kilobytes at a
+// time.  The dictionary entries are for the passwords "owner" and "user".
+static bool checkRevision6()
+{
+    const GooString ownerKey(fromHex("7e1314d50a58a555c4f7b9cf875a1981c87fca8fcde1587f76a28fcfdf5e00d3"
+                                     "21222324252627283132333435363738"));
+    const GooString userKey(fromHex("17424b40ead366f7ddef0ff073608aa68ba701714b5cef3409b94c4ffa763726"
+                                    "01020304050607081112131415161718"));
+    const GooString ownerEnc(fromHex("f3bb857a9fbf5a729819b5e923c70e898c8dc796c250c1c357eee2939f5178c6"));
+    const GooString userEnc(fromHex("25f821921a06c32bd81fb44591b83e24776e996cdff2ba9e2648d6fa50aad89c"));
+    const GooString fileID("0123456789abcdef");
+    const std::string expectedKey = fromHex("030e19242f3a45505b66717c87929da8b3bec9d4dfeaf5000b16212c37424d58");
+
+    const GooString owner("owner");
+    const GooString user("user");
+    const GooString wrong("wrong");
+    const struct
+    {
+        const GooString *ownerPassword;
+        const GooString *userPassword;
+        bool result;
+        bool ownerPasswordOk;
+    } tests[] = {
+        { &owner, nullptr, true, true },
+        { &wrong, &user, true, false },
+        { &wrong, &wrong, false, false },
+    };
+
+    bool ok = true;
+    for (const auto &test : tests) {
+        unsigned char fileKey[32];
+        bool ownerPasswordOk;
+        const bool result = Decrypt::makeFileKey(6, 32, &ownerKey, &userKey, &ownerEnc, &userEnc, -4, &fileID, test.ownerPassword, test.userPassword, fileKey, true, &ownerPasswordOk);
+        if (result != test.result || ownerPasswordOk != test.ownerPasswordOk || (result && std::string(reinterpret_cast<char *>(fileKey), 32) != expectedKey)) {
+            fprintf(stderr, "Revision 6 file key for the passwords %s and %s is wrong\n", test.ownerPassword ? test.ownerPassword->c_str() : "(none)", test.userPassword ? test.userPassword->c_str() : "(none)");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    for (bool enabled : { true, false }) {
+        Decrypt::setCPUInstructionsEnabled(enabled);
+        const bool passed = checkSHA256() & checkAESDecrypt() & checkAESRoundTrip() & checkRevision6();
+        if (!passed) {
+            fprintf(stderr, "The checks failed with the CPU instructions %s\n", enabled ? "enabled" : "disabled");
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
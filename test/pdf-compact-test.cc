@@ -0,0 +1,494 @@
+//========================================================================
+//
+// pdf-compact-test.cc
+//
+// Saves generated documents in compact mode (writeCompact), reloads
+// them and compares them with the original: pages, text, document
+// information and the objects reachable from the catalog.  Also checks
+// that identical streams are written once, and that encrypted documents
+// are written with the complete rewrite instead.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "GlobalParams.h"
+#include "Object.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "XRef.h"
+#include "goo/GooString.h"
+
+#include "test-pdf-builder.h"
+
+//------------------------------------------------------------------------
+// RC4 and MD5, for the Standard security handler (revision 2)
+//------------------------------------------------------------------------
+
+static std::string rc4(const std::string &key, const std::string &data)
+{
+    unsigned char s[256];
+    for (int i = 0; i < 256; ++i) {
+        s[i] = static_cast<unsigned char>(i);
+    }
+    for (int i = 0, j = 0; i < 256; ++i) {
+        j = (j + s[i] + static_cast<unsigned char>(key[i % key.size()])) & 0xff;
+        std::swap(s[i], s[j]);
+    }
+    std::string out(data);
+    for (size_t k = 0, i = 0, j = 0; k < out.size(); ++k) {
+        i = (i + 1) & 0xff;
+        j = (j + s[i]) & 0xff;
+        std::swap(s[i], s[j]);
+        out[k] = static_cast<char>(out[k] ^ s[(s[i] + s[j]) & 0xff]);
+    }
+    return out;
+}
+
+static std::string md5(const std::string &msg)
+{
+    static const uint32_t k[64] = { 0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+                                    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+                                    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+                                    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+    static const int r[64] = { 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+                               4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21 };
+
+    std::string data(msg);
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56) {
+        data.push_back(0);
+    }
+    const uint64_t bits = static_cast<uint64_t>(msg.size()) * 8;
+    for (int i = 0; i < 8; ++i) {
+        data.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = 0;
+            for (int j = 0; j < 4; ++j) {
+                w[i] |= static_cast<uint32_t>(static_cast<unsigned char>(data[block + 4 * i + j])) << (8 * j);
+            }
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t f;
+            int g;
+            if (i < 16) {
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if (i < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            } else if (i < 48) {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            const uint32_t t = d;
+            d = c;
+            c = b;
+            const uint32_t x = a + f + k[i] + w[g];
+            b = b + ((x << r[i]) | (x >> (32 - r[i])));
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+    }
+
+    std::string digest;
+    for (uint32_t x : h) {
+        for (int j = 0; j < 4; ++j) {
+            digest.push_back(static_cast<char>((x >> (8 * j)) & 0xff));
+        }
+    }
+    return digest;
+}
+
+static const unsigned char passwordPad[32] = { 0x28, 0xbf, 0x4e, 0x5e, 0x4e, 0x75, 0x8a, 0x41, 0x64, 0x00, 0x4e, 0x56, 0xff, 0xfa, 0x01, 0x08,
+                                               0x2e, 0x2e, 0x00, 0xb6, 0xd0, 0x68, 0x3e, 0x80, 0x2f, 0x0c, 0xa9, 0xfe, 0x64, 0x53, 0x69, 0x7a };
+
+static std::string padPassword(const std::string &password)
+{
+    std::string padded = password.substr(0, 32);
+    padded.append(reinterpret_cast<const char *>(passwordPad), 32 - padded.size());
+    return padded;
+}
+
+static std::string hexString(const std::string &s)
+{
+    std::string hex = "<";
+    char buf[3];
+    for (char c : s) {
+        snprintf(buf, sizeof(buf), "%02x", static_cast<unsigned char>(c));
+        hex += buf;
+    }
+    return hex + ">";
+}
+
+//------------------------------------------------------------------------
+// test documents
+//------------------------------------------------------------------------
+
+struct TestObject
+{
+    std::string dict; // the object, or the dictionary of a stream
+    std::optional<std::string> data = {}; // the stream data
+    std::optional<std::string> title = {}; // for the document information dictionary
+    int lengthNum = 0; // if not 0, the object with the /Length of the stream
+};
+
+// Three pages which show the same image through three identical image
+// streams, and page 3 also shows a different one with the same
+// dictionary.  The /Length of the contents of page 1 is object 15, and
+// object 14 isn't referenced at all.
+static std::vector<TestObject> makeTestObjects()
+{
+    std::string image(4 * 4 * 3, '\0');
+    for (size_t i = 0; i < image.size(); ++i) {
+        image[i] = static_cast<char>(i * 7);
+    }
+    std::string otherImage(image);
+    otherImage[0] = 'x';
+    const std::string imageDict = "<< /Type /XObject /Subtype /Image /Width 4 /Height 4 /ColorSpace /DeviceRGB /BitsPerComponent 8 >>";
+
+    std::vector<TestObject> objs;
+    objs.push_back({ .dict = "<< /Type /Catalog /Pages 2 0 R >>" });
+    objs.push_back({ .dict = "<< /Type /Pages /Kids [3 0 R 4 0 R 5 0 R] /Count 3 >>" });
+    for (int i = 0; i < 3; ++i) {
+        std::string xobjects = "/Im " + std::to_string(7 + i) + " 0 R";
+        if (i == 2) {
+            xobjects += " /Im2 13 0 R";
+        }
+        objs.push_back({ .dict = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 6 0 R >> /XObject << " + xobjects + " >> >> /Contents " + std::to_string(10 + i) + " 0 R >>" });
+    }
+    objs.push_back({ .dict = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>" });
+    for (int i = 0; i < 3; ++i) {
+        objs.push_back({ .dict = imageDict, .data = image });
+    }
+    std::string firstContents;
+    for (int i = 0; i < 3; ++i) {
+        const std::string contents = "BT /F1 12 Tf 72 700 Td (Text on page " + std::to_string(i + 1) + ") Tj ET q 40 0 0 40 72 600 cm /Im Do Q" + (i == 2 ? " q 40 0 0 40 200 600 cm /Im2 Do Q" : "");
+        objs.push_back({ .dict = "<< >>", .data = contents, .lengthNum = i == 0 ? 15 : 0 });
+        if (i == 0) {
+            firstContents = contents;
+        }
+    }
+    objs.push_back({ .dict = imageDict, .data = otherImage });
+    objs.push_back({ .dict = "<< /Unused true >>" });
+    objs.push_back({ .dict = std::to_string(firstContents.size()) });
+    objs.push_back({ .dict = "<< /Title %s >>", .title = "Compact test" });
+    return objs;
+}
+
+static bool writeTestDocument(const std::string &fileName, bool encrypt)
+{
+    std::vector<TestObject> objs = makeTestObjects();
+    const int infoNum = static_cast<int>(objs.size());
+    const std::string fileID = "0123456789abcdef";
+    const int permissions = -4;
+    std::string fileKey;
+    std::string trailerExtra;
+
+    if (encrypt) {
+        // revision 2, 40-bit RC4, with an empty user password
+        const std::string ownerKey = rc4(md5(padPassword("owner")).substr(0, 5), padPassword(""));
+        std::string keyData = padPassword("") + ownerKey;
+        for (int i = 0; i < 4; ++i) {
+            keyData.push_back(static_cast<char>((static_cast<uint32_t>(permissions) >> (8 * i)) & 0xff));
+        }
+        fileKey = md5(keyData + fileID).substr(0, 5);
+        const std::string userKey = rc4(fileKey, padPassword(""));
+        objs.push_back({ .dict = "<< /Filter /Standard /V 1 /R 2 /Length 40 /P " + std::to_string(permissions) + " /O " + hexString(ownerKey) + " /U " + hexString(userKey) + " >>" });
+        trailerExtra = " /Encrypt " + std::to_string(objs.size()) + " 0 R";
+    }
+
+    TestPDFBuilder builder;
+    for (const TestObject &obj : objs) {
+        const int num = builder.getNextNum();
+        std::string objKey;
+        if (encrypt) {
+            std::string keyData = fileKey;
+            keyData.push_back(static_cast<char>(num & 0xff));
+            keyData.push_back(static_cast<char>((num >> 8) & 0xff));
+            keyData.push_back(static_cast<char>((num >> 16) & 0xff));
+            keyData.push_back(0);
+            keyData.push_back(0);
+            objKey = md5(keyData).substr(0, 10);
+        }
+        std::string dict = obj.dict;
+        if (obj.title) {
+            dict.replace(dict.find("%s"), 2, hexString(encrypt ? rc4(objKey, *obj.title) : *obj.title));
+        }
+        if (obj.data && obj.lengthNum) {
+            dict.insert(dict.rfind(">>"), "/Length " + std::to_string(obj.lengthNum) + " 0 R ");
+            builder.addObject(dict + "\nstream\n" + (encrypt ? rc4(objKey, *obj.data) : *obj.data) + "\nendstream");
+        } else if (obj.data) {
+            builder.addStream(dict, encrypt ? rc4(objKey, *obj.data) : *obj.data);
+        } else {
+            builder.addObject(dict);
+        }
+    }
+    return builder.writeFile(fileName, "/Root 1 0 R /Info " + std::to_string(infoNum) + " 0 R /ID [" + hexString(fileID) + hexString(fileID) + "]" + trailerExtra);
+}
+
+//------------------------------------------------------------------------
+// comparison
+//------------------------------------------------------------------------
+
+// Compares two object graphs; the object numbers may differ, so
+// references are compared by comparing the objects they point to.
+class GraphComparer
+{
+public:
+    GraphComparer(XRef *xrefA, XRef *xrefB) : origXRef(xrefA), newXRef(xrefB) { }
+
+    bool compare(const Object &objA, const Object &objB);
+
+private:
+    bool compareStreams(Stream *strA, Stream *strB);
+
+    XRef *origXRef;
+    XRef *newXRef;
+    std::map<int, int> followedRefs; // original object number -> new object number
+};
+
+bool GraphComparer::compare(const Object &objA, const Object &objB)
+{
+    if (objA.isRef()) {
+        Object origObj = origXRef->fetch(objA.getRef());
+        if (!objB.isRef()) {
+            // references to missing objects are written as null
+            return objB.isNull() && origObj.isNull();
+        }
+        const auto [it, inserted] = followedRefs.emplace(objA.getRef().num, objB.getRef().num);
+        if (!inserted) {
+            return it->second == objB.getRef().num;
+        }
+        return compare(origObj, newXRef->fetch(objB.getRef()));
+    }
+    if (objA.getType() != objB.getType()) {
+        return false;
+    }
+    switch (objA.getType()) {
+    case objBool:
+        return objA.getBool() == objB.getBool();
+    case objInt:
+        return objA.getInt() == objB.getInt();
+    case objReal:
+        return objA.getReal() == objB.getReal();
+    case objString:
+        return objA.getString() == objB.getString();
+    case objName:
+        return strcmp(objA.getName(), objB.getName()) == 0;
+    case objNull:
+        return true;
+    case objArray:
+        if (objA.arrayGetLength() != objB.arrayGetLength()) {
+            return false;
+        }
+        for (int i = 0; i < objA.arrayGetLength(); ++i) {
+            if (!compare(objA.getArray()->getNF(i), objB.getArray()->getNF(i))) {
+                return false;
+            }
+        }
+        return true;
+    case objDict:
+        if (objA.dictGetLength() != objB.dictGetLength()) {
+            return false;
+        }
+        for (int i = 0; i < objA.dictGetLength(); ++i) {
+            if (!compare(objA.getDict()->getValNF(i), objB.getDict()->lookupNF(objA.getDict()->getKey(i)))) {
+                return false;
+            }
+        }
+        return true;
+    case objStream:
+        return compareStreams(objA.getStream(), objB.getStream());
+    default:
+        return false;
+    }
+}
+
+bool GraphComparer::compareStreams(Stream *strA, Stream *strB)
+{
+    // the /Length of the streams may differ
+    Dict *dictA = strA->getDict();
+    Dict *dictB = strB->getDict();
+    for (int i = 0; i < dictA->getLength(); ++i) {
+        const std::string &key = dictA->getKey(i);
+        if (key != "Length" && !compare(dictA->getValNF(i), dictB->lookupNF(key))) {
+            return false;
+        }
+    }
+    if (!strA->rewind() || !strB->rewind()) {
+        return false;
+    }
+    int c;
+    do {
+        c = strA->getChar();
+        if (c != strB->getChar()) {
+            return false;
+        }
+    } while (c != EOF);
+    return true;
+}
+
+static std::string pageText(PDFDoc *doc, int pg)
+{
+    TextOutputDev textOut(nullptr, false, 0, false, false);
+    doc->displayPage(&textOut, pg, 72, 72, 0, false, true, false);
+    return textOut.getText(std::nullopt).toStr();
+}
+
+static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
+{
+    bool ok = true;
+
+    if (newDoc->getNumPages() != origDoc->getNumPages()) {
+        fprintf(stderr, "%d pages instead of %d\n", newDoc->getNumPages(), origDoc->getNumPages());
+        return false;
+    }
+    for (int pg = 1; pg <= origDoc->getNumPages(); ++pg) {
+        const std::string text = pageText(origDoc, pg);
+        if (text.empty() || pageText(newDoc, pg) != text) {
+            fprintf(stderr, "The text of page %d differs\n", pg);
+            ok = false;
+        }
+    }
+    if (newDoc->getDocInfoTitle() != origDoc->getDocInfoTitle()) {
+        fprintf(stderr, "The document title differs\n");
+        ok = false;
+    }
+
+    XRef *origXRef = origDoc->getXRef();
+    XRef *newXRef = newDoc->getXRef();
+    GraphComparer comparer(origXRef, newXRef);
+    if (!comparer.compare(Object(Ref { .num = origXRef->getRootNum(), .gen = origXRef->getRootGen() }), Object(Ref { .num = newXRef->getRootNum(), .gen = newXRef->getRootGen() }))) {
+        fprintf(stderr, "The objects reachable from the catalog differ\n");
+        ok = false;
+    }
+    return ok;
+}
+
+static Ref pageXObjectRef(PDFDoc *doc, int pg, const char *name)
+{
+    Dict *resources = doc->getPage(pg)->getResourceDict();
+    const Object xobjects = resources->lookup("XObject");
+    if (!xobjects.isDict()) {
+        return Ref::INVALID();
+    }
+    const Object &ref = xobjects.getDict()->lookupNF(name);
+    return ref.isRef() ? ref.getRef() : Ref::INVALID();
+}
+
+static int countCompressedObjects(PDFDoc *doc)
+{
+    XRef *xref = doc->getXRef();
+    int n = 0;
+    for (int i = 0; i < xref->getNumObjects(); ++i) {
+        if (xref->getEntry(i)->type == xrefEntryCompressed) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------
+
+static bool runTest(const std::string &workDir, bool encrypt)
+{
+    const char *what = encrypt ? "encrypted" : "plain";
+    const std::string inFile = workDir + "/pdf-compact-test-" + what + ".pdf";
+    const std::string outFile = workDir + "/pdf-compact-test-" + what + "-out.pdf";
+
+    if (!writeTestDocument(inFile, encrypt)) {
+        fprintf(stderr, "%s: couldn't write %s\n", what, inFile.c_str());
+        return false;
+    }
+    PDFDoc doc(std::make_unique<GooString>(inFile));
+    if (!doc.isOk() || doc.isEncrypted() != encrypt) {
+        fprintf(stderr, "%s: couldn't load %s\n", what, inFile.c_str());
+        return false;
+    }
+    if (doc.saveAs(outFile, writeCompact) != errNone) {
+        fprintf(stderr, "%s: couldn't save %s\n", what, outFile.c_str());
+        return false;
+    }
+    PDFDoc newDoc(std::make_unique<GooString>(outFile));
+    if (!newDoc.isOk() || newDoc.isEncrypted() != encrypt) {
+        fprintf(stderr, "%s: couldn't load %s\n", what, outFile.c_str());
+        return false;
+    }
+
+    bool ok = compareDocuments(&doc, &newDoc);
+
+    const Ref im1 = pageXObjectRef(&newDoc, 1, "Im");
+    const Ref im2 = pageXObjectRef(&newDoc, 2, "Im");
+    const Ref im3 = pageXObjectRef(&newDoc, 3, "Im");
+    const Ref other = pageXObjectRef(&newDoc, 3, "Im2");
+    if (im1 == Ref::INVALID() || other == Ref::INVALID() || im1 == other) {
+        fprintf(stderr, "%s: the different images were merged\n", what);
+        ok = false;
+    }
+    if (encrypt) {
+        // encrypted documents are written with the complete rewrite, so
+        // nothing is renumbered, merged or compressed
+        if (im1 == im2 || im2 == im3 || newDoc.getXRef()->getNumObjects() != doc.getXRef()->getNumObjects() || countCompressedObjects(&newDoc) != 0) {
+            fprintf(stderr, "%s: the document wasn't written with the complete rewrite\n", what);
+            ok = false;
+        }
+    } else {
+        if (im1 != im2 || im2 != im3) {
+            fprintf(stderr, "%s: the identical images weren't merged\n", what);
+            ok = false;
+        }
+        const Object contents = newDoc.getPage(1)->getContents();
+        if (!contents.isStream() || !contents.getStream()->getDict()->lookupNF("Length").isInt()) {
+            fprintf(stderr, "%s: the indirect /Length of a stream wasn't written directly\n", what);
+            ok = false;
+        }
+        if (countCompressedObjects(&newDoc) == 0) {
+            fprintf(stderr, "%s: no objects were written to object streams\n", what);
+            ok = false;
+        }
+        if (newDoc.getPDFMajorVersion() * 10 + newDoc.getPDFMinorVersion() < 15) {
+            fprintf(stderr, "%s: the header wasn't raised to PDF 1.5\n", what);
+            ok = false;
+        }
+    }
+
+    remove(inFile.c_str());
+    remove(outFile.c_str());
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s WORK-DIR\n", argv[0]);
+        return 1;
+    }
+
+    globalParams = std::make_unique<GlobalParams>();
+
+    bool ok = runTest(argv[1], false);
+    ok = runTest(argv[1], true) && ok;
+    return ok ? 0 : 1;
+}
@@ -10,6 +10,8 @@
 //
 //========================================================================
 
+#include <map>
+
 #include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
@@ -19,17 +21,20 @@
 #include "utils/parseargs.h"
 
 static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc);
+static bool compareDocumentGraphs(PDFDoc *origDoc, PDFDoc *newDoc);
 static bool compareObjects(const Object *objA, const Object *objB);
 
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static bool forceIncremental = false;
+static bool compact = false;
 static bool checkOutput = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = { { .arg = "-opw", .kind = argString, .val = ownerPassword, .size = sizeof(ownerPassword), .usage = "owner password (for encrypted files)" },
                                    { .arg = "-upw", .kind = argString, .val = userPassword, .size = sizeof(userPassword), .usage = "user password (for encrypted files)" },
                                    { .arg = "-i", .kind = argFlag, .val = &forceIncremental, .size = 0, .usage = "incremental update mode" },
+                                   { .arg = "-compact", .kind = argFlag, .val = &compact, .size = 0, .usage = "compact mode (object and xref streams)" },
                                    { .arg = "-check", .kind = argFlag, .val = &checkOutput, .size = 0, .usage = "verify the generated document" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -71,8 +76,8 @@ int main(int argc, char *argv[])
         goto done;
     }
 
-    // save it back (in rewrite or incremental update mode)
-    if (doc->saveAs(argv[2], forceIncremental ? writeForceIncremental : writeForceRewrite) != 0) {
+    // save it back (in rewrite, compact or incremental update mode)
+    if (doc->saveAs(argv[2], forceIncremental ? writeForceIncremental : compact ? writeCompact : writeForceRewrite) != 0) {
         fprintf(stderr, "Error saving document\n");
         res = 1;
         goto done;
@@ -84,7 +89,7 @@ int main(int argc, char *argv[])
         if (!docOut->isOk()) {
             fprintf(stderr, "Error loading generated document\n");
             res = 1;
-        } else if (!compareDocuments(doc, docOut)) {
+        } else if (!(compact ? compareDocumentGraphs(doc, docOut) : compareDocuments(doc, docOut))) {
             fprintf(stderr, "Verification failed\n");
             res = 1;
         }
@@ -96,6 +101,27 @@ done:
     return res;
 }
 
+// In compact mode the objects are renumbered, so references are
+// compared by comparing the objects they point to
+static XRef *origFollowXRef = nullptr;
+static XRef *newFollowXRef = nullptr;
+static std::map<int, int> followedRefs; // original object number -> new object number
+
+static bool compareFollowedRefs(const Object *objA, const Object *objB)
+{
+    Object origObj = origFollowXRef->fetch(objA->getRef());
+    if (!objB->isRef()) {
+        // references to missing objects are written as null
+        return objB->isNull() && origObj.isNull();
+    }
+    const auto [it, inserted] = followedRefs.emplace(objA->getRef().num, objB->getRef().num);
+    if (!inserted) {
+        return it->second == objB->getRef().num;
+    }
+    Object newObj = newFollowXRef->fetch(objB->getRef());
+    return compareObjects(&origObj, &newObj);
+}
+
 static bool compareDictionaries(Dict *dictA, Dict *dictB)
 {
     const int length = dictA->getLength();
@@ -203,6 +229,9 @@ static bool compareObjects(const Object *objA, const Object *objB)
         return true;
     }
     case objRef: {
+        if (origFollowXRef) {
+            return compareFollowedRefs(objA, objB);
+        }
         if (objB->getType() != objRef) {
             return false;
         }
@@ -309,3 +338,29 @@ static bool compareDocuments(PDFDoc *origDoc, PDFDoc *newDoc)
 
     return result;
 }
+
+static bool compareDocumentGraphs(PDFDoc *origDoc, PDFDoc *newDoc)
+{
+    bool result = true;
+    XRef *origXRef = origDoc->getXRef();
+    XRef *newXRef = newDoc->getXRef();
+    origFollowXRef = origXRef;
+    newFollowXRef = newXRef;
+
+    // Compare the objects reachable from the catalog and the document
+    // information dictionary
+    const Object origRoot(Ref { .num = origXRef->getRootNum(), .gen = origXRef->getRootGen() });
+    const Object newRoot(Ref { .num = newXRef->getRootNum(), .gen = newXRef->getRootGen() });
+    if (!compareObjects(&origRoot, &newRoot)) {
+        fprintf(stderr, "Objects reachable from the catalog differ\n");
+        result = false;
+    }
+    const Object origInfo = origXRef->getDocInfoNF();
+    const Object newInfo = newXRef->getDocInfoNF();
+    if (!compareObjects(&origInfo, &newInfo)) {
+        fprintf(stderr, "Objects reachable from the document information dictionary differ\n");
+        result = false;
+    }
+
+    return result;
+}
@@ -33,6 +33,7 @@
 // Not enabled by default.
 // #define COPY_FILE 1
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdarg>
@@ -41,18 +42,25 @@
 #include <cstring>
 #include <cerrno>
 #include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "goo/GooString.h"
 #include "goo/GooTimer.h"
+#include "goo/PNGWriter.h"
 #include "GlobalParams.h"
 #include "splash/SplashBitmap.h"
+#include "splash/SplashFont.h"
 #include "Object.h" /* must be included before SplashOutputDev.h because of sloppiness in SplashOutputDev.h */
 #include "SplashOutputDev.h"
 #include "TextOutputDev.h"
 #include "PDFDoc.h"
+#include "Stream.h"
 #include "Link.h"
+#include "test-pdf-builder.h"
 
 #define dimof(X) (sizeof(X) / sizeof((X)[0]))
 
@@ -112,6 +120,9 @@ constexpr const char *OUT_ARG = "-out";
 constexpr const char *LOAD_ONLY_ARG = "-loadonly";
 constexpr const char *PAGE_ARG = "-page";
 constexpr const char *TEXT_ARG = "-text";
+constexpr const char *TABLE_BENCH_ARG = "-tablebench";
+constexpr const char *SELECTION_BENCH_ARG = "-selectionbench";
+constexpr const char *PNG_BENCH_ARG = "-pngbench";
 
 /* Should we record timings? True if -timings command-line argument was given. */
 static bool gfTimings = false;
@@ -141,6 +152,26 @@ static bool gfRecursive = false;
 /* If true, we only dump the text, not render */
 static bool gfTextOnly = false;
 
+/* If > 0, we time the text layout analysis of a generated page with a table
+   of 'gTableBenchRows' x 'gTableBenchCols' cells, each far enough from its
+   neighbours to end up in a block of its own.
+   Controlled by -tablebench RxC command-line argument */
+static int gTableBenchRows = 0;
+static int gTableBenchCols = 0;
+
+/* If > 0, we time text selections on generated pages with
+   'gSelectionBenchRows' x 'gSelectionBenchCols' words.
+   Controlled by -selectionbench RxC command-line argument */
+static int gSelectionBenchRows = 0;
+static int gSelectionBenchCols = 0;
+
+/* If > 0, we time PNG encoding of a generated 'gPngBenchWidth' x
+   'gPngBenchHeight' RGB page image with libpng and with the chunked
+   encoder on a varying number of threads.
+   Controlled by -pngbench WxH command-line argument */
+static int gPngBenchWidth = 0;
+static int gPngBenchHeight = 0;
+
 constexpr int PAGE_NO_NOT_GIVEN = -1;
 
 /* If equals PAGE_NO_NOT_GIVEN, we're in default mode where we render all pages.
@@ -515,7 +546,7 @@ static void LogInfo(const char *fmt, ...)
 
 static void PrintUsageAndExit(int argc, char **argv)
 {
-    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
+    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-tablebench RxC] [-selectionbench RxC] [-pngbench WxH] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
     for (int i = 0; i < argc; i++) {
         printf("i=%d, '%s'\n", i, argv[i]);
     }
@@ -581,6 +612,197 @@ Exit:
     delete pdfDoc;
 }
 
+/* Make a one page PDF of 'width' x 'height' with the content stream 'content',
+   which can use the font /F1. */
+static std::vector<char> MakePagePdf(const std::string &content, int width, int height)
+{
+    TestPDFBuilder builder;
+    builder.addObject("<< /Type /Catalog /Pages 2 0 R >>");
+    builder.addObject("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    builder.addObject("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + std::to_string(width) + " " + std::to_string(height) + "] /Resources << /Font << /F1 4 0 R >> >> /Contents 5 0 R >>");
+    builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>");
+    builder.addStream("<< >>", content);
+    const std::string pdf = builder.getFile("/Root 1 0 R");
+    return std::vector<char>(pdf.begin(), pdf.end());
+}
+
+static std::vector<char> MakeTablePdf(int rows, int cols)
+{
+    std::string content = "BT /F1 6 Tf\n";
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            content += "1 0 0 1 " + std::to_string(10 + col * 40) + " " + std::to_string(10 + (rows - 1 - row) * 12) + " Tm (" + std::to_string(row * cols + col) + ") Tj\n";
+        }
+    }
+    content += "ET\n";
+    return MakePagePdf(content, 20 + cols * 40, 20 + rows * 12);
+}
+
+/* A single column of 'rows' lines of 'cols' words each, which ends up in one
+   block with many lines. */
+static std::vector<char> MakeColumnPdf(int rows, int cols)
+{
+    std::string content = "BT /F1 6 Tf 8 TL\n1 0 0 1 10 " + std::to_string(10 + (rows - 1) * 8) + " Tm\n";
+    for (int row = 0; row < rows; row++) {
+        content += "(";
+        for (int col = 0; col < cols; col++) {
+            content += (col ? " w" : "w") + std::to_string((row * cols + col) % 1000);
+        }
+        content += ") Tj T*\n";
+    }
+    content += "ET\n";
+    return MakePagePdf(content, 20 + cols * 20, 20 + rows * 8);
+}
+
+static void RunTableBench()
+{
+    LogInfo("started: table %dx%d\n", gTableBenchRows, gTableBenchCols);
+
+    std::vector<char> data = MakeTablePdf(gTableBenchRows, gTableBenchCols);
+    PDFDoc pdfDoc(std::make_unique<MemStream>(data.data(), 0, data.size(), Object::null()));
+    if (!pdfDoc.isOk()) {
+        error(errIO, -1, "RunTableBench(): failed to open generated PDF");
+        return;
+    }
+
+    TextOutputDev textOut(nullptr, true, 0, false, false);
+    if (!textOut.isOk()) {
+        return;
+    }
+
+    GooTimer msTimer;
+    pdfDoc.displayPage(&textOut, 1, 72, 72, 0, false, true, false);
+    GooString txt = textOut.getText(PDFRectangle { 0.0, 0.0, 1.0e6, 1.0e6 });
+    msTimer.stop();
+    LogInfo("table %dx%d: %.2f ms (%zu bytes of text)\n", gTableBenchRows, gTableBenchCols, msTimer.getElapsed() * 1000.0, txt.size());
+    LogInfo("finished: table %dx%d\n", gTableBenchRows, gTableBenchCols);
+}
+
+/* Time selections, selected text and word hit tests on the page in 'data'. */
+static void RunSelectionBench(const char *name, const std::vector<char> &data)
+{
+    PDFDoc pdfDoc(std::make_unique<MemStream>(data.data(), 0, data.size(), Object::null()));
+    if (!pdfDoc.isOk()) {
+        error(errIO, -1, "RunSelectionBench(): failed to open generated PDF");
+        return;
+    }
+
+    TextOutputDev textOut(nullptr, true, 0, false, false);
+    if (!textOut.isOk()) {
+        return;
+    }
+    pdfDoc.displayPage(&textOut, 1, 72, 72, 0, false, true, false);
+    const double width = pdfDoc.getPageMediaWidth(1);
+    const double height = pdfDoc.getPageMediaHeight(1);
+    std::unique_ptr<TextPage> textPage = textOut.takeText();
+
+    // short drags at pseudo-random places, like mouse moves while selecting
+    constexpr int nSelections = 200;
+    unsigned int seed = 1;
+    const auto random = [&seed](double max) {
+        seed = seed * 1103515245 + 12345;
+        return max * ((seed >> 8) & 0xffff) / 0xffff;
+    };
+    size_t nRects = 0, nBytes = 0, nWords = 0;
+    GooTimer msTimer;
+    for (int i = 0; i < nSelections; i++) {
+        const double x = random(width), y = random(height);
+        const PDFRectangle selection(x, y, x + random(100), y + random(30));
+        std::vector<PDFRectangle *> *rects = textPage->getSelectionRegion(selection, selectionStyleGlyph, 1.0);
+        nRects += rects->size();
+        for (PDFRectangle *rect : *rects) {
+            delete rect;
+        }
+        delete rects;
+        nBytes += textPage->getSelectionText(selection, selectionStyleGlyph).size();
+        if (textPage->findWordAt(x, y)) {
+            nWords++;
+        }
+    }
+    msTimer.stop();
+    LogInfo("selection %s: %.3f ms per selection (%zu rects, %zu bytes, %zu words hit)\n", name, msTimer.getElapsed() * 1000.0 / nSelections, nRects, nBytes, nWords);
+}
+
+static void RunSelectionBenches()
+{
+    char name[64];
+
+    LogInfo("started: selections %dx%d\n", gSelectionBenchRows, gSelectionBenchCols);
+    snprintf(name, sizeof(name), "table %dx%d", gSelectionBenchRows, gSelectionBenchCols);
+    RunSelectionBench(name, MakeTablePdf(gSelectionBenchRows, gSelectionBenchCols));
+    snprintf(name, sizeof(name), "column %dx%d", gSelectionBenchRows, gSelectionBenchCols);
+    RunSelectionBench(name, MakeColumnPdf(gSelectionBenchRows, gSelectionBenchCols));
+    LogInfo("finished: selections %dx%d\n", gSelectionBenchRows, gSelectionBenchCols);
+}
+
+#if ENABLE_LIBPNG
+/* Encode 'data' with 'nThreads' compression threads (0 for libpng), handing
+   the rows over in bands the way a banded renderer would. */
+static void RunPngBench(std::vector<unsigned char> &data, int nThreads)
+{
+    constexpr int bandHeight = 256;
+    const int rowSize = 3 * gPngBenchWidth;
+
+    FILE *f = tmpfile();
+    if (!f) {
+        error(errIO, -1, "RunPngBench(): failed to create a temporary file");
+        return;
+    }
+    std::vector<unsigned char *> rows(gPngBenchHeight);
+    for (int y = 0; y < gPngBenchHeight; y++) {
+        rows[y] = data.data() + static_cast<size_t>(y) * rowSize;
+    }
+
+    GooTimer msTimer;
+    PNGWriter writer(PNGWriter::RGB);
+    writer.setCompressionThreads(nThreads);
+    bool ok = writer.init(f, gPngBenchWidth, gPngBenchHeight, 600, 600);
+    for (int y = 0; ok && y < gPngBenchHeight; y += bandHeight) {
+        ok = writer.writeRows(rows.data() + y, std::min(bandHeight, gPngBenchHeight - y));
+    }
+    ok = ok && writer.close();
+    fflush(f);
+    msTimer.stop();
+    LogInfo("png %dx%d, %d threads: %.2f ms (%ld bytes)%s\n", gPngBenchWidth, gPngBenchHeight, nThreads, msTimer.getElapsed() * 1000.0, ftell(f), ok ? "" : " FAILED");
+    fclose(f);
+}
+
+static void RunPngBenches()
+{
+    LogInfo("started: png %dx%d\n", gPngBenchWidth, gPngBenchHeight);
+
+    /* something like a rendered page: white, with a gradient header, lines
+       of small dark marks standing in for text, and a noisy photo */
+    std::vector<unsigned char> data(static_cast<size_t>(gPngBenchWidth) * gPngBenchHeight * 3, 0xff);
+    unsigned int seed = 1;
+    for (int y = 0; y < gPngBenchHeight; y++) {
+        unsigned char *p = data.data() + static_cast<size_t>(y) * gPngBenchWidth * 3;
+        for (int x = 0; x < gPngBenchWidth; x++, p += 3) {
+            seed = seed * 1103515245 + 12345;
+            if (y < gPngBenchHeight / 10) {
+                p[0] = 255 * x / gPngBenchWidth;
+                p[1] = 255 * y / (gPngBenchHeight / 10 + 1);
+                p[2] = 128;
+            } else if (y > gPngBenchHeight * 2 / 3 && x < gPngBenchWidth / 2) {
+                p[0] = (x + y) & 0xff;
+                p[1] = ((x ^ y) + ((seed >> 16) & 0x1f)) & 0xff;
+                p[2] = (seed >> 8) & 0xff;
+            } else if (y % 40 < 24 && x % 17 < 11 && ((seed >> 16) & 3)) {
+                p[0] = p[1] = p[2] = 0x20;
+            }
+        }
+    }
+
+    const int nProcessors = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    RunPngBench(data, 0);
+    for (int nThreads = 1; nThreads < nProcessors; nThreads *= 2) {
+        RunPngBench(data, nThreads);
+    }
+    RunPngBench(data, nProcessors);
+    LogInfo("finished: png %dx%d\n", gPngBenchWidth, gPngBenchHeight);
+}
+#endif
+
 #ifdef _MSC_VER
 #    define POPPLER_TMP_NAME "c:\\poppler_tmp.pdf"
 #else
@@ -593,6 +815,7 @@ static void RenderPdf(const char *fileName)
     PdfEnginePoppler *engineSplash = nullptr;
     int pageCount;
     double timeInMs;
+    unsigned long long pathHits0, pathMisses0, pathHits, pathMisses;
 
 #ifdef COPY_FILE
     // TODO: fails if file already exists and has read-only attribute
@@ -620,6 +843,7 @@ static void RenderPdf(const char *fileName)
         goto Error;
     }
 
+    SplashFont::getGlyphPathCacheStats(&pathHits0, &pathMisses0);
     for (int curPage = 1; curPage <= pageCount; curPage++) {
         if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage)) {
             continue;
@@ -641,6 +865,14 @@ static void RenderPdf(const char *fileName)
 
         delete bmpSplash;
     }
+    if (gfTimings) {
+        SplashFont::getGlyphPathCacheStats(&pathHits, &pathMisses);
+        pathHits -= pathHits0;
+        pathMisses -= pathMisses0;
+        if (pathHits + pathMisses > 0) {
+            LogInfo("glyph path cache: %llu hits, %llu misses (%.1f%% hit rate)\n", pathHits, pathMisses, 100.0 * static_cast<double>(pathHits) / static_cast<double>(pathHits + pathMisses));
+        }
+    }
 Error:
     delete engineSplash;
     LogInfo("finished: %s\n", fileName);
@@ -759,6 +991,30 @@ static void ParseCommandLine(int argc, char **argv)
                 gOutFileName = str_dup(argv[i]);
             } else if (str_ieq(arg, TEXT_ARG)) {
                 gfTextOnly = true;
+            } else if (str_ieq(arg, TABLE_BENCH_ARG)) {
+                ++i;
+                if (i == argc) {
+                    PrintUsageAndExit(argc, argv); /* expect RxC after that */
+                }
+                if (!ParseResolutionString(argv[i], &gTableBenchRows, &gTableBenchCols) || gTableBenchRows < 1 || gTableBenchCols < 1) {
+                    PrintUsageAndExit(argc, argv);
+                }
+            } else if (str_ieq(arg, SELECTION_BENCH_ARG)) {
+                ++i;
+                if (i == argc) {
+                    PrintUsageAndExit(argc, argv); /* expect RxC after that */
+                }
+                if (!ParseResolutionString(argv[i], &gSelectionBenchRows, &gSelectionBenchCols) || gSelectionBenchRows < 1 || gSelectionBenchCols < 1) {
+                    PrintUsageAndExit(argc, argv);
+                }
+            } else if (str_ieq(arg, PNG_BENCH_ARG)) {
+                ++i;
+                if (i == argc) {
+                    PrintUsageAndExit(argc, argv); /* expect WxH after that */
+                }
+                if (!ParseResolutionString(argv[i], &gPngBenchWidth, &gPngBenchHeight) || gPngBenchWidth < 1 || gPngBenchHeight < 1) {
+                    PrintUsageAndExit(argc, argv);
+                }
             } else if (str_ieq(arg, LOAD_ONLY_ARG)) {
                 gfLoadOnly = true;
             } else if (str_ieq(arg, PAGE_ARG)) {
@@ -808,10 +1064,9 @@ int main(int argc, char **argv)
 {
     setErrorCallback(my_error);
     ParseCommandLine(argc, argv);
-    if (0 == StrList_Len(&gArgsListRoot)) {
+    if (0 == StrList_Len(&gArgsListRoot) && gTableBenchRows == 0 && gSelectionBenchRows == 0 && gPngBenchWidth == 0) {
         PrintUsageAndExit(argc, argv);
     }
-    assert(gArgsListRoot);
 
     SplashColorsInit();
     globalParams = std::make_unique<GlobalParams>();
@@ -838,6 +1093,18 @@ int main(int argc, char **argv)
         gErrFile = stderr;
     }
 
+    if (gTableBenchRows > 0) {
+        RunTableBench();
+    }
+    if (gSelectionBenchRows > 0) {
+        RunSelectionBenches();
+    }
+#if ENABLE_LIBPNG
+    if (gPngBenchWidth > 0) {
+        RunPngBenches();
+    }
+#endif
+
     StrList *curr = gArgsListRoot;
     while (curr) {
         RenderCmdLineArg(curr->str);
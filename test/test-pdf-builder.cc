@@ -0,0 +1,51 @@
+//========================================================================
+//
+// test-pdf-builder.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "test-pdf-builder.h"
+
+#include <cstdio>
+
+int TestPDFBuilder::addObject(const std::string &object)
+{
+    offsets.push_back(body.size());
+    const int num = static_cast<int>(offsets.size());
+    body += std::to_string(num) + " 0 obj\n" + object + "\nendobj\n";
+    return num;
+}
+
+int TestPDFBuilder::addStream(const std::string &dict, const std::string &data)
+{
+    std::string object = dict;
+    object.insert(object.rfind(">>"), "/Length " + std::to_string(data.size()) + " ");
+    return addObject(object + "\nstream\n" + data + "\nendstream");
+}
+
+std::string TestPDFBuilder::getFile(const std::string &trailerEntries) const
+{
+    std::string file = body;
+    const size_t xrefOffset = file.size();
+    file += "xref\n0 " + std::to_string(offsets.size() + 1) + "\n0000000000 65535 f \n";
+    for (size_t offset : offsets) {
+        char entry[21];
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+        file += entry;
+    }
+    file += "trailer\n<< /Size " + std::to_string(offsets.size() + 1) + " " + trailerEntries + " >>\nstartxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+    return file;
+}
+
+bool TestPDFBuilder::writeFile(const std::string &fileName, const std::string &trailerEntries) const
+{
+    const std::string file = getFile(trailerEntries);
+    FILE *f = fopen(fileName.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    const bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,44 @@
+//========================================================================
+//
+// test-pdf-builder.h
+//
+// Builds small PDF files for the tests.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEST_PDF_BUILDER_H
+#define TEST_PDF_BUILDER_H
+
+#include <string>
+#include <vector>
+
+// Objects are numbered from 1 in the order they are added, and the
+// cross-reference table is written by getFile().
+class TestPDFBuilder
+{
+public:
+    // Add the object <object>, in PDF syntax, and return its number.
+    int addObject(const std::string &object);
+
+    // Add a stream with the dictionary <dict>, which mustn't contain
+    // /Length, and the data <data>, and return its number.
+    int addStream(const std::string &dict, const std::string &data);
+
+    // The number of the next object.
+    int getNextNum() const { return static_cast<int>(offsets.size()) + 1; }
+
+    // The whole file, with <trailerEntries> (at least /Root) in the
+    // trailer dictionary.
+    std::string getFile(const std::string &trailerEntries) const;
+
+    // Write getFile(<trailerEntries>) to <fileName>.
+    bool writeFile(const std::string &fileName, const std::string &trailerEntries) const;
+
+private:
+    std::string body = "%PDF-1.4\n";
+    std::vector<size_t> offsets;
+};
+
+#endif
@@ -0,0 +1,155 @@
+//========================================================================
+//
+// text-output-test.cc
+//
+// Extracts the text of a generated document through an output function,
+// as pdftotext does, and checks that it is the same with and without
+// TextOutputDev::setStreamOnly(), that it is passed on in large chunks,
+// and that it hasn't changed: the expected hashes are of the output of
+// pdftotext before the text was written in chunks.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextOutputDev.h"
+#include "goo/GooString.h"
+
+#include "test-pdf-builder.h"
+
+// Page 1 has three columns of small text, more than one chunk; page 2
+// has hyphenation and non-ASCII characters; page 3 is empty.
+static std::string makePage1Contents()
+{
+    std::string contents = "BT /F1 5 Tf 5 TL";
+    for (int col = 0; col < 3; ++col) {
+        contents += " 1 0 0 1 " + std::to_string(20 + 195 * col) + " 770 Tm";
+        for (int line = 0; line < 150; ++line) {
+            contents += " (Line " + std::to_string(line + 1) + " of column " + std::to_string(col + 1) + ", the quick brown fox) '";
+        }
+    }
+    return contents + " ET";
+}
+
+static const char page2Contents[] = "BT /F1 12 Tf 72 700 Td (Caf\351 cr\350me br\373l\351e, a self-) Tj 0 -14 Td (contained para-) Tj 0 -14 Td (graph.) Tj"
+                                    " 0 -40 Td (Second \253paragraph\273 \226 with dashes) Tj ET";
+
+static bool writeTestDocument(const std::string &fileName)
+{
+    const std::string contents[] = { makePage1Contents(), page2Contents, "" };
+    TestPDFBuilder builder;
+
+    // 1: catalog, 2: pages, 3: F1, then the pages and their contents
+    builder.addObject("<< /Type /Catalog /Pages 2 0 R >>");
+    builder.addObject("<< /Type /Pages /Kids [4 0 R 6 0 R 8 0 R] /Count 3 >>");
+    builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+    for (int i = 0; i < 3; ++i) {
+        builder.addObject("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents " + std::to_string(5 + 2 * i) + " 0 R >>");
+        builder.addStream("<< >>", contents[i]);
+    }
+    return builder.writeFile(fileName, "/Root 1 0 R");
+}
+
+struct Output
+{
+    std::string text;
+    int nChunks = 0;
+};
+
+static void appendChunk(void *stream, const char *text, int len)
+{
+    auto *output = static_cast<Output *>(stream);
+    output->text.append(text, len);
+    ++output->nChunks;
+}
+
+// 64-bit FNV-1a
+static uint64_t hashText(const std::string &text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+struct Layout
+{
+    const char *name; // the pdftotext option
+    bool physLayout;
+    bool rawOrder;
+    size_t length; // of the pdftotext output
+    uint64_t hash;
+};
+
+static const Layout layouts[] = {
+    { .name = "default", .physLayout = false, .rawOrder = false, .length = 18670, .hash = 0x3ace3ce68e3456eeULL },
+    { .name = "-layout", .physLayout = true, .rawOrder = false, .length = 19488, .hash = 0x1183be9721259afcULL },
+    { .name = "-raw", .physLayout = false, .rawOrder = true, .length = 18668, .hash = 0x68fccb7a55fe7ab0ULL },
+};
+
+static bool checkLayout(PDFDoc *doc, const Layout &layout)
+{
+    bool ok = true;
+    std::string text;
+    for (bool streamOnly : { false, true }) {
+        Output output;
+        TextOutputDev textOut(&appendChunk, &output, layout.physLayout, 0, layout.rawOrder, false);
+        textOut.setStreamOnly(streamOnly);
+        doc->displayPages(&textOut, 1, doc->getNumPages(), 72, 72, 0, true, false, false);
+
+        if (output.text.size() != layout.length || hashText(output.text) != layout.hash) {
+            fprintf(stderr, "%s%s: the text (%zu bytes, hash %016llx) differs from the expected text\n", layout.name, streamOnly ? ", stream only" : "", output.text.size(), static_cast<unsigned long long>(hashText(output.text)));
+            ok = false;
+        }
+        if (streamOnly && output.text != text) {
+            fprintf(stderr, "%s: the text differs with setStreamOnly()\n", layout.name);
+            ok = false;
+        }
+        text = output.text;
+
+        // one chunk per 16 KB, and one for the end of each page
+        const int maxChunks = static_cast<int>(output.text.size() / 16384) + doc->getNumPages();
+        if (output.nChunks < 2 || output.nChunks > maxChunks) {
+            fprintf(stderr, "%s%s: the text came in %d chunks instead of at most %d\n", layout.name, streamOnly ? ", stream only" : "", output.nChunks, maxChunks);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s WORK-DIR\n", argv[0]);
+        return 1;
+    }
+    const std::string pdfFile = std::string(argv[1]) + "/text-output-test.pdf";
+
+    globalParams = std::make_unique<GlobalParams>();
+
+    if (!writeTestDocument(pdfFile)) {
+        fprintf(stderr, "Couldn't write %s\n", pdfFile.c_str());
+        return 1;
+    }
+    PDFDoc doc(std::make_unique<GooString>(pdfFile));
+    if (!doc.isOk()) {
+        fprintf(stderr, "Couldn't load %s\n", pdfFile.c_str());
+        return 1;
+    }
+
+    bool ok = true;
+    for (const Layout &layout : layouts) {
+        ok = checkLayout(&doc, layout) && ok;
+    }
+
+    remove(pdfFile.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+//========================================================================
+//
+// text-search-index-test.cc
+//
+// Builds a TextSearchIndex for a generated document, runs queries on it
+// and checks that saving and loading the index doesn't change the
+// results.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "TextSearchIndex.h"
+#include "UTF.h"
+#include "goo/GooString.h"
+
+#include "test-pdf-builder.h"
+
+// Page 1 and 3 use Helvetica with WinAnsiEncoding, page 2 uses a font
+// whose ToUnicode CMap maps A, B, C and D to CJK ideographs.
+static const char *const pageContents[] = {
+    "BT /F1 12 Tf 72 700 Td (Hello World caf\351) Tj 0 -20 Td (Index 42 entries) Tj ET",
+    "BT /F2 12 Tf 72 700 Td (AB) Tj 0 -20 Td (CD) Tj 0 -20 Td (hello) Tj ET",
+    "BT /F1 12 Tf 72 700 Td (Hello again, world) Tj ET",
+};
+
+static const char toUnicode[] = "/CIDInit /ProcSet findresource begin 12 dict begin begincmap\n"
+                                "/CIDSystemInfo << /Registry (Adobe) /Ordering (UCS) /Supplement 0 >> def\n"
+                                "/CMapName /Adobe-Identity-UCS def /CMapType 2 def\n"
+                                "1 begincodespacerange <00> <FF> endcodespacerange\n"
+                                "4 beginbfchar <41> <4E2D> <42> <6587> <43> <65E5> <44> <672C> endbfchar\n"
+                                "endcmap CMapName currentdict /CMap defineresource pop end end\n";
+
+static bool writeTestDocument(const std::string &fileName)
+{
+    const int nPages = sizeof(pageContents) / sizeof(pageContents[0]);
+    TestPDFBuilder builder;
+
+    // 1: catalog, 2: pages, 3: F1, 4: F2, 5: ToUnicode, then the pages
+    // and their contents
+    builder.addObject("<< /Type /Catalog /Pages 2 0 R >>");
+    std::string kids;
+    for (int i = 0; i < nPages; ++i) {
+        kids += std::to_string(6 + 2 * i) + " 0 R ";
+    }
+    builder.addObject("<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(nPages) + " >>");
+    builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+    builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /ToUnicode 5 0 R >>");
+    builder.addStream("<< >>", toUnicode);
+    for (int i = 0; i < nPages; ++i) {
+        builder.addObject("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R /F2 4 0 R >> >> /Contents " + std::to_string(7 + 2 * i) + " 0 R >>");
+        builder.addStream("<< >>", pageContents[i]);
+    }
+    return builder.writeFile(fileName, "/Root 1 0 R");
+}
+
+static std::vector<TextSearchIndex::Match> find(const TextSearchIndex &index, const std::string &utf8)
+{
+    const std::vector<Unicode> u = utf8ToUCS4(utf8);
+    return index.find(u.data(), static_cast<int>(u.size()));
+}
+
+static bool sameMatches(const std::vector<TextSearchIndex::Match> &a, const std::vector<TextSearchIndex::Match> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].page != b[i].page || a[i].rects.size() != b[i].rects.size()) {
+            return false;
+        }
+        for (size_t j = 0; j < a[i].rects.size(); ++j) {
+            const PDFRectangle &ra = a[i].rects[j];
+            const PDFRectangle &rb = b[i].rects[j];
+            if (ra.x1 != rb.x1 || ra.y1 != rb.y1 || ra.x2 != rb.x2 || ra.y2 != rb.y2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct Query
+{
+    const char *text; // in UTF-8
+    std::vector<int> pages; // the page of each expected match
+};
+
+static const Query queries[] = {
+    { .text = "hello", .pages = { 1, 2, 3 } },
+    { .text = "HELLO world", .pages = { 1 } },
+    { .text = "hello, world", .pages = { 1 } },
+    { .text = "again world", .pages = { 3 } },
+    { .text = "cafe", .pages = { 1 } },
+    { .text = "CAF\xc3\x89", .pages = { 1 } },
+    { .text = "42", .pages = { 1 } },
+    { .text = "again", .pages = { 3 } },
+    { .text = "index 42 entries", .pages = { 1 } },
+    { .text = "\xe4\xb8\xad\xe6\x96\x87", .pages = { 2 } }, // U+4E2D U+6587
+    { .text = "\xe6\x97\xa5\xe6\x9c\xac", .pages = { 2 } }, // U+65E5 U+672C
+    { .text = "\xe4\xb8\xad\xe6\x9c\xac", .pages = {} }, // U+4E2D U+672C
+    { .text = "\xe6\x9c\xac\xe6\x97\xa5", .pages = {} }, // U+672C U+65E5
+    { .text = "world hello", .pages = {} },
+    { .text = "missing", .pages = {} },
+    { .text = "", .pages = {} },
+};
+
+static bool checkQueries(const TextSearchIndex &index, const char *what)
+{
+    bool ok = true;
+    for (const Query &query : queries) {
+        const std::vector<TextSearchIndex::Match> matches = find(index, query.text);
+        std::vector<int> pages;
+        for (const TextSearchIndex::Match &match : matches) {
+            pages.push_back(match.page);
+            if (match.rects.empty()) {
+                fprintf(stderr, "%s: match of '%s' on page %d has no rectangles\n", what, query.text, match.page);
+                ok = false;
+            }
+        }
+        if (pages != query.pages) {
+            fprintf(stderr, "%s: '%s' has %zu matches instead of %zu\n", what, query.text, pages.size(), query.pages.size());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static bool sameResults(const TextSearchIndex &a, const TextSearchIndex &b, const char *what)
+{
+    bool ok = true;
+    if (a.getNumPages() != b.getNumPages() || a.getNumTerms() != b.getNumTerms()) {
+        fprintf(stderr, "%s: %d pages / %d terms instead of %d / %d\n", what, b.getNumPages(), b.getNumTerms(), a.getNumPages(), a.getNumTerms());
+        ok = false;
+    }
+    for (const Query &query : queries) {
+        if (!sameMatches(find(a, query.text), find(b, query.text))) {
+            fprintf(stderr, "%s: different matches for '%s'\n", what, query.text);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s WORK-DIR\n", argv[0]);
+        return 1;
+    }
+    const std::string pdfFile = std::string(argv[1]) + "/text-search-index-test.pdf";
+    const std::string indexFile = std::string(argv[1]) + "/text-search-index-test.idx";
+
+    globalParams = std::make_unique<GlobalParams>();
+
+    if (!writeTestDocument(pdfFile)) {
+        fprintf(stderr, "Couldn't write %s\n", pdfFile.c_str());
+        return 1;
+    }
+    PDFDoc doc(std::make_unique<GooString>(pdfFile));
+    if (!doc.isOk()) {
+        fprintf(stderr, "Couldn't load %s\n", pdfFile.c_str());
+        return 1;
+    }
+
+    bool ok = true;
+    const std::unique_ptr<TextSearchIndex> index = TextSearchIndex::build(&doc, 1);
+    ok = checkQueries(*index, "build") && ok;
+
+    // the index must not depend on the number of threads
+    const std::unique_ptr<TextSearchIndex> threadedIndex = TextSearchIndex::build(&doc, 3);
+    ok = sameResults(*index, *threadedIndex, "threaded build") && ok;
+
+    if (!index->save(indexFile.c_str())) {
+        fprintf(stderr, "Couldn't save %s\n", indexFile.c_str());
+        return 1;
+    }
+    const std::unique_ptr<TextSearchIndex> loadedIndex = TextSearchIndex::load(indexFile.c_str());
+    if (!loadedIndex) {
+        fprintf(stderr, "Couldn't load %s\n", indexFile.c_str());
+        return 1;
+    }
+    ok = checkQueries(*loadedIndex, "load") && ok;
+    ok = sameResults(*index, *loadedIndex, "load") && ok;
+
+    // a truncated file must be rejected
+    std::error_code ec;
+    std::filesystem::resize_file(indexFile, 20, ec);
+    if (!ec && TextSearchIndex::load(indexFile.c_str())) {
+        fprintf(stderr, "Truncated index was loaded\n");
+        ok = false;
+    }
+
+    remove(pdfFile.c_str());
+    remove(indexFile.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+//========================================================================
+//
+// text-selection-test.cc
+//
+// Checks text selections and word hit tests on generated pages whose
+// blocks, lines and words are found through TextPage's selection
+// indexes.  The expected selections were recorded with the linear scans
+// the indexes replaced.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Stream.h"
+#include "TextOutputDev.h"
+#include "goo/GooString.h"
+
+#include "test-pdf-builder.h"
+
+// Page 1 is a table of many small blocks, page 2 a single block with
+// more lines than TextPage::minIndexedLines, page 3 a heading over two
+// columns.
+static std::string tableContent()
+{
+    std::string content = "BT /F1 8 Tf\n";
+    for (int row = 0; row < 40; ++row) {
+        for (int col = 0; col < 6; ++col) {
+            content += "1 0 0 1 " + std::to_string(40 + col * 90) + " " + std::to_string(740 - row * 16) + " Tm (r" + std::to_string(row) + "c" + std::to_string(col) + ") Tj\n";
+        }
+    }
+    return content + "ET";
+}
+
+static std::string columnContent()
+{
+    std::string content = "BT /F1 8 Tf 11 TL 1 0 0 1 40 760 Tm\n";
+    for (int row = 0; row < 60; ++row) {
+        content += "(line " + std::to_string(row) + " alpha beta gamma) Tj T*\n";
+    }
+    return content + "ET";
+}
+
+static std::string twoColumnContent()
+{
+    std::string content = "BT /F1 14 Tf 1 0 0 1 40 750 Tm (Heading of the page) Tj ET\n";
+    for (int col = 0; col < 2; ++col) {
+        content += "BT /F1 8 Tf 11 TL 1 0 0 1 " + std::to_string(40 + col * 280) + " 700 Tm\n";
+        for (int row = 0; row < 40; ++row) {
+            content += "(col" + std::to_string(col) + " row " + std::to_string(row) + " text here) Tj T*\n";
+        }
+        content += "ET\n";
+    }
+    // two overlapping words
+    return content + "BT /F1 8 Tf 1 0 0 1 40 100 Tm (overlapping) Tj 1 0 0 1 50 103 Tm (words) Tj ET";
+}
+
+static std::string makeTestDocument()
+{
+    const std::string pageContents[] = { tableContent(), columnContent(), twoColumnContent() };
+    const int nPages = sizeof(pageContents) / sizeof(pageContents[0]);
+    TestPDFBuilder builder;
+
+    // 1: catalog, 2: pages, 3: F1, then the pages and their contents
+    builder.addObject("<< /Type /Catalog /Pages 2 0 R >>");
+    std::string kids;
+    for (int i = 0; i < nPages; ++i) {
+        kids += std::to_string(4 + 2 * i) + " 0 R ";
+    }
+    builder.addObject("<< /Type /Pages /Kids [" + kids + "] /Count " + std::to_string(nPages) + " >>");
+    builder.addObject("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+    for (int i = 0; i < nPages; ++i) {
+        builder.addObject("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents " + std::to_string(5 + 2 * i) + " 0 R >>");
+        builder.addStream("<< >>", pageContents[i]);
+    }
+    return builder.getFile("/Root 1 0 R");
+}
+
+// The selected region as the number of rectangles and their union
+static std::string selectionRegion(TextPage *page, const PDFRectangle &selection, SelectionStyle style)
+{
+    std::vector<PDFRectangle *> *rects = page->getSelectionRegion(selection, style, 1.0);
+    PDFRectangle bounds(0, 0, 0, 0);
+    for (size_t i = 0; i < rects->size(); ++i) {
+        const PDFRectangle *rect = (*rects)[i];
+        if (i == 0) {
+            bounds = *rect;
+        } else {
+            bounds.x1 = std::min(bounds.x1, rect->x1);
+            bounds.y1 = std::min(bounds.y1, rect->y1);
+            bounds.x2 = std::max(bounds.x2, rect->x2);
+            bounds.y2 = std::max(bounds.y2, rect->y2);
+        }
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%zu: %.2f %.2f %.2f %.2f", rects->size(), bounds.x1, bounds.y1, bounds.x2, bounds.y2);
+    for (PDFRectangle *rect : *rects) {
+        delete rect;
+    }
+    delete rects;
+    return buf;
+}
+
+struct Selection
+{
+    int page;
+    PDFRectangle rect; // in device space, at 72 dpi
+    SelectionStyle style;
+    const char *text;
+    const char *region;
+};
+
+static const Selection selections[] = {
+    { 1, { 45, 47, 50, 49 }, selectionStyleGlyph, "c", "1: 47.00 45.00 52.00 55.00" },
+    { 1, { 45, 47, 50, 49 }, selectionStyleWord, "r0c0", "1: 40.00 45.00 56.00 55.00" },
+    { 1, { 45, 47, 50, 49 }, selectionStyleLine, "r0c0", "1: 40.00 45.00 56.00 55.00" },
+    { 1, { 40, 50, 140, 70 }, selectionStyleGlyph, "r0c0r0c1r0c2r0c3r0c4r0c5\nr1c0r1c", "8: 40.00 45.00 506.00 71.00" },
+    { 1, { 40, 50, 140, 70 }, selectionStyleWord, "r0c0r0c1r0c2r0c3r0c4r0c5\nr1c0r1c1", "8: 40.00 45.00 506.00 71.00" },
+    { 1, { 40, 50, 140, 70 }, selectionStyleLine, "r0c0r0c1r0c2r0c3r0c4r0c5\nr1c0r1c1", "8: 40.00 45.00 506.00 71.00" },
+    { 1, { 300, 200, 100, 120 }, selectionStyleGlyph, "r4c1r4c2r4c3r4c4r4c5\nr5c0r5c1r5c2r5c3r5c4r5c5\nr6c0r6c1r6c2r6c3r6c4r6c5\nr7c0r7c1r7c2r7c3r7c4r7c5\nr8c0r8c1r8c2r8c3r8c4r8c5\nr9c0r9c1r9c2", "32: 40.00 109.00 506.00 199.00" },
+    { 1, { 300, 200, 100, 120 }, selectionStyleWord, "r4c1r4c2r4c3r4c4r4c5\nr5c0r5c1r5c2r5c3r5c4r5c5\nr6c0r6c1r6c2r6c3r6c4r6c5\nr7c0r7c1r7c2r7c3r7c4r7c5\nr8c0r8c1r8c2r8c3r8c4r8c5\nr9c0r9c1r9c2r9c3", "33: 40.00 109.00 506.00 199.00" },
+    { 1, { 300, 200, 100, 120 }, selectionStyleLine, "r4c1r4c2r4c3r4c4r4c5\nr5c0r5c1r5c2r5c3r5c4r5c5\nr6c0r6c1r6c2r6c3r6c4r6c5\nr7c0r7c1r7c2r7c3r7c4r7c5\nr8c0r8c1r8c2r8c3r8c4r8c5\nr9c0r9c1r9c2r9c3", "33: 40.00 109.00 506.00 199.00" },
+    { 1, { 130, 300, 470, 340 }, selectionStyleGlyph, "r16c1r16c2r16c3r16c4r16c5\nr17c0r17c1r17c2r17c3r17c4r17c5\nr18c0r18c1r18c2r18c3r18c4", "16: 40.00 301.00 511.00 343.00" },
+    { 1, { 130, 300, 470, 340 }, selectionStyleWord, "r16c1r16c2r16c3r16c4r16c5\nr17c0r17c1r17c2r17c3r17c4r17c5\nr18c0r18c1r18c2r18c3r18c4r18c5", "17: 40.00 301.00 511.00 343.00" },
+    { 1, { 130, 300, 470, 340 }, selectionStyleLine, "r16c1r16c2r16c3r16c4r16c5\nr17c0r17c1r17c2r17c3r17c4r17c5\nr18c0r18c1r18c2r18c3r18c4r18c5", "17: 40.00 301.00 511.00 343.00" },
+    { 1, { 0, 500, 612, 500 }, selectionStyleGlyph, "r28c0r28c1r28c2r28c3r28c4r28c5", "6: 40.00 493.00 511.00 503.00" },
+    { 1, { 0, 500, 612, 500 }, selectionStyleWord, "r28c0r28c1r28c2r28c3r28c4r28c5", "6: 40.00 493.00 511.00 503.00" },
+    { 1, { 0, 500, 612, 500 }, selectionStyleLine, "r28c0r28c1r28c2r28c3r28c4r28c5", "6: 40.00 493.00 511.00 503.00" },
+    { 1, { 221, 40, 223, 100 }, selectionStyleGlyph, "r0c2r0c3r0c4r0c5\nr1c0r1c1r1c2r1c3r1c4r1c5\nr2c0r2c1r2c2r2c3r2c4r2c5\nr3c0r3c1r", "19: 40.00 45.00 506.00 103.00" },
+    { 1, { 221, 40, 223, 100 }, selectionStyleWord, "r0c2r0c3r0c4r0c5\nr1c0r1c1r1c2r1c3r1c4r1c5\nr2c0r2c1r2c2r2c3r2c4r2c5\nr3c0r3c1r3c2", "19: 40.00 45.00 506.00 103.00" },
+    { 1, { 221, 40, 223, 100 }, selectionStyleLine, "r0c2r0c3r0c4r0c5\nr1c0r1c1r1c2r1c3r1c4r1c5\nr2c0r2c1r2c2r2c3r2c4r2c5\nr3c0r3c1r3c2", "19: 40.00 45.00 506.00 103.00" },
+    { 1, { 590, 780, 560, 760 }, selectionStyleGlyph, "", "0: 0.00 0.00 0.00 0.00" },
+    { 1, { 590, 780, 560, 760 }, selectionStyleWord, "", "1: 490.00 669.00 511.00 679.00" },
+    { 1, { 590, 780, 560, 760 }, selectionStyleLine, "r39c5", "1: 490.00 669.00 511.00 679.00" },
+    { 1, { 10, 58, 300, 58 }, selectionStyleGlyph, "r1c0r1c1r1c2", "3: 40.00 61.00 236.00 71.00" },
+    { 1, { 10, 58, 300, 58 }, selectionStyleWord, "r1c0r1c1r1c2r1c3", "4: 40.00 61.00 326.00 71.00" },
+    { 1, { 10, 58, 300, 58 }, selectionStyleLine, "r1c0r1c1r1c2r1c3", "4: 40.00 61.00 326.00 71.00" },
+    { 1, { 10, 58, 10, 58 }, selectionStyleGlyph, "", "0: 0.00 0.00 0.00 0.00" },
+    { 1, { 10, 58, 10, 58 }, selectionStyleWord, "r1c0", "1: 40.00 61.00 56.00 71.00" },
+    { 1, { 10, 58, 10, 58 }, selectionStyleLine, "r1c0", "1: 40.00 61.00 56.00 71.00" },
+    { 1, { 600, 58, 130, 58 }, selectionStyleGlyph, "r1c1r1c2r1c3r1c4r1c5", "5: 130.00 61.00 506.00 71.00" },
+    { 1, { 600, 58, 130, 58 }, selectionStyleWord, "r1c1r1c2r1c3r1c4r1c5", "5: 130.00 61.00 506.00 71.00" },
+    { 1, { 600, 58, 130, 58 }, selectionStyleLine, "r1c1r1c2r1c3r1c4r1c5", "5: 130.00 61.00 506.00 71.00" },
+    { 2, { 45, 30, 120, 33 }, selectionStyleGlyph, "ne 0 alpha beta gamm", "1: 43.00 25.00 124.00 35.00" },
+    { 2, { 45, 30, 120, 33 }, selectionStyleWord, "line 0 alpha beta gamma", "1: 40.00 25.00 128.00 35.00" },
+    { 2, { 45, 30, 120, 33 }, selectionStyleLine, "line 0 alpha beta gamma", "1: 40.00 25.00 128.00 35.00" },
+    { 2, { 60, 100, 80, 130 }, selectionStyleGlyph, "alpha beta gamma\nline 7 alpha beta gamma\nline 8 alpha beta gamma\nline 9 alpha", "4: 40.00 91.00 128.00 134.00" },
+    { 2, { 60, 100, 80, 130 }, selectionStyleWord, "alpha beta gamma\nline 7 alpha beta gamma\nline 8 alpha beta gamma\nline 9 alpha", "4: 40.00 91.00 128.00 134.00" },
+    { 2, { 60, 100, 80, 130 }, selectionStyleLine, "line 6 alpha beta gamma\nline 7 alpha beta gamma\nline 8 alpha beta gamma\nline 9 alpha beta gamma", "4: 40.00 91.00 128.00 134.00" },
+    { 2, { 200, 650, 30, 620 }, selectionStyleGlyph, "line 54 alpha beta gamma\nline 55 alpha beta gamma\nline 56 alpha beta gamma", "3: 40.00 619.00 133.00 651.00" },
+    { 2, { 200, 650, 30, 620 }, selectionStyleWord, "line 54 alpha beta gamma\nline 55 alpha beta gamma\nline 56 alpha beta gamma", "3: 40.00 619.00 133.00 651.00" },
+    { 2, { 200, 650, 30, 620 }, selectionStyleLine, "line 54 alpha beta gamma\nline 55 alpha beta gamma\nline 56 alpha beta gamma", "3: 40.00 619.00 133.00 651.00" },
+    { 2, { 150, 500, 150, 520 }, selectionStyleGlyph, "line 44 alpha beta gamma\nline 45 alpha beta gamma", "2: 40.00 509.00 133.00 530.00" },
+    { 2, { 150, 500, 150, 520 }, selectionStyleWord, "line 44 alpha beta gamma\nline 45 alpha beta gamma", "3: 40.00 498.00 133.00 530.00" },
+    { 2, { 150, 500, 150, 520 }, selectionStyleLine, "line 43 alpha beta gamma\nline 44 alpha beta gamma\nline 45 alpha beta gamma", "3: 40.00 498.00 133.00 530.00" },
+    { 2, { 40, 600, 45, 640 }, selectionStyleGlyph, "line 52 alpha beta gamma\nline 53 alpha beta gamma\nline 54 alpha beta gamma\nli", "4: 40.00 597.00 133.00 640.00" },
+    { 2, { 40, 600, 45, 640 }, selectionStyleWord, "line 52 alpha beta gamma\nline 53 alpha beta gamma\nline 54 alpha beta gamma\nline", "4: 40.00 597.00 133.00 640.00" },
+    { 2, { 40, 600, 45, 640 }, selectionStyleLine, "line 52 alpha beta gamma\nline 53 alpha beta gamma\nline 54 alpha beta gamma\nline 55 alpha beta gamma", "4: 40.00 597.00 133.00 640.00" },
+    { 2, { 0, 0, 10, 10 }, selectionStyleGlyph, "", "0: 0.00 0.00 0.00 0.00" },
+    { 2, { 0, 0, 10, 10 }, selectionStyleWord, "line 0 alpha beta gamma", "1: 40.00 25.00 128.00 35.00" },
+    { 2, { 0, 0, 10, 10 }, selectionStyleLine, "line 0 alpha beta gamma", "1: 40.00 25.00 128.00 35.00" },
+    { 2, { 100, 420, 500, 420 }, selectionStyleGlyph, "a gamma", "1: 98.00 410.00 133.00 420.00" },
+    { 2, { 100, 420, 500, 420 }, selectionStyleWord, "beta gamma", "1: 87.00 410.00 133.00 420.00" },
+    { 2, { 100, 420, 500, 420 }, selectionStyleLine, "line 35 alpha beta gamma", "1: 40.00 410.00 133.00 420.00" },
+    { 2, { 90, 800, 100, 700 }, selectionStyleGlyph, "et", "1: 92.00 674.00 99.00 684.00" },
+    { 2, { 90, 800, 100, 700 }, selectionStyleWord, "beta", "1: 87.00 674.00 104.00 684.00" },
+    { 2, { 90, 800, 100, 700 }, selectionStyleLine, "line 59 alpha beta gamma", "1: 40.00 674.00 133.00 684.00" },
+    { 3, { 40, 40, 90, 60 }, selectionStyleGlyph, "Heading", "1: 40.00 30.00 93.00 47.00" },
+    { 3, { 40, 40, 90, 60 }, selectionStyleWord, "Heading", "1: 40.00 30.00 93.00 47.00" },
+    { 3, { 40, 40, 90, 60 }, selectionStyleLine, "Heading of the page", "1: 40.00 30.00 167.00 47.00" },
+    { 3, { 330, 200, 340, 230 }, selectionStyleGlyph, "1 row 10 text here\ncol1 row 11 text here\ncol1 row 12 text here\ncol1 r", "4: 320.00 195.00 395.00 238.00" },
+    { 3, { 330, 200, 340, 230 }, selectionStyleWord, "col1 row 10 text here\ncol1 row 11 text here\ncol1 row 12 text here\ncol1 row", "4: 320.00 195.00 395.00 238.00" },
+    { 3, { 330, 200, 340, 230 }, selectionStyleLine, "col1 row 10 text here\ncol1 row 11 text here\ncol1 row 12 text here\ncol1 row 13 text here", "4: 320.00 195.00 395.00 238.00" },
+    { 3, { 200, 515, 340, 95 }, selectionStyleGlyph, "words\noverlapping\ncol1 r", "3: 40.00 85.00 340.00 695.00" },
+    { 3, { 200, 515, 340, 95 }, selectionStyleWord, "words\noverlapping\ncol1 row", "4: 40.00 85.00 350.00 695.00" },
+    { 3, { 200, 515, 340, 95 }, selectionStyleLine, "col0 row 39 text here\nwords\noverlapping\ncol1 row 0 text here", "4: 40.00 85.00 390.00 695.00" },
+    { 3, { 700, 10, 600, 30 }, selectionStyleGlyph, "", "0: 0.00 0.00 0.00 0.00" },
+    { 3, { 700, 10, 600, 30 }, selectionStyleWord, "", "1: 320.00 85.00 390.00 95.00" },
+    { 3, { 700, 10, 600, 30 }, selectionStyleLine, "col1 row 0 text here", "1: 320.00 85.00 390.00 95.00" },
+    { 3, { 400, 40, 350, 120 }, selectionStyleGlyph, "col1 row 1 text here\ncol1 row 2 text here\ncol1 row", "3: 320.00 96.00 390.00 128.00" },
+    { 3, { 400, 40, 350, 120 }, selectionStyleWord, "col1 row 1 text here\ncol1 row 2 text here\ncol1 row", "4: 320.00 85.00 390.00 128.00" },
+    { 3, { 400, 40, 350, 120 }, selectionStyleLine, "col1 row 0 text here\ncol1 row 1 text here\ncol1 row 2 text here\ncol1 row 3 text here", "4: 320.00 85.00 390.00 128.00" },
+    { 3, { 45, 690, 60, 695 }, selectionStyleGlyph, "verla", "1: 44.00 685.00 62.00 695.00" },
+    { 3, { 45, 690, 60, 695 }, selectionStyleWord, "overlapping", "1: 40.00 685.00 82.00 695.00" },
+    { 3, { 45, 690, 60, 695 }, selectionStyleLine, "overlapping", "1: 40.00 685.00 82.00 695.00" },
+    { 3, { 52, 688, 52, 688 }, selectionStyleGlyph, "", "0: 0.00 0.00 0.00 0.00" },
+    { 3, { 52, 688, 52, 688 }, selectionStyleWord, "words", "1: 50.00 682.00 72.00 692.00" },
+    { 3, { 52, 688, 52, 688 }, selectionStyleLine, "words", "1: 50.00 682.00 72.00 692.00" },
+};
+
+// A point halfway between two blocks of the table must select the first
+// of them in reading order, like the linear scan did
+static bool checkTie(TextPage *page)
+{
+    PDFRectangle above, below;
+    for (const TextFlow *flow = page->getFlows(); flow; flow = flow->getNext()) {
+        for (const TextBlock *blk = flow->getBlocks(); blk; blk = blk->getNext()) {
+            const std::unique_ptr<std::string> text = blk->getLines()->getWords()->getText();
+            if (*text == "r4c0") {
+                above = blk->getBBox();
+            } else if (*text == "r5c0") {
+                below = blk->getBBox();
+            }
+        }
+    }
+    const double x = above.x1, y = (above.y2 + below.y1) / 2;
+    if (x != below.x1 || y - above.y2 != below.y1 - y) {
+        fprintf(stderr, "page 1: r4c0 and r5c0 aren't aligned\n");
+        return false;
+    }
+    const GooString text = page->getSelectionText(PDFRectangle(x, y, x, y), selectionStyleWord);
+    if (text.toStr() != "r4c0") {
+        fprintf(stderr, "page 1: selection at %g %g is '%s' instead of 'r4c0'\n", x, y, text.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The first word in reading order whose bounding box contains (x, y)
+static const TextWord *findWordAtLinear(const TextPage *page, double x, double y)
+{
+    for (const TextFlow *flow = page->getFlows(); flow; flow = flow->getNext()) {
+        for (const TextBlock *blk = flow->getBlocks(); blk; blk = blk->getNext()) {
+            for (const TextLine *line = blk->getLines(); line; line = line->getNext()) {
+                for (const TextWord *word = line->getWords(); word; word = word->getNext()) {
+                    const PDFRectangle bbox = word->getBBox();
+                    if (x >= bbox.x1 && x <= bbox.x2 && y >= bbox.y1 && y <= bbox.y2) {
+                        return word;
+                    }
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+static bool checkFindWordAt(TextPage *page, int pageNum)
+{
+    int nHits = 0;
+    for (double y = -10; y < 802; y += 1.5) {
+        for (double x = -10; x < 622; x += 1.5) {
+            const TextWord *expected = findWordAtLinear(page, x, y);
+            const TextWord *found = page->findWordAt(x, y);
+            if (found != expected) {
+                fprintf(stderr, "page %d: findWordAt(%g, %g) found '%s' instead of '%s'\n", pageNum, x, y, found ? found->getText()->c_str() : "", expected ? expected->getText()->c_str() : "");
+                return false;
+            }
+            if (found) {
+                ++nHits;
+            }
+        }
+    }
+    if (nHits == 0) {
+        fprintf(stderr, "page %d: findWordAt didn't find any word\n", pageNum);
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    globalParams = std::make_unique<GlobalParams>();
+
+    const std::string pdf = makeTestDocument();
+    PDFDoc doc(std::make_unique<MemStream>(pdf.data(), 0, pdf.size(), Object::null()));
+    if (!doc.isOk()) {
+        fprintf(stderr, "Couldn't load the generated document\n");
+        return 1;
+    }
+
+    bool ok = true;
+    std::vector<std::unique_ptr<TextPage>> pages;
+    for (int pg = 1; pg <= doc.getNumPages(); ++pg) {
+        TextOutputDev textOut(nullptr, true, 0, false, false);
+        doc.displayPage(&textOut, pg, 72, 72, 0, false, true, false);
+        pages.push_back(textOut.takeText());
+    }
+
+    for (const Selection &sel : selections) {
+        TextPage *page = pages[sel.page - 1].get();
+        const GooString text = page->getSelectionText(sel.rect, sel.style);
+        const std::string region = selectionRegion(page, sel.rect, sel.style);
+        if (text.toStr() != sel.text || region != sel.region) {
+            fprintf(stderr, "page %d: selection %g %g %g %g (style %d) is '%s' / '%s' instead of '%s' / '%s'\n", sel.page, sel.rect.x1, sel.rect.y1, sel.rect.x2, sel.rect.y2, sel.style, text.c_str(), region.c_str(), sel.text, sel.region);
+            ok = false;
+        }
+    }
+
+    ok = checkTie(pages[0].get()) && ok;
+
+    for (size_t i = 0; i < pages.size(); ++i) {
+        ok = checkFindWordAt(pages[i].get(), static_cast<int>(i) + 1) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -43,15 +43,18 @@
 #include <cstdio>
 #include <cctype>
 #include <cmath>
+#include <memory>
 #include "goo/gmem.h"
 #include "goo/NetPBMWriter.h"
 #include "goo/PNGWriter.h"
 #include "goo/TiffWriter.h"
 #include "Error.h"
+#include "Gfx.h"
 #include "GfxState.h"
 #include "Object.h"
 #include "Stream.h"
 #include "JBIG2Stream.h"
+#include "PDFDoc.h"
 #include "ImageOutputDev.h"
 
 ImageOutputDev::ImageOutputDev(char *fileRootA, bool pageNamesA, bool listImagesA)
@@ -74,6 +77,7 @@ ImageOutputDev::ImageOutputDev(char *fileRootA, bool pageNamesA, bool listImages
     errorCode = 0;
     minHeight = 0;
     minWidth = 0;
+    resolutionKnown = true;
     if (listImages) {
         printf("page   num  type   width height color comp bpc  enc interp  object ID x-ppi y-ppi size ratio\n");
         printf("--------------------------------------------------------------------------------------------\n");
@@ -233,20 +237,24 @@ void ImageOutputDev::listImage(GfxState *state, Object *ref, Stream *str, int wi
         printf("[none]     ");
     }
 
-    const std::array<double, 6> &mat = state->getCTM();
-    double width2 = sqrt(mat[0] * mat[0] + mat[1] * mat[1]);
-    double height2 = sqrt(mat[2] * mat[2] + mat[3] * mat[3]);
-    double xppi = fabs(width * 72.0 / width2);
-    double yppi = fabs(height * 72.0 / height2);
-    if (xppi < 1.0) {
-        printf("%5.3f ", xppi);
-    } else {
-        printf("%5.0f ", xppi);
-    }
-    if (yppi < 1.0) {
-        printf("%5.3f ", yppi);
+    if (resolutionKnown) {
+        const std::array<double, 6> &mat = state->getCTM();
+        double width2 = sqrt(mat[0] * mat[0] + mat[1] * mat[1]);
+        double height2 = sqrt(mat[2] * mat[2] + mat[3] * mat[3]);
+        double xppi = fabs(width * 72.0 / width2);
+        double yppi = fabs(height * 72.0 / height2);
+        if (xppi < 1.0) {
+            printf("%5.3f ", xppi);
+        } else {
+            printf("%5.0f ", xppi);
+        }
+        if (yppi < 1.0) {
+            printf("%5.3f ", yppi);
+        } else {
+            printf("%5.0f ", yppi);
+        }
     } else {
-        printf("%5.0f ", yppi);
+        printf("    -     - ");
     }
 
     Goffset embedSize = -1;
@@ -338,10 +346,29 @@ long ImageOutputDev::getInlineImageLength(Stream *str, int width, int height, Gf
     return len;
 }
 
+// Copy the rest of <str> to <f>.  Data that is not filtered is copied
+// straight from the input file when possible.
+static void copyStream(Stream *str, FILE *f)
+{
+    BaseStream *baseStr = str->getBaseStream();
+    if (baseStr == str) {
+        FileOutStream outStr(f, 0);
+        outStr.copyFrom(baseStr, -1);
+        return;
+    }
+
+    unsigned char buf[65536];
+    int n;
+    while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+        if (fwrite(buf, 1, n, f) != static_cast<size_t>(n)) {
+            break;
+        }
+    }
+}
+
 void ImageOutputDev::writeRawImage(Stream *str, const char *ext)
 {
     FILE *f;
-    int c;
 
     // open the image file
     setFilename(ext);
@@ -362,9 +389,7 @@ void ImageOutputDev::writeRawImage(Stream *str, const char *ext)
     }
 
     // copy the stream
-    while ((c = str->getChar()) != EOF) {
-        fputc(c, f);
-    }
+    copyStream(str, f);
 
     str->close();
     fclose(f);
@@ -573,7 +598,6 @@ void ImageOutputDev::writeImage(GfxState * /*state*/, Object * /*ref*/, Stream *
         Object *globals = jb2Str->getGlobalsStream();
         if (globals->isStream()) {
             FILE *f;
-            int c;
             Stream *globalsStr = globals->getStream();
 
             setFilename("jb2g");
@@ -583,9 +607,7 @@ void ImageOutputDev::writeImage(GfxState * /*state*/, Object * /*ref*/, Stream *
                 return;
             }
             if (globalsStr->rewind()) {
-                while ((c = globalsStr->getChar()) != EOF) {
-                    fputc(c, f);
-                }
+                copyStream(globalsStr, f);
                 globalsStr->close();
             }
             fclose(f);
@@ -768,6 +790,32 @@ void ImageOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref, Stream *s
     }
 }
 
+void ImageOutputDev::drawImageXObject(PDFDoc *doc, Ref ref, Object &&colorSpaces, int pageNumA, int imgNumA)
+{
+    XRef *xref = doc->getXRef();
+
+    // let Gfx draw the image from a one-operator content stream, so the
+    // image and its mask are handled exactly as on a page
+    auto xobjects = std::make_unique<Dict>(xref);
+    xobjects->add("Im", Object(ref));
+    Dict resDict(xref);
+    resDict.add("XObject", Object(std::move(xobjects)));
+    if (colorSpaces.isDict()) {
+        resDict.add("ColorSpace", std::move(colorSpaces));
+    }
+
+    static const char content[] = "/Im Do";
+    Object contentObj(std::make_unique<MemStream>(content, 0, sizeof(content) - 1, Object(std::make_unique<Dict>(xref))));
+
+    pageNum = pageNumA;
+    imgNum = imgNumA;
+    resolutionKnown = false;
+    const PDFRectangle box(0, 0, 1, 1);
+    Gfx gfx(doc, this, &resDict, box, nullptr);
+    gfx.display(&contentObj);
+    resolutionKnown = true;
+}
+
 bool ImageOutputDev::passesSizeFilter(int width, int height) const
 {
     return height >= minHeight && width >= minWidth;
@@ -36,6 +36,7 @@
 #include "OutputDev.h"
 
 class GfxState;
+class PDFDoc;
 
 //------------------------------------------------------------------------
 // ImageOutputDev
@@ -95,6 +96,13 @@ public:
     void setMinHeight(int height) { minHeight = height; }
     void setMinWidth(int width) { minWidth = width; }
 
+    // Write or list the image XObject <ref> (and its mask) on its own,
+    // as image number <imgNumA> of page <pageNumA>, without a content
+    // stream that draws it.  <colorSpaces> is the ColorSpace resource
+    // dictionary that applies to it, for the default color spaces.  The
+    // resolution of such images is unknown.
+    void drawImageXObject(PDFDoc *doc, Ref ref, Object &&colorSpaces, int pageNumA, int imgNumA);
+
     // Get the error code
     // 0 = No error, 1 = Error opening a PDF file, 2 = Error opening an output file, 3 = Error related to PDF permissions, 99 = Other error.
     int getErrorCode() const { return errorCode; }
@@ -162,6 +170,7 @@ private:
     int errorCode; // code for any error creating the output files
     int minWidth; // smallest width that will be output
     int minHeight; // smallest height that will be output
+    bool resolutionKnown; // set if images are drawn from a content stream
 };
 
 #endif
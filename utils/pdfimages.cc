@@ -36,6 +36,12 @@
 #include "config.h"
 #include <poppler-config.h>
 #include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
 #include "GlobalParams.h"
@@ -66,6 +72,8 @@ static bool printVersion = false;
 static bool printHelp = false;
 static int minHeight = 0;
 static int minWidth = 0;
+static bool uniqueImages = false;
+static int numberOfJobs = 0;
 
 static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstPage, .size = 0, .usage = "first page to convert" },
                                    { .arg = "-l", .kind = argInt, .val = &lastPage, .size = 0, .usage = "last page to convert" },
@@ -87,6 +95,8 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-print-filenames", .kind = argFlag, .val = &printFilenames, .size = 0, .usage = "print image filenames to stdout" },
                                    { .arg = "-min-height", .kind = argInt, .val = &minHeight, .size = 0, .usage = "images with smaller height will be ignored" },
                                    { .arg = "-min-width", .kind = argInt, .val = &minWidth, .size = 0, .usage = "images with smaller width will be ignored" },
+                                   { .arg = "-unique", .kind = argFlag, .val = &uniqueImages, .size = 0, .usage = "take each image XObject once from the page resources, without reading the page contents" },
+                                   { .arg = "-jobs", .kind = argInt, .val = &numberOfJobs, .size = 0, .usage = "number of jobs writing images with -unique (default: number of processors)" },
                                    { .arg = "-q", .kind = argFlag, .val = &quiet, .size = 0, .usage = "don't print any messages or errors" },
                                    { .arg = "-v", .kind = argFlag, .val = &printVersion, .size = 0, .usage = "print copyright and version info" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -95,6 +105,192 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
                                    { .arg = "-?", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    {} };
 
+// An image XObject found by scanResources
+struct ImageXObject
+{
+    Ref ref;
+    Ref owner; // stream whose resources name the image, INVALID for the page resources
+    int page;
+    int imgNum;
+};
+
+struct ResourceScan
+{
+    std::vector<ImageXObject> images;
+    std::unordered_set<Ref> seen; // images and streams with resources already scanned
+    int imgNum = 0;
+};
+
+static int getImageDimension(Dict *dict, const char *key, const char *abbrev)
+{
+    Object obj = dict->lookup(key);
+    if (obj.isNull()) {
+        obj = dict->lookup(abbrev);
+    }
+    if (obj.isInt()) {
+        return obj.getInt();
+    }
+    if (obj.isReal()) {
+        return static_cast<int>(obj.getReal());
+    }
+    return 0;
+}
+
+// The number of images ImageOutputDev writes for the image XObject
+// with the dictionary <dict>: none if it is filtered out by size, one
+// for the image and one for its explicit or soft mask, if any
+static int countImageFiles(Dict *dict)
+{
+    const int width = getImageDimension(dict, "Width", "W");
+    const int height = getImageDimension(dict, "Height", "H");
+    if (width < 1 || height < 1 || width < minWidth || height < minHeight) {
+        return 0;
+    }
+    Object obj = dict->lookup("ImageMask");
+    if (obj.isNull()) {
+        obj = dict->lookup("IM");
+    }
+    if (obj.isBool() && obj.getBool()) {
+        return 1;
+    }
+    if (dict->lookup("SMask").isStream() || dict->lookup("Mask").isStream()) {
+        return 2;
+    }
+    return 1;
+}
+
+static void scanResources(XRef *xref, Dict *resDict, Ref owner, int page, ResourceScan *scan);
+
+// Scan the resources of a form XObject, tiling pattern, soft mask group
+// or appearance stream
+static void scanResourceStream(XRef *xref, const Object &refObj, int page, ResourceScan *scan)
+{
+    if (!refObj.isRef() || !scan->seen.insert(refObj.getRef()).second) {
+        return;
+    }
+    Object obj = refObj.fetch(xref);
+    if (!obj.isStream()) {
+        return;
+    }
+    Object resObj = obj.getStream()->getDict()->lookup("Resources");
+    if (resObj.isDict()) {
+        scanResources(xref, resObj.getDict(), refObj.getRef(), page, scan);
+    }
+}
+
+// Number the image XObjects in <resDict> and in the resources of the
+// streams it names that have not been seen yet
+static void scanResources(XRef *xref, Dict *resDict, Ref owner, int page, ResourceScan *scan)
+{
+    Object xobjects = resDict->lookup("XObject");
+    if (xobjects.isDict()) {
+        for (int i = 0; i < xobjects.dictGetLength(); i++) {
+            const Object &refObj = xobjects.getDict()->getValNF(i);
+            if (!refObj.isRef() || scan->seen.contains(refObj.getRef())) {
+                continue;
+            }
+            Object obj = refObj.fetch(xref);
+            if (!obj.isStream()) {
+                continue;
+            }
+            Object subtype = obj.getStream()->getDict()->lookup("Subtype");
+            if (subtype.isName("Image")) {
+                scan->seen.insert(refObj.getRef());
+                const int n = countImageFiles(obj.getStream()->getDict());
+                if (n > 0) {
+                    scan->images.push_back({ .ref = refObj.getRef(), .owner = owner, .page = page, .imgNum = scan->imgNum });
+                    scan->imgNum += n;
+                }
+            } else if (subtype.isName("Form")) {
+                scanResourceStream(xref, refObj, page, scan);
+            }
+        }
+    }
+
+    Object patterns = resDict->lookup("Pattern");
+    if (patterns.isDict()) {
+        for (int i = 0; i < patterns.dictGetLength(); i++) {
+            scanResourceStream(xref, patterns.getDict()->getValNF(i), page, scan);
+        }
+    }
+
+    Object extGStates = resDict->lookup("ExtGState");
+    if (extGStates.isDict()) {
+        for (int i = 0; i < extGStates.dictGetLength(); i++) {
+            Object extGState = extGStates.dictGetVal(i);
+            if (extGState.isDict()) {
+                Object softMask = extGState.dictLookup("SMask");
+                if (softMask.isDict()) {
+                    scanResourceStream(xref, softMask.dictLookupNF("G"), page, scan);
+                }
+            }
+        }
+    }
+}
+
+// Scan the resources of page <pg> and of its annotation appearances
+static void scanPage(PDFDoc *doc, int pg, ResourceScan *scan)
+{
+    XRef *xref = doc->getXRef();
+    Page *page = doc->getPage(pg);
+    if (!page) {
+        return;
+    }
+    if (Dict *resDict = page->getResourceDict()) {
+        scanResources(xref, resDict, Ref::INVALID(), pg, scan);
+    }
+
+    Object annots = page->getAnnotsObject();
+    if (!annots.isArray()) {
+        return;
+    }
+    for (int i = 0; i < annots.arrayGetLength(); i++) {
+        Object annot = annots.arrayGet(i);
+        if (!annot.isDict()) {
+            continue;
+        }
+        Object appearances = annot.dictLookup("AP");
+        if (!appearances.isDict()) {
+            continue;
+        }
+        const Object &normal = appearances.getDict()->lookupNF("N");
+        if (normal.isRef()) {
+            Object obj = normal.fetch(xref);
+            if (obj.isStream()) {
+                scanResourceStream(xref, normal, pg, scan);
+            } else if (obj.isDict()) {
+                for (int j = 0; j < obj.dictGetLength(); j++) {
+                    scanResourceStream(xref, obj.getDict()->getValNF(j), pg, scan);
+                }
+            }
+        } else if (normal.isDict()) {
+            for (int j = 0; j < normal.dictGetLength(); j++) {
+                scanResourceStream(xref, normal.getDict()->getValNF(j), pg, scan);
+            }
+        }
+    }
+}
+
+static void drawImageXObject(PDFDoc *doc, ImageOutputDev *imgOut, const ImageXObject &image)
+{
+    Object colorSpaces;
+    if (image.owner == Ref::INVALID()) {
+        Page *page = doc->getPage(image.page);
+        if (page && page->getResourceDict()) {
+            colorSpaces = page->getResourceDict()->lookup("ColorSpace");
+        }
+    } else {
+        Object obj = doc->getXRef()->fetch(image.owner);
+        if (obj.isStream()) {
+            Object resObj = obj.getStream()->getDict()->lookup("Resources");
+            if (resObj.isDict()) {
+                colorSpaces = resObj.dictLookup("ColorSpace");
+            }
+        }
+    }
+    imgOut->drawImageXObject(doc, image.ref, std::move(colorSpaces), image.page, image.imgNum);
+}
+
 int main(int argc, char *argv[])
 {
     char *imgRoot = nullptr;
@@ -140,9 +336,9 @@ int main(int argc, char *argv[])
     }
 
     std::unique_ptr<PDFDoc> doc = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
-    delete fileName;
 
     if (!doc->isOk()) {
+        delete fileName;
         return 1;
     }
 
@@ -150,6 +346,7 @@ int main(int argc, char *argv[])
 #ifdef ENFORCE_PERMISSIONS
     if (!doc->okToCopy()) {
         error(errNotAllowed, -1, "Copying of images from this document is not allowed.");
+        delete fileName;
         return 3;
     }
 #endif
@@ -160,6 +357,7 @@ int main(int argc, char *argv[])
     }
     if (firstPage > doc->getNumPages()) {
         error(errCommandLine, -1, "Wrong page range given: the first page ({0:d}) can not be larger then the number of pages in the document ({1:d}).", firstPage, doc->getNumPages());
+        delete fileName;
         return 99;
     }
     if (lastPage < 1 || lastPage > doc->getNumPages()) {
@@ -167,14 +365,14 @@ int main(int argc, char *argv[])
     }
     if (lastPage < firstPage) {
         error(errCommandLine, -1, "Wrong page range given: the first page ({0:d}) can not be after the last page ({1:d}).", firstPage, lastPage);
+        delete fileName;
         return 99;
     }
 
     // write image files
-    auto *imgOut = new ImageOutputDev(imgRoot, pageNames, listImages);
-    imgOut->setMinHeight(minHeight);
-    imgOut->setMinWidth(minWidth);
-    if (imgOut->isOk()) {
+    const auto setupImageOutputDev = [](ImageOutputDev *imgOut) {
+        imgOut->setMinHeight(minHeight);
+        imgOut->setMinWidth(minWidth);
         if (allFormats) {
             imgOut->enablePNG(true);
             imgOut->enableTiff(true);
@@ -191,9 +389,66 @@ int main(int argc, char *argv[])
             imgOut->enableCCITT(dumpCCITT);
         }
         imgOut->enablePrintFilenames(printFilenames);
+    };
+    auto *imgOut = new ImageOutputDev(imgRoot, pageNames, listImages);
+    setupImageOutputDev(imgOut);
+    int exitCode = imgOut->isOk() ? 0 : imgOut->getErrorCode();
+    if (imgOut->isOk() && !uniqueImages) {
         doc->displayPages(imgOut, firstPage, lastPage, 72, 72, 0, true, false, false);
+        exitCode = imgOut->getErrorCode();
+    } else if (imgOut->isOk()) {
+        ResourceScan scan;
+        for (int pg = firstPage; pg <= lastPage; pg++) {
+            scanPage(doc.get(), pg, &scan);
+        }
+
+        // the images are numbered up front, so they can be written in
+        // any order; each extra job reads its own copy of the document
+        // as streams can not be shared between threads
+        if (numberOfJobs <= 0) {
+            numberOfJobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        if (listImages || fileName->compare("fd://0") == 0) {
+            numberOfJobs = 1;
+        }
+        // opening a copy only pays off for a few images
+        numberOfJobs = std::min(numberOfJobs, std::max(1, static_cast<int>(scan.images.size() / 16)));
+        std::vector<std::unique_ptr<PDFDoc>> jobDocs;
+        std::vector<std::unique_ptr<ImageOutputDev>> jobImgOuts;
+        for (int i = 1; i < numberOfJobs; i++) {
+            std::unique_ptr<PDFDoc> jobDoc = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
+            if (!jobDoc->isOk()) {
+                break;
+            }
+            jobDocs.push_back(std::move(jobDoc));
+            jobImgOuts.push_back(std::make_unique<ImageOutputDev>(imgRoot, pageNames, listImages));
+            setupImageOutputDev(jobImgOuts.back().get());
+        }
+
+        std::atomic<size_t> nextImage(0);
+        const auto writeImages = [&nextImage, &scan](PDFDoc *d, ImageOutputDev *out) {
+            for (size_t i = nextImage++; i < scan.images.size(); i = nextImage++) {
+                drawImageXObject(d, out, scan.images[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(jobDocs.size());
+        for (size_t i = 0; i < jobDocs.size(); i++) {
+            threads.emplace_back(writeImages, jobDocs[i].get(), jobImgOuts[i].get());
+        }
+        writeImages(doc.get(), imgOut);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        exitCode = imgOut->getErrorCode();
+        for (const std::unique_ptr<ImageOutputDev> &jobImgOut : jobImgOuts) {
+            if (exitCode == 0) {
+                exitCode = jobImgOut->getErrorCode();
+            }
+        }
     }
-    const int exitCode = imgOut->isOk() ? 0 : imgOut->getErrorCode();
     delete imgOut;
+    delete fileName;
     return exitCode;
 }
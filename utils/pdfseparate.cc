@@ -20,6 +20,11 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "parseargs.h"
 #include "goo/GooString.h"
 #include "PDFDoc.h"
@@ -29,11 +34,13 @@
 
 static int firstPage = 0;
 static int lastPage = 0;
+static int numberOfJobs = 0;
 static bool printVersion = false;
 static bool printHelp = false;
 
 static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstPage, .size = 0, .usage = "first page to extract" },
                                    { .arg = "-l", .kind = argInt, .val = &lastPage, .size = 0, .usage = "last page to extract" },
+                                   { .arg = "-j", .kind = argInt, .val = &numberOfJobs, .size = 0, .usage = "number of jobs to run concurrently (default: number of processors)" },
                                    { .arg = "-v", .kind = argFlag, .val = &printVersion, .size = 0, .usage = "print copyright and version info" },
                                    { .arg = "-h", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
                                    { .arg = "-help", .kind = argFlag, .val = &printHelp, .size = 0, .usage = "print usage information" },
@@ -43,7 +50,6 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
 
 static bool extractPages(const char *srcFileName, const char *destFileName)
 {
-    char pathName[4096];
     auto *doc = new PDFDoc(std::make_unique<GooString>(srcFileName));
 
     if (!doc->isOk()) {
@@ -115,19 +121,43 @@ static bool extractPages(const char *srcFileName, const char *destFileName)
     }
     free(auxDestFileName);
 
-    for (int pageNo = firstPage; pageNo <= lastPage; pageNo++) {
-        snprintf(pathName, sizeof(pathName) - 1, destFileName, pageNo);
-        auto *pagedoc = new PDFDoc(std::make_unique<GooString>(srcFileName));
-        int errCode = pagedoc->savePageAs(pathName, pageNo);
-        if (errCode != errNone) {
-            delete doc;
-            delete pagedoc;
-            return false;
+    // savePageAs leaves the document unchanged, so each job saves its
+    // pages from a single document; the extra jobs open their own copy
+    if (numberOfJobs <= 0) {
+        numberOfJobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    numberOfJobs = std::min(numberOfJobs, lastPage - firstPage + 1);
+    std::vector<std::unique_ptr<PDFDoc>> jobDocs;
+    for (int i = 1; i < numberOfJobs; i++) {
+        auto jobDoc = std::make_unique<PDFDoc>(std::make_unique<GooString>(srcFileName));
+        if (!jobDoc->isOk()) {
+            break;
+        }
+        jobDocs.push_back(std::move(jobDoc));
+    }
+
+    std::atomic<int> nextPage(firstPage);
+    std::atomic<bool> failed(false);
+    const auto savePages = [&nextPage, &failed, destFileName](PDFDoc *d) {
+        char pathName[4096];
+        for (int pageNo = nextPage++; pageNo <= lastPage && !failed; pageNo = nextPage++) {
+            snprintf(pathName, sizeof(pathName) - 1, destFileName, pageNo);
+            if (d->savePageAs(pathName, pageNo) != errNone) {
+                failed = true;
+            }
         }
-        delete pagedoc;
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(jobDocs.size());
+    for (const std::unique_ptr<PDFDoc> &d : jobDocs) {
+        threads.emplace_back(savePages, d.get());
+    }
+    savePages(doc);
+    for (std::thread &thread : threads) {
+        thread.join();
     }
     delete doc;
-    return true;
+    return !failed;
 }
 
 static constexpr int kOtherError = 99;
@@ -646,14 +646,26 @@ int main(int argc, char *argv[])
         return 2;
     }
     std::unordered_map<int, SignatureInfo *> signatureInfos;
-    for (unsigned int i = 0; i < sigCount; i++) {
+    {
         // Let's start the signature check first for signatures.
         // we can always wait for completion later
-        FormFieldSignature *ffs = signatures.at(i);
-        if (ffs->getSignatureType() == CryptoSign::SignatureType::unsigned_signature_field) {
-            continue;
+        // The signed data of all of them is hashed in one pass.
+        std::vector<FormFieldSignature *> signedFields;
+        std::vector<int> signedIndices;
+        for (unsigned int i = 0; i < sigCount; i++) {
+            FormFieldSignature *ffs = signatures.at(i);
+            if (ffs->getSignatureType() == CryptoSign::SignatureType::unsigned_signature_field) {
+                continue;
+            }
+            signedFields.push_back(ffs);
+            signedIndices.push_back(i);
+        }
+        if (!signedFields.empty()) {
+            const std::vector<SignatureInfo *> infos = FormFieldSignature::validateSignaturesAsync(signedFields, !dontVerifyCert, false, -1 /* now */, !noOCSPRevocationCheck, useAIACertFetch);
+            for (size_t j = 0; j < infos.size(); j++) {
+                signatureInfos[signedIndices[j]] = infos[j];
+            }
         }
-        signatureInfos[i] = ffs->validateSignatureAsync(!dontVerifyCert, false, -1 /* now */, !noOCSPRevocationCheck, useAIACertFetch, {});
     }
     bool totalDocumentSigned = false;
     bool oneSignatureInvalid = false;
@@ -114,6 +114,7 @@ static int crop_y = 0;
 static int crop_w = 0;
 static int crop_h = 0;
 static int sz = 0;
+static int pngThreads = 0;
 static bool useCropBox = false;
 static bool mono = false;
 static bool gray = false;
@@ -201,6 +202,7 @@ static const ArgDesc argDesc[] = {
     { .arg = "-H", .kind = argInt, .val = &crop_h, .size = 0, .usage = "height of crop area in pixels (default is 0)" },
     { .arg = "-sz", .kind = argInt, .val = &sz, .size = 0, .usage = "size of crop square in pixels (sets W and H)" },
     { .arg = "-cropbox", .kind = argFlag, .val = &useCropBox, .size = 0, .usage = "use the crop box rather than media box" },
+    { .arg = "-png-threads", .kind = argInt, .val = &pngThreads, .size = 0, .usage = "compress PNG files on this many threads" },
 
     { .arg = "-mono", .kind = argFlag, .val = &mono, .size = 0, .usage = "generate a monochrome image file (PNG, JPEG)" },
     { .arg = "-gray", .kind = argFlag, .val = &gray, .size = 0, .usage = "generate a grayscale image file (PNG, JPEG)" },
@@ -357,6 +359,9 @@ static void writePageImage(GooString *filename)
         } else {
             writer = new PNGWriter(PNGWriter::RGB);
         }
+        if (pngThreads > 0) {
+            static_cast<PNGWriter *>(writer)->setCompressionThreads(pngThreads);
+        }
 
 #    if USE_CMS
         if (icc_data) {
@@ -51,10 +51,14 @@
 #    include <fcntl.h> // for O_BINARY
 #    include <io.h> // for _setmode
 #endif
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <memory>
 #include "parseargs.h"
 #include "goo/GooString.h"
+#include "goo/ImgWriter.h"
+#include "goo/gfile.h"
 #include "GlobalParams.h"
 #include "PDFDoc.h"
 #include "PDFDocFactory.h"
@@ -136,6 +140,8 @@ static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
 static char thinLineModeStr[8] = "";
 static SplashThinLineMode thinLineMode = splashThinLineDefault;
+static int bandHeight = 0;
+static int pngThreads = 0;
 #ifdef UTILS_USE_PTHREADS
 static int numberOfJobs = 1;
 #endif // UTILS_USE_PTHREADS
@@ -191,6 +197,8 @@ static const ArgDesc argDesc[] = { { .arg = "-f", .kind = argInt, .val = &firstP
 #endif
                                    { .arg = "-freetype", .kind = argString, .val = enableFreeTypeStr, .size = sizeof(enableFreeTypeStr), .usage = "enable FreeType font rasterizer: yes, no" },
                                    { .arg = "-thinlinemode", .kind = argString, .val = thinLineModeStr, .size = sizeof(thinLineModeStr), .usage = "set thin line mode: none, solid, shape. Default: none" },
+                                   { .arg = "-band", .kind = argInt, .val = &bandHeight, .size = 0, .usage = "render PNG, JPEG and TIFF pages in bands of this many pixel rows" },
+                                   { .arg = "-png-threads", .kind = argInt, .val = &pngThreads, .size = 0, .usage = "compress PNG files on this many threads" },
 
                                    { .arg = "-aa", .kind = argString, .val = antialiasStr, .size = sizeof(antialiasStr), .usage = "enable font anti-aliasing: yes, no" },
                                    { .arg = "-aaVector", .kind = argString, .val = vectorAntialiasStr, .size = sizeof(vectorAntialiasStr), .usage = "enable vector anti-aliasing: yes, no" },
@@ -279,6 +287,46 @@ static bool parseJpegOptions()
 
 static auto annotDisplayDecideCbk = [](Annot * /*annot*/, void * /*user_data*/) { return !hideAnnotations; };
 
+// Renders the page bandHeight rows at a time and writes each band as
+// soon as it is done, so that only one band is ever held in memory.
+static bool savePageBands(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, const char *ppmFile, SplashBitmap::WriteImgParams *params)
+{
+    const SplashImageFileFormat format = png ? splashFormatPng : jpeg ? splashFormatJpeg : jpegcmyk ? splashFormatJpegCMYK : splashFormatTiff;
+    FILE *f;
+    if (ppmFile != nullptr) {
+        if (!(f = openFile(ppmFile, "wb"))) {
+            return false;
+        }
+    } else {
+#if defined(_WIN32) || defined(__CYGWIN__)
+        _setmode(fileno(stdout), O_BINARY);
+#endif
+        f = stdout;
+    }
+
+    std::unique_ptr<ImgWriter> writer;
+    SplashColorMode imageWriterFormat = splashModeRGB8;
+    bool ok = true;
+    for (int bandY = 0; ok && bandY < h; bandY += bandHeight) {
+        const int bandH = std::min(bandHeight, h - bandY);
+        doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, y + bandY, w, bandH, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
+        SplashBitmap *bitmap = splashOut->getBitmap();
+        if (!writer) {
+            writer = SplashBitmap::createImgWriter(format, bitmap->getMode(), params, &imageWriterFormat);
+            ok = writer && writer->init(f, bitmap->getWidth(), h, x_resolution, y_resolution);
+        }
+        ok = ok && bitmap->getHeight() == bandH && bitmap->writeImgRows(writer.get(), imageWriterFormat) == SplashError::NoError;
+    }
+    ok = ok && writer->close();
+
+    if (f == stdout) {
+        fflush(f);
+    } else {
+        fclose(f);
+    }
+    return ok;
+}
+
 static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x, int y, int w, int h, double pg_w, double pg_h, char *ppmFile)
 {
     if (w == 0) {
@@ -289,21 +337,34 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
     }
     w = (x + w > pg_w ? static_cast<int>(ceil(pg_w - x)) : w);
     h = (y + h > pg_h ? static_cast<int>(ceil(pg_h - y)) : h);
-    doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, y, w, h, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
-
-    SplashBitmap *bitmap = splashOut->getBitmap();
 
     SplashBitmap::WriteImgParams params;
     params.jpegQuality = jpegQuality;
     params.jpegProgressive = jpegProgressive;
     params.jpegOptimize = jpegOptimize;
     params.tiffCompression = TiffCompressionStr;
+    params.pngCompressionThreads = std::max(pngThreads, 0);
+
+    if (bandHeight > 0 && h > bandHeight && (png || jpeg || jpegcmyk || tiff)) {
+        if (!savePageBands(doc, splashOut, pg, x, y, w, h, ppmFile, &params)) {
+            fprintf(stderr, "Could not write image to %s; exiting\n", ppmFile != nullptr ? ppmFile : "stdout");
+            exit(EXIT_FAILURE);
+        }
+        if (progress) {
+            fprintf(stderr, "%d %d %s\n", pg, lastPage, ppmFile != nullptr ? ppmFile : "");
+        }
+        return;
+    }
+
+    doc->displayPageSlice(splashOut, pg, x_resolution, y_resolution, 0, !useCropBox, false, false, x, y, w, h, nullptr, nullptr, annotDisplayDecideCbk, nullptr);
+
+    SplashBitmap *bitmap = splashOut->getBitmap();
 
     if (ppmFile != nullptr) {
         SplashError e;
 
         if (png) {
-            e = bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
+            e = bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution, &params);
         } else if (jpeg) {
             e = bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution, &params);
         } else if (jpegcmyk) {
@@ -323,7 +384,7 @@ static void savePageSlice(PDFDoc *doc, SplashOutputDev *splashOut, int pg, int x
 #endif
 
         if (png) {
-            bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
+            bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution, &params);
         } else if (jpeg) {
             bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution, &params);
         } else if (tiff) {
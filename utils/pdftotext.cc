@@ -410,6 +410,7 @@ int main(int argc, char *argv[])
                 textOut.setMinColSpacing1(colspacing);
                 textOut.setEndOfLineHyphenMode(hyphenMode);
                 textOut.setInlineLinkURIs(printURLs);
+                textOut.setStreamOnly(true);
                 if (noPageBreaks) {
                     textOut.setTextPageBreaks(false);
                 }
@@ -26,6 +26,8 @@
 #include "parseargs.h"
 #include "config.h"
 #include <poppler-config.h>
+#include <optional>
+#include <string>
 #include <vector>
 
 static bool printVersion = false;
@@ -134,22 +136,77 @@ static bool doMergeFormDict(Dict *srcFormDict, Dict *mergeFormDict, int numOffse
     return true;
 }
 
+// The OutputConditionIdentifiers of the output intents of <doc>, or
+// nothing if it has no output intents.
+static std::optional<std::vector<std::string>> getOutputIntentIds(PDFDoc *doc)
+{
+    Object catObj = doc->getXRef()->getCatalog();
+    Object intents = catObj.dictLookup("OutputIntents");
+    if (!intents.isArrayOfLengthAtLeast(1)) {
+        return {};
+    }
+    std::vector<std::string> ids;
+    for (int i = 0; i < intents.arrayGetLength(); i++) {
+        Object intent = intents.arrayGet(i, 0);
+        if (intent.isDict()) {
+            Object idf = intent.dictLookup("OutputConditionIdentifier");
+            if (idf.isString()) {
+                ids.push_back(idf.getString());
+            }
+        }
+    }
+    return ids;
+}
+
+// Write the entries of a page dictionary to strings, so that its
+// document can be closed before the page tree is written.  The result
+// is split around the Parent entries, which are only known once all the
+// documents have been merged.
+static std::vector<std::string> writePageDict(Dict *pageDict, XRef *yRef, unsigned int numOffset)
+{
+    std::vector<std::string> pieces;
+    StringOutStream str;
+    for (int j = 0; j < pageDict->getLength(); j++) {
+        if (j > 0) {
+            str.printf(" ");
+        }
+        const std::string &key = pageDict->getKey(j);
+        if (key == "Parent") {
+            pieces.push_back(std::move(str.getString()));
+            str.getString().clear();
+        } else {
+            Object value = pageDict->getValNF(j).copy();
+            str.printf("/%s ", key.c_str());
+            PDFDoc::writeObject(&value, &str, yRef, numOffset, nullptr, cryptRC4, 0, 0, 0);
+        }
+    }
+    pieces.push_back(std::move(str.getString()));
+    return pieces;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 int main(int argc, char *argv[])
 ///////////////////////////////////////////////////////////////////////////
 // Merge PDF files given by arguments 1 to argc-2 and write the result
 // to the file specified by argument argc-1.
+//
+// The files are merged one after the other: the objects of each file are
+// written as soon as it has been read, and the file is closed before the
+// next one is opened.  Only the file whose catalog entries the ones of
+// the others are merged into (usually the first one) is kept open until
+// the end.
 ///////////////////////////////////////////////////////////////////////////
 {
     int objectsCount = 0;
     unsigned int numOffset = 0;
-    std::vector<Object> pages;
-    std::vector<unsigned int> offsets;
+    std::vector<std::vector<std::string>> pages;
     XRef *yRef, *countRef;
     FILE *f;
     OutStream *outStr;
     int rootNum;
-    std::vector<std::unique_ptr<PDFDoc>> docs;
+    std::unique_ptr<PDFDoc> firstDoc;
+    std::unique_ptr<PDFDoc> formDoc;
+    std::vector<std::optional<std::vector<std::string>>> docIntentIds;
     int majorVersion = 0;
     int minorVersion = 0;
     char *fileName = argv[argc - 1];
@@ -169,6 +226,8 @@ int main(int argc, char *argv[])
     }
     globalParams = std::make_unique<GlobalParams>();
 
+    // Check all the files, and find the version and output intents of the
+    // result, before writing anything
     for (int i = 1; i < argc - 1; i++) {
         std::unique_ptr<PDFDoc> doc = std::make_unique<PDFDoc>(std::make_unique<GooString>(argv[i]));
         if (doc->isOk() && !doc->isEncrypted() && doc->getXRef()->getCatalog().isDict()) {
@@ -180,7 +239,10 @@ int main(int argc, char *argv[])
                     minorVersion = doc->getPDFMinorVersion();
                 }
             }
-            docs.push_back(std::move(doc));
+            docIntentIds.push_back(getOutputIntentIds(doc.get()));
+            if (!firstDoc) {
+                firstDoc = std::move(doc);
+            }
         } else if (doc->isOk()) {
             if (doc->isEncrypted()) {
                 error(errUnimplemented, -1, "Could not merge encrypted files ('{0:s}')", argv[i]);
@@ -212,8 +274,8 @@ int main(int argc, char *argv[])
     Object names;
     Object afObj;
     Object ocObj;
-    if (!docs.empty()) {
-        Object catObj = docs[0]->getXRef()->getCatalog();
+    if (firstDoc) {
+        Object catObj = firstDoc->getXRef()->getCatalog();
         if (!catObj.isDict()) {
             fclose(f);
             delete yRef;
@@ -225,24 +287,22 @@ int main(int argc, char *argv[])
         Dict *catDict = catObj.getDict();
         intentsObj = catDict->lookup("OutputIntents");
         afObj = catDict->lookupNF("AcroForm").copy();
-        Ref *refPage = docs[0]->getCatalog()->getPageRef(1);
+        Ref *refPage = firstDoc->getCatalog()->getPageRef(1);
         if (!afObj.isNull() && refPage) {
-            docs[0]->markAcroForm(&afObj, yRef, countRef, 0, refPage->num, refPage->num);
+            firstDoc->markAcroForm(&afObj, yRef, countRef, 0, refPage->num, refPage->num);
         }
         ocObj = catDict->lookupNF("OCProperties").copy();
         if (!ocObj.isNull() && ocObj.isDict() && refPage) {
-            docs[0]->markPageObjects(ocObj.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+            firstDoc->markPageObjects(ocObj.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
         }
         names = catDict->lookup("Names");
         if (!names.isNull() && names.isDict() && refPage) {
-            docs[0]->markPageObjects(names.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
+            firstDoc->markPageObjects(names.getDict(), yRef, countRef, 0, refPage->num, refPage->num);
         }
         if (intentsObj.isArrayOfLengthAtLeast(1)) {
-            for (size_t i = 1; i < docs.size(); i++) {
-                Object pagecatObj = docs[i]->getXRef()->getCatalog();
-                Dict *pagecatDict = pagecatObj.getDict();
-                Object pageintents = pagecatDict->lookup("OutputIntents");
-                if (pageintents.isArrayOfLengthAtLeast(1)) {
+            for (size_t i = 1; i < docIntentIds.size(); i++) {
+                const std::optional<std::vector<std::string>> &pageIntentIds = docIntentIds[i];
+                if (pageIntentIds) {
                     Array *intents = intentsObj.getArray();
                     for (int j = intents->getLength() - 1; j >= 0; j--) {
                         Object intent = intents->get(j, 0);
@@ -251,22 +311,15 @@ int main(int argc, char *argv[])
                             if (idf.isString()) {
                                 const std::string &gidf = idf.getString();
                                 bool removeIntent = true;
-                                for (int k = 0; k < pageintents.arrayGetLength(); k++) {
-                                    Object pgintent = pageintents.arrayGet(k, 0);
-                                    if (pgintent.isDict()) {
-                                        Object pgidf = pgintent.dictLookup("OutputConditionIdentifier");
-                                        if (pgidf.isString()) {
-                                            const std::string &gpgidf = pgidf.getString();
-                                            if (gpgidf == gidf) {
-                                                removeIntent = false;
-                                                break;
-                                            }
-                                        }
+                                for (const std::string &gpgidf : *pageIntentIds) {
+                                    if (gpgidf == gidf) {
+                                        removeIntent = false;
+                                        break;
                                     }
                                 }
                                 if (removeIntent) {
                                     intents->remove(j);
-                                    error(errSyntaxWarning, -1, "Output intent {0:s} missing in pdf {1:s}, removed", gidf.c_str(), docs[i]->getFileName()->c_str());
+                                    error(errSyntaxWarning, -1, "Output intent {0:s} missing in pdf {1:s}, removed", gidf.c_str(), argv[i + 1]);
                                 }
                             } else {
                                 intents->remove(j);
@@ -288,7 +341,7 @@ int main(int argc, char *argv[])
             for (int j = intents->getLength() - 1; j >= 0; j--) {
                 Object intent = intents->get(j, 0);
                 if (intent.isDict()) {
-                    docs[0]->markPageObjects(intent.getDict(), yRef, countRef, numOffset, 0, 0);
+                    firstDoc->markPageObjects(intent.getDict(), yRef, countRef, numOffset, 0, 0);
                 } else {
                     intents->remove(j);
                 }
@@ -296,17 +349,32 @@ int main(int argc, char *argv[])
         }
     }
 
-    for (size_t i = 0; i < docs.size(); i++) {
-        for (int j = 1; j <= docs[i]->getNumPages(); j++) {
-            if (!docs[i]->getCatalog()->getPage(j)) {
+    for (size_t i = 0; i < docIntentIds.size(); i++) {
+        std::unique_ptr<PDFDoc> nextDoc;
+        PDFDoc *doc = firstDoc.get();
+        if (i > 0) {
+            nextDoc = std::make_unique<PDFDoc>(std::make_unique<GooString>(argv[i + 1]));
+            if (!nextDoc->isOk()) {
+                fclose(f);
+                delete yRef;
+                delete countRef;
+                delete outStr;
+                error(errSyntaxError, -1, "Could not merge damaged documents ('{0:s}')", argv[i + 1]);
+                return -1;
+            }
+            doc = nextDoc.get();
+        }
+        std::vector<Object> docPages;
+        for (int j = 1; j <= doc->getNumPages(); j++) {
+            if (!doc->getCatalog()->getPage(j)) {
                 continue;
             }
 
             const PDFRectangle *cropBox = nullptr;
-            if (docs[i]->getCatalog()->getPage(j)->isCropped()) {
-                cropBox = &docs[i]->getCatalog()->getPage(j)->getCropBox();
+            if (doc->getCatalog()->getPage(j)->isCropped()) {
+                cropBox = &doc->getCatalog()->getPage(j)->getCropBox();
             }
-            if (!docs[i]->replacePageDict(j, docs[i]->getCatalog()->getPage(j)->getRotate(), docs[i]->getCatalog()->getPage(j)->getMediaBox(), cropBox)) {
+            if (!doc->replacePageDict(j, doc->getCatalog()->getPage(j)->getRotate(), doc->getCatalog()->getPage(j)->getMediaBox(), cropBox)) {
                 fclose(f);
                 delete yRef;
                 delete countRef;
@@ -314,22 +382,21 @@ int main(int argc, char *argv[])
                 error(errSyntaxError, -1, "PDFDoc::replacePageDict failed.");
                 return -1;
             }
-            Ref *refPage = docs[i]->getCatalog()->getPageRef(j);
-            Object page = docs[i]->getXRef()->fetch(*refPage);
+            Ref *refPage = doc->getCatalog()->getPageRef(j);
+            Object page = doc->getXRef()->fetch(*refPage);
             Dict *pageDict = page.getDict();
-            Object *resDict = docs[i]->getCatalog()->getPage(j)->getResourceDictObject();
+            Object *resDict = doc->getCatalog()->getPage(j)->getResourceDictObject();
             if (resDict->isDict()) {
                 pageDict->set("Resources", resDict->copy());
             }
-            pages.push_back(std::move(page));
-            offsets.push_back(numOffset);
-            docs[i]->markPageObjects(pageDict, yRef, countRef, numOffset, refPage->num, refPage->num);
+            doc->markPageObjects(pageDict, yRef, countRef, numOffset, refPage->num, refPage->num);
             Object annotsObj = pageDict->lookupNF("Annots").copy();
             if (!annotsObj.isNull()) {
-                docs[i]->markAnnotations(&annotsObj, yRef, countRef, numOffset, refPage->num, refPage->num);
+                doc->markAnnotations(&annotsObj, yRef, countRef, numOffset, refPage->num, refPage->num);
             }
+            docPages.push_back(std::move(page));
         }
-        Object pageCatObj = docs[i]->getXRef()->getCatalog();
+        Object pageCatObj = doc->getXRef()->getCatalog();
         if (!pageCatObj.isDict()) {
             fclose(f);
             delete yRef;
@@ -344,12 +411,15 @@ int main(int argc, char *argv[])
             if (!names.isDict()) {
                 names = Object(std::make_unique<Dict>(yRef));
             }
-            doMergeNameDict(docs[i].get(), yRef, countRef, 0, 0, names.getDict(), pageNames.getDict(), numOffset);
+            doMergeNameDict(doc, yRef, countRef, 0, 0, names.getDict(), pageNames.getDict(), numOffset);
         }
         Object pageForm = pageCatDict->lookup("AcroForm");
         if (i > 0 && !pageForm.isNull() && pageForm.isDict()) {
             if (afObj.isNull()) {
                 afObj = pageCatDict->lookupNF("AcroForm").copy();
+                // the fields of the following documents are merged into
+                // this AcroForm, so keep its document open
+                formDoc = std::move(nextDoc);
             } else if (afObj.isDict()) {
                 if (!doMergeFormDict(afObj.getDict(), pageForm.getDict(), numOffset)) {
                     fclose(f);
@@ -360,7 +430,10 @@ int main(int argc, char *argv[])
                 }
             }
         }
-        objectsCount += docs[i]->writePageObjects(outStr, yRef, numOffset, true);
+        objectsCount += doc->writePageObjects(outStr, yRef, numOffset, true);
+        for (Object &page : docPages) {
+            pages.push_back(writePageDict(page.getDict(), yRef, numOffset));
+        }
         numOffset = yRef->getNumObjects() + 1;
     }
 
@@ -410,19 +483,12 @@ int main(int argc, char *argv[])
         yRef->add(rootNum + i + 2, 0, outStr->getPos(), true);
         outStr->printf("%zu 0 obj\n", rootNum + i + 2);
         outStr->printf("<< ");
-        Dict *pageDict = pages[i].getDict();
-        for (int j = 0; j < pageDict->getLength(); j++) {
+        for (size_t j = 0; j < pages[i].size(); j++) {
             if (j > 0) {
-                outStr->printf(" ");
-            }
-            const std::string &key = pageDict->getKey(j);
-            Object value = pageDict->getValNF(j).copy();
-            if (key == "Parent") {
                 outStr->printf("/Parent %d 0 R", rootNum + 1);
-            } else {
-                outStr->printf("/%s ", key.c_str());
-                PDFDoc::writeObject(&value, outStr, yRef, offsets[i], nullptr, cryptRC4, 0, 0, 0);
             }
+            const std::string &piece = pages[i][j];
+            outStr->write(std::span(reinterpret_cast<const unsigned char *>(piece.data()), piece.size()));
         }
         outStr->printf(" >>\nendobj\n");
         objectsCount++;